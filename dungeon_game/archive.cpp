@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include <algorithm>
+
+#include "archive.h"
+#include "dungeon.h"
+#include "save.h"
+
+#define ARCHIVE_ENTRY_SIZE 16  /* On disk: seed, length, offset */
+
+/* A member of an archive being written: from the old archive, or a file */
+typedef struct archive_member {
+  uint32_t seed;
+  uint32_t order;           /* Later arguments replace earlier ones */
+  const uint8_t *data;      /* In the old archive, or NULL */
+  uint32_t length;
+  std::string file;
+} archive_member_t;
+
+static inline uint32_t get_be32(const uint8_t *p)
+{
+  uint32_t be32;
+
+  memcpy(&be32, p, sizeof (be32));
+
+  return be32toh(be32);
+}
+
+static inline uint64_t get_be64(const uint8_t *p)
+{
+  uint64_t be64;
+
+  memcpy(&be64, p, sizeof (be64));
+
+  return be64toh(be64);
+}
+
+static inline void put_be32(uint8_t *p, uint32_t v)
+{
+  v = htobe32(v);
+  memcpy(p, &v, sizeof (v));
+}
+
+static inline void put_be64(uint8_t *p, uint64_t v)
+{
+  v = htobe64(v);
+  memcpy(p, &v, sizeof (v));
+}
+
+static void get_entry(const uint8_t *archive, uint32_t i, archive_entry_t *e)
+{
+  const uint8_t *p;
+
+  p = archive + get_be64(archive + 16) + i * ARCHIVE_ENTRY_SIZE;
+  e->seed = get_be32(p);
+  e->length = get_be32(p + 4);
+  e->offset = get_be64(p + 8);
+}
+
+const uint8_t *archive_map(const char *path, size_t *size)
+{
+  struct stat buf;
+  const uint8_t *archive;
+  uint64_t count, index;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) < 0) {
+    perror(path);
+    return NULL;
+  }
+  if (fstat(fd, &buf)) {
+    perror(path);
+    close(fd);
+    return NULL;
+  }
+  if (buf.st_size < ARCHIVE_HEADER_SIZE) {
+    fprintf(stderr, "%s: Not an RLG327 archive.\n", path);
+    close(fd);
+    return NULL;
+  }
+  if ((archive = (const uint8_t *) mmap(NULL, buf.st_size, PROT_READ,
+                                        MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+    perror(path);
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+
+  /* Only the header is checked here; members are checked as they're *
+   * found, so that opening a huge archive doesn't read all of it.    */
+  count = get_be32(archive + 10);
+  index = get_be64(archive + 16);
+  if (memcmp(archive, ARCHIVE_SEMANTIC, strlen(ARCHIVE_SEMANTIC)) ||
+      get_be32(archive + 6) != ARCHIVE_VERSION ||
+      index < ARCHIVE_HEADER_SIZE || index > (uint64_t) buf.st_size ||
+      count * ARCHIVE_ENTRY_SIZE != buf.st_size - index) {
+    fprintf(stderr, "%s: Not an RLG327 archive.\n", path);
+    munmap((void *) archive, buf.st_size);
+    return NULL;
+  }
+  *size = buf.st_size;
+
+  return archive;
+}
+
+void archive_unmap(const uint8_t *archive, size_t size)
+{
+  munmap((void *) archive, size);
+}
+
+const uint8_t *archive_find(const uint8_t *archive, size_t size,
+                            uint32_t seed, uint32_t *length)
+{
+  archive_entry_t e;
+  uint32_t lo, hi, mid;
+  uint64_t index;
+
+  index = get_be64(archive + 16);
+  for (lo = 0, hi = get_be32(archive + 10); lo < hi; ) {
+    mid = lo + (hi - lo) / 2;
+    get_entry(archive, mid, &e);
+    if (e.seed < seed) {
+      lo = mid + 1;
+    } else if (e.seed > seed) {
+      hi = mid;
+    } else {
+      if (e.offset < ARCHIVE_HEADER_SIZE || e.offset > index ||
+          e.length > index - e.offset) {
+        fprintf(stderr, "Corrupt archive entry for seed %u.\n", seed);
+        return NULL;
+      }
+      *length = e.length;
+
+      return archive + e.offset;
+    }
+  }
+
+  return NULL;
+}
+
+/* <seed>.rlg327, as written by --generate, or -1 for anything else. */
+static int64_t seed_from_name(const char *path)
+{
+  const char *name;
+  uint32_t seed;
+  int end;
+
+  name = (name = strrchr(path, '/')) ? name + 1 : path;
+  end = 0;
+  if (sscanf(name, "%u.rlg327%n", &seed, &end) != 1 ||
+      !end || name[end] || !(name[0] >= '0' && name[0] <= '9')) {
+    return -1;
+  }
+
+  return seed;
+}
+
+static int add_file(std::vector<archive_member_t> &members, const char *path)
+{
+  archive_member_t m;
+  struct stat buf;
+  struct dirent *de;
+  DIR *dir;
+  int64_t seed;
+  std::string child;
+
+  if (stat(path, &buf)) {
+    perror(path);
+    return 1;
+  }
+
+  if (S_ISDIR(buf.st_mode)) {
+    if (!(dir = opendir(path))) {
+      perror(path);
+      return 1;
+    }
+    while ((de = readdir(dir))) {
+      if (seed_from_name(de->d_name) >= 0) {
+        child = std::string(path) + "/" + de->d_name;
+        if (add_file(members, child.c_str())) {
+          closedir(dir);
+          return 1;
+        }
+      }
+    }
+    closedir(dir);
+
+    return 0;
+  }
+
+  if ((seed = seed_from_name(path)) < 0) {
+    fprintf(stderr, "%s: Members must be named <seed>.rlg327.\n", path);
+    return 1;
+  }
+  m.seed = seed;
+  m.order = members.size();
+  m.data = NULL;
+  m.length = buf.st_size;
+  m.file = path;
+  members.push_back(m);
+
+  return 0;
+}
+
+static bool member_before(const archive_member_t &a, const archive_member_t &b)
+{
+  return a.seed < b.seed || (a.seed == b.seed && a.order < b.order);
+}
+
+static int write_padding(FILE *f, uint64_t *offset)
+{
+  static const uint8_t zero[ARCHIVE_ALIGN] = { 0 };
+  uint32_t pad;
+
+  pad = (ARCHIVE_ALIGN - *offset % ARCHIVE_ALIGN) % ARCHIVE_ALIGN;
+  *offset += pad;
+
+  return fwrite(zero, 1, pad, f) != pad;
+}
+
+/* Copies a save file into the archive, checking that it is one. */
+static int write_file_member(FILE *f, archive_member_t *m)
+{
+  uint8_t *data;
+  FILE *in;
+  int retval;
+
+  if (!(in = fopen(m->file.c_str(), "r"))) {
+    perror(m->file.c_str());
+    return 1;
+  }
+  data = (uint8_t *) malloc(m->length ? m->length : 1);
+  retval = 0;
+  if (fread(data, 1, m->length, in) != m->length ||
+      m->length < 14 /* The semantic, version, and size */ ||
+      memcmp(data, DUNGEON_SAVE_SEMANTIC, strlen(DUNGEON_SAVE_SEMANTIC)) ||
+      get_be32(data + 10) != m->length) {
+    fprintf(stderr, "%s: Not an RLG327 save file.\n", m->file.c_str());
+    retval = 1;
+  } else if (fwrite(data, 1, m->length, f) != m->length) {
+    retval = 1;
+  }
+  free(data);
+  fclose(in);
+
+  return retval;
+}
+
+int archive_append(const char *path, char **files, uint32_t count)
+{
+  std::vector<archive_member_t> members, merged;
+  std::vector<archive_entry_t> index;
+  archive_member_t m;
+  archive_entry_t e;
+  const uint8_t *old;
+  uint8_t header[ARCHIVE_HEADER_SIZE], entry[ARCHIVE_ENTRY_SIZE];
+  uint64_t offset;
+  size_t old_size;
+  uint32_t i, added;
+  std::string tmp;
+  struct stat buf;
+  FILE *f;
+  int failed;
+
+  old = NULL;
+  old_size = 0;
+  if (!stat(path, &buf) && !(old = archive_map(path, &old_size))) {
+    return 1;
+  }
+
+  /* The old members come first, so that new files with the same seed *
+   * sort after them and replace them.                                 */
+  for (i = 0; old && i < get_be32(old + 10); i++) {
+    get_entry(old, i, &e);
+    if (e.offset < ARCHIVE_HEADER_SIZE || e.offset > old_size ||
+        e.length > old_size - e.offset) {
+      fprintf(stderr, "%s: Corrupt archive entry for seed %u.\n",
+              path, e.seed);
+      archive_unmap(old, old_size);
+      return 1;
+    }
+    m.seed = e.seed;
+    m.order = members.size();
+    m.data = old + e.offset;
+    m.length = e.length;
+    members.push_back(m);
+  }
+  added = members.size();
+  for (i = 0; i < count; i++) {
+    if (add_file(members, files[i])) {
+      if (old) {
+        archive_unmap(old, old_size);
+      }
+      return 1;
+    }
+  }
+  added = members.size() - added;
+
+  std::sort(members.begin(), members.end(), member_before);
+  for (i = 0; i < members.size(); i++) {
+    if (i + 1 < members.size() && members[i + 1].seed == members[i].seed) {
+      continue;
+    }
+    merged.push_back(members[i]);
+  }
+
+  tmp = std::string(path) + ".tmp";
+  if (!(f = fopen(tmp.c_str(), "w"))) {
+    perror(tmp.c_str());
+    if (old) {
+      archive_unmap(old, old_size);
+    }
+    return 1;
+  }
+
+  errno = 0;
+  memset(header, 0, sizeof (header));
+  failed = fwrite(header, 1, sizeof (header), f) != sizeof (header);
+  for (offset = ARCHIVE_HEADER_SIZE, i = 0;
+       !failed && i < merged.size();
+       i++) {
+    failed = write_padding(f, &offset);
+    e.seed = merged[i].seed;
+    e.length = merged[i].length;
+    e.offset = offset;
+    index.push_back(e);
+    if (merged[i].data) {
+      failed = failed || (fwrite(merged[i].data, 1, merged[i].length, f) !=
+                          merged[i].length);
+    } else {
+      failed = failed || write_file_member(f, &merged[i]);
+    }
+    offset += merged[i].length;
+  }
+  failed = failed || write_padding(f, &offset);
+
+  /* The index, and then the header that points at it */
+  for (i = 0; !failed && i < index.size(); i++) {
+    put_be32(entry, index[i].seed);
+    put_be32(entry + 4, index[i].length);
+    put_be64(entry + 8, index[i].offset);
+    failed = fwrite(entry, 1, sizeof (entry), f) != sizeof (entry);
+  }
+  memcpy(header, ARCHIVE_SEMANTIC, strlen(ARCHIVE_SEMANTIC));
+  put_be32(header + 6, ARCHIVE_VERSION);
+  put_be32(header + 10, index.size());
+  put_be64(header + 16, offset);
+  failed = (failed || fseek(f, 0, SEEK_SET) ||
+            fwrite(header, 1, sizeof (header), f) != sizeof (header) ||
+            fflush(f) || fsync(fileno(f)));
+  if (failed && errno) {
+    perror(tmp.c_str());
+  }
+  failed = fclose(f) || failed;
+
+  if (old) {
+    archive_unmap(old, old_size);
+  }
+
+  if (failed || rename(tmp.c_str(), path)) {
+    if (!failed) {
+      perror(path);
+    }
+    unlink(tmp.c_str());
+    return 1;
+  }
+
+  printf("%s: %u levels added, %lu in the archive.\n",
+         path, added, (unsigned long) index.size());
+
+  return 0;
+}
+
+int archive_list(const char *path)
+{
+  const uint8_t *archive;
+  archive_entry_t e;
+  uint32_t i, count, version;
+  size_t size;
+
+  if (!(archive = archive_map(path, &size))) {
+    return 1;
+  }
+
+  count = get_be32(archive + 10);
+  printf("%10s %8s %10s  %s\n", "seed", "bytes", "offset", "format");
+  for (i = 0; i < count; i++) {
+    get_entry(archive, i, &e);
+    version = (e.length >= 14 && e.offset + 14 <= size ?
+               get_be32(archive + e.offset + 6) : 0);
+    printf("%10u %8u %10lu  version %u%s\n", e.seed, e.length,
+           (unsigned long) e.offset, version & ~DUNGEON_SAVE_COMPRESSED,
+           (version & DUNGEON_SAVE_COMPRESSED) ? ", compressed" : "");
+  }
+  printf("%u levels, %lu bytes\n", count, (unsigned long) size);
+
+  archive_unmap(archive, size);
+
+  return 0;
+}
+
+int archive_extract(const char *path, uint32_t seed, const char *out)
+{
+  const uint8_t *archive, *member;
+  char filename[PATH_MAX];
+  uint32_t length;
+  size_t size;
+  int retval;
+
+  if (!(archive = archive_map(path, &size))) {
+    return 1;
+  }
+  if (!(member = archive_find(archive, size, seed, &length))) {
+    fprintf(stderr, "%s: No level with seed %u.\n", path, seed);
+    archive_unmap(archive, size);
+    return 1;
+  }
+
+  if (!out) {
+    snprintf(filename, sizeof (filename), "%u.rlg327", seed);
+    out = filename;
+  }
+  if ((retval = save_file_write(out, member, length))) {
+    perror(out);
+  }
+
+  archive_unmap(archive, size);
+
+  return retval;
+}
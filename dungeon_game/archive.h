@@ -0,0 +1,51 @@
+#ifndef ARCHIVE_H
+# define ARCHIVE_H
+
+# include <stdint.h>
+# include <stddef.h>
+
+/* Many save files in one, for corpora too big to keep as a file per  *
+ * level.  Everything is big-endian, like the save file header:       *
+ *                                                                    *
+ *   0   "RLA327"                                                     *
+ *   6   version, 4 bytes                                             *
+ *   10  number of entries, 4 bytes                                   *
+ *   14  two bytes of padding                                         *
+ *   16  offset of the index, 8 bytes                                 *
+ *   24  the save files, each starting at a multiple of ARCHIVE_ALIGN *
+ *       so that snapshots can be loaded in place from a mapping      *
+ *   ... the index: one archive_entry_t per save file, sorted by seed *
+ *                                                                    *
+ * Members are named by their seed, as in a --generate corpus, and an *
+ * archive holds at most one of each.  Adding to an archive rewrites  *
+ * it, so that a crash never leaves it half-updated.                  */
+
+# define ARCHIVE_SEMANTIC    "RLA327"
+# define ARCHIVE_VERSION     0U
+# define ARCHIVE_HEADER_SIZE 24
+# define ARCHIVE_ALIGN       8
+# define ARCHIVE_EXTENSION   ".rla"
+
+typedef struct archive_entry {
+  uint32_t seed;
+  uint32_t length;
+  uint64_t offset;
+} archive_entry_t;
+
+/* Maps an archive and checks its header; NULL on failure. */
+const uint8_t *archive_map(const char *path, size_t *size);
+void archive_unmap(const uint8_t *archive, size_t size);
+/* Binary search of the index of a mapped archive.  Returns the member *
+ * in place, or NULL if there's no level with that seed.               */
+const uint8_t *archive_find(const uint8_t *archive, size_t size,
+                            uint32_t seed, uint32_t *length);
+
+/* The tools.  Files given to archive_append() may be directories, in   *
+ * which case every <seed>.rlg327 in them is added.  An archive that   *
+ * doesn't exist yet is created.  Extracting with a NULL out writes     *
+ * <seed>.rlg327 in the working directory.                              */
+int archive_append(const char *path, char **files, uint32_t count);
+int archive_list(const char *path);
+int archive_extract(const char *path, uint32_t seed, const char *out);
+
+#endif
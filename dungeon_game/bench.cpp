@@ -0,0 +1,684 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "dungeon.h"
+#include "path.h"
+#include "pc.h"
+#include "npc.h"
+#include "character.h"
+#include "codec.h"
+#include "descriptions.h"
+#include "spawn.h"
+#include "move.h"
+#include "io.h"
+#include "decide.h"
+
+/* Microbenchmarks for the hot loops.  Build with 'make bench' and run  *
+ * ./rlg327-bench [name...]; with no arguments, everything is run.  A   *
+ * fixed seed is used so that runs are comparable from build to build.  */
+
+#define BENCH_SEED 1
+
+typedef grid<GRID_DYNAMIC, GRID_DYNAMIC, terrain_type_t> dyn_map_t;
+typedef grid<GRID_DYNAMIC, GRID_DYNAMIC, uint8_t> dyn_byte_t;
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void report(const char *name, double seconds, uint32_t iterations)
+{
+  printf("%-32s %12.3f us/op %10u ops\n",
+         name, seconds * 1000000.0 / iterations, iterations);
+}
+
+static void bench_setup(dungeon_t *d)
+{
+  rng_seed(BENCH_SEED);
+  init_dungeon(d);
+  gen_dungeon(d);
+  config_pc(d);
+}
+
+static void copy_to_dynamic(dungeon_t *d, dyn_map_t *map, dyn_byte_t *hard)
+{
+  uint32_t x, y;
+
+  map->init(DUNGEON_X, DUNGEON_Y, ter_wall);
+  hard->init(DUNGEON_X, DUNGEON_Y, 0);
+  for (y = 0; y < DUNGEON_Y; y++) {
+    for (x = 0; x < DUNGEON_X; x++) {
+      (*map)[y][x] = d->map[y][x];
+      (*hard)[y][x] = d->hardness[y][x];
+    }
+  }
+}
+
+/* Fixed grid<80, 21> against the GRID_DYNAMIC instantiation of the *
+ * same engines, on the same level.                                  */
+static void bench_grid(dungeon_t *d)
+{
+  dyn_map_t map;
+  dyn_byte_t hard, dist, tunnel, downhill;
+  uint32_t i, n, x, y, seen;
+  pair_t a, b;
+  no_observer o;
+  double t;
+
+  copy_to_dynamic(d, &map, &hard);
+  dist.init(DUNGEON_X, DUNGEON_Y, 255);
+  tunnel.init(DUNGEON_X, DUNGEON_Y, 255);
+  x = character_get_x(d, PC_ID);
+  y = character_get_y(d, PC_ID);
+
+  n = 5000;
+  t = now();
+  for (i = 0; i < n; i++) {
+    dijkstra_walk(d->map, d->pc_distance, x, y);
+  }
+  report("dijkstra fixed", now() - t, n);
+  t = now();
+  for (i = 0; i < n; i++) {
+    dijkstra_walk(map, dist, x, y);
+  }
+  report("dijkstra dynamic", now() - t, n);
+
+  t = now();
+  for (i = 0; i < n; i++) {
+    dijkstra_tunnel_walk(d->map, d->hardness, d->pc_tunnel, x, y);
+  }
+  report("dijkstra_tunnel fixed", now() - t, n);
+  t = now();
+  for (i = 0; i < n; i++) {
+    dijkstra_tunnel_walk(map, hard, tunnel, x, y);
+  }
+  report("dijkstra_tunnel dynamic", now() - t, n);
+
+  /* What each of the above now adds on top, for both maps */
+  t = now();
+  for (i = 0; i < n; i++) {
+    downhill_walk(d->pc_distance, d->pc_downhill);
+    downhill_tunnel(d->pc_tunnel, d->hardness, d->pc_tunnel_downhill);
+  }
+  report("downhill fixed", now() - t, n);
+  downhill.init(DUNGEON_X, DUNGEON_Y, DOWNHILL_STAY);
+  t = now();
+  for (i = 0; i < n; i++) {
+    downhill_walk(dist, downhill);
+    downhill_tunnel(tunnel, hard, downhill);
+  }
+  report("downhill dynamic", now() - t, n);
+
+  n = 2000000;
+  t = now();
+  for (seen = i = 0; i < n; i++) {
+    a[dim_x] = 1 + (i * 7) % (DUNGEON_X - 2);
+    a[dim_y] = 1 + (i * 3) % (DUNGEON_Y - 2);
+    b[dim_x] = 1 + i % (DUNGEON_X - 2);
+    b[dim_y] = 1 + (i / (DUNGEON_X - 2)) % (DUNGEON_Y - 2);
+    seen += line_of_sight(d->map, a, b, NPC_VISUAL_RANGE, o);
+  }
+  report("line_of_sight fixed", now() - t, n);
+  t = now();
+  for (i = 0; i < n; i++) {
+    a[dim_x] = 1 + (i * 7) % (DUNGEON_X - 2);
+    a[dim_y] = 1 + (i * 3) % (DUNGEON_Y - 2);
+    b[dim_x] = 1 + i % (DUNGEON_X - 2);
+    b[dim_y] = 1 + (i / (DUNGEON_X - 2)) % (DUNGEON_Y - 2);
+    seen -= line_of_sight(map, a, b, NPC_VISUAL_RANGE, o);
+  }
+  report("line_of_sight dynamic", now() - t, n);
+  if (seen) {
+    fprintf(stderr, "line_of_sight: fixed and dynamic grids disagree\n");
+  }
+
+  t = now();
+  for (i = 0; i < n; i++) {
+    a[dim_x] = 1 + i % (DUNGEON_X - 2);
+    a[dim_y] = 1 + (i / (DUNGEON_X - 2)) % (DUNGEON_Y - 2);
+    gradient_tunnel_step(d->pc_tunnel, d->hardness, a, b);
+  }
+  report("gradient_tunnel_step fixed", now() - t, n);
+  t = now();
+  for (i = 0; i < n; i++) {
+    a[dim_x] = 1 + i % (DUNGEON_X - 2);
+    a[dim_y] = 1 + (i / (DUNGEON_X - 2)) % (DUNGEON_Y - 2);
+    gradient_tunnel_step(tunnel, hard, a, b);
+  }
+  report("gradient_tunnel_step dynamic", now() - t, n);
+}
+
+/* Packing and unpacking the level's hardness, as in a compressed save. */
+static void bench_codec(dungeon_t *d)
+{
+  uint8_t raw[DUNGEON_Y * DUNGEON_X], out[DUNGEON_Y * DUNGEON_X];
+  uint8_t packed[pack_bound(DUNGEON_Y * DUNGEON_X)];
+  uint32_t i, n, y, size;
+  double t;
+
+  for (y = 0; y < DUNGEON_Y; y++) {
+    d->hardness.get_row(y, raw + y * DUNGEON_X);
+  }
+
+  n = 2000;
+  t = now();
+  for (i = 0; i < n; i++) {
+    size = pack_bytes(raw, sizeof (raw), DUNGEON_X, packed);
+  }
+  report("pack_bytes hardness", now() - t, n);
+
+  n = 200000;
+  t = now();
+  for (i = 0; i < n; i++) {
+    unpack_bytes(packed, size, out, sizeof (out));
+  }
+  report("unpack_bytes hardness", now() - t, n);
+
+  printf("%-32s %12u -> %u bytes, method %u\n", "hardness packed",
+         (uint32_t) sizeof (raw), size, packed[0]);
+  if (memcmp(raw, out, sizeof (raw))) {
+    fprintf(stderr, "unpack_bytes: round trip failed\n");
+  }
+}
+
+/* Importing a large gray map, resampled down to the dungeon. */
+static void bench_pgm(dungeon_t *d)
+{
+  char path[] = "/tmp/rlg327-bench-XXXXXX";
+  uint32_t i, n, x, y, width, height;
+  uint8_t *row;
+  terrain_type_t map[DUNGEON_Y][DUNGEON_X];
+  uint8_t hardness[DUNGEON_Y][DUNGEON_X];
+  uint32_t num_rooms;
+  room_t *rooms;
+  double t;
+  FILE *f;
+  int fd;
+
+  width = 4096;
+  height = 2048;
+  if ((fd = mkstemp(path)) < 0 || !(f = fdopen(fd, "w"))) {
+    perror(path);
+    return;
+  }
+  fprintf(f, "P5\n# rlg327-bench\n%u %u\n255\n", width, height);
+  row = (uint8_t *) malloc(width);
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      row[x] = (x / 256 + y / 256) % 3 ? (x ^ y) % 254 + 1 : 0;
+    }
+    fwrite(row, 1, width, f);
+  }
+  free(row);
+  fclose(f);
+
+  /* Put the benchmark level back afterwards */
+  for (y = 0; y < DUNGEON_Y; y++) {
+    for (x = 0; x < DUNGEON_X; x++) {
+      map[y][x] = d->map[y][x];
+      hardness[y][x] = d->hardness[y][x];
+    }
+  }
+  rooms = d->rooms;
+  num_rooms = d->num_rooms;
+
+  n = 10;
+  t = now();
+  for (i = 0; i < n; i++) {
+    read_pgm(d, path);
+    free(d->rooms);
+  }
+  report("read_pgm 4096x2048", now() - t, n);
+  unlink(path);
+
+  for (y = 0; y < DUNGEON_Y; y++) {
+    for (x = 0; x < DUNGEON_X; x++) {
+      d->map[y][x] = map[y][x];
+      d->hardness[y][x] = hardness[y][x];
+    }
+  }
+  d->rooms = rooms;
+  d->num_rooms = num_rooms;
+}
+
+/* Synthetic description files, n entries each, in dir/dungeon_game. *
+ * Entries vary in every field and list them in varying order, so    *
+ * the parser sees every path a real file would take it down.        */
+static int write_descriptions(const char *dir, uint32_t n)
+{
+  static const char *colors[] = {
+    "BLACK", "BLUE", "CYAN", "GREEN", "MAGENTA", "RED", "WHITE", "YELLOW"
+  };
+  static const char *abilities[] = {
+    "ERRATIC", "PASS", "SMART", "TELE", "TUNNEL"
+  };
+  static const char *types[] = {
+    "WEAPON", "OFFHAND", "RANGED", "LIGHT", "ARMOR", "HELMET", "CLOAK",
+    "GLOVES", "BOOTS", "AMULET", "RING", "SCROLL", "BOOK", "FLASK", "GOLD",
+    "AMMUNITION", "FOOD", "WAND", "CONTAINER"
+  };
+  static const char *dice_fields[] = {
+    "HIT", "DAM", "DODGE", "DEF", "WEIGHT", "SPEED", "ATTR", "VAL"
+  };
+  char path[PATH_MAX];
+  uint32_t i, j, k;
+  FILE *f;
+
+  snprintf(path, sizeof (path), "%s/dungeon_game/" MONSTER_DESC_FILE, dir);
+  if (!(f = fopen(path, "w"))) {
+    perror(path);
+    return 1;
+  }
+  fprintf(f, "RLG327 MONSTER DESCRIPTION 1\n");
+  for (i = 0; i < n; i++) {
+    fprintf(f, "\nBEGIN MONSTER\n");
+    if (i & 1) {
+      fprintf(f, "SPEED %u+%ud%u\nHP %u+%ud%u\n",
+              5 + i % 15, 1 + i % 3, 2 + i % 9, 10 + i % 90, i % 4, 6);
+    }
+    fprintf(f, "NAME Synthetic Monster %u\nSYMB %c\nCOLOR",
+            i, 'A' + i % 26);
+    for (j = 0; j <= i % 3; j++) {
+      fprintf(f, " %s", colors[(i + j) % 8]);
+    }
+    fprintf(f, "\nDESC\n");
+    for (j = 0; j <= i % 5; j++) {
+      fprintf(f, "Line %u of the description of synthetic monster %u, "
+              "which is long.\n", j, i);
+    }
+    fprintf(f, ".\nABIL");
+    for (j = 0; j <= i % 5; j++) {
+      fprintf(f, " %s", abilities[(i * 7 + j) % 5]);
+    }
+    fprintf(f, "\nDAM %u+%ud%u\n", i % 20, 1 + i % 4, 4 + i % 8);
+    if (!(i & 1)) {
+      fprintf(f, "HP %u+%ud%u\nSPEED %u+%ud%u\n",
+              10 + i % 90, i % 4, 6, 5 + i % 15, 1 + i % 3, 2 + i % 9);
+    }
+    fprintf(f, "END\n");
+  }
+  if (fclose(f)) {
+    perror(path);
+    return 1;
+  }
+
+  snprintf(path, sizeof (path), "%s/dungeon_game/" OBJECT_DESC_FILE, dir);
+  if (!(f = fopen(path, "w"))) {
+    perror(path);
+    return 1;
+  }
+  fprintf(f, "RLG327 OBJECT DESCRIPTION 1\n");
+  for (i = 0; i < n; i++) {
+    fprintf(f, "\nBEGIN OBJECT\nNAME synthetic object %u\n"
+            "TYPE %s\nCOLOR %s\nDESC\n", i, types[i % 19], colors[i % 8]);
+    for (j = 0; j <= i % 3; j++) {
+      fprintf(f, "Line %u of the description of synthetic object %u.\n",
+              j, i);
+    }
+    fprintf(f, ".\n");
+    for (j = 0; j < 8; j++) {
+      k = (i + j) % 8;
+      fprintf(f, "%s %d+%ud%u\n", dice_fields[k],
+              (int) (i % 7) - 3, i % 3, 1 + (i + k) % 6);
+    }
+    fprintf(f, "END\n");
+  }
+  if (fclose(f)) {
+    perror(path);
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Startup: parsing 100,000 of each kind of description */
+static void bench_descriptions(dungeon_t *d)
+{
+  std::vector<monster_description> monsters;
+  std::vector<object_description> objects;
+  char dir[] = "/tmp/rlg327-bench-XXXXXX";
+  char path[PATH_MAX], *home;
+  struct timeval past[2];
+  uint32_t n;
+  double t;
+
+  n = 100000;
+  gettimeofday(past, NULL);
+  past[0].tv_sec -= 60;
+  past[1] = past[0];
+  if (!mkdtemp(dir)) {
+    perror(dir);
+    return;
+  }
+  snprintf(path, sizeof (path), "%s/dungeon_game", dir);
+  if (mkdir(path, 0700) || write_descriptions(dir, n)) {
+    perror(path);
+    return;
+  }
+
+  home = getenv("HOME");
+  setenv("HOME", dir, 1);
+  d->monster_descriptions.swap(monsters);
+  d->object_descriptions.swap(objects);
+
+  /* The cache won't trust the times of files this fresh (see cache.h) */
+  snprintf(path, sizeof (path), "%s/dungeon_game/" MONSTER_DESC_FILE, dir);
+  utimes(path, past);
+  snprintf(path, sizeof (path), "%s/dungeon_game/" OBJECT_DESC_FILE, dir);
+  utimes(path, past);
+
+  t = now();
+  parse_descriptions(d);
+  report("parse_descriptions 100k", now() - t, 1);
+  if (d->monster_descriptions.size() != n ||
+      d->object_descriptions.size() != n) {
+    fprintf(stderr, "parse_descriptions: read %u monsters, %u objects\n",
+            (uint32_t) d->monster_descriptions.size(),
+            (uint32_t) d->object_descriptions.size());
+  }
+
+  /* The parse above wrote the cache; this time it's loaded from it. */
+  destroy_descriptions(d);
+  t = now();
+  parse_descriptions(d);
+  report("parse_descriptions 100k cached", now() - t, 1);
+  if (d->monster_descriptions.size() != n ||
+      d->object_descriptions.size() != n) {
+    fprintf(stderr, "cache_load: read %u monsters, %u objects\n",
+            (uint32_t) d->monster_descriptions.size(),
+            (uint32_t) d->object_descriptions.size());
+  }
+
+  d->monster_descriptions.swap(monsters);
+  d->object_descriptions.swap(objects);
+  if (home) {
+    setenv("HOME", home, 1);
+  } else {
+    unsetenv("HOME");
+  }
+
+  snprintf(path, sizeof (path), "%s/dungeon_game/" MONSTER_DESC_FILE, dir);
+  unlink(path);
+  snprintf(path, sizeof (path), "%s/dungeon_game/" OBJECT_DESC_FILE, dir);
+  unlink(path);
+  snprintf(path, sizeof (path), "%s/dungeon_game/" DESCRIPTION_CACHE_FILE,
+           dir);
+  unlink(path);
+  snprintf(path, sizeof (path), "%s/dungeon_game", dir);
+  rmdir(path);
+  rmdir(dir);
+}
+
+/* A draw by walking the cumulative weights, for comparison */
+static uint32_t spawn_linear(const std::vector<uint32_t> &weight,
+                             uint32_t total)
+{
+  uint32_t i, r;
+
+  for (r = rng_rand() % total, i = 0; r >= weight[i]; i++) {
+    r -= weight[i];
+  }
+
+  return i;
+}
+
+/* Spawning from 10,000 monster descriptions of assorted rarities and *
+ * depths: the table build a depth change costs, single draws from    *
+ * the table and by a linear scan, and whole monsters, created in      *
+ * batches and cleared away again.                                     */
+static void bench_spawn(dungeon_t *d)
+{
+  std::vector<monster_description> monsters;
+  std::vector<uint32_t> color(1, COLOR_RED), weight;
+  string_arena text;
+  turn_queue turns;
+  character_id_t c;
+  char name[32];
+  uint32_t i, j, n, total, sum;
+  double t;
+
+  n = 10000;
+  monsters.resize(n);
+  for (i = 0; i < n; i++) {
+    snprintf(name, sizeof (name), "spawn monster %u", i);
+    monsters[i].set(text.intern(name), text.intern("A monster."),
+                    'a' + i % 26, color, dice(5, 1, 10), 0,
+                    dice(10, 1, 6), dice(0, 1, 4));
+    monsters[i].set_spawn(1 + i % MAX_RARITY, i % 8, i % 8 + 4);
+  }
+  d->monster_descriptions.swap(monsters);
+
+  j = 100;
+  t = now();
+  for (i = 0; i < j; i++) {
+    d->depth = i & 1;
+    spawn_prepare(d);
+  }
+  report("spawn table build 10k", now() - t, j);
+
+  d->depth = 6;
+  for (total = i = 0; i < n; i++) {
+    weight.push_back(6 >= i % 8 && 6 <= i % 8 + 4 ? 1 + i % MAX_RARITY : 0);
+    total += weight.back();
+  }
+
+  j = 4000000;
+  t = now();
+  for (sum = i = 0; i < j; i++) {
+    sum += spawn_monster(d);
+  }
+  report("spawn alias 10k", now() - t, j);
+  j = 40000;
+  t = now();
+  for (i = 0; i < j; i++) {
+    sum += spawn_linear(weight, total);
+  }
+  report("spawn linear 10k", now() - t, j);
+
+  /* The PC's turn queue is set aside, and each batch of monsters is *
+   * taken back off the map through a queue of their own.            */
+  turns.swap(d->next_turn);
+  j = 1000000;
+  t = now();
+  for (i = 0; i < j; i += 10) {
+    gen_monsters(d, 10, 0);
+    while ((c = d->next_turn.remove_min())) {
+      charpair(d->characters.position[c]) = NO_CHARACTER;
+      d->characters.remove(c);
+    }
+  }
+  report("generate_monster 10k", now() - t, j);
+  d->next_turn.swap(turns);
+
+  d->num_monsters = 0;
+  d->depth = 0;
+  d->monster_descriptions.swap(monsters);
+  d->monster_spawn.clear();
+  d->object_spawn.clear();
+  if (!sum) {
+    fprintf(stderr, "spawn: no monsters\n");
+  }
+}
+
+/* One NPC stepping from each floor cell in turn, for every combination *
+ * of the movement abilities.  Tunnelers dig, so each combination gets  *
+ * the same seed and a fresh copy of the level.                         */
+static void bench_npc(dungeon_t *d)
+{
+  terrain_type_t map[DUNGEON_Y][DUNGEON_X];
+  uint8_t hardness[DUNGEON_Y][DUNGEON_X];
+  std::vector<uint32_t> cells;
+  monster_description m;
+  character_table &t = d->characters;
+  character_id_t c;
+  uint32_t i, j, n, x, y;
+  char name[32];
+  pair_t next;
+  double start;
+
+  for (y = 0; y < DUNGEON_Y; y++) {
+    d->map.get_row(y, map[y]);
+    d->hardness.get_row(y, hardness[y]);
+    for (x = 1; x < DUNGEON_X - 1; x++) {
+      if (d->map[y][x] >= ter_floor) {
+        cells.push_back(y * DUNGEON_X + x);
+      }
+    }
+  }
+
+  c = new_npc(d, m);
+  t.alive[c] = 1;
+  n = 200000;
+  for (j = 0; j < NPC_PASS_WALL << 1; j++) {
+    rng_seed(BENCH_SEED);
+    t.characteristics[c] = j;
+    t.have_seen_pc[c] = 0;
+    start = now();
+    for (i = 0; i < n; i++) {
+      t.position[c][dim_y] = cells[i % cells.size()] / DUNGEON_X;
+      t.position[c][dim_x] = cells[i % cells.size()] % DUNGEON_X;
+      npc_next_pos(d, c, next);
+    }
+    snprintf(name, sizeof (name), "npc_next_pos %02x", j);
+    report(name, now() - start, n);
+    for (y = 0; y < DUNGEON_Y; y++) {
+      d->map.set_row(y, map[y]);
+      d->hardness.set_row(y, hardness[y]);
+    }
+    dijkstra(d);
+    dijkstra_tunnel(d);
+  }
+  t.remove(c);
+}
+
+/* Whole NPC turns, scheduling and all, with ever more NPCs on a level *
+ * opened up to make room for them.  Every NPC is as fast as the PC,   *
+ * so each goes once per round, and the PC, who stands still, is too   *
+ * tough to die.  Every combination of the abilities is dealt out in  *
+ * turn.                                                               */
+static void bench_turns(dungeon_t *d)
+{
+  terrain_type_t map[DUNGEON_Y][DUNGEON_X];
+  uint8_t hardness[DUNGEON_Y][DUNGEON_X];
+  std::vector<monster_description> monsters;
+  std::vector<uint32_t> color(1, COLOR_RED);
+  static const uint32_t nummon[] = { 10, 100, 1000, 1400 };
+  character_table &t = d->characters;
+  string_arena text;
+  character_id_t c;
+  uint32_t i, j, k, n, x, y, threads;
+  char name[40];
+  double start;
+
+  for (i = 0; i < NPC_PASS_WALL << 1; i++) {
+    snprintf(name, sizeof (name), "turns monster %u", i);
+    monsters.emplace_back();
+    monsters.back().set(text.intern(name), text.intern("A monster."),
+                        'A' + i, color, dice(PC_SPEED, 0, 1), i,
+                        dice(10, 1, 6), dice(0, 1, 4));
+  }
+  d->monster_descriptions.swap(monsters);
+  d->monster_spawn.clear();
+
+  for (y = 0; y < DUNGEON_Y; y++) {
+    d->map.get_row(y, map[y]);
+    d->hardness.get_row(y, hardness[y]);
+    for (x = 1; y && y < DUNGEON_Y - 1 && x < DUNGEON_X - 1; x++) {
+      if (d->map[y][x] < ter_floor) {
+        d->map[y][x] = ter_floor_hall;
+        d->hardness[y][x] = 0;
+      }
+    }
+  }
+  dijkstra(d);
+  dijkstra_tunnel(d);
+
+  /* Every NPC is as fast as the PC, so all of them are due together, *
+   * and each round is one batch for the decision phase (decide.h).    */
+  threads = sysconf(_SC_NPROCESSORS_ONLN);
+  for (i = 0; i < sizeof (nummon) / sizeof (nummon[0]); i++) {
+    for (k = 0; k < 2; k++) {
+      if (k) {
+        decide_start(threads);
+      }
+      rng_seed(BENCH_SEED);
+      t.next_turn[PC_ID] = 0;
+      gen_monsters(d, nummon[i], 0);
+      n = 200000 / nummon[i];
+      start = now();
+      for (j = 0; j < n; j++) {
+        t.hp[PC_ID] = INT32_MAX;
+        do_npc_moves(d);
+        character_next_turn(d, PC_ID);
+        io_clear_messages();
+      }
+      if (k) {
+        snprintf(name, sizeof (name), "npc turns %u, %u threads",
+                 d->num_monsters, threads);
+        decide_stop();
+      } else {
+        snprintf(name, sizeof (name), "npc turns %u", d->num_monsters);
+      }
+      report(name, now() - start, n * d->num_monsters);
+
+      while ((c = d->next_turn.remove_min())) {
+        charpair(t.position[c]) = NO_CHARACTER;
+        t.remove(c);
+      }
+    }
+  }
+
+  for (y = 0; y < DUNGEON_Y; y++) {
+    d->map.set_row(y, map[y]);
+    d->hardness.set_row(y, hardness[y]);
+  }
+  dijkstra(d);
+  dijkstra_tunnel(d);
+  d->num_monsters = 0;
+  d->monster_descriptions.swap(monsters);
+  d->monster_spawn.clear();
+}
+
+static const struct {
+  const char *name;
+  void (*func)(dungeon_t *d);
+} benchmarks[] = {
+  { "grid",         bench_grid         },
+  { "codec",        bench_codec        },
+  { "pgm",          bench_pgm          },
+  { "descriptions", bench_descriptions },
+  { "spawn",        bench_spawn        },
+  { "npc",          bench_npc          },
+  { "turns",        bench_turns        },
+  { 0,              0                  }
+};
+
+int main(int argc, char *argv[])
+{
+  static dungeon_t d;
+  uint32_t i;
+  int j;
+
+  bench_setup(&d);
+
+  for (i = 0; benchmarks[i].name; i++) {
+    for (j = 1; j < argc && strcmp(argv[j], benchmarks[i].name); j++)
+      ;
+    if (argc == 1 || j < argc) {
+      benchmarks[i].func(&d);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+#include "builtin.h"
+#include "builtin_tables.h"
+#include "dungeon.h"
+#include "journal.h"
+
+void builtin_monster_descriptions(dungeon_t *d)
+{
+  const builtin_monster_t *b;
+  std::vector<uint32_t> color;
+  uint32_t i, n;
+
+  n = sizeof (builtin_monsters) / sizeof (builtin_monsters[0]);
+  d->monster_descriptions.reserve(n);
+  for (i = 0, b = builtin_monsters; i < n; i++, b++) {
+    color.assign(builtin_monster_colors + b->color,
+                 builtin_monster_colors + b->color + b->num_color);
+    d->monster_descriptions.emplace_back();
+    d->monster_descriptions.back().set(b->name, b->description, b->symbol,
+                                       color, b->speed, b->abilities,
+                                       b->hitpoints, b->damage);
+    d->monster_descriptions.back().set_spawn(b->rarity, b->min_depth,
+                                             b->max_depth);
+  }
+}
+
+void builtin_object_descriptions(dungeon_t *d)
+{
+  const builtin_object_t *b;
+  uint32_t i, n;
+
+  n = sizeof (builtin_objects) / sizeof (builtin_objects[0]);
+  d->object_descriptions.reserve(n);
+  for (i = 0, b = builtin_objects; i < n; i++, b++) {
+    d->object_descriptions.emplace_back();
+    d->object_descriptions.back().set(b->name, b->description,
+                                      (object_type_t) b->type, b->color,
+                                      b->hit, b->damage, b->dodge,
+                                      b->defence, b->weight, b->speed,
+                                      b->attribute, b->value);
+    d->object_descriptions.back().set_spawn(b->rarity, b->min_depth,
+                                            b->max_depth);
+  }
+}
+
+uint64_t description_hash(const char *name)
+{
+  std::string file;
+  int fd;
+
+  file = description_file(name);
+  if ((fd = open(file.c_str(), O_RDONLY)) < 0 && errno == ENOENT) {
+    return (strcmp(name, MONSTER_DESC_FILE) ?
+            BUILTIN_OBJECT_HASH : BUILTIN_MONSTER_HASH);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+
+  return journal_hash_file(file.c_str());
+}
@@ -0,0 +1,43 @@
+#ifndef BUILTIN_H
+# define BUILTIN_H
+
+# include <stdint.h>
+# include <string_view>
+
+# include "dice.h"
+
+typedef struct dungeon dungeon_t;
+
+/* The shipped description files, compiled in.  At build time mkbuiltin *
+ * runs the real parser over monster_desc.txt and object_desc.txt and   *
+ * writes builtin_tables.h, a pair of constexpr arrays of these records *
+ * and the files' hashes.  A description file in the usual place still  *
+ * wins; the built-in table only fills in for one that's missing or     *
+ * yields nothing, so that a game can start without any files at all,   *
+ * and without reading a byte to get going.                             */
+
+typedef struct builtin_monster {
+  std::string_view name, description;
+  char symbol;
+  uint32_t color;            /* Index of the first in builtin_monster_colors */
+  uint32_t num_color;
+  uint32_t abilities;
+  dice speed, hitpoints, damage;
+  uint32_t rarity, min_depth, max_depth;
+} builtin_monster_t;
+
+typedef struct builtin_object {
+  std::string_view name, description;
+  uint32_t type;
+  uint32_t color;
+  dice hit, damage, dodge, defence, weight, speed, attribute, value;
+  uint32_t rarity, min_depth, max_depth;
+} builtin_object_t;
+
+void builtin_monster_descriptions(dungeon_t *d);
+void builtin_object_descriptions(dungeon_t *d);
+/* The hash of a description file, as journals record it.  A missing *
+ * file hashes as the built-in table that replaces it.               */
+uint64_t description_hash(const char *name);
+
+#endif
@@ -0,0 +1,174 @@
+/* Generated by mkbuiltin; edit monster_desc.txt and object_desc.txt, not this. */
+
+#ifndef BUILTIN_TABLES_H
+# define BUILTIN_TABLES_H
+
+# include "builtin.h"
+# include "descriptions.h"
+
+# define BUILTIN_MONSTER_HASH 0x5183b78df7d56dd0ULL
+# define BUILTIN_OBJECT_HASH  0x3add7a36a7af1324ULL
+
+static constexpr uint32_t builtin_monster_colors[] = {
+  4,
+  7, 1, 5,
+  1, 5,
+  2, 4,
+  2, 7, 6, 5, 1, 3, 4,
+  1,
+  4,
+  2,
+  7,
+};
+
+static constexpr builtin_monster_t builtin_monsters[] = {
+  { "Junior Barbarian",
+    "This is a junior barbarian.  He--or is it she?  You can't tell for sure--\n"
+    "looks like... it should still be in barbarian school.  The barbarians are\n"
+    "putting them in the dungeons young these days.  It's wearing dirty, tattered\n"
+    "cloth armor and wielding a wooden sword.  You have a hard time feeling\n"
+    "intimidated.",
+    'p', 0, 1, 0x00000001,
+    { 7, 1, 4 }, { 12, 2, 6 }, { 0, 1, 4 },
+    100, 0, MAX_DEPTH },
+  { "Amazon Lich Queen",
+    "She was a powerful Amazon warrior in life.  Death at the hands of the undead\n"
+    "hordes was followed by her resurrection through dark, necromantic arts.  Her\n"
+    "power in life didn't approach her undead glory.  Clad in night-black robes\n"
+    "that don't move in the wind, her incorporeal form commands the power of death\n"
+    "over life.  You may just be her next victim.  You fear for your soul as you\n"
+    "quake before her malevolent majesty.",
+    'p', 1, 3, 0x00000011,
+    { 10, 10, 2 }, { 2999, 1, 1001 }, { 30, 5, 9 },
+    100, 0, MAX_DEPTH },
+  { "Durin's Bane",
+    "Nameless Terror, Flame of Udun, Shadow and Flame\n"
+    "This is a Balrog of Morgoth - Weilding a Fiery whip and flaming sword, a\n"
+    "hellish beast with a mane and eyes of fire. This creature is responsible\n"
+    "for the destruction of the great city of Moria. The defeat of this monster\n"
+    "will avenge the death ofcountless dwarves, re-establish the wealth and power\n"
+    "of the Misty Mountains and bring peace to the halls of Khazad-dum",
+    'B', 4, 2, 0x00000003,
+    { 20, 0, 1 }, { 100, 0, 1 }, { 10, 2, 20 },
+    100, 0, MAX_DEPTH },
+  { "Titan",
+    "Looming over you at a massive 15 feet tall, weighing nearly a ton, the\n"
+    "Titan is a force to be reckened with. A mighty oak club is his weapon of\n"
+    "choice, but you are all too aware it would take no more than a flick of\n"
+    "the wrist for him to shatter every bone in your body.",
+    'M', 6, 2, 0x00000005,
+    { 4, 2, 3 }, { 500, 2, 500 }, { 25, 3, 6 },
+    100, 0, MAX_DEPTH },
+  { "Slime",
+    "Eww...  It's slimy.",
+    's', 8, 7, 0x00000007,
+    { 60, 0, 10 }, { 10, 0, 1 }, { 0, 10, 4 },
+    100, 0, MAX_DEPTH },
+  { "Software Bug",
+    "The TA says it crashes whenever it runs, but it works fine on *your*\n"
+    "computer.  It's probably a hardware problem.  It's really, really, really\n"
+    "annoying.",
+    'z', 15, 1, 0x00000003,
+    { 30, 0, 1 }, { 1000, 0, 1 }, { 0, 5, 1 },
+    100, 0, MAX_DEPTH },
+  { "Hardware Bug",
+    "It doesn't actually exist.  See: Software Bug.",
+    'z', 16, 1, 0x0000000a,
+    { 10, 0, 1 }, { 500, 2, 500 }, { 10, 3, 6 },
+    100, 0, MAX_DEPTH },
+  { "C Program",
+    "It may require a few extra lines of code, but damn is it fast!",
+    'C', 17, 1, 0x00000001,
+    { 0, 3, 5 }, { 1000, 0, 50 }, { 800, 0, 6 },
+    100, 0, MAX_DEPTH },
+  { "C++ Program",
+    "Does in one line what it take 200 lines to do in C, but what's taking so\n"
+    "long?",
+    'C', 18, 1, 0x00000007,
+    { 2, 0, 1 }, { 500, 5, 100 }, { 100, 9, 9 },
+    100, 0, MAX_DEPTH }
+};
+
+static constexpr builtin_object_t builtin_objects[] = {
+  { "a NERF(R) dagger",
+    "This is a totally wicked looking dagger.  It's got awesome barbs on the back\n"
+    "of the blade, a compass on the hilt, and myriad other embellishments that\n"
+    "serve no functional purpose.  You could totally be a deadly assassin with a\n"
+    "sweet blade like this.  Since it's so light, it won't encumber you.  It's\n"
+    "made out of polyurethane foam.",
+    1, 5,
+    { 0, 0, 1 }, { 0, 0, 1 }, { 10, 0, 1 }, { 0, 0, 1 },
+    { 1, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 }, { 9, 1, 6 },
+    100, 0, MAX_DEPTH },
+  { "a vorpal blade",
+    "One, two! One, two! And through and through!\n"
+    "It goes snicker-snack.",
+    1, 1,
+    { 12, 3, 4 }, { 100, 1, 92 }, { 0, 0, 1 }, { 0, 0, 1 },
+    { 15, 0, 1 }, { 0, 0, 5 }, { 0, 0, 1 }, { 198, 2, 51 },
+    100, 0, MAX_DEPTH },
+  { "a super dress",
+    "This dress is totes fab! It's off-the-shoulder with an A-line waste, sequins,\n"
+    "and lavender chiffon.  It fits tight to mid-calf and you totally can't take\n"
+    "full steps in it, but, like, who cares?  You'll be the hit of the party as\n"
+    "long as Shirley doesn't show up wearing the same thing again.",
+    5, 5,
+    { 0, 2, 3 }, { 30, 2, 50 }, { 0, 0, 1 }, { 0, 0, 1 },
+    { 0, 2, 2 }, { 10, 0, 1 }, { 0, 0, 1 }, { 449, 0, 1 },
+    100, 0, MAX_DEPTH },
+  { "a pair of super shoes",
+    "You'll be the belle of the prom in these Prada dress sandals.  The 3\" spike\n"
+    "heel makes you a bit unsteady, but they look like they could cause some\n"
+    "major damage.",
+    9, 5,
+    { 0, 0, 1 }, { 0, 0, 10 }, { 0, 0, 1 }, { 0, 0, 1 },
+    { 0, 2, 2 }, { 100, 0, 1 }, { 0, 0, 1 }, { 449, 0, 1 },
+    100, 0, MAX_DEPTH },
+  { "a chainmail coif",
+    "A heavy chainmail head covering.",
+    6, 7,
+    { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 }, { 10, 2, 6 },
+    { 8, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 }, { 48, 2, 11 },
+    100, 0, MAX_DEPTH },
+  { "the Aegis",
+    "A very high-quality shield.  Nobody knows what it looks like, except for\n"
+    "maybe--now--you, but you're not telling.  The back side is inscribed with the\n"
+    "words: \"If found, please return to Zeus, Mount Olympus\".",
+    2, 3,
+    { 0, 0, 1 }, { 0, 0, 1 }, { 20, 2, 8 }, { 20, 3, 8 },
+    { 3, 0, 1 }, { 7, 0, 1 }, { 0, 0, 1 }, { 17000, 0, 1 },
+    100, 0, MAX_DEPTH },
+  { "a cloak of invisibility",
+    "One of the Deathly Hallows, this cloak grants the wearer invisibility.  Last\n"
+    "know to be the property of the Boy Who Lived.",
+    7, 6,
+    { 0, 0, 1 }, { 0, 0, 1 }, { 24, 5, 4 }, { 0, 0, 1 },
+    { 1, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 }, { 10000, 5, 1000 },
+    100, 0, MAX_DEPTH },
+  { "the One Ring",
+    "The One Ring to rule them all... and in the darkness bind them.  Created by\n"
+    "Sauron as a tool in his quest to dominate Middle Earth.  It draws the dark\n"
+    "sorcerer's eye upon its wearer.",
+    11, 3,
+    { 10, 2, 5 }, { 10, 1, 55 }, { 50, 6, 8 }, { 50, 6, 8 },
+    { 1, 0, 1 }, { 3, 2, 5 }, { 0, 0, 1 }, { 1000000, 2, 1000000 },
+    100, 0, MAX_DEPTH },
+  { "a torch",
+    "A short wooden stick topped with an oil-soaked cloth, perfect for lighting\n"
+    "your way through the dungeon.",
+    4, 7,
+    { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 },
+    { 2, 1, 2 }, { 0, 0, 1 }, { 0, 1, 3 }, { 0, 1, 3 },
+    100, 0, MAX_DEPTH },
+  { "a Wicked Lasers(R) Torch",
+    "From the makers of the world's most refined lasers, comes the ultimate in\n"
+    "handheld flashlights. The Flashtorch is a compact, portable searchlight that\n"
+    "is capable of producing an incredible 4100 lumens of intense white light. Use\n"
+    "this power to guide your way home, light a fire, or even fry an egg!",
+    4, 7,
+    { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 },
+    { 1, 1, 2 }, { 0, 0, 1 }, { 200, 0, 1 }, { 199, 0, 1 },
+    100, 0, MAX_DEPTH }
+};
+
+#endif
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "dungeon.h"
+#include "descriptions.h"
+#include "journal.h"
+#include "save.h"
+
+static void cache_put_dice(cache_dice_t *c, const dice &d)
+{
+  c->base = d.get_base();
+  c->number = d.get_number();
+  c->sides = d.get_sides();
+}
+
+static dice cache_get_dice(const cache_dice_t *c)
+{
+  return dice(c->base, c->number, c->sides);
+}
+
+static void cache_put_string(cache_string_t *c, std::string_view s,
+                             char *strings, uint32_t *string_size)
+{
+  c->offset = *string_size;
+  c->length = s.length();
+  c->hash = string_arena::hash(s);
+  memcpy(strings + *string_size, s.data(), s.length());
+  *string_size += s.length();
+}
+
+static std::string_view cache_get_string(dungeon_t *d,
+                                         const cache_string_t *c,
+                                         const char *strings)
+{
+  return d->description_text.intern(std::string_view(strings + c->offset,
+                                                     c->length), c->hash);
+}
+
+static int cache_key(cache_source_t *c, const char *name)
+{
+  std::string file;
+  struct stat buf;
+
+  file = description_file(name);
+  if (stat(file.c_str(), &buf)) {
+    return 1;
+  }
+
+  c->size = buf.st_size;
+  c->mtime_sec = buf.st_mtim.tv_sec;
+  c->mtime_nsec = buf.st_mtim.tv_nsec;
+  /* A file modified within the last second could be modified again *
+   * without its time changing.  Make sure its time can't match, so  *
+   * that the next start compares hashes instead.                    */
+  if (c->mtime_sec >= time(NULL) - 1) {
+    c->mtime_sec = -1;
+  }
+  c->hash = journal_hash_file(file.c_str());
+
+  return 0;
+}
+
+/* 0 if the file still matches c, 1 if it doesn't, and -1 if it only  *
+ * matched by its hash, so that the key wants refreshing.             */
+static int cache_check(const cache_source_t *c, const char *name)
+{
+  std::string file;
+  struct stat buf;
+
+  file = description_file(name);
+  if (stat(file.c_str(), &buf) || (uint64_t) buf.st_size != c->size) {
+    return 1;
+  }
+  if (buf.st_mtim.tv_sec == c->mtime_sec &&
+      buf.st_mtim.tv_nsec == c->mtime_nsec) {
+    return 0;
+  }
+
+  return journal_hash_file(file.c_str()) == c->hash ? -1 : 1;
+}
+
+int cache_write(dungeon_t *d)
+{
+  std::vector<monster_description> &m = d->monster_descriptions;
+  std::vector<object_description> &o = d->object_descriptions;
+  cache_header_t *h;
+  cache_monster_t *cm;
+  cache_object_t *co;
+  uint32_t *colors;
+  char *strings;
+  uint8_t *image;
+  uint64_t size;
+  uint32_t i, j, num_colors, string_size;
+  int failed;
+
+  for (num_colors = string_size = i = 0; i < m.size(); i++) {
+    num_colors += m[i].get_color().size();
+    string_size += (m[i].get_name().length() +
+                    m[i].get_description().length());
+  }
+  for (i = 0; i < o.size(); i++) {
+    string_size += (o[i].get_name().length() +
+                    o[i].get_description().length());
+  }
+
+  size = (sizeof (*h) + m.size() * sizeof (*cm) + o.size() * sizeof (*co) +
+          num_colors * sizeof (*colors) + string_size);
+  if (size > UINT32_MAX) {
+    return 1;
+  }
+
+  image = (uint8_t *) calloc(1, size);
+  h = (cache_header_t *) image;
+  cm = (cache_monster_t *) (h + 1);
+  co = (cache_object_t *) (cm + m.size());
+  colors = (uint32_t *) (co + o.size());
+  strings = (char *) (colors + num_colors);
+
+  memcpy(h->semantic, CACHE_SEMANTIC, strlen(CACHE_SEMANTIC));
+  h->version = CACHE_VERSION;
+  h->byte_order = CACHE_BYTE_ORDER;
+  if (cache_key(&h->monsters, MONSTER_DESC_FILE) ||
+      cache_key(&h->objects, OBJECT_DESC_FILE)) {
+    free(image);
+    return 1;
+  }
+  h->num_monsters = m.size();
+  h->num_objects = o.size();
+  h->num_colors = num_colors;
+
+  for (num_colors = string_size = i = 0; i < m.size(); i++, cm++) {
+    cache_put_string(&cm->name, m[i].get_name(), strings, &string_size);
+    cache_put_string(&cm->description, m[i].get_description(),
+                     strings, &string_size);
+    cm->color = num_colors;
+    cm->num_color = m[i].get_color().size();
+    for (j = 0; j < cm->num_color; j++) {
+      colors[num_colors++] = m[i].get_color()[j];
+    }
+    cm->abilities = m[i].get_abilities();
+    cm->symbol = m[i].get_symbol();
+    cache_put_dice(&cm->speed, m[i].get_speed());
+    cache_put_dice(&cm->hitpoints, m[i].get_hitpoints());
+    cache_put_dice(&cm->damage, m[i].get_damage());
+    cm->rarity = m[i].get_rarity();
+    cm->min_depth = m[i].get_min_depth();
+    cm->max_depth = m[i].get_max_depth();
+  }
+  for (i = 0; i < o.size(); i++, co++) {
+    cache_put_string(&co->name, o[i].get_name(), strings, &string_size);
+    cache_put_string(&co->description, o[i].get_description(),
+                     strings, &string_size);
+    co->type = o[i].get_type();
+    co->color = o[i].get_color();
+    cache_put_dice(&co->hit, o[i].get_hit());
+    cache_put_dice(&co->damage, o[i].get_damage());
+    cache_put_dice(&co->dodge, o[i].get_dodge());
+    cache_put_dice(&co->defence, o[i].get_defence());
+    cache_put_dice(&co->weight, o[i].get_weight());
+    cache_put_dice(&co->speed, o[i].get_speed());
+    cache_put_dice(&co->attribute, o[i].get_attribute());
+    cache_put_dice(&co->value, o[i].get_value());
+    co->rarity = o[i].get_rarity();
+    co->min_depth = o[i].get_min_depth();
+    co->max_depth = o[i].get_max_depth();
+  }
+  h->string_size = string_size;
+
+  failed = save_file_write(description_file(DESCRIPTION_CACHE_FILE).c_str(),
+                           image, size);
+  free(image);
+
+  return failed;
+}
+
+static int cache_string_ok(const cache_string_t *s, uint32_t string_size)
+{
+  return s->offset <= string_size && s->length <= string_size - s->offset;
+}
+
+static int cache_read(dungeon_t *d, const uint8_t *image, uint64_t size,
+                      int *stale)
+{
+  const cache_header_t *h;
+  const cache_monster_t *cm;
+  const cache_object_t *co;
+  const uint32_t *colors;
+  const char *strings;
+  std::vector<uint32_t> color;
+  uint32_t i;
+  int check;
+
+  h = (const cache_header_t *) image;
+  if (size < sizeof (*h) ||
+      memcmp(h->semantic, CACHE_SEMANTIC, strlen(CACHE_SEMANTIC)) ||
+      h->version != CACHE_VERSION || h->byte_order != CACHE_BYTE_ORDER ||
+      size != (sizeof (*h) + (uint64_t) h->num_monsters * sizeof (*cm) +
+               (uint64_t) h->num_objects * sizeof (*co) +
+               (uint64_t) h->num_colors * sizeof (*colors) +
+               h->string_size)) {
+    return 1;
+  }
+
+  *stale = 0;
+  if ((check = cache_check(&h->monsters, MONSTER_DESC_FILE)) > 0) {
+    return 1;
+  }
+  *stale |= check;
+  if ((check = cache_check(&h->objects, OBJECT_DESC_FILE)) > 0) {
+    return 1;
+  }
+  *stale |= check;
+
+  cm = (const cache_monster_t *) (h + 1);
+  co = (const cache_object_t *) (cm + h->num_monsters);
+  colors = (const uint32_t *) (co + h->num_objects);
+  strings = (const char *) (colors + h->num_colors);
+
+  d->description_text.reserve(h->string_size,
+                              2 * (h->num_monsters + h->num_objects));
+
+  d->monster_descriptions.reserve(h->num_monsters);
+  for (i = 0; i < h->num_monsters; i++, cm++) {
+    if (!cache_string_ok(&cm->name, h->string_size) ||
+        !cache_string_ok(&cm->description, h->string_size) ||
+        cm->color > h->num_colors ||
+        cm->num_color > h->num_colors - cm->color ||
+        cm->rarity > MAX_RARITY) {
+      return 1;
+    }
+    color.assign(colors + cm->color, colors + cm->color + cm->num_color);
+    d->monster_descriptions.emplace_back();
+    d->monster_descriptions.back().set(
+      cache_get_string(d, &cm->name, strings),
+      cache_get_string(d, &cm->description, strings),
+      cm->symbol, color, cache_get_dice(&cm->speed), cm->abilities,
+      cache_get_dice(&cm->hitpoints), cache_get_dice(&cm->damage));
+    d->monster_descriptions.back().set_spawn(cm->rarity, cm->min_depth,
+                                             cm->max_depth);
+  }
+
+  d->object_descriptions.reserve(h->num_objects);
+  for (i = 0; i < h->num_objects; i++, co++) {
+    if (!cache_string_ok(&co->name, h->string_size) ||
+        !cache_string_ok(&co->description, h->string_size) ||
+        co->type > objtype_CONTAINER || co->rarity > MAX_RARITY) {
+      return 1;
+    }
+    d->object_descriptions.emplace_back();
+    d->object_descriptions.back().set(
+      cache_get_string(d, &co->name, strings),
+      cache_get_string(d, &co->description, strings),
+      (object_type_t) co->type, co->color,
+      cache_get_dice(&co->hit), cache_get_dice(&co->damage),
+      cache_get_dice(&co->dodge), cache_get_dice(&co->defence),
+      cache_get_dice(&co->weight), cache_get_dice(&co->speed),
+      cache_get_dice(&co->attribute), cache_get_dice(&co->value));
+    d->object_descriptions.back().set_spawn(co->rarity, co->min_depth,
+                                            co->max_depth);
+  }
+
+  return 0;
+}
+
+int cache_load(dungeon_t *d)
+{
+  std::string file;
+  struct stat buf;
+  void *image;
+  int fd, failed, stale;
+
+  file = description_file(DESCRIPTION_CACHE_FILE);
+  if ((fd = open(file.c_str(), O_RDONLY)) < 0) {
+    return 1;
+  }
+  if (fstat(fd, &buf) || !buf.st_size ||
+      (image = mmap(NULL, buf.st_size, PROT_READ,
+                    MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+    close(fd);
+    return 1;
+  }
+  close(fd);
+
+  if ((failed = cache_read(d, (const uint8_t *) image, buf.st_size,
+                           &stale))) {
+    destroy_descriptions(d);
+  }
+  munmap(image, buf.st_size);
+
+  /* The text was touched but not changed; rekey, to skip the hash. */
+  if (!failed && stale) {
+    cache_write(d);
+  }
+
+  return failed;
+}
@@ -0,0 +1,104 @@
+#ifndef CACHE_H
+# define CACHE_H
+
+# include <stdint.h>
+
+typedef struct dungeon dungeon_t;
+
+/* The description files, already parsed.  After a successful parse of  *
+ * the text, the descriptions are written out as fixed-size records and *
+ * a string table; on later starts the cache is mapped and the records  *
+ * become descriptions without going anywhere near the lexer.  Like a   *
+ * snapshot it's in native byte order, with a marker to catch a foreign *
+ * one, and it holds offsets rather than pointers, so it can be mapped  *
+ * anywhere:                                                            *
+ *                                                                      *
+ *   cache_header_t                                                     *
+ *   cache_monster_t[num_monsters]                                      *
+ *   cache_object_t[num_objects]                                        *
+ *   uint32_t[num_colors]     Monster colors, each monster's in a run   *
+ *   char[string_size]        Names and descriptions, unterminated      *
+ *                                                                      *
+ * The cache is keyed by each text file's size and modification time,   *
+ * which cost a stat() to check, and by its content hash.  The hash is  *
+ * only computed when the size matches but the time doesn't, so that a  *
+ * file that was merely touched or copied doesn't force a reparse.      */
+
+# define CACHE_SEMANTIC   "RLD327"
+# define CACHE_VERSION    2U
+# define CACHE_BYTE_ORDER 0x01020304
+
+typedef struct cache_source {
+  uint64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t hash;         /* journal_hash() of the contents */
+} cache_source_t;
+
+typedef struct cache_header {
+  char semantic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  cache_source_t monsters;
+  cache_source_t objects;
+  uint32_t num_monsters;
+  uint32_t num_objects;
+  uint32_t num_colors;
+  uint32_t string_size;
+} cache_header_t;
+
+typedef struct cache_dice {
+  int32_t base;
+  uint32_t number;
+  uint32_t sides;
+} cache_dice_t;
+
+/* Strings are offsets into the string table and lengths.  Their hashes *
+ * come along so that loading them into the arena doesn't rehash them.  */
+typedef struct cache_string {
+  uint32_t offset;
+  uint32_t length;
+  uint32_t hash;         /* string_arena::hash() */
+} cache_string_t;
+
+typedef struct cache_monster {
+  cache_string_t name;
+  cache_string_t description;
+  uint32_t color;        /* First of num_color entries in the color table */
+  uint32_t num_color;
+  uint32_t abilities;
+  int32_t symbol;
+  cache_dice_t speed;
+  cache_dice_t hitpoints;
+  cache_dice_t damage;
+  uint32_t rarity;
+  uint32_t min_depth;
+  uint32_t max_depth;
+} cache_monster_t;
+
+typedef struct cache_object {
+  cache_string_t name;
+  cache_string_t description;
+  uint32_t type;
+  uint32_t color;
+  cache_dice_t hit;
+  cache_dice_t damage;
+  cache_dice_t dodge;
+  cache_dice_t defence;
+  cache_dice_t weight;
+  cache_dice_t speed;
+  cache_dice_t attribute;
+  cache_dice_t value;
+  uint32_t rarity;
+  uint32_t min_depth;
+  uint32_t max_depth;
+} cache_object_t;
+
+/* Fills in d's descriptions from the cache if it's there and matches   *
+ * the text files; returns nonzero, leaving them empty, if it doesn't.  */
+int cache_load(dungeon_t *d);
+/* Writes d's descriptions to the cache, keyed to the text files as they *
+ * are now.                                                              */
+int cache_write(dungeon_t *d);
+
+#endif
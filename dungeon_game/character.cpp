@@ -5,37 +5,143 @@
 #include "npc.h"
 #include "pc.h"
 #include "dungeon.h"
+#include "descriptions.h"
 
-void character_delete(void *c)
+character_id_t character_table::add()
 {
-  delete (character *) c;
+  character_id_t c;
+
+  /* Slot zero is NO_CHARACTER, and the next is the PC's */
+  if (size() < PC_ID + 1) {
+    clear_npcs();
+  }
+
+  if (unused.empty()) {
+    if (size() == MAX_CHARACTER) {
+      return NO_CHARACTER;
+    }
+    c = size();
+    position.emplace_back();
+    next_turn.emplace_back();
+    sequence_number.emplace_back();
+    speed.emplace_back();
+    hp.emplace_back();
+    alive.emplace_back();
+    characteristics.emplace_back();
+    have_seen_pc.emplace_back();
+    pc_last_known_position.emplace_back();
+    archetype.emplace_back();
+
+    return c;
+  }
+
+  c = unused.back();
+  unused.pop_back();
+  position[c] = character_pair();
+  next_turn[c] = 0;
+  sequence_number[c] = 0;
+  speed[c] = 0;
+  hp[c] = 0;
+  alive[c] = 0;
+  characteristics[c] = 0;
+  have_seen_pc[c] = 0;
+  pc_last_known_position[c] = character_pair();
+  archetype[c] = NULL;
+
+  return c;
 }
 
-static char *print_character(const void *v)
+void character_table::remove(character_id_t c)
 {
-  (void) print_character;
-
-  const character *c = (const character *)v;
+  alive[c] = 0;
+  unused.push_back(c);
+}
 
-  static char string[80];
+void character_table::clear_npcs()
+{
+  position.resize(PC_ID + 1);
+  next_turn.resize(PC_ID + 1);
+  sequence_number.resize(PC_ID + 1);
+  speed.resize(PC_ID + 1);
+  hp.resize(PC_ID + 1);
+  alive.resize(PC_ID + 1);
+  characteristics.resize(PC_ID + 1);
+  have_seen_pc.resize(PC_ID + 1);
+  pc_last_known_position.resize(PC_ID + 1);
+  archetype.resize(PC_ID + 1);
+  unused.clear();
+}
 
-  snprintf(string, 80, "%d:%d", c->next_turn, c->sequence_number);
+/* As the generic heap's comparitor had it: differences, not < */
+#define turn_before(a, b)                                              \
+  ((int32_t) ((a).next_turn - (b).next_turn) ?                         \
+   (int32_t) ((a).next_turn - (b).next_turn) < 0 :                     \
+   (int32_t) ((a).sequence_number - (b).sequence_number) < 0)
 
-  return string;
+void turn_queue::insert(const character_table &t, character_id_t c)
+{
+  entry e, *h;
+  uint32_t i;
+
+  e.next_turn = t.next_turn[c];
+  e.sequence_number = t.sequence_number[c];
+  e.c = c;
+
+  heap.emplace_back();
+  h = heap.data();
+  for (i = heap.size() - 1; i && turn_before(e, h[(i - 1) / 2]); ) {
+    h[i] = h[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  h[i] = e;
 }
 
-int32_t compare_characters_by_next_turn(const void *character1,
-                                        const void *character2)
+character_id_t turn_queue::remove_min()
 {
-  int32_t diff;
+  character_id_t c;
+  entry e, *h;
+  uint32_t i, child, n;
 
-  diff = (((character *) character1)->next_turn -
-          ((character *) character2)->next_turn);
-  return diff ? diff : (((character *) character1)->sequence_number -
-                        ((character *) character2)->sequence_number);
+  if (heap.empty()) {
+    return NO_CHARACTER;
+  }
+
+  h = heap.data();
+  c = h[0].c;
+  e = h[heap.size() - 1];
+  n = heap.size() - 1;
+  for (i = 0; (child = 2 * i + 1) < n; i = child) {
+    if (child + 1 < n && turn_before(h[child + 1], h[child])) {
+      child++;
+    }
+    if (!turn_before(h[child], e)) {
+      break;
+    }
+    h[i] = h[child];
+  }
+  h[i] = e;
+  heap.pop_back();
+
+  return c;
 }
 
-uint32_t can_see(dungeon_t *d, pair_t voyeur, pair_t exhibitionist, int is_pc)
+/* Watches every cell the PC's line of sight passes over, so that the *
+ * PC learns the terrain and objects along the way.                    */
+class pc_observer {
+ private:
+  dungeon_t *d;
+ public:
+  pc_observer(dungeon_t *d) : d(d) {}
+  inline void operator()(pair_t cell)
+  {
+    pc_learn_terrain(d->the_pc, cell, mappair(cell));
+    pc_see_object(d->the_pc, objpair(cell));
+  }
+};
+
+template <class map_grid, class observer>
+uint32_t line_of_sight(map_grid &map, pair_t voyeur, pair_t exhibitionist,
+                       int16_t visual_range, observer &o)
 {
   /* Application of Bresenham's Line Drawing Algorithm.  If we can draw *
    * a line from v to e without intersecting any walls, then v can see  *
@@ -48,9 +154,6 @@ uint32_t can_see(dungeon_t *d, pair_t voyeur, pair_t exhibitionist, int is_pc)
   pair_t first, second;
   pair_t del, f;
   int16_t a, b, c, i;
-  int16_t visual_range;
-
-  visual_range = is_pc ? PC_VISUAL_RANGE : NPC_VISUAL_RANGE;
 
   first[dim_x] = voyeur[dim_x];
   first[dim_y] = voyeur[dim_y];
@@ -64,11 +167,6 @@ uint32_t can_see(dungeon_t *d, pair_t voyeur, pair_t exhibitionist, int is_pc)
     return 0;
   }
 
-  /*
-  mappair(first) = ter_debug;
-  mappair(second) = ter_debug;
-  */
-
   if (second[dim_x] > first[dim_x]) {
     del[dim_x] = second[dim_x] - first[dim_x];
     f[dim_x] = 1;
@@ -90,14 +188,11 @@ uint32_t can_see(dungeon_t *d, pair_t voyeur, pair_t exhibitionist, int is_pc)
     c = a - del[dim_x];
     b = c - del[dim_x];
     for (i = 0; i <= del[dim_x]; i++) {
-      if (is_pc) {
-        pc_learn_terrain(d->the_pc, first, mappair(first));
-        pc_see_object(d->the_pc, objpair(first));
-      }
-      if ((mappair(first) < ter_floor) && i && (i != del[dim_x])) {
+      o(first);
+      if ((map[first[dim_y]][first[dim_x]] < ter_floor) &&
+          i && (i != del[dim_x])) {
         return 0;
       }
-      /*      mappair(first) = ter_debug;*/
       first[dim_x] += f[dim_x];
       if (c < 0) {
         c += a;
@@ -112,14 +207,11 @@ uint32_t can_see(dungeon_t *d, pair_t voyeur, pair_t exhibitionist, int is_pc)
     c = a - del[dim_y];
     b = c - del[dim_y];
     for (i = 0; i <= del[dim_y]; i++) {
-      if (is_pc) {
-        pc_learn_terrain(d->the_pc, first, mappair(first));
-        pc_see_object(d->the_pc, objpair(first));
-      }
-      if ((mappair(first) < ter_floor) && i && (i != del[dim_y])) {
+      o(first);
+      if ((map[first[dim_y]][first[dim_x]] < ter_floor) &&
+          i && (i != del[dim_y])) {
         return 0;
       }
-      /*      mappair(first) = ter_debug;*/
       first[dim_y] += f[dim_y];
       if (c < 0) {
         c += a;
@@ -134,74 +226,101 @@ uint32_t can_see(dungeon_t *d, pair_t voyeur, pair_t exhibitionist, int is_pc)
   return 1;
 }
 
-int32_t character_get_hp(const character *c){
-  return ((character *) c)->hp;
+template uint32_t line_of_sight(grid<DUNGEON_X, DUNGEON_Y, terrain_type_t> &,
+                                pair_t, pair_t, int16_t, no_observer &);
+template uint32_t line_of_sight(grid<GRID_DYNAMIC, GRID_DYNAMIC,
+                                     terrain_type_t> &,
+                                pair_t, pair_t, int16_t, no_observer &);
+
+uint32_t can_see(dungeon_t *d, pair_t voyeur, pair_t exhibitionist, int is_pc)
+{
+  no_observer npc_eyes;
+  pc_observer pc_eyes(d);
+
+  if (is_pc) {
+    return line_of_sight(d->map, voyeur, exhibitionist,
+                         PC_VISUAL_RANGE, pc_eyes);
+  }
+
+  return line_of_sight(d->map, voyeur, exhibitionist,
+                       NPC_VISUAL_RANGE, npc_eyes);
 }
 
-int32_t character_get_attack(const character *c){
-  return ((character *) c)->damage->roll();
+int32_t character_get_hp(dungeon_t *d, character_id_t c)
+{
+  return d->characters.hp[c];
 }
 
-int8_t *character_get_pos(const character *c)
+int32_t character_get_attack(dungeon_t *d, character_id_t c)
 {
-  return ((character *) c)->position;
+  return d->characters.archetype[c]->get_damage().roll();
 }
 
-int8_t character_get_y(const character *c)
+int8_t *character_get_pos(dungeon_t *d, character_id_t c)
 {
-  return ((character *) c)->position[dim_y];
+  return d->characters.position[c];
 }
 
-void character_set_y(character *c, int8_t y)
+int8_t character_get_y(dungeon_t *d, character_id_t c)
 {
-  ((character *) c)->position[dim_y] = y;
+  return d->characters.position[c][dim_y];
 }
 
-int8_t character_get_x(const character *c)
+void character_set_y(dungeon_t *d, character_id_t c, int8_t y)
 {
-  return ((character *) c)->position[dim_x];
+  d->characters.position[c][dim_y] = y;
 }
 
-void character_set_x(character *c, int8_t x)
+int8_t character_get_x(dungeon_t *d, character_id_t c)
 {
-  ((character *) c)->position[dim_x] = x;
+  return d->characters.position[c][dim_x];
 }
 
-uint32_t character_get_next_turn(const character *c)
+void character_set_x(dungeon_t *d, character_id_t c, int8_t x)
 {
-  return ((character *) c)->next_turn;
+  d->characters.position[c][dim_x] = x;
 }
 
-void character_die(character *c)
+uint32_t character_get_next_turn(dungeon_t *d, character_id_t c)
 {
-  ((character *) c)->alive = 0;
+  return d->characters.next_turn[c];
 }
 
-int character_is_alive(const character *c)
+void character_die(dungeon_t *d, character_id_t c)
 {
-  return ((character *) c)->alive;
+  d->characters.alive[c] = 0;
 }
 
-void character_next_turn(character *c)
+int character_is_alive(dungeon_t *d, character_id_t c)
 {
-  character *the_character = (character *) c;
+  return d->characters.alive[c];
+}
 
-  the_character->next_turn += (1000 / the_character->speed);
+void character_next_turn(dungeon_t *d, character_id_t c)
+{
+  d->characters.next_turn[c] += (1000 / d->characters.speed[c]);
 }
 
-void character_reset_turn(character *c)
+void character_reset_turn(dungeon_t *d, character_id_t c)
 {
-  character *the_character = (character *) c;
+  d->characters.next_turn[c] -= (1000 / d->characters.speed[c]);
+}
 
-  the_character->next_turn -= (1000 / the_character->speed);
+char character_get_symbol(dungeon_t *d, character_id_t c)
+{
+  return d->characters.archetype[c]->get_symbol();
 }
 
-char character_get_symbol(const character *c)
+uint32_t character_get_color(dungeon_t *d, character_id_t c)
 {
-  return ((character *) c)->symbol;
+  const std::vector<uint32_t> &color =
+    d->characters.archetype[c]->get_color();
+
+  return color[rand_range(0, color.size() - 1)];
 }
 
-const char *character_get_name(const character *c)
+const char *character_get_name(dungeon_t *d, character_id_t c)
 {
-  return c->name;
+  /* Interned, so NUL terminated */
+  return d->characters.archetype[c]->get_name().data();
 }
@@ -8,19 +8,37 @@
 # include "utils.h"
 
 typedef struct dungeon dungeon_t;
-class dice;
+class monster_description;
 
-class character {
+/* Characters are known by a small, dense ID, and everything about them *
+ * is kept in columns indexed by it, so that the scheduler and the NPC  *
+ * movers, which look at a few fields of every character every turn,    *
+ * stream through memory rather than chasing a pointer to each one.     *
+ * The charmap holds IDs, and so does the turn_queue below.  ID zero is *
+ * no character at all, and the PC always has PC_ID.  The IDs of dead   *
+ * NPCs are reused, so they are only good while the NPC is alive or     *
+ * still queued; sequence_number is what tells characters apart.        */
+typedef uint16_t character_id_t;
+
+# define NO_CHARACTER  0
+# define PC_ID         1
+# define MAX_CHARACTER UINT16_MAX
+
+/* For the generic heap (see heap.h), which holds void pointers */
+# define character_id(v) ((character_id_t) (uintptr_t) (v))
+# define character_datum(c) ((void *) (uintptr_t) (c))
+
+/* A pair_t that can be kept in a vector, and passed on as one */
+struct character_pair {
+  pair_t p;
+  operator int8_t *() { return p; }
+};
+
+class character_table {
  public:
-  char symbol;
-  pair_t position;
-  int32_t speed;
-  uint32_t next_turn;
-  uint32_t alive;
-  std::vector<uint32_t> color;
-  int32_t hp;
-  const dice *damage;
-  const char *name;
+  /* Hot: the scheduler and the movers read these for every character */
+  std::vector<character_pair> position;
+  std::vector<uint32_t> next_turn;
   /* The priority queue is not stable.  It's nice to have a record of *
    * how many monsters have been created, and this sequence number    *
    * serves that purpose, but more importantly, prioritizing lower    *
@@ -28,28 +46,81 @@ class character {
    * is fair.  PC gets sequence number zero, and a global sequence,   *
    * stored in the dungeon, is incremented each time a NPC is         *
    * created and copied here then.                                    */
-  uint32_t sequence_number;
-  uint32_t get_color() { return color[rand_range(0, color.size() - 1)]; }
-  char get_symbol() { return symbol; }
+  std::vector<uint32_t> sequence_number;
+  std::vector<int32_t> speed;
+  std::vector<int32_t> hp;
+  std::vector<uint8_t> alive;
+  std::vector<uint32_t> characteristics;  /* NPC_* bits; none for the PC */
+  std::vector<uint8_t> have_seen_pc;
+  std::vector<character_pair> pc_last_known_position;
+  /* Cold: what kind of character it is, for display and combat.  *
+   * Every NPC made from a description points at it, rather than   *
+   * keeping a copy of its symbol, colors, name and damage.        */
+  std::vector<const monster_description *> archetype;
+  /* IDs of the dead, for reuse */
+  std::vector<character_id_t> unused;
+
+  /* A zeroed slot for a new NPC; NO_CHARACTER if there are too many */
+  character_id_t add();
+  void remove(character_id_t c);
+  /* Removes every NPC.  The PC's slot, and what's in it, is kept. */
+  void clear_npcs();
+  uint32_t size() const { return next_turn.size(); }
+};
+
+/* Who moves next: a binary heap, all in one array, of characters with  *
+ * the next_turn and sequence_number they had when they were queued.    *
+ * Neither changes while a character waits, and no two characters have  *
+ * the same pair, so the order is exactly the one the generic heap (see *
+ * heap.h) gave.                                                        */
+class turn_queue {
+ private:
+  struct entry {
+    uint32_t next_turn;
+    uint32_t sequence_number;
+    character_id_t c;
+  };
+  std::vector<entry> heap;
+ public:
+  void insert(const character_table &t, character_id_t c);
+  /* NO_CHARACTER once there's nobody left */
+  character_id_t remove_min();
+  /* Who remove_min() would give, left where it is */
+  character_id_t peek() const
+  {
+    return heap.empty() ? NO_CHARACTER : heap[0].c;
+  }
+  void clear() { heap.clear(); }
+  void swap(turn_queue &other) { heap.swap(other.heap); }
+  uint32_t size() const { return heap.size(); }
 };
 
-int32_t compare_characters_by_next_turn(const void *character1,
-                                        const void *character2);
 uint32_t can_see(dungeon_t *d, pair_t voyeur, pair_t exhibitionist, int is_pc);
-void character_delete(void *c);
-int8_t *character_get_pos(const character *c);
-int8_t character_get_y(const character *c);
-void character_set_y(character *c, int8_t y);
-int8_t character_get_x(const character *c);
-void character_set_x(character *c, int8_t x);
-uint32_t character_get_next_turn(const character *c);
-void character_die(character *c);
-int character_is_alive(const character *c);
-void character_next_turn(character *c);
-void character_reset_turn(character *c);
-char character_get_symbol(const character *c);
-const char *character_get_name(const character *c);  
-int32_t character_get_hp(const character *c);
-int32_t character_get_attack(const character *c);
+
+/* The Bresenham walk behind can_see(), generic over the map grid type.  *
+ * The observer is called on every cell the line passes over; NPCs use   *
+ * no_observer, which compiles away.  Instantiated for the fixed and the *
+ * GRID_DYNAMIC grids (see grid.h).                                      */
+struct no_observer {
+  inline void operator()(pair_t cell) {}
+};
+template <class map_grid, class observer>
+uint32_t line_of_sight(map_grid &map, pair_t voyeur, pair_t exhibitionist,
+                       int16_t visual_range, observer &o);
+int8_t *character_get_pos(dungeon_t *d, character_id_t c);
+int8_t character_get_y(dungeon_t *d, character_id_t c);
+void character_set_y(dungeon_t *d, character_id_t c, int8_t y);
+int8_t character_get_x(dungeon_t *d, character_id_t c);
+void character_set_x(dungeon_t *d, character_id_t c, int8_t x);
+uint32_t character_get_next_turn(dungeon_t *d, character_id_t c);
+void character_die(dungeon_t *d, character_id_t c);
+int character_is_alive(dungeon_t *d, character_id_t c);
+void character_next_turn(dungeon_t *d, character_id_t c);
+void character_reset_turn(dungeon_t *d, character_id_t c);
+char character_get_symbol(dungeon_t *d, character_id_t c);
+uint32_t character_get_color(dungeon_t *d, character_id_t c);
+const char *character_get_name(dungeon_t *d, character_id_t c);
+int32_t character_get_hp(dungeon_t *d, character_id_t c);
+int32_t character_get_attack(dungeon_t *d, character_id_t c);
 
 #endif
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "checkpoint.h"
+#include "dungeon.h"
+#include "save.h"
+
+typedef enum checkpoint_op {
+  checkpoint_quit,
+  checkpoint_save,
+  checkpoint_resume
+} checkpoint_op_t;
+
+/* Small enough to go through a pipe in one piece */
+typedef struct checkpoint_command {
+  uint32_t op;
+  char path[256];
+} checkpoint_command_t;
+
+typedef struct checkpoint {
+  pid_t pid;
+  int fd;        /* The write end of its command pipe */
+  uint32_t turn;
+} checkpoint_t;
+
+/* Oldest first.  A checkpoint gets a copy of the ones before it, so *
+ * that once resumed it can rewind further still.                    */
+static checkpoint_t checkpoints[CHECKPOINT_MAX];
+static uint32_t num_checkpoints;
+/* The copy writing the latest autosave, if any */
+static pid_t autosaver;
+
+static int checkpoint_send(uint32_t i, checkpoint_op_t op, const char *path)
+{
+  checkpoint_command_t cmd;
+
+  memset(&cmd, 0, sizeof (cmd));
+  cmd.op = op;
+  if (path) {
+    snprintf(cmd.path, sizeof (cmd.path), "%s", path);
+  }
+
+  return write(checkpoints[i].fd, &cmd, sizeof (cmd)) != sizeof (cmd);
+}
+
+static void checkpoint_drop(uint32_t i)
+{
+  checkpoint_send(i, checkpoint_quit, NULL);
+  close(checkpoints[i].fd);
+  num_checkpoints--;
+  memmove(checkpoints + i, checkpoints + i + 1,
+          (num_checkpoints - i) * sizeof (*checkpoints));
+}
+
+/* Where a checkpoint waits to be told what to do.  Returns only to *
+ * resume the game.                                                 */
+static void checkpoint_park(dungeon_t *d, int fd)
+{
+  checkpoint_command_t cmd;
+  ssize_t n;
+
+  for (;;) {
+    if ((n = read(fd, &cmd, sizeof (cmd))) < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n != sizeof (cmd)) {
+      _exit(0);
+    }
+
+    switch (cmd.op) {
+    case checkpoint_save:
+      write_dungeon(d, cmd.path[0] ? cmd.path : NULL);
+      break;
+    case checkpoint_resume:
+      close(fd);
+      return;
+    default:
+      _exit(0);
+    }
+  }
+}
+
+int checkpoint_take(dungeon_t *d, uint32_t turn)
+{
+  pid_t parent, pid;
+  int fd[2];
+
+  /* Commands to a checkpoint that has gone away fail with EPIPE. */
+  signal(SIGPIPE, SIG_IGN);
+  while (waitpid(-1, NULL, WNOHANG) > 0)
+    ;
+
+  if (num_checkpoints == CHECKPOINT_MAX) {
+    checkpoint_drop(0);
+  }
+
+  if (pipe(fd)) {
+    return -1;
+  }
+  /* Else anything still buffered would be written twice. */
+  fflush(NULL);
+
+  parent = getpid();
+  if ((pid = fork()) < 0) {
+    close(fd[0]);
+    close(fd[1]);
+    return -1;
+  }
+
+  if (!pid) {
+    close(fd[1]);
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != parent) {
+      _exit(0);
+    }
+    checkpoint_park(d, fd[0]);
+
+    return 1;
+  }
+
+  close(fd[0]);
+  checkpoints[num_checkpoints].pid = pid;
+  checkpoints[num_checkpoints].fd = fd[1];
+  checkpoints[num_checkpoints].turn = turn;
+  num_checkpoints++;
+
+  return 0;
+}
+
+int checkpoint_write(uint32_t i, const char *path)
+{
+  if (i >= num_checkpoints) {
+    return 1;
+  }
+
+  if (checkpoint_send(i, checkpoint_save, path)) {
+    checkpoint_drop(i);
+    return 1;
+  }
+
+  return 0;
+}
+
+int checkpoint_autosave(dungeon_t *d, char *file)
+{
+  pid_t pid;
+
+  /* Two at once would share a temporary file; see save_file_write(). */
+  if (autosaver) {
+    waitpid(autosaver, NULL, 0);
+    autosaver = 0;
+  }
+  fflush(NULL);
+
+  if ((pid = fork()) < 0) {
+    return 1;
+  }
+  if (!pid) {
+    _exit(write_dungeon(d, file));
+  }
+  autosaver = pid;
+
+  return 0;
+}
+
+int checkpoint_rewind(uint32_t i)
+{
+  struct pollfd p;
+  pid_t pid;
+
+  if (i >= num_checkpoints) {
+    return 1;
+  }
+
+  pid = checkpoints[i].pid;
+  if (checkpoint_send(i, checkpoint_resume, NULL)) {
+    checkpoint_drop(i);
+    return 1;
+  }
+
+  /* The future being abandoned is no use to anyone */
+  while (num_checkpoints > i + 1) {
+    checkpoint_drop(num_checkpoints - 1);
+  }
+  /* Let a save in flight finish before the checkpoint makes its own. */
+  autosave_stop();
+  if (autosaver) {
+    waitpid(autosaver, NULL, 0);
+  }
+
+  /* The checkpoint may be a sibling, which waitpid() can't wait for. */
+  if ((p.fd = syscall(SYS_pidfd_open, pid, 0)) >= 0) {
+    p.events = POLLIN;
+    while (poll(&p, 1, -1) < 0 && errno == EINTR)
+      ;
+  } else {
+    waitpid(pid, NULL, 0);
+  }
+
+  _exit(0);
+}
+
+uint32_t checkpoint_count(void)
+{
+  return num_checkpoints;
+}
+
+uint32_t checkpoint_turn(uint32_t i)
+{
+  return checkpoints[i].turn;
+}
+
+void checkpoint_discard_all(void)
+{
+  while (num_checkpoints) {
+    checkpoint_drop(num_checkpoints - 1);
+  }
+  /* Ours exit as soon as they read that; reap them, or they'd outlive *
+   * the game as zombies.  Checkpoints we only inherited aren't ours.  */
+  while (waitpid(-1, NULL, 0) > 0)
+    ;
+}
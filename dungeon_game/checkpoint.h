@@ -0,0 +1,38 @@
+#ifndef CHECKPOINT_H
+# define CHECKPOINT_H
+
+# include <stdint.h>
+
+typedef struct dungeon dungeon_t;
+
+/* Checkpoints are forked copies of the game.  fork() shares every page *
+ * with the running game until one side writes to it, so taking one    *
+ * costs a page table copy, not a serialisation.  The copy parks on a   *
+ * pipe until it's told to write itself out as a save file, which it    *
+ * does on its own time, or to resume, which rewinds the game to the    *
+ * point where it was taken: the current process hands over the         *
+ * terminal, waits for the checkpoint's game to finish, and exits.      *
+ *                                                                      *
+ * Only the newest CHECKPOINT_MAX are kept.  Parked checkpoints die     *
+ * with the process that took them.                                     */
+
+# define CHECKPOINT_MAX 8
+
+/* Returns 0 in the game, having taken a checkpoint; 1 when the game  *
+ * has been rewound to it, in the checkpoint; and -1 if fork() failed. */
+int checkpoint_take(dungeon_t *d, uint32_t turn);
+/* Asks checkpoint i, counted from the oldest, to write itself to path, *
+ * or to the default save file if path is NULL.  Returns immediately.   */
+int checkpoint_write(uint32_t i, const char *path);
+/* Forks a copy of the game that writes itself to file, or to the     *
+ * default save file if file is NULL, and exits.  It isn't a           *
+ * checkpoint, so it neither pushes one out nor can be rewound to.     *
+ * Returns nonzero if fork() failed.                                   */
+int checkpoint_autosave(dungeon_t *d, char *file);
+/* Doesn't return unless checkpoint i is gone. */
+int checkpoint_rewind(uint32_t i);
+uint32_t checkpoint_count(void);
+uint32_t checkpoint_turn(uint32_t i);
+void checkpoint_discard_all(void);
+
+#endif
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "chunk.h"
+
+const uint16_t chunk_spread[CHUNK_DIM] = {
+  0x000, 0x001, 0x004, 0x005, 0x010, 0x011, 0x014, 0x015,
+  0x040, 0x041, 0x044, 0x045, 0x050, 0x051, 0x054, 0x055,
+  0x100, 0x101, 0x104, 0x105, 0x110, 0x111, 0x114, 0x115,
+  0x140, 0x141, 0x144, 0x145, 0x150, 0x151, 0x154, 0x155
+};
+
+int chunk_pager_init(chunk_pager_t *p, size_t size)
+{
+  const char *tmp;
+  char path[256];
+  void *base;
+
+  if (!(tmp = getenv("TMPDIR"))) {
+    tmp = "/tmp";
+  }
+  snprintf(path, sizeof (path), "%s/rlg327-chunks-XXXXXX", tmp);
+
+  if ((p->fd = mkstemp(path)) < 0) {
+    perror(path);
+    return 1;
+  }
+  unlink(path);
+
+  if (ftruncate(p->fd, size)) {
+    perror("ftruncate");
+    close(p->fd);
+    p->fd = -1;
+    return 1;
+  }
+
+  if ((base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   p->fd, 0)) == MAP_FAILED) {
+    perror("mmap");
+    close(p->fd);
+    p->fd = -1;
+    return 1;
+  }
+
+  p->base = (uint8_t *) base;
+  p->size = size;
+
+  return 0;
+}
+
+void chunk_pager_delete(chunk_pager_t *p)
+{
+  munmap(p->base, p->size);
+  close(p->fd);
+  p->base = NULL;
+  p->size = 0;
+  p->fd = -1;
+}
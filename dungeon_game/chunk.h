@@ -0,0 +1,237 @@
+#ifndef CHUNK_H
+# define CHUNK_H
+
+# include <stdint.h>
+# include <stddef.h>
+# include <string.h>
+
+/* Chunked storage for the dungeon's grids.  The dense [y][x] arrays are *
+ * fine for the classic 80x21 level, but on very large maps every grid   *
+ * (map, hardness, both distance maps, charmap and objmap) would have    *
+ * to be fully resident.  Here the grid is cut into square tiles of      *
+ * CHUNK_DIM x CHUNK_DIM cells.  Cells inside a tile are stored in       *
+ * Morton (Z-curve) order, so the 8-neighbourhood walked by pathfinding  *
+ * and line of sight stays within a cache line or two.  Tiles are only   *
+ * allocated when first touched, and tiles away from the action can be   *
+ * paged out to a memory-mapped backing file, to be brought back in      *
+ * transparently by the next access.                                     */
+
+# define CHUNK_SHIFT 5
+# define CHUNK_DIM   (1 << CHUNK_SHIFT)
+# define CHUNK_MASK  (CHUNK_DIM - 1)
+# define CHUNK_CELLS (CHUNK_DIM * CHUNK_DIM)
+
+/* Bits of a 5-bit coordinate spread to the even bit positions. */
+extern const uint16_t chunk_spread[CHUNK_DIM];
+
+static inline __attribute__ ((always_inline))
+uint32_t chunk_morton(uint32_t x, uint32_t y)
+{
+  return chunk_spread[x & CHUNK_MASK] | (chunk_spread[y & CHUNK_MASK] << 1);
+}
+
+/* The backing file is created lazily the first time a tile is paged out, *
+ * so small maps never touch the filesystem.  The file is unlinked as     *
+ * soon as it is mapped; it disappears with the process.                  */
+typedef struct chunk_pager {
+  int fd;
+  uint8_t *base;
+  size_t size;
+} chunk_pager_t;
+
+int chunk_pager_init(chunk_pager_t *p, size_t size);
+void chunk_pager_delete(chunk_pager_t *p);
+
+template <class T>
+class chunked_grid {
+ private:
+  uint32_t width, height;
+  uint32_t tiles_x, tiles_y;
+  T fill;
+  T **tiles;         /* Resident tiles, NULL if absent or paged out */
+  uint8_t *swapped;  /* Tile has a valid copy in the backing file   */
+  chunk_pager_t pager;
+
+  chunked_grid(const chunked_grid &);
+  chunked_grid &operator=(const chunked_grid &);
+
+  T *page_in(uint32_t t)
+  {
+    uint32_t i;
+
+    tiles[t] = new T[CHUNK_CELLS];
+    if (swapped[t]) {
+      memcpy(tiles[t], pager.base + (size_t) t * sizeof (T) * CHUNK_CELLS,
+             sizeof (T) * CHUNK_CELLS);
+      swapped[t] = 0;
+    } else {
+      for (i = 0; i < CHUNK_CELLS; i++) {
+        tiles[t][i] = fill;
+      }
+    }
+
+    return tiles[t];
+  }
+
+ public:
+  /* Lets grid[y][x] resolve through at(), so code written against the *
+   * dense arrays works unchanged on chunked storage.                  */
+  class row {
+   private:
+    chunked_grid *g;
+    uint32_t y;
+   public:
+    row(chunked_grid *g, uint32_t y) : g(g), y(y) {}
+    inline __attribute__ ((always_inline)) T &operator[](uint32_t x)
+    {
+      return g->at(x, y);
+    }
+  };
+
+  chunked_grid() : width(0), height(0), tiles_x(0), tiles_y(0), fill(),
+                   tiles(0), swapped(0)
+  {
+    pager.fd = -1;
+    pager.base = 0;
+    pager.size = 0;
+  }
+  ~chunked_grid() { destroy(); }
+
+  void init(uint32_t w, uint32_t h, const T &f)
+  {
+    destroy();
+    width = w;
+    height = h;
+    fill = f;
+    tiles_x = (w + CHUNK_MASK) >> CHUNK_SHIFT;
+    tiles_y = (h + CHUNK_MASK) >> CHUNK_SHIFT;
+    tiles = new T *[tiles_x * tiles_y]();
+    swapped = new uint8_t[tiles_x * tiles_y]();
+  }
+
+  void destroy()
+  {
+    uint32_t t;
+
+    if (tiles) {
+      for (t = 0; t < tiles_x * tiles_y; t++) {
+        delete [] tiles[t];
+      }
+      delete [] tiles;
+      delete [] swapped;
+      tiles = 0;
+      swapped = 0;
+    }
+    if (pager.base) {
+      chunk_pager_delete(&pager);
+    }
+    width = height = tiles_x = tiles_y = 0;
+  }
+
+  /* The fast path is a tile table load and a Morton lookup; only an *
+   * absent tile takes the out-of-line branch.                       */
+  inline __attribute__ ((always_inline)) T &at(uint32_t x, uint32_t y)
+  {
+    uint32_t t = (y >> CHUNK_SHIFT) * tiles_x + (x >> CHUNK_SHIFT);
+    T *tile = tiles[t];
+
+    if (__builtin_expect(!tile, 0)) {
+      tile = page_in(t);
+    }
+
+    return tile[chunk_morton(x, y)];
+  }
+
+  inline __attribute__ ((always_inline)) row operator[](uint32_t y)
+  {
+    return row(this, y);
+  }
+
+  inline uint32_t get_width() const { return width; }
+  inline uint32_t get_height() const { return height; }
+
+  /* Rows cut across tiles and Morton order scatters them within a tile, *
+   * so these go a cell at a time.                                     */
+  void set_row(uint32_t y, const T *src)
+  {
+    uint32_t x;
+
+    for (x = 0; x < width; x++) {
+      at(x, y) = src[x];
+    }
+  }
+  void get_row(uint32_t y, T *dst)
+  {
+    uint32_t x;
+
+    for (x = 0; x < width; x++) {
+      dst[x] = at(x, y);
+    }
+  }
+
+  /* Resets every cell to v.  Paged-out copies are simply forgotten. */
+  void clear(const T &v)
+  {
+    uint32_t t;
+
+    fill = v;
+    for (t = 0; t < tiles_x * tiles_y; t++) {
+      delete [] tiles[t];
+      tiles[t] = 0;
+      swapped[t] = 0;
+    }
+  }
+
+  int page_out(uint32_t tx, uint32_t ty)
+  {
+    uint32_t t = ty * tiles_x + tx;
+
+    if (!tiles[t]) {
+      return 0;
+    }
+    if (!pager.base &&
+        chunk_pager_init(&pager, ((size_t) tiles_x * tiles_y *
+                                  sizeof (T) * CHUNK_CELLS))) {
+      return 1;
+    }
+    memcpy(pager.base + (size_t) t * sizeof (T) * CHUNK_CELLS, tiles[t],
+           sizeof (T) * CHUNK_CELLS);
+    delete [] tiles[t];
+    tiles[t] = 0;
+    swapped[t] = 1;
+
+    return 0;
+  }
+
+  /* Pages out every tile that does not intersect the given region. */
+  int page_out_outside(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+  {
+    uint32_t tx, ty;
+
+    for (ty = 0; ty < tiles_y; ty++) {
+      for (tx = 0; tx < tiles_x; tx++) {
+        if ((((tx + 1) << CHUNK_SHIFT) <= x0) || ((tx << CHUNK_SHIFT) > x1) ||
+            (((ty + 1) << CHUNK_SHIFT) <= y0) || ((ty << CHUNK_SHIFT) > y1)) {
+          if (page_out(tx, ty)) {
+            return 1;
+          }
+        }
+      }
+    }
+
+    return 0;
+  }
+
+  uint32_t resident_tiles() const
+  {
+    uint32_t t, n;
+
+    for (n = t = 0; t < tiles_x * tiles_y; t++) {
+      n += !!tiles[t];
+    }
+
+    return n;
+  }
+};
+
+#endif
@@ -0,0 +1,423 @@
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+#include "codec.h"
+
+/* Header field offsets */
+#define PACK_METHOD     0
+#define PACK_STRIDE     1
+#define PACK_RAW_LEN    3
+#define PACK_MID_LEN    7  /* What the Huffman stage codes, when used */
+#define PACK_PACKED_LEN 11
+
+/* Huffman code lengths, two to a byte, ahead of the bitstream. */
+#define PACK_LENGTHS    128
+
+static inline uint32_t get_be32(const uint8_t *p)
+{
+  uint32_t be32;
+
+  memcpy(&be32, p, sizeof (be32));
+
+  return be32toh(be32);
+}
+
+static inline void put_be32(uint8_t *p, uint32_t v)
+{
+  v = htobe32(v);
+  memcpy(p, &v, sizeof (v));
+}
+
+static void delta_encode(const uint8_t *src, uint32_t n, uint32_t stride,
+                         uint8_t *dst)
+{
+  uint32_t i;
+
+  for (i = 0; i < n && i < stride; i++) {
+    dst[i] = src[i];
+  }
+  for (; i < n; i++) {
+    dst[i] = src[i] - src[i - stride];
+  }
+}
+
+/* In place, a row at a time; each row depends only on the one above. */
+static void delta_decode(uint8_t *b, uint32_t n, uint32_t stride)
+{
+  uint32_t r, x, w;
+
+  for (r = stride; r < n; r += stride) {
+    w = n - r < stride ? n - r : stride;
+    for (x = 0; x < w; x++) {
+      b[r + x] += b[r + x - stride];
+    }
+  }
+}
+
+/* Control byte c: c < 128 copies the next c + 1 bytes; otherwise the *
+ * next byte is repeated c - 125 times, so runs are 3 to 130 long.    */
+static uint32_t rle_encode(const uint8_t *src, uint32_t n, uint8_t *dst)
+{
+  uint32_t i, j, r, out;
+
+  for (i = out = 0; i < n; ) {
+    for (r = 1; i + r < n && r < 130 && src[i + r] == src[i]; r++)
+      ;
+    if (r >= 3) {
+      dst[out++] = 125 + r;
+      dst[out++] = src[i];
+      i += r;
+      continue;
+    }
+
+    /* A literal span, up to the next run worth encoding */
+    for (j = i; j < n && j - i < 128; j++) {
+      if (j + 2 < n && src[j] == src[j + 1] && src[j] == src[j + 2]) {
+        break;
+      }
+    }
+    dst[out++] = j - i - 1;
+    memcpy(dst + out, src + i, j - i);
+    out += j - i;
+    i = j;
+  }
+
+  return out;
+}
+
+static int rle_decode(const uint8_t *src, uint32_t avail,
+                      uint8_t *dst, uint32_t n)
+{
+  uint32_t in, out, len;
+  uint8_t c;
+
+  for (in = out = 0; out < n; ) {
+    if (in >= avail) {
+      return 1;
+    }
+    c = src[in++];
+    if (c < 128) {
+      len = c + 1;
+      if (len > avail - in || len > n - out) {
+        return 1;
+      }
+      memcpy(dst + out, src + in, len);
+      in += len;
+    } else {
+      len = c - 125;
+      if (in >= avail || len > n - out) {
+        return 1;
+      }
+      memset(dst + out, src[in++], len);
+    }
+    out += len;
+  }
+
+  return in != avail;
+}
+
+static int compare_keys(const void *key, const void *with)
+{
+  uint64_t a = *(const uint64_t *) key;
+  uint64_t b = *(const uint64_t *) with;
+
+  return a < b ? -1 : a > b;
+}
+
+/* Code lengths from symbol frequencies, by the two-queue method: with *
+ * the leaves sorted, the joined nodes come out sorted too, so the two *
+ * lightest are always at the front of one queue or the other.  If the *
+ * tree comes out deeper than PACK_MAX_CODE, the frequencies are       *
+ * flattened and it's rebuilt.                                         */
+static void huffman_lengths(uint32_t freq[256], uint8_t len[256])
+{
+  uint32_t weight[511];
+  uint64_t key[256];
+  uint16_t leaf[256], parent[511];
+  uint32_t i, j, nodes, leaves, next_leaf, next_node, pick[2], depth, max;
+
+  for (;;) {
+    /* Sort keys carry the symbol in the low byte */
+    for (leaves = i = 0; i < 256; i++) {
+      weight[i] = freq[i];
+      if (freq[i]) {
+        key[leaves++] = (uint64_t) freq[i] << 8 | i;
+      }
+    }
+    qsort(key, leaves, sizeof (key[0]), compare_keys);
+    for (i = 0; i < leaves; i++) {
+      leaf[i] = key[i] & 0xff;
+    }
+
+    memset(len, 0, 256);
+    if (leaves == 1) {
+      len[leaf[0]] = 1;
+      return;
+    }
+
+    for (nodes = 256, next_leaf = 0, next_node = 256;
+         nodes < 256 + leaves - 1;
+         nodes++) {
+      for (j = 0; j < 2; j++) {
+        if (next_leaf < leaves &&
+            (next_node == nodes ||
+             weight[leaf[next_leaf]] <= weight[next_node])) {
+          pick[j] = leaf[next_leaf++];
+        } else {
+          pick[j] = next_node++;
+        }
+      }
+      weight[nodes] = weight[pick[0]] + weight[pick[1]];
+      parent[pick[0]] = parent[pick[1]] = nodes;
+    }
+
+    /* The root is the last node joined.  Parents are always later than *
+     * their children, so depths can be filled in from the top down.    */
+    for (i = nodes - 1; i > nodes - 1 - (leaves - 1); i--) {
+      weight[i] = (i == nodes - 1) ? 0 : weight[parent[i]] + 1;
+    }
+    for (max = 0, i = 0; i < leaves; i++) {
+      depth = weight[parent[leaf[i]]] + 1;
+      len[leaf[i]] = depth;
+      max = depth > max ? depth : max;
+    }
+    if (max <= PACK_MAX_CODE) {
+      return;
+    }
+
+    for (i = 0; i < 256; i++) {
+      if (freq[i]) {
+        freq[i] = (freq[i] + 1) / 2;
+      }
+    }
+  }
+}
+
+static void huffman_codes(const uint8_t len[256], uint16_t code[256])
+{
+  uint32_t l, s, c;
+
+  for (c = 0, l = 1; l <= PACK_MAX_CODE; l++, c <<= 1) {
+    for (s = 0; s < 256; s++) {
+      if (len[s] == l) {
+        code[s] = c++;
+      }
+    }
+  }
+}
+
+static uint32_t huffman_encode(const uint8_t *src, uint32_t n, uint8_t *dst)
+{
+  uint32_t freq[256];
+  uint8_t len[256];
+  uint16_t code[256];
+  uint64_t acc;
+  uint32_t i, bits, out;
+
+  memset(freq, 0, sizeof (freq));
+  for (i = 0; i < n; i++) {
+    freq[src[i]]++;
+  }
+  memset(len, 0, sizeof (len));
+  if (n) {
+    huffman_lengths(freq, len);
+  }
+  huffman_codes(len, code);
+
+  for (i = 0; i < PACK_LENGTHS; i++) {
+    dst[i] = len[2 * i] << 4 | len[2 * i + 1];
+  }
+
+  for (out = PACK_LENGTHS, acc = bits = i = 0; i < n; i++) {
+    acc = acc << len[src[i]] | code[src[i]];
+    for (bits += len[src[i]]; bits >= 8; bits -= 8) {
+      dst[out++] = acc >> (bits - 8);
+    }
+  }
+  if (bits) {
+    dst[out++] = acc << (8 - bits);
+  }
+
+  return out;
+}
+
+static int huffman_decode(const uint8_t *src, uint32_t avail,
+                          uint8_t *dst, uint32_t n)
+{
+  uint16_t table[1 << PACK_MAX_CODE];
+  uint8_t len[256];
+  uint16_t code[256];
+  uint64_t acc;
+  uint32_t i, j, kraft, bits, in, peek;
+
+  if (avail < PACK_LENGTHS) {
+    return 1;
+  }
+  for (kraft = i = 0; i < 256; i++) {
+    len[i] = (i & 1) ? src[i / 2] & 0xf : src[i / 2] >> 4;
+    if (len[i] > PACK_MAX_CODE) {
+      return 1;
+    }
+    if (len[i]) {
+      kraft += 1 << (PACK_MAX_CODE - len[i]);
+    }
+  }
+  if (kraft > (1 << PACK_MAX_CODE)) {
+    return 1;
+  }
+  huffman_codes(len, code);
+
+  /* Each code fills every slot that starts with it; holes stay 0. */
+  memset(table, 0, sizeof (table));
+  for (i = 0; i < 256; i++) {
+    if (len[i]) {
+      for (j = 0; j < 1U << (PACK_MAX_CODE - len[i]); j++) {
+        table[(code[i] << (PACK_MAX_CODE - len[i])) | j] = len[i] << 8 | i;
+      }
+    }
+  }
+
+  for (in = PACK_LENGTHS, acc = bits = i = 0; i < n; i++) {
+    while (bits <= 56 && in < avail) {
+      acc = acc << 8 | src[in++];
+      bits += 8;
+    }
+    peek = (bits >= PACK_MAX_CODE                             ?
+            acc >> (bits - PACK_MAX_CODE)                     :
+            acc << (PACK_MAX_CODE - bits)) & ((1 << PACK_MAX_CODE) - 1);
+    if (!table[peek] || (table[peek] >> 8) > bits) {
+      return 1;
+    }
+    dst[i] = table[peek] & 0xff;
+    bits -= table[peek] >> 8;
+  }
+
+  return in != avail || bits >= 8;
+}
+
+uint32_t pack_bytes(const uint8_t *src, uint32_t n, uint32_t stride,
+                    uint8_t *dst)
+{
+  uint8_t *delta, *rle, *huff;
+  const uint8_t *stage, *payload;
+  uint32_t method, best, mid, size, best_mid, best_size;
+
+  delta = (uint8_t *) malloc(n + 1);
+  rle = (uint8_t *) malloc(n + n / 128 + 1);
+  huff = (uint8_t *) malloc(PACK_LENGTHS + 2 * (n + n / 128 + 1));
+
+  /* Storing it raw is always an option, and the fallback. */
+  memcpy(dst + PACK_HEADER, src, n);
+  best = 0;
+  best_mid = best_size = n;
+
+  if (stride && stride < 0x10000) {
+    delta_encode(src, n, stride, delta);
+  }
+
+  for (method = 1; method < 8; method++) {
+    if ((method & PACK_DELTA) && !(stride && stride < 0x10000)) {
+      continue;
+    }
+    stage = (method & PACK_DELTA) ? delta : src;
+    mid = n;
+    if (method & PACK_RLE) {
+      mid = rle_encode(stage, n, rle);
+      stage = rle;
+    }
+    size = mid;
+    payload = stage;
+    if (method & PACK_HUFFMAN) {
+      size = huffman_encode(stage, mid, huff);
+      payload = huff;
+    }
+    if (size < best_size) {
+      memcpy(dst + PACK_HEADER, payload, size);
+      best = method;
+      best_mid = mid;
+      best_size = size;
+    }
+  }
+
+  free(delta);
+  free(rle);
+  free(huff);
+
+  dst[PACK_METHOD] = best;
+  dst[PACK_STRIDE] = (best & PACK_DELTA) ? stride >> 8 : 0;
+  dst[PACK_STRIDE + 1] = (best & PACK_DELTA) ? stride & 0xff : 0;
+  put_be32(dst + PACK_RAW_LEN, n);
+  put_be32(dst + PACK_MID_LEN, best_mid);
+  put_be32(dst + PACK_PACKED_LEN, best_size);
+
+  return PACK_HEADER + best_size;
+}
+
+int packed_info(const uint8_t *src, uint32_t avail,
+                uint32_t *raw, uint32_t *block)
+{
+  if (avail < PACK_HEADER ||
+      get_be32(src + PACK_PACKED_LEN) > avail - PACK_HEADER ||
+      get_be32(src + PACK_RAW_LEN) > PACK_MAX_RAW) {
+    return 1;
+  }
+  *raw = get_be32(src + PACK_RAW_LEN);
+  *block = PACK_HEADER + get_be32(src + PACK_PACKED_LEN);
+
+  return 0;
+}
+
+uint32_t unpack_bytes(const uint8_t *src, uint32_t avail,
+                      uint8_t *dst, uint32_t n)
+{
+  uint32_t method, stride, mid, size;
+  const uint8_t *payload;
+  uint8_t *rle;
+  int failed;
+
+  if (avail < PACK_HEADER) {
+    return 0;
+  }
+  method = src[PACK_METHOD];
+  stride = src[PACK_STRIDE] << 8 | src[PACK_STRIDE + 1];
+  mid = get_be32(src + PACK_MID_LEN);
+  size = get_be32(src + PACK_PACKED_LEN);
+  payload = src + PACK_HEADER;
+  if (method > (PACK_DELTA | PACK_RLE | PACK_HUFFMAN)               ||
+      get_be32(src + PACK_RAW_LEN) != n                             ||
+      size > avail - PACK_HEADER                                    ||
+      ((method & PACK_DELTA) && !stride)                            ||
+      (!(method & PACK_RLE) && mid != n)                            ||
+      (!(method & PACK_HUFFMAN) && size != mid)) {
+    return 0;
+  }
+
+  switch (method & (PACK_RLE | PACK_HUFFMAN)) {
+  case 0:
+    memcpy(dst, payload, n);
+    failed = 0;
+    break;
+  case PACK_RLE:
+    failed = rle_decode(payload, size, dst, n);
+    break;
+  case PACK_HUFFMAN:
+    failed = huffman_decode(payload, size, dst, n);
+    break;
+  default:
+    rle = (uint8_t *) malloc(mid + 1);
+    failed = (huffman_decode(payload, size, rle, mid) ||
+              rle_decode(rle, mid, dst, n));
+    free(rle);
+    break;
+  }
+  if (failed) {
+    return 0;
+  }
+
+  if (method & PACK_DELTA) {
+    delta_decode(dst, n, stride);
+  }
+
+  return PACK_HEADER + size;
+}
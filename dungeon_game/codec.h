@@ -0,0 +1,46 @@
+#ifndef CODEC_H
+# define CODEC_H
+
+# include <stdint.h>
+
+/* A small byte codec for save files.  A packed block is a 15-byte     *
+ * big-endian header followed by the data after up to three stages:   *
+ *                                                                     *
+ *   PACK_DELTA    Each byte minus the one a stride before it.  With   *
+ *                 the stride set to the row width, rows become their  *
+ *                 difference from the row above, which turns smooth   *
+ *                 images and repeated terrain into runs of zero.      *
+ *   PACK_RLE      Runs of three or more equal bytes become two bytes; *
+ *                 everything else is copied through in literal spans. *
+ *   PACK_HUFFMAN  A canonical Huffman code over what's left, with at  *
+ *                 most PACK_MAX_CODE bits per symbol.                 *
+ *                                                                     *
+ * pack_bytes() tries every combination and keeps the smallest, so a   *
+ * block is never more than PACK_HEADER bytes larger than its input.   *
+ * Decoding is table-driven: literal spans and runs are memcpy() and   *
+ * memset(), the delta is undone a whole row at a time, and Huffman    *
+ * codes are looked up PACK_MAX_CODE bits at once.                     */
+
+# define PACK_DELTA    0x01
+# define PACK_RLE      0x02
+# define PACK_HUFFMAN  0x04
+# define PACK_HEADER   15
+# define PACK_MAX_CODE 12
+# define PACK_MAX_RAW  (1U << 24)
+
+/* An upper bound on the size of a packed block, for sizing buffers. */
+# define pack_bound(n) ((n) + PACK_HEADER)
+
+uint32_t pack_bytes(const uint8_t *src, uint32_t n, uint32_t stride,
+                    uint8_t *dst);
+/* Returns the length of the block read from src, or 0 if it's corrupt *
+ * or doesn't unpack to exactly n bytes.                               */
+uint32_t unpack_bytes(const uint8_t *src, uint32_t avail,
+                      uint8_t *dst, uint32_t n);
+/* Reads the block header at src: its unpacked length, and its own   *
+ * length, header included.  Fails if the block would overrun avail   *
+ * or claims to unpack to more than PACK_MAX_RAW bytes.               */
+int packed_info(const uint8_t *src, uint32_t avail,
+                uint32_t *raw, uint32_t *block);
+
+#endif
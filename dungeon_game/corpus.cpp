@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "corpus.h"
+#include "dungeon.h"
+#include "utils.h"
+
+/* Batch generation of save files, for building test corpora like *
+ * 327_test_dungeons/.  Level i is seeded with a value derived from *
+ * the base seed and i alone, so the corpus is the same no matter   *
+ * how many threads build it or which thread gets which level.  The *
+ * file is named for its seed, so 'rlg327 --rand <seed>' regenerates *
+ * any level of the corpus.                                          */
+
+typedef struct corpus_job {
+  const char *dir;
+  uint32_t base_seed;
+  uint32_t count;
+  uint32_t compress;
+  uint32_t next;    /* Next level to claim; shared by the workers */
+  uint32_t failed;
+  pthread_mutex_t lock;
+  double cpu_time;  /* Summed over the workers, under lock */
+} corpus_job_t;
+
+static double now(clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime(clock, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/* Murmur3's finalizer; adjacent levels get unrelated seeds. */
+uint32_t corpus_level_seed(uint32_t base_seed, uint32_t level)
+{
+  uint32_t h;
+
+  h = base_seed + level * 0x9e3779b9;
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+
+  return h;
+}
+
+static int generate_level(dungeon_t *d, const char *dir, uint32_t seed)
+{
+  char filename[PATH_MAX];
+  int retval;
+
+  snprintf(filename, sizeof (filename), "%s/%u.rlg327", dir, seed);
+
+  /* The RNG is per-thread, so seeding it here only affects this level */
+  rng_seed(seed);
+  init_dungeon(d);
+  gen_dungeon(d);
+  retval = write_dungeon(d, filename);
+  delete_dungeon(d);
+
+  return retval;
+}
+
+static void *corpus_worker(void *v)
+{
+  corpus_job_t *job = (corpus_job_t *) v;
+  dungeon_t *d;
+  uint32_t level;
+  double t;
+
+  t = now(CLOCK_THREAD_CPUTIME_ID);
+  d = new dungeon_t();
+  d->compress_saves = job->compress;
+
+  while ((level = __sync_fetch_and_add(&job->next, 1)) < job->count) {
+    if (generate_level(d, job->dir,
+                       corpus_level_seed(job->base_seed, level))) {
+      __sync_fetch_and_add(&job->failed, 1);
+    }
+  }
+
+  delete d;
+
+  t = now(CLOCK_THREAD_CPUTIME_ID) - t;
+  pthread_mutex_lock(&job->lock);
+  job->cpu_time += t;
+  pthread_mutex_unlock(&job->lock);
+
+  return NULL;
+}
+
+/* How well the pool scaled is judged from the levels it made, not *
+ * against a separate serial run: every level is generated once, and *
+ * the workers' CPU time, summed, is what one thread would have      *
+ * taken.  Against the wall clock, that gives the speedup.  Levels   *
+ * vary a good deal in cost, so comparing the rates of two different *
+ * sets of them says little.                                         */
+int generate_corpus(uint32_t count, const char *dir, uint32_t threads,
+                    uint32_t base_seed, uint32_t compress)
+{
+  corpus_job_t job;
+  pthread_t *pool;
+  char *path;
+  uint32_t i, started;
+  double t, speedup;
+
+  path = (char *) malloc(strlen(dir) + 2);
+  sprintf(path, "%s/", dir);
+  makedirectory(path);
+  free(path);
+
+  if (!threads) {
+    threads = 1;
+  }
+
+  job.dir = dir;
+  job.compress = compress;
+  job.base_seed = base_seed;
+  job.failed = 0;
+  job.next = 0;
+  job.count = count;
+  job.cpu_time = 0.0;
+  pthread_mutex_init(&job.lock, NULL);
+
+  pool = (pthread_t *) malloc(threads * sizeof (*pool));
+  t = now(CLOCK_MONOTONIC);
+  for (started = 0; started < threads; started++) {
+    if (pthread_create(pool + started, NULL, corpus_worker, &job)) {
+      perror("pthread_create");
+      break;
+    }
+  }
+  if (!started) {
+    /* No threads at all; do the job here. */
+    corpus_worker(&job);
+  }
+  for (i = 0; i < started; i++) {
+    pthread_join(pool[i], NULL);
+  }
+  t = now(CLOCK_MONOTONIC) - t;
+  free(pool);
+  pthread_mutex_destroy(&job.lock);
+
+  printf("Generated %u levels in %s with base seed %u.\n",
+         count - job.failed, dir, base_seed);
+  if (job.failed) {
+    fprintf(stderr, "%u levels could not be written.\n", job.failed);
+  }
+
+  if (!count || t <= 0.0) {
+    return !!job.failed;
+  }
+
+  started = started ? started : 1;
+  speedup = job.cpu_time / t;
+  printf("%3u threads: %10.1f levels/s, %.3fs wall, %.3fs CPU\n",
+         started, count / t, t, job.cpu_time);
+  printf("Speedup %.2fx, scaling efficiency %.1f%% per core\n",
+         speedup, 100.0 * speedup / started);
+
+  return !!job.failed;
+}
@@ -0,0 +1,10 @@
+#ifndef CORPUS_H
+# define CORPUS_H
+
+# include <stdint.h>
+
+uint32_t corpus_level_seed(uint32_t base_seed, uint32_t level);
+int generate_corpus(uint32_t count, const char *dir, uint32_t threads,
+                    uint32_t base_seed, uint32_t compress);
+
+#endif
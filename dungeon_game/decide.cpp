@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "decide.h"
+#include "dungeon.h"
+#include "npc.h"
+#include "utils.h"
+
+static struct {
+  uint32_t running;
+  uint32_t restart;          /* Forked while running; threads to start */
+  pthread_t *pool;
+  uint32_t workers;          /* Not counting the caller */
+  pthread_mutex_t lock;
+  pthread_cond_t go, done;
+  uint32_t generation;       /* Bumped for each batch */
+  uint32_t busy;             /* Workers yet to finish this batch */
+  uint32_t stop;
+  /* The batch */
+  dungeon_t *d;
+  npc_decision_t *decisions;
+  uint32_t n;
+  uint32_t next;             /* Next decision to claim */
+} decide = {
+  0, 0, NULL, 0,
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
+
+static void decide_one(dungeon_t *d, npc_decision_t *e)
+{
+  character_table &t = d->characters;
+
+  e->decided = 0;
+  if (!t.alive[e->c]) {
+    return;
+  }
+
+  e->from[dim_y] = t.position[e->c][dim_y];
+  e->from[dim_x] = t.position[e->c][dim_x];
+  e->digs = d->digs;
+  e->pc_last_known_position[dim_y] = t.pc_last_known_position[e->c][dim_y];
+  e->pc_last_known_position[dim_x] = t.pc_last_known_position[e->c][dim_x];
+  e->have_seen_pc = t.have_seen_pc[e->c];
+  e->decided = npc_plan_pos(d, e->c, e->next);
+}
+
+static void decide_claim(void)
+{
+  uint32_t i;
+
+  while ((i = __sync_fetch_and_add(&decide.next, 1)) < decide.n) {
+    decide_one(decide.d, decide.decisions + i);
+  }
+}
+
+/* Started with the generation there was then, so that a batch handed *
+ * out before the worker gets going isn't missed.                      */
+static void *decide_main(void *v)
+{
+  uint32_t generation = (uintptr_t) v;
+
+  pthread_mutex_lock(&decide.lock);
+  for (;;) {
+    while (decide.generation == generation && !decide.stop) {
+      pthread_cond_wait(&decide.go, &decide.lock);
+    }
+    if (decide.stop) {
+      break;
+    }
+    generation = decide.generation;
+    pthread_mutex_unlock(&decide.lock);
+
+    decide_claim();
+
+    pthread_mutex_lock(&decide.lock);
+    if (!--decide.busy) {
+      pthread_cond_signal(&decide.done);
+    }
+  }
+  pthread_mutex_unlock(&decide.lock);
+
+  return NULL;
+}
+
+/* fork() brings only the calling thread, and a checkpoint forks between *
+ * turns, when the workers are all waiting; the child starts its own.    */
+static void decide_child(void)
+{
+  decide.restart = decide.running ? decide.workers + 1 : 0;
+  decide.running = 0;
+  decide.workers = 0;
+  free(decide.pool);
+  decide.pool = NULL;
+  pthread_mutex_init(&decide.lock, NULL);
+  pthread_cond_init(&decide.go, NULL);
+  pthread_cond_init(&decide.done, NULL);
+}
+
+static void decide_register_fork(void)
+{
+  pthread_atfork(NULL, NULL, decide_child);
+}
+
+int decide_start(uint32_t threads)
+{
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+  if (decide.running) {
+    return 0;
+  }
+
+  pthread_once(&once, decide_register_fork);
+
+#ifdef CHUNKED_WORLD
+  threads = 1;
+#endif
+
+  decide.stop = 0;
+  decide.workers = 0;
+  if (threads > 1) {
+    decide.pool = (pthread_t *) malloc((threads - 1) * sizeof (*decide.pool));
+    for (; decide.workers < threads - 1; decide.workers++) {
+      if (create_thread(decide.pool + decide.workers, decide_main,
+                        (void *) (uintptr_t) decide.generation)) {
+        perror("pthread_create");
+        break;
+      }
+    }
+  }
+  decide.running = 1;
+
+  return 0;
+}
+
+uint32_t decide_running(void)
+{
+  if (!decide.running && decide.restart) {
+    decide_start(decide.restart);
+    decide.restart = 0;
+  }
+
+  return decide.running;
+}
+
+void decide_npcs(dungeon_t *d, npc_decision_t *decisions, uint32_t n)
+{
+  decide.d = d;
+  decide.decisions = decisions;
+  decide.n = n;
+  decide.next = 0;
+
+  if (!decide.workers || n < DECIDE_MIN_BATCH) {
+    decide_claim();
+    return;
+  }
+
+  pthread_mutex_lock(&decide.lock);
+  decide.busy = decide.workers;
+  decide.generation++;
+  pthread_cond_broadcast(&decide.go);
+  pthread_mutex_unlock(&decide.lock);
+
+  decide_claim();
+
+  pthread_mutex_lock(&decide.lock);
+  while (decide.busy) {
+    pthread_cond_wait(&decide.done, &decide.lock);
+  }
+  pthread_mutex_unlock(&decide.lock);
+}
+
+uint32_t decide_take(dungeon_t *d, npc_decision_t *e, pair_t next)
+{
+  character_table &t = d->characters;
+
+  if (!e->decided) {
+    return 0;
+  }
+
+  if (t.position[e->c][dim_y] != e->from[dim_y] ||
+      t.position[e->c][dim_x] != e->from[dim_x] ||
+      (d->digs != e->digs && !npc_plan_ignores_digs(d, e->c))) {
+    decide_drop(d, e);
+    return 0;
+  }
+
+  next[dim_y] = e->next[dim_y];
+  next[dim_x] = e->next[dim_x];
+
+  return 1;
+}
+
+void decide_drop(dungeon_t *d, npc_decision_t *e)
+{
+  character_table &t = d->characters;
+
+  if (e->decided) {
+    t.pc_last_known_position[e->c][dim_y] = e->pc_last_known_position[dim_y];
+    t.pc_last_known_position[e->c][dim_x] = e->pc_last_known_position[dim_x];
+    t.have_seen_pc[e->c] = e->have_seen_pc;
+    e->decided = 0;
+  }
+}
+
+void decide_stop(void)
+{
+  uint32_t i;
+
+  if (!decide.running) {
+    return;
+  }
+
+  pthread_mutex_lock(&decide.lock);
+  decide.stop = 1;
+  pthread_cond_broadcast(&decide.go);
+  pthread_mutex_unlock(&decide.lock);
+  for (i = 0; i < decide.workers; i++) {
+    pthread_join(decide.pool[i], NULL);
+  }
+  free(decide.pool);
+  decide.pool = NULL;
+  decide.workers = 0;
+  decide.running = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef DECIDE_H
+# define DECIDE_H
+
+# include <stdint.h>
+
+# include "dims.h"
+# include "character.h"
+
+typedef struct dungeon dungeon_t;
+
+/* The NPC turn in two phases.  Every NPC due at the same time is popped *
+ * off the turn queue together, and those whose moves don't depend on    *
+ * the RNG or on digging (see npc_plan_pos()) decide them at once, on a  *
+ * pool of threads.  The moves are then made one at a time, in turn      *
+ * order, exactly as the serial loop makes them: collisions, displacing  *
+ * and combat are all settled there.  A decision is only used if the NPC *
+ * is still where it decided from and nothing has been dug out since    *
+ * (that it could have noticed; see npc_plan_ignores_digs()); otherwise  *
+ * it's thrown away, and the NPC decides again in its turn.              *
+ * Either way the game comes out the same, bit for bit, as it does with  *
+ * one thread.                                                           *
+ *                                                                       *
+ * There's one pool, for the one game being played; simulations run     *
+ * many games on threads of their own, and stay serial.  A CHUNKED_WORLD *
+ * grid pages its tiles in as they're read, so there the decisions are   *
+ * made on the calling thread alone.                                     */
+
+/* Fewer NPCs than this in a turn aren't worth waking the pool for */
+# define DECIDE_MIN_BATCH 16
+
+typedef struct npc_decision {
+  character_id_t c;
+  uint32_t decided;
+  pair_t next;
+  pair_t from;                 /* Its position when it decided */
+  uint32_t digs;               /* dungeon_t::digs when it decided */
+  /* Its memory of the PC beforehand, to put back if the plan is dropped */
+  pair_t pc_last_known_position;
+  uint8_t have_seen_pc;
+} npc_decision_t;
+
+/* threads includes the caller, so one gives the two phases without a pool */
+int decide_start(uint32_t threads);
+uint32_t decide_running(void);
+/* Decides as many of the n as can be decided ahead of their turns */
+void decide_npcs(dungeon_t *d, npc_decision_t *decisions, uint32_t n);
+/* In the NPC's turn: its decision in next, if it still holds.  If not, *
+ * gives 0, having put back its memory, for it to decide again.         */
+uint32_t decide_take(dungeon_t *d, npc_decision_t *e, pair_t next);
+/* Puts back the memory of an NPC whose turn didn't come after all */
+void decide_drop(dungeon_t *d, npc_decision_t *e);
+void decide_stop(void);
+
+#endif
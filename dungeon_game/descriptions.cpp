@@ -2,12 +2,18 @@
 #include <cstring>
 #include <iostream>
 #include <cstdio>
-#include <fstream>
+#include <string_view>
+#include <charconv>
 #include <limits.h>
 #include <ncurses.h>
 #include <vector>
 #include <sstream>
 #include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "descriptions.h"
 #include "dungeon.h"
@@ -15,6 +21,8 @@
 #include "dice.h"
 #include "character.h"
 #include "utils.h"
+#include "cache.h"
+#include "builtin.h"
 
 #define MONSTER_FILE_SEMANTIC          "RLG327 MONSTER DESCRIPTION"
 #define MONSTER_FILE_VERSION           1U
@@ -112,23 +120,84 @@ extern const char object_symbol[] = {
   '%', /* objtype_CONTAINER */
 };
 
-static inline void eat_whitespace(std::ifstream &f)
+/* The description files are mapped and lexed in place.  Tokens and   *
+ * lines are views into the mapping, so nothing is allocated until a   *
+ * field is copied into its description.  The primitives below stand   *
+ * in for the istream calls the parser was first written against:      *
+ * lex_token() for operator>>, lex_line() for getline().               */
+typedef struct lexer {
+  const char *start;
+  const char *next;
+  const char *end;
+  std::ostream *err;          /* Where parse errors go */
+  uint32_t discarded;         /* Entries thrown away for them */
+  bool skipping;              /* Through the rest of one of those */
+} lexer_t;
+
+/* The entry being read is thrown away; the next one is looked for */
+static inline void lex_discard(lexer_t *f)
 {
-  while (isspace(f.peek())) {
-    f.get();
+  f->discarded++;
+  f->skipping = true;
+}
+
+static inline int lex_peek(lexer_t *f)
+{
+  return f->next < f->end ? (unsigned char) *f->next : EOF;
+}
+
+static inline int lex_get(lexer_t *f)
+{
+  return f->next < f->end ? (unsigned char) *f->next++ : EOF;
+}
+
+/* The next run of non-whitespace; empty at the end of the file. */
+static inline std::string_view lex_token(lexer_t *f)
+{
+  const char *start;
+
+  while (f->next < f->end && isspace((unsigned char) *f->next)) {
+    f->next++;
+  }
+  for (start = f->next;
+       f->next < f->end && !isspace((unsigned char) *f->next);
+       f->next++)
+    ;
+
+  return std::string_view(start, f->next - start);
+}
+
+/* The rest of the line, consuming but not including the newline */
+static inline std::string_view lex_line(lexer_t *f)
+{
+  const char *start, *newline;
+
+  start = f->next;
+  if (!(newline = (const char *) memchr(start, '\n', f->end - start))) {
+    newline = f->end;
+  }
+  f->next = newline < f->end ? newline + 1 : newline;
+
+  return std::string_view(start, newline - start);
+}
+
+static inline void eat_whitespace(lexer_t *f)
+{
+  while (isspace(lex_peek(f))) {
+    lex_get(f);
   }  
 }
 
-static inline void eat_blankspace(std::ifstream &f)
+static inline void eat_blankspace(lexer_t *f)
 {
-  while (isblank(f.peek())) {
-    f.get();
+  while (isblank(lex_peek(f))) {
+    lex_get(f);
   }  
 }
 
-static uint32_t parse_name(std::ifstream &f,
-                           std::string *lookahead,
-                           std::string *name)
+static uint32_t parse_name(lexer_t *f,
+                           std::string_view *lookahead,
+                           std::string_view *name)
 {
   /* Always start by eating the blanks.  If we then find a newline, we *
    * know there's an error in the file.  If we eat all whitespace,     *
@@ -137,50 +206,50 @@ static uint32_t parse_name(std::ifstream &f,
 
   eat_blankspace(f);
 
-  if (f.peek() == '\n') {
+  if (lex_peek(f) == '\n') {
     return 1;
   }
 
-  getline(f, *name);
+  *name = lex_line(f);
 
   /* We enter this function with the semantic in the lookahead, so we  *
    * read a new one so that we're in the same state for the next call. */
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
   return 0;
 }
 
-static uint32_t parse_monster_name(std::ifstream &f,
-                                   std::string *lookahead,
-                                   std::string *name)
+static uint32_t parse_monster_name(lexer_t *f,
+                                   std::string_view *lookahead,
+                                   std::string_view *name)
 {
   return parse_name(f, lookahead, name);
 }
 
-static uint32_t parse_monster_symb(std::ifstream &f,
-                                   std::string *lookahead,
+static uint32_t parse_monster_symb(lexer_t *f,
+                                   std::string_view *lookahead,
                                    char *symb)
 {
   eat_blankspace(f);
 
-  if (f.peek() == '\n') {
+  if (lex_peek(f) == '\n') {
     return 1;
   }
 
-  *symb = f.get();
+  *symb = lex_get(f);
 
   eat_blankspace(f);
-  if (f.peek() != '\n') {
+  if (lex_peek(f) != '\n') {
     return 1;
   }
 
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
   return 0;
 }
 
-static uint32_t parse_color(std::ifstream &f,
-                            std::string *lookahead,
+static uint32_t parse_color(lexer_t *f,
+                            std::string_view *lookahead,
                             uint32_t *color)
 {
   uint32_t i;
@@ -189,11 +258,11 @@ static uint32_t parse_color(std::ifstream &f,
 
   eat_blankspace(f);
 
-  if (f.peek() == '\n') {
+  if (lex_peek(f) == '\n') {
     return 1;
   }
 
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
   for (i = 0; colors_lookup[i].name; i++) {
     if (*lookahead == colors_lookup[i].name) {
@@ -207,17 +276,17 @@ static uint32_t parse_color(std::ifstream &f,
   }
 
   eat_blankspace(f);
-  if (f.peek() != '\n') {
+  if (lex_peek(f) != '\n') {
     return 1;
   }
 
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
   return 0;
 }
 
-static uint32_t parse_monster_color(std::ifstream &f,
-                                    std::string *lookahead,
+static uint32_t parse_monster_color(lexer_t *f,
+                                    std::string_view *lookahead,
                                     std::vector<uint32_t> *color)
 {
   uint32_t i;
@@ -227,12 +296,12 @@ static uint32_t parse_monster_color(std::ifstream &f,
 
   eat_blankspace(f);
 
-  if (f.peek() == '\n') {
+  if (lex_peek(f) == '\n') {
     return 1;
   }
 
   do {
-    f >> *lookahead;
+    *lookahead = lex_token(f);
 
     for (i = 0; colors_lookup[i].name; i++) {
       if (*lookahead == colors_lookup[i].name) {
@@ -248,87 +317,165 @@ static uint32_t parse_monster_color(std::ifstream &f,
     color->push_back(c);
 
     eat_blankspace(f);
-  } while (f.peek() != '\n');
+  } while (lex_peek(f) != '\n');
 
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
   return 0;
 }
 
-static uint32_t parse_desc(std::ifstream &f,
-                           std::string *lookahead,
-                           std::string *desc)
+static uint32_t parse_desc(lexer_t *f,
+                           std::string_view *lookahead,
+                           std::string_view *desc)
 {
+  const char *start, *end;
+
   /* DESC is special.  Data doesn't follow on the same line *
    * as the keyword, so we want to eat the newline, too.    */
   eat_blankspace(f);
 
-  if (f.peek() != '\n') {
+  if (lex_peek(f) != '\n') {
     return 1;
   }
 
-  f.get();
+  lex_get(f);
 
-  while (f.peek() != EOF) {
-    getline(f, *lookahead);
+  /* The lines are already contiguous in the file, so the description *
+   * is copied out in one piece once its end has been found.          */
+  start = end = f->next;
+  for (;;) {
+    if (lex_peek(f) == EOF) {
+      return 1;
+    }
+    end = f->next;
+    *lookahead = lex_line(f);
     if (lookahead->length() > 77) {
       return 1;
     }
-
-    lookahead->push_back('\n');
-
-    if (*lookahead == ".\n") {
+    if (*lookahead == ".") {
       break;
     }
-
-    *desc += *lookahead;
   }
 
-  /* Strip off the trailing newline */
-  desc->erase(desc->length() - 1);
+  /* Less the trailing newline */
+  *desc = std::string_view(start, end > start ? end - start - 1 : 0);
 
-  if (*lookahead != ".\n") {
-    return 1;
-  }
-
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
   return 0;
 }
 
-static uint32_t parse_monster_desc(std::ifstream &f,
-                                   std::string *lookahead,
-                                   std::string *desc)
+static uint32_t parse_monster_desc(lexer_t *f,
+                                   std::string_view *lookahead,
+                                   std::string_view *desc)
 {
   return parse_desc(f, lookahead, desc);
 }
 
-typedef uint32_t (*dice_parser_func_t)(std::ifstream &f,
-                                       std::string *lookahead,
+typedef uint32_t (*dice_parser_func_t)(lexer_t *f,
+                                       std::string_view *lookahead,
                                        dice *hit);
 
-static uint32_t parse_dice(std::ifstream &f,
-                           std::string *lookahead,
+static uint32_t parse_dice(lexer_t *f,
+                           std::string_view *lookahead,
                            dice *d)
 {
   int32_t base;
   uint32_t number, sides;
+  const char *p, *end;
+  std::from_chars_result r;
 
   eat_blankspace(f);
 
-  if (f.peek() == '\n') {
+  if (lex_peek(f) == '\n') {
     return 1;
   }
 
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
-  if (sscanf(lookahead->c_str(), "%d+%ud%u", &base, &number, &sides) != 3) {
+  /* <base>+<number>d<sides> */
+  p = lookahead->data();
+  end = p + lookahead->length();
+  if ((r = std::from_chars(p, end, base)).ec != std::errc() ||
+      r.ptr == end || *r.ptr != '+' ||
+      (r = std::from_chars(r.ptr + 1, end, number)).ec != std::errc() ||
+      r.ptr == end || *r.ptr != 'd' ||
+      (r = std::from_chars(r.ptr + 1, end, sides)).ec != std::errc()) {
     return 1;
   }
 
   d->set(base, number, sides);
 
-  f >> *lookahead;
+  *lookahead = lex_token(f);
+
+  return 0;
+}
+
+static bool parse_uint(std::string_view token, uint32_t *n)
+{
+  const char *end;
+
+  end = token.data() + token.length();
+
+  return std::from_chars(token.data(), end, *n).ptr == end && !token.empty();
+}
+
+static uint32_t parse_rarity(lexer_t *f,
+                             std::string_view *lookahead,
+                             uint32_t *rarity)
+{
+  eat_blankspace(f);
+
+  if (lex_peek(f) == '\n') {
+    return 1;
+  }
+
+  *lookahead = lex_token(f);
+  if (!parse_uint(*lookahead, rarity) || !*rarity || *rarity > MAX_RARITY) {
+    return 1;
+  }
+
+  eat_blankspace(f);
+  if (lex_peek(f) != '\n') {
+    return 1;
+  }
+
+  *lookahead = lex_token(f);
+
+  return 0;
+}
+
+/* DEPTH <shallowest> [<deepest>] */
+static uint32_t parse_depth(lexer_t *f,
+                            std::string_view *lookahead,
+                            uint32_t *min_depth,
+                            uint32_t *max_depth)
+{
+  eat_blankspace(f);
+
+  if (lex_peek(f) == '\n') {
+    return 1;
+  }
+
+  *lookahead = lex_token(f);
+  if (!parse_uint(*lookahead, min_depth)) {
+    return 1;
+  }
+
+  *max_depth = MAX_DEPTH;
+  eat_blankspace(f);
+  if (lex_peek(f) != '\n') {
+    *lookahead = lex_token(f);
+    if (!parse_uint(*lookahead, max_depth) || *max_depth < *min_depth) {
+      return 1;
+    }
+    eat_blankspace(f);
+    if (lex_peek(f) != '\n') {
+      return 1;
+    }
+  }
+
+  *lookahead = lex_token(f);
 
   return 0;
 }
@@ -337,8 +484,8 @@ static dice_parser_func_t parse_monster_speed = parse_dice;
 static dice_parser_func_t parse_monster_dam = parse_dice;
 static dice_parser_func_t parse_monster_hp = parse_dice;
 
-static uint32_t parse_monster_abil(std::ifstream &f,
-                                   std::string *lookahead,
+static uint32_t parse_monster_abil(lexer_t *f,
+                                   std::string_view *lookahead,
                                    uint32_t *abil)
 {
   uint32_t i;
@@ -347,13 +494,13 @@ static uint32_t parse_monster_abil(std::ifstream &f,
 
   eat_blankspace(f);
 
-  if (f.peek() == '\n') {
+  if (lex_peek(f) == '\n') {
     return 1;
   }
 
   /* Will not lead to error if an ability is listed multiple times. */
-  while (f.peek() != '\n') {
-    f >> *lookahead;
+  while (lex_peek(f) != '\n') {
+    *lookahead = lex_token(f);
 
     for (i = 0; abilities_lookup[i].name; i++) {
       if (*lookahead == abilities_lookup[i].name) {
@@ -369,154 +516,197 @@ static uint32_t parse_monster_abil(std::ifstream &f,
     eat_blankspace(f);
   }
 
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
   return 0;
 }
 
-static uint32_t parse_monster_description(std::ifstream &f,
-                                          std::string *lookahead,
+static uint32_t parse_monster_description(lexer_t *f,
+                                          std::string_view *lookahead,
+                                          string_arena *text,
                                           std::vector<monster_description> *v)
 {
-  std::string s;
   bool read_name, read_symb, read_color, read_desc,
-       read_speed, read_dam, read_hp, read_abil;
-  std::string name, desc;
+       read_speed, read_dam, read_hp, read_abil,
+       read_rrty, read_depth;
+  std::string_view name, desc;
   char symb;
-  uint32_t abil;
+  uint32_t abil, rrty, min_depth, max_depth;
   std::vector<uint32_t> color;
   dice speed, dam, hp;
-  monster_description m;
   int count;
 
   read_name = read_symb = read_color = read_desc =
-              read_speed = read_dam = read_hp = read_abil = false;
+              read_speed = read_dam = read_hp = read_abil =
+              read_rrty = read_depth = false;
+  rrty = MAX_RARITY;
+  min_depth = 0;
+  max_depth = MAX_DEPTH;
 
   if (*lookahead != "BEGIN") {
-    std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-              << "Parse error in monster description.\n"
-              << "Discarding monster." << std::endl;
+    *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+            << "Parse error in monster description.\n"
+            << "Discarding monster." << std::endl;
+    /* Unless this is the rest of one already counted */
+    f->discarded += !f->skipping;
     do {
-      f >> *lookahead;
-    } while (*lookahead != "BEGIN" && f.peek() != EOF);
+      *lookahead = lex_token(f);
+    } while (*lookahead != "BEGIN" && lex_peek(f) != EOF);
   }
-  if (f.peek() == EOF) {
+  f->skipping = false;
+  if (lex_peek(f) == EOF) {
     return 1;
   }
-  f >> *lookahead;
+  *lookahead = lex_token(f);
   if (*lookahead != "MONSTER") {
     return 1;
   }
 
-  for (f >> *lookahead, count = 0;
-       count < NUM_MONSTER_DESCRIPTION_FIELDS;
+  /* Every field once, in any order.  END ends the loop, and then the *
+   * count tells whether all of the required ones were there.         */
+  for (*lookahead = lex_token(f), count = 0;
+       *lookahead != "END";
        count++) {
     /* This could definately be more concise. */
     if        (*lookahead == "NAME")  {
       if (read_name || parse_monster_name(f, lookahead, &name)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in monster name.\n"
-                  << "Discarding monster." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in monster name.\n"
+                << "Discarding monster." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_name = true;
     } else if (*lookahead == "DESC")  {
       if (read_desc || parse_monster_desc(f, lookahead, &desc)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in monster description.\n"
-                  << "Discarding monster." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in monster description.\n"
+                << "Discarding monster." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_desc = true;
     } else if (*lookahead == "SYMB")  {
       if (read_symb || parse_monster_symb(f, lookahead, &symb)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in monster symbol.\n"
-                  << "Discarding monster." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in monster symbol.\n"
+                << "Discarding monster." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_symb = true;
     } else if (*lookahead == "COLOR") {
       if (read_color || parse_monster_color(f, lookahead, &color)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in monster color.\n"
-                  << "Discarding monster." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in monster color.\n"
+                << "Discarding monster." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_color = true;
     } else if (*lookahead == "SPEED") {
       if (read_speed || parse_monster_speed(f, lookahead, &speed)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in monster speed.\n"
-                  << "Discarding monster." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in monster speed.\n"
+                << "Discarding monster." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_speed = true;
     } else if (*lookahead == "ABIL")  {
       if (read_abil || parse_monster_abil(f, lookahead, &abil)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in monster abilities.\n"
-                  << "Discarding monster." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in monster abilities.\n"
+                << "Discarding monster." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_abil = true;
     } else if (*lookahead == "HP")    {
       if (read_hp || parse_monster_hp(f, lookahead, &hp)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in monster hitpoints.\n"
-                  << "Discarding monster." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in monster hitpoints.\n"
+                << "Discarding monster." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_hp = true;
     } else if (*lookahead == "DAM")   {
       if (read_dam || parse_monster_dam(f, lookahead, &dam)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in monster damage.\n"
-                  << "Discarding monster." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in monster damage.\n"
+                << "Discarding monster." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_dam = true;
-    } else                           {
-      std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                << "Parse error in monster description.\n"
+    } else if (*lookahead == "RRTY")  {
+      if (read_rrty || parse_rarity(f, lookahead, &rrty)) {
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in monster rarity.\n"
+                << "Discarding monster." << std::endl;
+        lex_discard(f);
+        return 1;
+      }
+      read_rrty = true;
+    } else if (*lookahead == "DEPTH") {
+      if (read_depth || parse_depth(f, lookahead, &min_depth, &max_depth)) {
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in monster depth.\n"
                 << "Discarding monster." << std::endl;
+        lex_discard(f);
+        return 1;
+      }
+      read_depth = true;
+    } else                           {
+      *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+              << "Parse error in monster description.\n"
+              << "Discarding monster." << std::endl;
+      lex_discard(f);
       return 1;
     }
   }
 
-  if (*lookahead != "END") {
+  if (count != NUM_MONSTER_DESCRIPTION_FIELDS + read_rrty + read_depth) {
+    *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+            << "Missing field in monster description.\n"
+            << "Discarding monster." << std::endl;
+    lex_discard(f);
     return 1;
   }
 
   eat_blankspace(f);
-  if (f.peek() != '\n' && f.peek() != EOF) {
+  if (lex_peek(f) != '\n' && lex_peek(f) != EOF) {
     return 1;
   }
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
-  m.set(name, desc, symb, color, speed, abil, hp, dam);
-  v->push_back(m);
+  /* Built in place; copying a finished one would copy its colors. */
+  v->emplace_back();
+  v->back().set(text->intern(name), text->intern(desc),
+                symb, color, speed, abil, hp, dam);
+  v->back().set_spawn(rrty, min_depth, max_depth);
 
   return 0;
 }
 
-static uint32_t parse_object_name(std::ifstream &f,
-                                  std::string *lookahead,
-                                  std::string *name)
+static uint32_t parse_object_name(lexer_t *f,
+                                  std::string_view *lookahead,
+                                  std::string_view *name)
 {
 
   return parse_name(f, lookahead, name);
 }
 
-static uint32_t parse_object_desc(std::ifstream &f,
-                                  std::string *lookahead,
-                                  std::string *desc)
+static uint32_t parse_object_desc(lexer_t *f,
+                                  std::string_view *lookahead,
+                                  std::string_view *desc)
 {
   return parse_desc(f, lookahead, desc);
 }
 
-static uint32_t parse_object_type(std::ifstream &f,
-                                  std::string *lookahead,
+static uint32_t parse_object_type(lexer_t *f,
+                                  std::string_view *lookahead,
                                   object_type_t *type)
 {
   uint32_t i;
@@ -525,11 +715,11 @@ static uint32_t parse_object_type(std::ifstream &f,
 
   eat_blankspace(f);
 
-  if (f.peek() == '\n') {
+  if (lex_peek(f) == '\n') {
     return 1;
   }
 
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
   for (i = 0; types_lookup[i].name; i++) {
     if (*lookahead == types_lookup[i].name) {
@@ -543,17 +733,17 @@ static uint32_t parse_object_type(std::ifstream &f,
   }
 
   eat_blankspace(f);
-  if (f.peek() != '\n') {
+  if (lex_peek(f) != '\n') {
     return 1;
   }
 
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
   return 0;
 }
 
-static uint32_t parse_object_color(std::ifstream &f,
-                                   std::string *lookahead,
+static uint32_t parse_object_color(lexer_t *f,
+                                   std::string_view *lookahead,
                                    uint32_t *color)
 {
   return parse_color(f, lookahead, color);
@@ -568,262 +758,404 @@ static dice_parser_func_t parse_object_speed = parse_dice;
 static dice_parser_func_t parse_object_attr = parse_dice;
 static dice_parser_func_t parse_object_val = parse_dice;
 
-static uint32_t parse_object_description(std::ifstream &f,
-                                         std::string *lookahead,
+static uint32_t parse_object_description(lexer_t *f,
+                                         std::string_view *lookahead,
+                                         string_arena *text,
                                          std::vector<object_description> *v)
 {
-  std::string s;
   bool read_name, read_desc, read_type, read_color,
        read_hit, read_dam, read_dodge, read_def,
-       read_weight, read_speed, read_attr, read_val;
-  std::string name, desc;
-  uint32_t color;
+       read_weight, read_speed, read_attr, read_val,
+       read_rrty, read_depth;
+  std::string_view name, desc;
+  uint32_t color, rrty, min_depth, max_depth;
   object_type_t type;
   dice hit, dam, dodge, def, weight, speed, attr, val;
-  object_description o;
   int count;
 
   read_name = read_desc = read_type = read_color =
               read_hit = read_dam = read_dodge = read_def =
-              read_weight = read_speed = read_attr = read_val = false;
+              read_weight = read_speed = read_attr = read_val =
+              read_rrty = read_depth = false;
+  rrty = MAX_RARITY;
+  min_depth = 0;
+  max_depth = MAX_DEPTH;
 
   if (*lookahead != "BEGIN") {
-    std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-              << "Parse error in object description.\n"
-              << "Discarding object." << std::endl;
+    *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+            << "Parse error in object description.\n"
+            << "Discarding object." << std::endl;
+    /* Unless this is the rest of one already counted */
+    f->discarded += !f->skipping;
     do {
-      f >> *lookahead;
-    } while (*lookahead != "BEGIN" && f.peek() != EOF);
+      *lookahead = lex_token(f);
+    } while (*lookahead != "BEGIN" && lex_peek(f) != EOF);
   }
-  if (f.peek() == EOF) {
+  f->skipping = false;
+  if (lex_peek(f) == EOF) {
     return 1;
   }
-  f >> *lookahead;
+  *lookahead = lex_token(f);
   if (*lookahead != "OBJECT") {
     return 1;
   }
 
-  for (f >> *lookahead, count = 0;
-       count < NUM_OBJECT_DESCRIPTION_FIELDS;
+  /* As for monsters */
+  for (*lookahead = lex_token(f), count = 0;
+       *lookahead != "END";
        count++) {
     /* This could definately be more concise. */
     if        (*lookahead == "NAME")  {
       if (read_name || parse_object_name(f, lookahead, &name)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object name.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object name.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_name = true;
     } else if (*lookahead == "DESC")  {
       if (read_desc || parse_object_desc(f, lookahead, &desc)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object description.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object description.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_desc = true;
     } else if (*lookahead == "TYPE")  {
       if (read_type || parse_object_type(f, lookahead, &type)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object type.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object type.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_type = true;
     } else if (*lookahead == "COLOR") {
       if (read_color || parse_object_color(f, lookahead, &color)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object color.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object color.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_color = true;
     } else if (*lookahead == "HIT")   {
       if (read_hit || parse_object_hit(f, lookahead, &hit)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object hit bonux.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object hit bonux.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_hit = true;
     } else if (*lookahead == "DAM")   {
       if (read_dam || parse_object_dam(f, lookahead, &dam)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object damage bonus.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object damage bonus.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_dam = true;
     } else if (*lookahead == "DODGE")   {
       if (read_dodge || parse_object_dodge(f, lookahead, &dodge)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object dodge bonus.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object dodge bonus.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_dodge = true;
     } else if (*lookahead == "DEF")   {
       if (read_def || parse_object_def(f, lookahead, &def)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object defence bonus.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object defence bonus.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_def = true;
     } else if (*lookahead == "WEIGHT")   {
       if (read_weight || parse_object_weight(f, lookahead, &weight)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object weight.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object weight.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_weight = true;
     } else if (*lookahead == "SPEED") {
       if (read_speed || parse_object_speed(f, lookahead, &speed)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object speed bonus.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object speed bonus.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_speed = true;
     } else if (*lookahead == "ATTR")  {
       if (read_attr || parse_object_attr(f, lookahead, &attr)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object special attribute bonus.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object special attribute bonus.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_attr = true;
     } else if (*lookahead == "VAL")    {
       if (read_val || parse_object_val(f, lookahead, &val)) {
-        std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                  << "Parse error in object value.\n"
-                  << "Discarding object." << std::endl;
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object value.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
         return 1;
       }
       read_val = true;
-    } else                           {
-      std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-                << "Parse error in object description.\n"
+    } else if (*lookahead == "RRTY")  {
+      if (read_rrty || parse_rarity(f, lookahead, &rrty)) {
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object rarity.\n"
+                << "Discarding object." << std::endl;
+        lex_discard(f);
+        return 1;
+      }
+      read_rrty = true;
+    } else if (*lookahead == "DEPTH") {
+      if (read_depth || parse_depth(f, lookahead, &min_depth, &max_depth)) {
+        *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+                << "Parse error in object depth.\n"
                 << "Discarding object." << std::endl;
+        lex_discard(f);
+        return 1;
+      }
+      read_depth = true;
+    } else                           {
+      *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+              << "Parse error in object description.\n"
+              << "Discarding object." << std::endl;
+      lex_discard(f);
       return 1;
     }
   }
 
-  if (*lookahead != "END") {
+  if (count != NUM_OBJECT_DESCRIPTION_FIELDS + read_rrty + read_depth) {
+    *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+            << "Missing field in object description.\n"
+            << "Discarding object." << std::endl;
+    lex_discard(f);
     return 1;
   }
 
   eat_blankspace(f);
-  if (f.peek() != '\n' && f.peek() != EOF) {
+  if (lex_peek(f) != '\n' && lex_peek(f) != EOF) {
     return 1;
   }
-  f >> *lookahead;
+  *lookahead = lex_token(f);
 
-  o.set(name, desc, type, color, hit, dam,
-        dodge, def, weight, speed, attr, val);
-  v->push_back(o);
+  v->emplace_back();
+  v->back().set(text->intern(name), text->intern(desc), type, color,
+                hit, dam, dodge, def, weight, speed, attr, val);
+  v->back().set_spawn(rrty, min_depth, max_depth);
 
   return 0;
 }
 
-static uint32_t parse_monster_descriptions(std::ifstream &f,
+static uint32_t parse_monster_descriptions(lexer_t *f,
                                            dungeon_t *d,
                                            std::vector<monster_description> *v)
 {
-  std::string s;
+  std::string_view s;
   std::stringstream expected;
-  std::string lookahead;
+  std::string_view lookahead;
 
   expected << MONSTER_FILE_SEMANTIC << " " << MONSTER_FILE_VERSION;
 
   eat_whitespace(f);
 
-  getline(f, s);
+  s = lex_line(f);
 
   if (s != expected.str()) {
-    std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-              << "Parse error in monster description file.\nExpected: \""
-              << expected.str() << "\"\nRead:     \"" << s << "\"\n\nAborting."
-              << std::endl;
+    *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+            << "Parse error in monster description file.\nExpected: \""
+            << expected.str() << "\"\nRead:     \"" << s << "\"\n\nAborting."
+            << std::endl;
     return 1;
   }
 
-  f >> lookahead;
+  lookahead = lex_token(f);
   do {
-    parse_monster_description(f, &lookahead, v);
-  } while (f.peek() != EOF);
+    parse_monster_description(f, &lookahead, &d->description_text, v);
+  } while (lex_peek(f) != EOF);
 
   return 0;
 }
 
-static uint32_t parse_object_descriptions(std::ifstream &f,
+static uint32_t parse_object_descriptions(lexer_t *f,
                                           dungeon_t *d,
                                           std::vector<object_description> *v)
 {
-  std::string s;
+  std::string_view s;
   std::stringstream expected;
-  std::string lookahead;
+  std::string_view lookahead;
 
   expected << OBJECT_FILE_SEMANTIC << " " << OBJECT_FILE_VERSION;
 
   eat_whitespace(f);
 
-  getline(f, s);
+  s = lex_line(f);
 
   if (s != expected.str()) {
-    std::cerr << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
-              << "Parse error in object description file.\nExpected: \""
-              << expected.str() << "\"\nRead:     \"" << s << "\"\n\nAborting."
-              << std::endl;
+    *f->err << "Discovered at " << __FILE__ << ":" << __LINE__ << "\n"
+            << "Parse error in object description file.\nExpected: \""
+            << expected.str() << "\"\nRead:     \"" << s << "\"\n\nAborting."
+            << std::endl;
     return 1;
   }
 
-  f >> lookahead;
+  lookahead = lex_token(f);
   do {
-    parse_object_description(f, &lookahead, v);
-  } while (f.peek() != EOF);
+    parse_object_description(f, &lookahead, &d->description_text, v);
+  } while (lex_peek(f) != EOF);
 
   return 0;
 }
 
-uint32_t parse_descriptions(dungeon_t *d)
+/* Where a description file is read from */
+std::string description_file(const char *name)
 {
   std::string file;
-  std::ifstream f;
-  uint32_t retval;
-
-  retval = 0;
 
   file = getenv("HOME");
   if (file.length() == 0) {
     file = ".";
   }
-  //file += std::string("/") + SAVE_DIR + "/" + MONSTER_DESC_FILE;
+  //file += std::string("/") + SAVE_DIR + "/" + name;
+
+  return file + "/dungeon_game/" + name;
+}
 
-  file+= std::string("/dungeon_game/")+MONSTER_DESC_FILE;
-  f.open(file.c_str());
+/* Maps the whole of a description file for the lexer.  -1, quietly, *
+ * if there's no such file; its built-in table stands in for it.      */
+static int lex_open(lexer_t *f, const std::string &file)
+{
+  struct stat buf;
+  void *map;
+  int fd;
 
-  if (parse_monster_descriptions(f, d, &d->monster_descriptions)) {
-    retval = 1;
+  if ((fd = open(file.c_str(), O_RDONLY)) < 0 && errno == ENOENT) {
+    return -1;
+  }
+  if (fd < 0 || fstat(fd, &buf)) {
+    *f->err << file << ": " << strerror(errno) << std::endl;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return 1;
+  }
+
+  map = NULL;
+  /* mmap() refuses an empty file */
+  if (buf.st_size && (map = mmap(NULL, buf.st_size, PROT_READ,
+                                 MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+    *f->err << file << ": " << strerror(errno) << std::endl;
+    close(fd);
+    return 1;
+  }
+  close(fd);
+  if (map) {
+    madvise(map, buf.st_size, MADV_SEQUENTIAL);
   }
 
-  f.close();
+  f->start = f->next = (const char *) map;
+  f->end = f->start + buf.st_size;
 
-  file = getenv("HOME");
-  if (file.length() == 0) {
-    file = ".";
+  return 0;
+}
+
+static void lex_close(lexer_t *f)
+{
+  if (f->start) {
+    munmap((void *) f->start, f->end - f->start);
+  }
+}
+
+uint32_t parse_description_files(dungeon_t *d,
+                                 const std::string &monster_file,
+                                 const std::string &object_file,
+                                 std::ostream &err, uint32_t *discarded)
+{
+  lexer_t monsters, objects;
+  int no_monsters, no_objects;
+  uint32_t retval;
+
+  retval = 0;
+
+  monsters.err = objects.err = &err;
+  monsters.discarded = objects.discarded = 0;
+  monsters.skipping = objects.skipping = false;
+
+  no_monsters = lex_open(&monsters, monster_file);
+  no_objects = lex_open(&objects, object_file);
+
+  /* Each entry's keywords take more room in the files than its text *
+   * takes over in the arena, so this fits all of it in one block.    */
+  d->description_text.reserve(
+    (no_monsters ? 0 : monsters.end - monsters.start) +
+    (no_objects ? 0 : objects.end - objects.start), 0);
+
+  if (no_monsters > 0) {
+    retval = 1;
+  } else if (!no_monsters) {
+    if (parse_monster_descriptions(&monsters, d, &d->monster_descriptions)) {
+      retval = 1;
+    }
+    lex_close(&monsters);
   }
-  //file += std::string("/") + SAVE_DIR + "/" + OBJECT_DESC_FILE;
-  file+= std::string("/dungeon_game/")+OBJECT_DESC_FILE;
-  f.open(file.c_str());
 
-  if (parse_object_descriptions(f, d, &d->object_descriptions)) {
+  if (no_objects > 0) {
     retval = 1;
+  } else if (!no_objects) {
+    if (parse_object_descriptions(&objects, d, &d->object_descriptions)) {
+      retval = 1;
+    }
+    lex_close(&objects);
+  }
+
+  if (discarded) {
+    *discarded = monsters.discarded + objects.discarded;
+  }
+
+  return retval;
+}
+
+uint32_t parse_descriptions(dungeon_t *d)
+{
+  uint32_t retval;
+
+  if (!cache_load(d)) {
+    return 0;
+  }
+
+  retval = parse_description_files(d, description_file(MONSTER_DESC_FILE),
+                                   description_file(OBJECT_DESC_FILE),
+                                   std::cerr, NULL);
+
+  /* Whatever the files didn't supply comes from the built-in tables, *
+   * so there's always something to spawn.                            */
+  if (d->monster_descriptions.empty()) {
+    builtin_monster_descriptions(d);
+  }
+  if (d->object_descriptions.empty()) {
+    builtin_object_descriptions(d);
   }
 
-  f.close();
+  /* Failing to write the cache only costs the next start a parse.  It *
+   * fails anyway without both files, since it's keyed by them.        */
+  if (!retval) {
+    cache_write(d);
+  }
 
   return retval;
 }
@@ -847,8 +1179,8 @@ uint32_t print_descriptions(dungeon_t *d)
   return 0;
 }
 
-void monster_description::set(const std::string &name,
-                              const std::string &description,
+void monster_description::set(std::string_view name,
+                              std::string_view description,
                               const char symbol,
                               const std::vector<uint32_t> &color,
                               const dice &speed,
@@ -905,14 +1237,23 @@ std::ostream &operator<<(std::ostream &o, monster_description &m)
 
 uint32_t destroy_descriptions(dungeon_t *d)
 {
+  uint32_t i;
+
+  for (i = 0; i < d->retired_descriptions.size(); i++) {
+    delete d->retired_descriptions[i];
+  }
+  d->retired_descriptions.clear();
   d->monster_descriptions.clear();
   d->object_descriptions.clear();
+  d->description_text.clear();
+  d->monster_spawn.clear();
+  d->object_spawn.clear();
 
   return 0;
 }
 
-void object_description::set(const std::string &name,
-                             const std::string &description,
+void object_description::set(std::string_view name,
+                             std::string_view description,
                              const object_type_t type,
                              const uint32_t color,
                              const dice &hit,
@@ -967,15 +1308,14 @@ std::ostream &operator<<(std::ostream &o, object_description &od)
   return od.print(o);
 }
 
-npc *monster_description::generate_monster(dungeon_t *d)
+character_id_t monster_description::generate_monster(dungeon_t *d)
 {
-  npc *n;
-  const std::vector<monster_description> &v = d->monster_descriptions;
-  const monster_description &m = v[rand_range(0, v.size() - 1)];
+  character_id_t c;
+  const monster_description &m = d->monster_descriptions[spawn_monster(d)];
 
-  n = new npc(d, m);
-
-  heap_insert(&d->next_turn, n);
+  if ((c = place_npc(d, m)) != NO_CHARACTER) {
+    d->next_turn.insert(d->characters, c);
+  }
 
-  return n;
+  return c;
 }
@@ -3,12 +3,23 @@
 
 # include <stdint.h>
 # include <vector>
+# include <iosfwd>
 # include <string>
+# include <string_view>
 # include "dice.h"
+# include "character.h"
 
 typedef struct dungeon dungeon_t;
 
+std::string description_file(const char *name);
 uint32_t parse_descriptions(dungeon_t *d);
+/* Just the text files, no cache and no built-ins; a missing file is *
+ * skipped, not an error.  Parse errors are written to err, and the  *
+ * number of entries they cost to *discarded, unless it's NULL.      */
+uint32_t parse_description_files(dungeon_t *d,
+                                 const std::string &monster_file,
+                                 const std::string &object_file,
+                                 std::ostream &err, uint32_t *discarded);
 uint32_t print_descriptions(dungeon_t *d);
 uint32_t destroy_descriptions(dungeon_t *d);
 
@@ -37,50 +48,79 @@ typedef enum object_type {
 
 extern const char object_symbol[];
 
-class npc;
+/* RRTY and DEPTH are optional in both kinds of description.  A rarity  *
+ * is a relative spawn weight, 1 to MAX_RARITY; DEPTH is the shallowest *
+ * and, optionally, the deepest level it spawns on.  Without them, a     *
+ * description is as common as they come, at every depth.               */
+# define MAX_RARITY 100
+# define MAX_DEPTH  UINT32_MAX
 
+/* Names and descriptions are views into the dungeon's string arena *
+ * (see intern.h), and set() expects them to be interned already.    *
+ * The built-in tables' literals (see builtin.h) live just as long.  */
 class monster_description {
  private:
-  std::string name, description;
+  std::string_view name, description;
   char symbol;
   std::vector<uint32_t> color;
   uint32_t abilities;
   dice speed, hitpoints, damage;
+  uint32_t rarity, min_depth, max_depth;
  public:
   monster_description() : name(),       description(), symbol(0),   color(0),
-                          abilities(0), speed(),       hitpoints(), damage()
+                          abilities(0), speed(),       hitpoints(), damage(),
+                          rarity(MAX_RARITY), min_depth(0),
+                          max_depth(MAX_DEPTH)
   {
   }
-  void set(const std::string &name,
-           const std::string &description,
+  void set(std::string_view name,
+           std::string_view description,
            const char symbol,
            const std::vector<uint32_t> &color,
            const dice &speed,
            const uint32_t abilities,
            const dice &hitpoints,
            const dice &damage);
+  inline void set_spawn(uint32_t rarity, uint32_t min_depth,
+                        uint32_t max_depth)
+  {
+    this->rarity = rarity;
+    this->min_depth = min_depth;
+    this->max_depth = max_depth;
+  }
   std::ostream &print(std::ostream &o);
-  static npc *generate_monster(dungeon_t *d);
-  char get_symbol() { return symbol; }
-
-  friend npc;
+  static character_id_t generate_monster(dungeon_t *d);
+  inline char get_symbol() const { return symbol; }
+  inline std::string_view get_name() const { return name; }
+  inline std::string_view get_description() const { return description; }
+  inline const std::vector<uint32_t> &get_color() const { return color; }
+  inline const uint32_t get_abilities() const { return abilities; }
+  inline const dice &get_speed() const { return speed; }
+  inline const dice &get_hitpoints() const { return hitpoints; }
+  inline const dice &get_damage() const { return damage; }
+  inline uint32_t get_rarity() const { return rarity; }
+  inline uint32_t get_min_depth() const { return min_depth; }
+  inline uint32_t get_max_depth() const { return max_depth; }
 };
 
 class object_description {
  private:
-  std::string name, description;
+  std::string_view name, description;
   object_type_t type;
   uint32_t color;
   dice hit, damage, dodge, defence, weight, speed, attribute, value;
+  uint32_t rarity, min_depth, max_depth;
  public:
   object_description() : name(),    description(), type(objtype_no_type),
                          color(0),  hit(),         damage(),
                          dodge(),   defence(),     weight(),
-                         speed(),   attribute(),   value()
+                         speed(),   attribute(),   value(),
+                         rarity(MAX_RARITY), min_depth(0),
+                         max_depth(MAX_DEPTH)
   {
   }
-  void set(const std::string &name,
-           const std::string &description,
+  void set(std::string_view name,
+           std::string_view description,
            const object_type_t type,
            const uint32_t color,
            const dice &hit,
@@ -91,11 +131,18 @@ class object_description {
            const dice &speed,
            const dice &attrubute,
            const dice &value);
+  inline void set_spawn(uint32_t rarity, uint32_t min_depth,
+                        uint32_t max_depth)
+  {
+    this->rarity = rarity;
+    this->min_depth = min_depth;
+    this->max_depth = max_depth;
+  }
   std::ostream &print(std::ostream &o);
   /* Need all these accessors because otherwise there is a *
    * circular dependancy that is difficult to get around.  */
-  inline const std::string &get_name() const { return name; }
-  inline const std::string &get_description() const { return description; }
+  inline std::string_view get_name() const { return name; }
+  inline std::string_view get_description() const { return description; }
   inline const object_type_t get_type() const { return type; }
   inline const uint32_t get_color() const { return color; }
   inline const dice &get_hit() const { return hit; }
@@ -106,6 +153,9 @@ class object_description {
   inline const dice &get_speed() const { return speed; }
   inline const dice &get_attribute() const { return attribute; }
   inline const dice &get_value() const { return value; }
+  inline uint32_t get_rarity() const { return rarity; }
+  inline uint32_t get_min_depth() const { return min_depth; }
+  inline uint32_t get_max_depth() const { return max_depth; }
 };
 
 std::ostream &operator<<(std::ostream &o, monster_description &m);
@@ -9,10 +9,10 @@ class dice {
   int32_t base;
   uint32_t number, sides;
  public:
-  dice() : base(0), number(0), sides(0)
+  constexpr dice() : base(0), number(0), sides(0)
   {
   }
-  dice(int32_t base, uint32_t number, uint32_t sides) :
+  constexpr dice(int32_t base, uint32_t number, uint32_t sides) :
   base(base), number(number), sides(sides)
   {
   }
@@ -2,8 +2,12 @@
 #include <stdint.h>
 #include <endian.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <limits.h>
 #include <errno.h>
+#include <ctype.h>
 #include <cstring>
 
 #include "dungeon.h"
@@ -11,11 +15,13 @@
 #include "heap.h"
 #include "pc.h"
 #include "npc.h"
+#include "save.h"
+#include "archive.h"
+#include "io.h"
+#include "path.h"
 
 using namespace std;
 
-rank_t rank_array [5];
-
 typedef struct corridor_path {
   heap_node_t *hn;
   uint8_t pos[2];
@@ -25,7 +31,8 @@ typedef struct corridor_path {
   int32_t cost;
 } corridor_path_t;
 
-static int32_t corridor_path_cmp(const void *key, const void *with) {
+static int32_t corridor_path_cmp(const void *key, const void *with,
+                                 void *unused) {
   return ((corridor_path_t *) key)->cost - ((corridor_path_t *) with)->cost;
 }
 
@@ -33,30 +40,23 @@ static int32_t corridor_path_cmp(const void *key, const void *with) {
  * subtle differences make it difficult to reuse.     */
 static void dijkstra_corridor(dungeon_t *d, pair_t from, pair_t to)
 {
-  static corridor_path_t path[DUNGEON_Y][DUNGEON_X], *p;
-  static uint32_t initialized = 0;
+  /* Scratch space is per call, not static, so that any number of *
+   * dungeons can be generated at once, on any number of threads.  */
+  corridor_path_t path[DUNGEON_Y][DUNGEON_X], *p;
   heap_t h;
   uint32_t x, y;
 
-  if (!initialized) {
-    for (y = 0; y < DUNGEON_Y; y++) {
-      for (x = 0; x < DUNGEON_X; x++) {
-        path[y][x].pos[dim_y] = y;
-        path[y][x].pos[dim_x] = x;
-      }
-    }
-    initialized = 1;
-  }
-  
   for (y = 0; y < DUNGEON_Y; y++) {
     for (x = 0; x < DUNGEON_X; x++) {
+      path[y][x].pos[dim_y] = y;
+      path[y][x].pos[dim_x] = x;
       path[y][x].cost = INT_MAX;
     }
   }
 
   path[from[dim_y]][from[dim_x]].cost = 0;
 
-  heap_init(&h, corridor_path_cmp, NULL);
+  heap_init(&h, corridor_path_cmp, NULL, NULL);
 
   for (y = 0; y < DUNGEON_Y; y++) {
     for (x = 0; x < DUNGEON_X; x++) {
@@ -179,7 +179,7 @@ static int empty_dungeon(dungeon_t *d)
         mapxy(x, y) = ter_wall_immutable;
         hardnessxy(x, y) = 255;
       }
-      charxy(x, y) = NULL;
+      charxy(x, y) = NO_CHARACTER;
       objxy(x, y) = NULL;
     }
   }
@@ -198,8 +198,8 @@ static int place_rooms(dungeon_t *d)
     success = 1;
     for (i = 0; success && i < d->num_rooms; i++) {
       r = d->rooms + i;
-      r->position[dim_x] = 1 + rand() % (DUNGEON_X - 2 - r->size[dim_x]);
-      r->position[dim_y] = 1 + rand() % (DUNGEON_Y - 2 - r->size[dim_y]);
+      r->position[dim_x] = 1 + rng_rand() % (DUNGEON_X - 2 - r->size[dim_x]);
+      r->position[dim_y] = 1 + rng_rand() % (DUNGEON_Y - 2 - r->size[dim_y]);
       for (p[dim_y] = r->position[dim_y] - 1;
            success && p[dim_y] < r->position[dim_y] + r->size[dim_y] + 1;
            p[dim_y]++) {
@@ -322,8 +322,9 @@ void delete_dungeon(dungeon_t *d)
   uint8_t y, x;
 
   free(d->rooms);
-  heap_delete(&d->next_turn);
-  memset(d->charmap, 0, sizeof (d->charmap));
+  d->next_turn.clear();
+  d->characters.clear_npcs();
+  d->charmap.clear(NO_CHARACTER);
   for (y = 0; y < DUNGEON_Y; y++) {
     for (x = 0; x < DUNGEON_X; x++) {
       if (d->objmap[y][x]) {
@@ -336,38 +337,47 @@ void delete_dungeon(dungeon_t *d)
 
 void init_dungeon(dungeon_t *d)
 {
+  d->map.init(DUNGEON_X, DUNGEON_Y, ter_wall);
+  d->hardness.init(DUNGEON_X, DUNGEON_Y, 0);
+  d->pc_distance.init(DUNGEON_X, DUNGEON_Y, 255);
+  d->pc_tunnel.init(DUNGEON_X, DUNGEON_Y, 255);
+  d->pc_downhill.init(DUNGEON_X, DUNGEON_Y, DOWNHILL_STAY);
+  d->pc_tunnel_downhill.init(DUNGEON_X, DUNGEON_Y, DOWNHILL_STAY);
+  d->charmap.init(DUNGEON_X, DUNGEON_Y, NO_CHARACTER);
+  d->objmap.init(DUNGEON_X, DUNGEON_Y, NULL);
+
   empty_dungeon(d);
 
-  memset(&d->next_turn, 0, sizeof (d->next_turn));
-  heap_init(&d->next_turn, compare_characters_by_next_turn, character_delete);
+  d->characters.clear_npcs();
+  d->next_turn.clear();
 }
 
-static int write_dungeon_map(dungeon_t *d, FILE *f)
+static uint8_t *write_dungeon_map(dungeon_t *d, uint8_t *image)
 {
-  uint32_t x, y;
+  uint32_t y;
+  uint8_t row[DUNGEON_X];
 
-  for (y = 1; y < DUNGEON_Y - 1; y++) {
-    for (x = 1; x < DUNGEON_X - 1; x++) {
-      fwrite(&d->hardness[y][x], sizeof (unsigned char), 1, f);
-    }
+  for (y = 1; y < DUNGEON_Y - 1; y++, image += DUNGEON_X - 2) {
+    d->hardness.get_row(y, row);
+    memcpy(image, row + 1, DUNGEON_X - 2);
   }
 
-  return 0;
+  return image;
 }
 
-static int write_rooms(dungeon_t *d, FILE *f)
+static uint8_t *write_rooms(dungeon_t *d, uint8_t *image)
 {
   uint32_t i;
 
-  for (i = 0; i < d->num_rooms; i++) {
+  for (i = 0; i < d->num_rooms; i++, image += 4) {
     /* write order is xpos, ypos, width, height */
-    fwrite(&d->rooms[i].position[dim_x], 1, 1, f);
-    fwrite(&d->rooms[i].position[dim_y], 1, 1, f);
-    fwrite(&d->rooms[i].size[dim_x], 1, 1, f);
-    fwrite(&d->rooms[i].size[dim_y], 1, 1, f);
+    image[0] = d->rooms[i].position[dim_x];
+    image[1] = d->rooms[i].position[dim_y];
+    image[2] = d->rooms[i].size[dim_x];
+    image[3] = d->rooms[i].size[dim_y];
   }
 
-  return 0;
+  return image;
 }
 
 static uint32_t calculate_dungeon_size(dungeon_t *d)
@@ -397,38 +407,46 @@ static void bubbleSort(rank_t arr[], int n) {
 }
 
 
-int write_ranking(dungeon_t *d, string player_name)
+/* The ranking is kept with the description files.  Built fresh on *
+ * each call; never strcat() onto the environment.                  */
+static string ranking_filename()
 {
+  string filename;
   char *home;
-  char *filename;
+
+  if (!(home = getenv("HOME"))) {
+    home = (char *) ".";
+  }
+  filename = home;
+  filename += string("/dungeon_game/") + SAVE_RANKING;
+
+  return filename;
+}
+
+int write_ranking(dungeon_t *d, string player_name)
+{
+  string filename;
   FILE *f;
-  size_t len;
 
-  home = getenv("HOME");
-  
-  len = (strlen(home)  + strlen(SAVE_RANKING) +
-  	 1 /* The NULL terminator */                            +
-  	 1 /* The slashes */);
+  filename = ranking_filename();
+  if (!(f = fopen(filename.c_str(), "wb"))) {
+    perror(filename.c_str());
 
-  filename = (char *) malloc(len * sizeof (*filename));
-	 sprintf(filename, "%s", home);
-	 
-  f = fopen(filename, "wb");
-  
-  free(filename);
+    return 1;
+  }
   
-  if(d->nummon_beaten!=0 && rank_array[4].nummon<=d->nummon_beaten){
-    rank_array[4].nummon = d->nummon_beaten;
-    rank_array[4].player_name = player_name;
+  if(d->nummon_beaten!=0 && d->ranking[4].nummon<=d->nummon_beaten){
+    d->ranking[4].nummon = d->nummon_beaten;
+    d->ranking[4].player_name = player_name;
   }
   
-  bubbleSort(rank_array,5);
+  bubbleSort(d->ranking,5);
 
   
   for(int i=0; i<5; i++){
-    if(rank_array[i].nummon!=0){
-      fprintf(f, "%d ", rank_array[i].nummon);
-      fprintf(f, "%s\n", rank_array[i].player_name.c_str());
+    if(d->ranking[i].nummon!=0){
+      fprintf(f, "%d ", d->ranking[i].nummon);
+      fprintf(f, "%s\n", d->ranking[i].player_name.c_str());
     }}
   fclose(f);
   
@@ -437,13 +455,16 @@ int write_ranking(dungeon_t *d, string player_name)
 }
 
 
-int write_dungeon(dungeon_t *d)
+/* The save file's path, in the heap; NULL means the default. */
+static char *save_filename(char *file)
 {
   char *home;
   char *filename;
-  FILE *f;
   size_t len;
-  uint32_t be32;
+
+  if (file) {
+    return strdup(file);
+  }
 
   if (!(home = getenv("HOME"))) {
     fprintf(stderr, "\"HOME\" is undefined.  Using working directory.\n");
@@ -459,72 +480,143 @@ int write_dungeon(dungeon_t *d)
   makedirectory(filename);
   strcat(filename, DUNGEON_SAVE_FILE);
 
-  if (!(f = fopen(filename, "w"))) {
-    perror(filename);
-    free(filename);
+  return filename;
+}
 
-    return 1;
+/* The complete contents of a save file, built in memory. */
+static uint8_t *dungeon_image(dungeon_t *d, uint32_t *size)
+{
+  uint8_t *image, *p;
+  uint32_t be32;
+
+  /* With a PC, this is a game in progress, and the whole thing is saved. *
+   * Bare levels, like the ones in a corpus, keep the version 0 format.   */
+  if (d->the_pc) {
+    return snapshot_save(d, size);
   }
-  free(filename);
+
+  *size = calculate_dungeon_size(d);
+  p = image = (uint8_t *) malloc(*size);
 
   /* The semantic, which is 6 bytes, 0-5 */
-  fwrite(DUNGEON_SAVE_SEMANTIC, 1, strlen(DUNGEON_SAVE_SEMANTIC), f);
+  memcpy(p, DUNGEON_SAVE_SEMANTIC, strlen(DUNGEON_SAVE_SEMANTIC));
+  p += strlen(DUNGEON_SAVE_SEMANTIC);
 
   /* The version, 4 bytes, 6-9 */
-  be32 = htobe32(DUNGEON_SAVE_VERSION);
-  fwrite(&be32, sizeof (be32), 1, f);
+  be32 = htobe32(DUNGEON_LEVEL_VERSION);
+  memcpy(p, &be32, sizeof (be32));
+  p += sizeof (be32);
 
   /* The size of the file, 4 bytes, 10-13 */
-  be32 = htobe32(calculate_dungeon_size(d));
-  fwrite(&be32, sizeof (be32), 1, f);
+  be32 = htobe32(*size);
+  memcpy(p, &be32, sizeof (be32));
+  p += sizeof (be32);
 
-  /* The dungeon map, 61440 bytes, 14-1495 */
-  write_dungeon_map(d, f);
+  /* The dungeon map, 1482 bytes, 14-1495 */
+  p = write_dungeon_map(d, p);
 
   /* And the rooms, num_rooms * 4 bytes, 1496-end */
-  write_rooms(d, f);
+  write_rooms(d, p);
 
-  fclose(f);
+  return image;
+}
 
-  return 0;
+/* As above, compressed if this dungeon's saves should be. */
+static uint8_t *dungeon_save_image(dungeon_t *d, uint32_t *size)
+{
+  uint8_t *image, *packed;
+
+  image = dungeon_image(d, size);
+  if (d->compress_saves) {
+    packed = save_image_pack(image, *size, size);
+    free(image);
+    image = packed;
+  }
+
+  return image;
 }
 
-static int read_dungeon_map(dungeon_t *d, FILE *f)
+int write_dungeon(dungeon_t *d, char *file)
 {
-  uint32_t x, y;
+  char *filename;
+  uint8_t *image;
+  uint32_t size;
+  int retval;
+
+  filename = save_filename(file);
+  image = dungeon_save_image(d, &size);
+  if ((retval = save_file_write(filename, image, size))) {
+    perror(filename);
+  }
+  free(image);
+  free(filename);
+
+  return retval;
+}
+
+/* Only the snapshot is taken here; the writer thread does the I/O. */
+int autosave_dungeon(dungeon_t *d, char *file)
+{
+  uint8_t *image;
+  uint32_t size;
+
+  image = dungeon_save_image(d, &size);
+
+  return autosave_submit(save_filename(file), image, size);
+}
+
+/* Rebuilds one row of the level from its hardness bytes.  The row is *
+ * assembled in local buffers and stored with one copy per grid.  Room *
+ * cells can't be recognized until the room array has been read, so    *
+ * every open cell starts as a corridor.                               */
+static void read_dungeon_row(dungeon_t *d, uint32_t y, const uint8_t *src)
+{
+  uint8_t hardness[DUNGEON_X];
+  terrain_type_t terrain[DUNGEON_X];
+  uint32_t x;
+
+  if (y == 0 || y == DUNGEON_Y - 1) {
+    memset(hardness, 255, sizeof (hardness));
+  } else {
+    hardness[0] = hardness[DUNGEON_X - 1] = 255;
+    memcpy(hardness + 1, src, DUNGEON_X - 2);
+  }
+
+  for (x = 0; x < DUNGEON_X; x++) {
+    terrain[x] = hardness[x] ? ter_wall : ter_floor_hall;
+  }
+  if (y == 0 || y == DUNGEON_Y - 1) {
+    memset(terrain, ter_wall_immutable, sizeof (terrain));
+  } else {
+    terrain[0] = terrain[DUNGEON_X - 1] = ter_wall_immutable;
+  }
+
+  d->hardness.set_row(y, hardness);
+  d->map.set_row(y, terrain);
+}
+
+static int read_dungeon_map(dungeon_t *d, const uint8_t *image)
+{
+  uint32_t y;
 
   for (y = 0; y < DUNGEON_Y; y++) {
-    for (x = 0; x < DUNGEON_X; x++) {
-      if (y == 0 || y == DUNGEON_Y - 1 ||
-          x == 0 || x == DUNGEON_X - 1) {
-        d->hardness[y][x] = 255;
-        d->map[y][x] = ter_wall_immutable;
-      } else {
-        fread(&d->hardness[y][x], sizeof (d->hardness[y][x]), 1, f);
-        if (d->hardness[y][x] == 0) {
-          /* Mark it as a corridor.  We can't recognize room cells until *
-           * after we've read the room array, which we haven't done yet. */
-          d->map[y][x] = ter_floor_hall;
-        } else {
-          d->map[y][x] = ter_wall;
-        }
-      }
-    }
+    read_dungeon_row(d, y, image + (y ? y - 1 : 0) * (DUNGEON_X - 2));
   }
 
   return 0;
 }
 
-static int read_rooms(dungeon_t *d, FILE *f)
+static int read_rooms(dungeon_t *d, const uint8_t *image)
 {
   uint32_t i;
   uint32_t x, y;
 
-  for (i = 0; i < d->num_rooms; i++) {
-    fread(&d->rooms[i].position[dim_x], 1, 1, f);
-    fread(&d->rooms[i].position[dim_y], 1, 1, f);
-    fread(&d->rooms[i].size[dim_x], 1, 1, f);
-    fread(&d->rooms[i].size[dim_y], 1, 1, f);
+  for (i = 0; i < d->num_rooms; i++, image += 4) {
+    /* Stored order is xpos, ypos, width, height */
+    d->rooms[i].position[dim_x] = image[0];
+    d->rooms[i].position[dim_y] = image[1];
+    d->rooms[i].size[dim_x] = image[2];
+    d->rooms[i].size[dim_y] = image[3];
 
     /* After reading each room, we need to reconstruct them in the dungeon. */
     for (y = d->rooms[i].position[dim_y];
@@ -569,8 +661,8 @@ int rank (dungeon_t *d){
       i++;
     }
 
-    rank_array[j].nummon = atoi(line.substr(0,i).c_str());
-    rank_array[j].player_name = line.substr(i+1,line.length());
+    d->ranking[j].nummon = atoi(line.substr(0,i).c_str());
+    d->ranking[j].player_name = line.substr(i+1,line.length());
     j++;
   }
 
@@ -578,9 +670,9 @@ int rank (dungeon_t *d){
   mvprintw(2,30,"%-80s", "Ranking: The Number Of Monsters Beaten");
   mvprintw(3,30,"%-80s","   #         NAME");
   j=0;
-  while(j<5 && rank_array[j].nummon!=0){
+  while(j<5 && d->ranking[j].nummon!=0){
     mvprintw(j+4,30,"   %d         %s",
-	     rank_array[j].nummon, rank_array[j].player_name.c_str());
+	     d->ranking[j].nummon, d->ranking[j].player_name.c_str());
     j++;
   }
 
@@ -603,20 +695,20 @@ int read_ranking(dungeon_t *d, char input)
   int j=0;
   
   for(j=0;j<5;j++){ 
-  rank_array[j].nummon = 0;
-  rank_array[j].player_name = " ";
+  d->ranking[j].nummon = 0;
+  d->ranking[j].player_name = " ";
   }
   
-  rank_array[0].nummon = 2;
-  rank_array[0].player_name = "KEISUKE(default)";
-  rank_array[1].nummon = 1;
-  rank_array[1].player_name = "KATE(default)";
+  d->ranking[0].nummon = 2;
+  d->ranking[0].player_name = "KEISUKE(default)";
+  d->ranking[1].nummon = 1;
+  d->ranking[1].player_name = "KATE(default)";
 
   
   //Start reading a file
   //filename = strcat(getenv("HOME"), "/ranking");
 
-  filename = strcat(getenv("HOME"),"/dungeon_game/ranking");
+  filename = ranking_filename();
 
     ifstream f(filename.c_str());
   /*ifstream f;
@@ -630,8 +722,8 @@ int read_ranking(dungeon_t *d, char input)
     while(line.at(i)!=' '){
     i++;
     }
-  rank_array[j].nummon = atoi(line.substr(0,i).c_str());
-  rank_array[j].player_name = line.substr(i+1,line.length());
+  d->ranking[j].nummon = atoi(line.substr(0,i).c_str());
+  d->ranking[j].player_name = line.substr(i+1,line.length());
   j++;
   }
 
@@ -649,9 +741,9 @@ int read_ranking(dungeon_t *d, char input)
   
   j=0;
   while(j<5){
-    if(rank_array[j].nummon!=0){
+    if(d->ranking[j].nummon!=0){
       mvprintw(j+7,19," |   %-2d        %-25s| ",
-	     rank_array[j].nummon, rank_array[j].player_name.c_str());
+	     d->ranking[j].nummon, d->ranking[j].player_name.c_str());
     }
     else{
       mvprintw(j+7,19," |                                      | ");
@@ -668,172 +760,218 @@ int read_ranking(dungeon_t *d, char input)
   mvprintw(18,29,"|___/_/ \\_\\___|_|\\_\\");
   attroff(COLOR_PAIR(COLOR_HIGHLIGHT));
 
-  input = getch();
+  input = io_getch();
   }
   return 0;
 }    
 
 
-int read_dungeon(dungeon_t *d, char *file)
+/* Loads a save file's contents from memory.  Version 0 levels are   *
+ * copied into the grids a row at a time straight out of the image,  *
+ * and version 1 snapshots are loaded in place from it.  Compressed  *
+ * files are unpacked into a plain image first.                      */
+static int load_dungeon_image(dungeon_t *d, const uint8_t *image,
+                              uint32_t size)
 {
-  char semantic[6];
-  uint32_t be32;
-  FILE *f;
-  char *home;
-  size_t len;
-  char *filename;
-  struct stat buf;
-
-  if (!file) {
-    if (!(home = getenv("HOME"))) {
-      fprintf(stderr, "\"HOME\" is undefined.  Using working directory.\n");
-      home = (char *) ".";
-    }
+  uint32_t be32, version, unpacked_size;
+  uint8_t *unpacked;
+  int retval;
 
-    len = (strlen(home) + strlen(SAVE_DIR) + strlen(DUNGEON_SAVE_FILE) +
-           1 /* The NULL terminator */                                 +
-           2 /* The slashes */);
+  d->num_rooms = 0;
 
-    filename = (char *) malloc(len * sizeof (*filename));
-    sprintf(filename, "%s/%s/%s", home, SAVE_DIR, DUNGEON_SAVE_FILE);
+  if (size < 14 /* The semantic, version, and size */ ||
+      strncmp((const char *) image, DUNGEON_SAVE_SEMANTIC, 6)) {
+    fprintf(stderr, "Not an RLG327 save file.\n");
+    return 1;
+  }
+  memcpy(&be32, image + 6, sizeof (be32));
+  version = be32toh(be32);
+  if ((version & ~DUNGEON_SAVE_COMPRESSED) != DUNGEON_LEVEL_VERSION &&
+      (version & ~DUNGEON_SAVE_COMPRESSED) != DUNGEON_SAVE_VERSION) {
+    fprintf(stderr, "File version mismatch.\n");
+    return 1;
+  }
+  memcpy(&be32, image + 10, sizeof (be32));
+  if (size != be32toh(be32)) {
+    fprintf(stderr, "File size mismatch.\n");
+    return 1;
+  }
 
-    if (!(f = fopen(filename, "r"))) {
-      perror(filename);
-      free(filename);
-      exit(-1);
+  if (version & DUNGEON_SAVE_COMPRESSED) {
+    if (!(unpacked = save_image_unpack(image, size, &unpacked_size))) {
+      fprintf(stderr, "Corrupt compressed save file.\n");
+      return 1;
     }
+    retval = load_dungeon_image(d, unpacked, unpacked_size);
+    free(unpacked);
 
-    if (stat(filename, &buf)) {
-      perror(filename);
-      exit(-1);
-    }
+    return retval;
+  }
 
-    free(filename);
-  } else {
-    if (!(f = fopen(file, "r"))) {
-      perror(file);
-      exit(-1);
-    }
-    if (stat(file, &buf)) {
-      perror(file);
-      exit(-1);
+  if (version == DUNGEON_SAVE_VERSION) {
+    if (snapshot_load(d, image, size)) {
+      fprintf(stderr, "Failed to load saved game.\n");
+      return 1;
     }
 
+    return 0;
   }
 
-  d->num_rooms = 0;
-
-  fread(semantic, sizeof(semantic), 1, f);
-  semantic[6] = '\0';
-  if (strncmp(semantic, DUNGEON_SAVE_SEMANTIC, 6)) {
-    fprintf(stderr, "Not an RLG327 save file.\n");
-    exit(-1);
-  }
-  fread(&be32, sizeof (be32), 1, f);
-  if (be32toh(be32) != 0) { /* Since we expect zero, be32toh() is a no-op. */
-    fprintf(stderr, "File version mismatch.\n");
-    exit(-1);
-  }
-  fread(&be32, sizeof (be32), 1, f);
-  if (buf.st_size != be32toh(be32)) {
+  d->num_rooms = calculate_num_rooms(size);
+  if (size < 14 + (DUNGEON_X - 2) * (DUNGEON_Y - 2) ||
+      size != calculate_dungeon_size(d)) {
     fprintf(stderr, "File size mismatch.\n");
-    exit(-1);
+    return 1;
   }
-  read_dungeon_map(d, f);
-  d->num_rooms = calculate_num_rooms(buf.st_size);
+  read_dungeon_map(d, image + 14);
   d->rooms = (room_t *) malloc(sizeof (*d->rooms) * d->num_rooms);
-  read_rooms(d, f);
-
-  fclose(f);
+  read_rooms(d, image + 14 + (DUNGEON_X - 2) * (DUNGEON_Y - 2));
 
   return 0;
 }
 
-int read_pgm(dungeon_t *d, char *pgm)
+/* Level <seed> of an archive, found with a binary search of its index */
+static int read_archived_dungeon(dungeon_t *d, char *file, uint32_t seed)
 {
-  FILE *f;
-  char s[80];
-  uint8_t gm[19][78];
-  uint32_t x, y;
-  uint32_t i;
+  const uint8_t *archive, *image;
+  uint32_t length;
+  size_t size;
 
-  if (!(f = fopen(pgm, "r"))) {
-    perror(pgm);
+  if (!(archive = archive_map(file, &size))) {
     exit(-1);
   }
-
-  if (!fgets(s, 80, f) || strncmp(s, "P5", 2)) {
-    fprintf(stderr, "Expected P5\n");
+  if (!(image = archive_find(archive, size, seed, &length))) {
+    fprintf(stderr, "%s: No level with seed %u.\n", file, seed);
     exit(-1);
   }
-  if (!fgets(s, 80, f)) {
-    fprintf(stderr, "Expected comment\n");
+  if (load_dungeon_image(d, image, length)) {
     exit(-1);
   }
-  if (!fgets(s, 80, f) || strncmp(s, "78 19", 5)) {
-    fprintf(stderr, "Expected 78\n");
-    exit(-1);
+  archive_unmap(archive, size);
+
+  return 0;
+}
+
+/* Where file names one level of an archive, as 'archive.rla#<seed>',  *
+ * returns the '#' and fills in seed; else NULL, for a plain file that  *
+ * may well have a '#' of its own.                                      */
+static char *archived_level(char *file, uint32_t *seed)
+{
+  char *hash, *end;
+  unsigned long n;
+  size_t len;
+
+  if (!(hash = strrchr(file, '#')) || !isdigit(hash[1])) {
+    return NULL;
   }
-  if (!fgets(s, 80, f) || strncmp(s, "255", 2)) {
-    fprintf(stderr, "Expected 255\n");
-    exit(-1);
+  len = hash - file;
+  if (len < strlen(ARCHIVE_EXTENSION) ||
+      strncmp(hash - strlen(ARCHIVE_EXTENSION), ARCHIVE_EXTENSION,
+              strlen(ARCHIVE_EXTENSION))) {
+    return NULL;
   }
+  errno = 0;
+  n = strtoul(hash + 1, &end, 10);
+  if (*end || errno || n > UINT32_MAX) {
+    return NULL;
+  }
+  *seed = n;
 
-  fread(gm, 1, 19 * 78, f);
+  return hash;
+}
 
-  fclose(f);
+/* The file is mapped rather than read.  'archive.rla#<seed>' names *
+ * one level of an archive.                                         */
+int read_dungeon(dungeon_t *d, char *file)
+{
+  const uint8_t *image;
+  int fd;
+  char *home;
+  size_t len;
+  char *filename;
+  char *hash;
+  uint32_t seed;
+  struct stat buf;
 
-  /* In our gray map, treat black (0) as corridor, white (255) as room, *
-   * all other values as a hardness.  For simplicity, treat every white *
-   * cell as its own room, so we have to count white after reading the  *
-   * image in order to allocate the room array.                         */
-  for (d->num_rooms = 0, y = 0; y < 19; y++) {
-    for (x = 0; x < 78; x++) {
-      if (!gm[y][x]) {
-        d->num_rooms++;
-      }
-    }
+  if (file && (hash = archived_level(file, &seed))) {
+    *hash = '\0';
+    read_archived_dungeon(d, file, seed);
+    *hash = '#';
+
+    return 0;
   }
-  d->rooms = (room_t *) malloc(sizeof (*d->rooms) * d->num_rooms);
 
-  for (i = 0, y = 0; y < 19; y++) {
-    for (x = 0; x < 78; x++) {
-      if (!gm[y][x]) {
-        d->rooms[i].position[dim_x] = x + 1;
-        d->rooms[i].position[dim_y] = y + 1;
-        d->rooms[i].size[dim_x] = 1;
-        d->rooms[i].size[dim_y] = 1;
-        i++;
-        d->map[y + 1][x + 1] = ter_floor_room;
-        d->hardness[y + 1][x + 1] = 0;
-      } else if (gm[y][x] == 255) {
-        d->map[y + 1][x + 1] = ter_floor_hall;
-        d->hardness[y + 1][x + 1] = 0;
-      } else {
-        d->map[y + 1][x + 1] = ter_wall;
-        d->hardness[y + 1][x + 1] = gm[y][x];
-      }
+  if (!file) {
+    if (!(home = getenv("HOME"))) {
+      fprintf(stderr, "\"HOME\" is undefined.  Using working directory.\n");
+      home = (char *) ".";
     }
+
+    len = (strlen(home) + strlen(SAVE_DIR) + strlen(DUNGEON_SAVE_FILE) +
+           1 /* The NULL terminator */                                 +
+           2 /* The slashes */);
+
+    filename = (char *) malloc(len * sizeof (*filename));
+    sprintf(filename, "%s/%s/%s", home, SAVE_DIR, DUNGEON_SAVE_FILE);
+    file = filename;
+  } else {
+    filename = NULL;
   }
 
-  for (x = 0; x < 80; x++) {
-    d->map[0][x] = ter_wall_immutable;
-    d->hardness[0][x] = 255;
-    d->map[20][x] = ter_wall_immutable;
-    d->hardness[20][x] = 255;
+  if ((fd = open(file, O_RDONLY)) < 0) {
+    perror(file);
+    exit(-1);
+  }
+  if (fstat(fd, &buf)) {
+    perror(file);
+    exit(-1);
   }
-  for (y = 1; y < 20; y++) {
-    d->map[y][0] = ter_wall_immutable;
-    d->hardness[y][0] = 255;
-    d->map[y][79] = ter_wall_immutable;
-    d->hardness[y][79] = 255;
+  if (buf.st_size < 14 /* The semantic, version, and size */) {
+    fprintf(stderr, "Not an RLG327 save file.\n");
+    exit(-1);
+  }
+  if ((image = (const uint8_t *) mmap(NULL, buf.st_size, PROT_READ,
+                                      MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+    perror(file);
+    exit(-1);
+  }
+  close(fd);
+  free(filename);
+
+  if (load_dungeon_image(d, image, buf.st_size)) {
+    exit(-1);
   }
 
+  munmap((void *) image, buf.st_size);
+
   return 0;
 }
 
-int get_highest_score(){
-  return rank_array[0].nummon;
+/* Everything further than radius from center is considered inactive  *
+ * and written out to the grids' backing files; fixed grids ignore it. *
+ * Pathfinding will fault the tiles it needs back in, so callers should *
+ * pick a radius that covers the cells the NPCs are actually using.    */
+void dungeon_page_out_inactive(dungeon_t *d, pair_t center, uint32_t radius)
+{
+  uint32_t x0, y0, x1, y1;
+
+  x0 = center[dim_x] > (int32_t) radius ? center[dim_x] - radius : 0;
+  y0 = center[dim_y] > (int32_t) radius ? center[dim_y] - radius : 0;
+  x1 = center[dim_x] + radius;
+  y1 = center[dim_y] + radius;
+
+  d->map.page_out_outside(x0, y0, x1, y1);
+  d->hardness.page_out_outside(x0, y0, x1, y1);
+  d->pc_distance.page_out_outside(x0, y0, x1, y1);
+  d->pc_tunnel.page_out_outside(x0, y0, x1, y1);
+  d->pc_downhill.page_out_outside(x0, y0, x1, y1);
+  d->pc_tunnel_downhill.page_out_outside(x0, y0, x1, y1);
+  d->charmap.page_out_outside(x0, y0, x1, y1);
+  d->objmap.page_out_outside(x0, y0, x1, y1);
+}
+
+int get_highest_score(dungeon_t *d){
+  return d->ranking[0].nummon;
 }
 
 void new_dungeon(dungeon_t *d)
@@ -849,13 +987,16 @@ void new_dungeon(dungeon_t *d)
   d->character_sequence_number = sequence_number;
 
   place_pc(d);
-  d->charmap[character_get_y(d->the_pc)][character_get_x(d->the_pc)] =
-    d->the_pc;
+  charpair(character_get_pos(d, PC_ID)) = PC_ID;
+
+  /* The distance maps wait for the PC's first move, but tunnelers *
+   * still weigh the new rock against them in the meantime.        */
+  downhill_tunnel(d->pc_tunnel, d->hardness, d->pc_tunnel_downhill);
 
   /* Need to add a mechanism to decide on a number of monsters.  --nummon  *
    * is just for testing, and if we're generating new dungeon levels, then *
    * presumably we've already done that testing.  We'll just put 10 in for *
    * now.                                                                  */
-  gen_monsters(d, d->max_monsters, character_get_next_turn(d->the_pc));
+  gen_monsters(d, d->max_monsters, character_get_next_turn(d, PC_ID));
   gen_objects(d, d->max_objects);
 }
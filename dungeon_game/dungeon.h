@@ -13,8 +13,13 @@
 
 #include "heap.h"
 # include "dims.h"
+# include "grid.h"
 # include "character.h"
+# include "decide.h"
 # include "descriptions.h"
+# include "intern.h"
+# include "spawn.h"
+# include "reload.h"
 # include "object.h"
 
 using namespace std;
@@ -33,10 +38,26 @@ using namespace std;
 #define SAVE_DIR               ".rlg327"
 #define DUNGEON_SAVE_FILE      "dungeon"
 #define SAVE_RANKING           "ranking"
+#define AUTOSAVE_TURNS         100 /* PC turns between autosaves, with --save */
 #define DUNGEON_SAVE_SEMANTIC  "RLG327"
-#define DUNGEON_SAVE_VERSION   0U
+#define DUNGEON_SAVE_VERSION   1U /* Full game snapshot; see save.h */
+#define DUNGEON_LEVEL_VERSION  0U /* Terrain and rooms only          */
+#define DUNGEON_SAVE_COMPRESSED 0x80000000U /* Version flag; see save.h */
 #define MONSTER_DESC_FILE      "monster_desc.txt"
 #define OBJECT_DESC_FILE       "object_desc.txt"
+#define DESCRIPTION_CACHE_FILE "descriptions.cache" /* See cache.h */
+
+/* Building with -DCHUNKED_WORLD gives the grids below dynamic          *
+ * dimensions and chunked, pageable storage (see grid.h and chunk.h).   *
+ * The default build keeps grid<DUNGEON_X, DUNGEON_Y>, which is laid    *
+ * out and indexed exactly like the dense arrays it replaced.           */
+# ifdef CHUNKED_WORLD
+#  define DUNGEON_GRID_X GRID_DYNAMIC
+#  define DUNGEON_GRID_Y GRID_DYNAMIC
+# else
+#  define DUNGEON_GRID_X DUNGEON_X
+#  define DUNGEON_GRID_Y DUNGEON_Y
+# endif
 
 #define mappair(pair) (d->map[pair[dim_y]][pair[dim_x]])
 #define mapxy(x, y) (d->map[y][x])
@@ -77,7 +98,7 @@ class pc;
 typedef struct dungeon {
   uint32_t num_rooms;
   room_t *rooms;
-  terrain_type_t map[DUNGEON_Y][DUNGEON_X];
+  grid<DUNGEON_GRID_X, DUNGEON_GRID_Y, terrain_type_t> map;
   /* Since hardness is usually not used, it would be expensive to pull it *
    * into cache every time we need a map cell, so we store it in a        *
    * parallel array, rather than using a structure to represent the       *
@@ -86,23 +107,41 @@ typedef struct dungeon {
    * that structure.  Pathfinding will require efficient use of the map,  *
    * and pulling in unnecessary data with each map cell would add a lot   *
    * of overhead to the memory system.                                    */
-  uint8_t hardness[DUNGEON_Y][DUNGEON_X];
-  uint8_t pc_distance[DUNGEON_Y][DUNGEON_X];
-  uint8_t pc_tunnel[DUNGEON_Y][DUNGEON_X];
-  character *charmap[DUNGEON_Y][DUNGEON_X];
-  object *objmap[DUNGEON_Y][DUNGEON_X];
-  pc *the_pc; /* PC needs to be a pointer, since it is a class */
-  heap_t next_turn;
+  grid<DUNGEON_GRID_X, DUNGEON_GRID_Y, uint8_t> hardness;
+  grid<DUNGEON_GRID_X, DUNGEON_GRID_Y, uint8_t> pc_distance;
+  grid<DUNGEON_GRID_X, DUNGEON_GRID_Y, uint8_t> pc_tunnel;
+  /* The step down each of the two above; see path.h */
+  grid<DUNGEON_GRID_X, DUNGEON_GRID_Y, uint8_t> pc_downhill;
+  grid<DUNGEON_GRID_X, DUNGEON_GRID_Y, uint8_t> pc_tunnel_downhill;
+  grid<DUNGEON_GRID_X, DUNGEON_GRID_Y, character_id_t> charmap;
+  grid<DUNGEON_GRID_X, DUNGEON_GRID_Y, object *> objmap;
+  character_table characters;  /* Indexed by what's in the charmap */
+  pc *the_pc; /* The PC's inventory and knowledge; the rest is at PC_ID */
+  turn_queue next_turn;
+  /* Scratch for do_npc_moves(); kept to save reallocating every turn */
+  std::vector<npc_decision_t> decisions;
   uint16_t num_monsters;
   uint16_t nummon_beaten;
   uint16_t max_monsters;
   uint16_t num_objects;
   uint16_t max_objects;
   uint32_t character_sequence_number;
+  uint32_t digs;            /* Rock tunneled to floor; changes the maps */
+  uint32_t depth;           /* Levels below the first */
   uint32_t save_and_exit;
   uint32_t quit_no_save;
+  uint32_t compress_saves;  /* Write save files with DUNGEON_SAVE_COMPRESSED */
+  uint32_t checkpoints;     /* Fork checkpoints; see checkpoint.h */
+  const char *pc_killed_by; /* Name of the NPC that killed the PC, if any */
+  rank_t ranking[5];
   std::vector<monster_description> monster_descriptions;
   std::vector<object_description> object_descriptions;
+  string_arena description_text; /* What the descriptions' strings view */
+  alias_table monster_spawn;      /* Indices into the descriptions, */
+  alias_table object_spawn;       /* weighted for spawn_depth        */
+  uint32_t spawn_depth;
+  /* Swapped out by a reload, but still in use; see reload.h */
+  std::vector<description_set *> retired_descriptions;
 } dungeon_t;
 
 void init_dungeon(dungeon_t *d);
@@ -110,13 +149,16 @@ void new_dungeon(dungeon_t *d);
 void delete_dungeon(dungeon_t *d);
 int gen_dungeon(dungeon_t *d);
 void render_dungeon(dungeon_t *d);
-int write_dungeon(dungeon_t *d);
+int write_dungeon(dungeon_t *d, char *file);
+int autosave_dungeon(dungeon_t *d, char *file);
 int write_ranking(dungeon_t *d,string player_name);
 int read_ranking(dungeon_t *d, char input);
 int rank(dungeon_t *d);
 int read_dungeon(dungeon_t *d, char *file);
+/* P2 or P5, any size; see pgm.cpp */
 int read_pgm(dungeon_t *d, char *pgm);
 void render_distance_map(dungeon_t *d);
 void render_tunnel_distance_map(dungeon_t *d);
-int get_highest_score();
+int get_highest_score(dungeon_t *d);
+void dungeon_page_out_inactive(dungeon_t *d, pair_t center, uint32_t radius);
 #endif
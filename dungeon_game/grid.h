@@ -0,0 +1,83 @@
+#ifndef GRID_H
+# define GRID_H
+
+# include <stdint.h>
+# include <string.h>
+
+# include "chunk.h"
+
+/* A dungeon grid, templated on its dimensions.  With compile-time      *
+ * dimensions, grid<80, 21, T> is a plain [H][W] array: the stride is   *
+ * a constant, indexing is bounds-free and folds exactly like the old   *
+ * dense arrays did, and the whole thing is trivially copyable.  With   *
+ * GRID_DYNAMIC dimensions, the size is set at init() time and storage  *
+ * is chunked (see chunk.h), which is what very large maps want.  Both  *
+ * support grid[y][x] and at(x, y), so code templated on the grid type  *
+ * is written once and works with either.                               */
+
+# define GRID_DYNAMIC 0
+
+/* The accessors are forced inline so that even the unoptimized build *
+ * indexes a fixed grid with plain address arithmetic.                 */
+# define grid_inline inline __attribute__ ((always_inline))
+
+template <uint32_t W, uint32_t H, class T>
+class grid {
+ public:
+  T cells[H][W];
+
+  template <class U>
+  struct rebind {
+    typedef grid<W, H, U> other;
+  };
+
+  grid_inline T *operator[](uint32_t y) { return cells[y]; }
+  grid_inline const T *operator[](uint32_t y) const { return cells[y]; }
+  grid_inline T &at(uint32_t x, uint32_t y) { return cells[y][x]; }
+  grid_inline const T &at(uint32_t x, uint32_t y) const
+  {
+    return cells[y][x];
+  }
+  grid_inline uint32_t get_width() const { return W; }
+  grid_inline uint32_t get_height() const { return H; }
+
+  /* Whole-row copies, for bulk loads and saves. */
+  inline void set_row(uint32_t y, const T *src)
+  {
+    memcpy(cells[y], src, sizeof (cells[y]));
+  }
+  inline void get_row(uint32_t y, T *dst) const
+  {
+    memcpy(dst, cells[y], sizeof (cells[y]));
+  }
+
+  /* Fixed grids are always fully resident, so these are no-ops. */
+  inline void init(uint32_t w, uint32_t h, const T &f) {}
+  inline int page_out_outside(uint32_t x0, uint32_t y0,
+                              uint32_t x1, uint32_t y1)
+  {
+    return 0;
+  }
+
+  void clear(const T &v)
+  {
+    uint32_t x, y;
+
+    for (y = 0; y < H; y++) {
+      for (x = 0; x < W; x++) {
+        cells[y][x] = v;
+      }
+    }
+  }
+};
+
+template <class T>
+class grid<GRID_DYNAMIC, GRID_DYNAMIC, T> : public chunked_grid<T> {
+ public:
+  template <class U>
+  struct rebind {
+    typedef grid<GRID_DYNAMIC, GRID_DYNAMIC, U> other;
+  };
+};
+
+#endif
@@ -84,13 +84,16 @@ void print_heap_node_list(heap_node_t *n)
 }
 
 void heap_init(heap_t *h,
-               int32_t (*compare)(const void *key, const void *with),
-               void (*datum_delete)(void *))
+               int32_t (*compare)(const void *key, const void *with,
+                                  void *context),
+               void (*datum_delete)(void *),
+               void *context)
 {
   h->min = NULL;
   h->size = 0;
   h->compare = compare;
   h->datum_delete = datum_delete;
+  h->context = context;
 }
 
 void heap_node_delete(heap_t *h, heap_node_t *hn)
@@ -120,6 +123,7 @@ void heap_delete(heap_t *h)
   h->size = 0;
   h->compare = NULL;
   h->datum_delete = NULL;
+  h->context = NULL;
 }
 
 heap_node_t *heap_insert(heap_t *h, void *v)
@@ -134,7 +138,7 @@ heap_node_t *heap_insert(heap_t *h, void *v)
   } else {
     n->next = n->prev = n;
   }
-  if (!h->min || (h->compare(v, h->min->datum) < 0)) {
+  if (!h->min || (h->compare(v, h->min->datum, h->context) < 0)) {
     h->min = n;
   }
   h->size++;
@@ -178,7 +182,7 @@ static void heap_consolidate(heap_t *h)
 
     while (a[x->degree]) {
       y = a[x->degree];
-      if (h->compare(x->datum, y->datum) > 0) {
+      if (h->compare(x->datum, y->datum, h->context) > 0) {
         swap(x, y);
       }
       a[x->degree] = NULL;
@@ -191,7 +195,7 @@ static void heap_consolidate(heap_t *h)
     if (a[i]) {
       if (h->min) {
         insert_heap_node_in_list(a[i], h->min);
-        if (h->compare(a[i]->datum, h->min->datum) < 0) {
+        if (h->compare(a[i]->datum, h->min->datum, h->context) < 0) {
           h->min = a[i];
         }
       } else {
@@ -240,12 +244,14 @@ void *heap_remove_min(heap_t *h)
 int heap_combine(heap_t *h, heap_t *h1, heap_t *h2)
 {
   if (h1->compare != h2->compare ||
-      h1->datum_delete != h2->datum_delete) {
+      h1->datum_delete != h2->datum_delete ||
+      h1->context != h2->context) {
     return 1;
   }
 
   h->compare = h1->compare;
   h->datum_delete = h1->datum_delete;
+  h->context = h1->context;
 
   if (!h1->min) {
     h->min = h2->min;
@@ -254,8 +260,8 @@ int heap_combine(heap_t *h, heap_t *h1, heap_t *h2)
     h->min = h1->min;
     h->size = h1->size;
   } else {
-    h->min = ((h->compare(h1->min->datum, h2->min->datum) < 0) ?
-              h1->min                                          :
+    h->min = ((h->compare(h1->min->datum, h2->min->datum, h->context) < 0) ?
+              h1->min                                                       :
               h2->min);
     splice_heap_node_lists(h1->min, h2->min);
   }
@@ -296,7 +302,7 @@ static void heap_cascading_cut(heap_t *h, heap_node_t *n)
 
 int heap_decrease_key(heap_t *h, heap_node_t *n, void *v)
 {
-  if (h->compare(n->datum, v) <= 0) {
+  if (h->compare(n->datum, v, h->context) <= 0) {
     return 1;
   }
 
@@ -319,11 +325,11 @@ int heap_decrease_key_no_replace(heap_t *h, heap_node_t *n)
 
   p = n->parent;
 
-  if (p && (h->compare(n->datum, p->datum) < 0)) {
+  if (p && (h->compare(n->datum, p->datum, h->context) < 0)) {
     heap_cut(h, n, p);
     heap_cascading_cut(h, p);
   }
-  if (h->compare(n->datum, h->min->datum) < 0) {
+  if (h->compare(n->datum, h->min->datum, h->context) < 0) {
     h->min = n;
   }
 
@@ -332,7 +338,7 @@ int heap_decrease_key_no_replace(heap_t *h, heap_node_t *n)
 
 #ifdef TESTING
 
-int32_t compare(const void *key, const void *with)
+int32_t compare(const void *key, const void *with, void *context)
 {
   return *((int *) key) - *((int *) with);
 }
@@ -364,7 +370,7 @@ int main(int argc, char *argv[])
   keys = calloc(n, sizeof (*keys));
   a = calloc(n, sizeof (*a));
 
-  heap_init(&h, compare, free);
+  heap_init(&h, compare, free, NULL);
 
   for (i = 0; i < n; i++) {
     keys[i] = malloc(sizeof (*keys[i]));
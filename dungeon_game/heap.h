@@ -10,16 +10,23 @@ extern "C" {
 struct heap_node;
 typedef struct heap_node heap_node_t;
 
+/* The comparitor is handed the context pointer given to heap_init(), *
+ * so it never needs to find its data through a global.  Heaps are    *
+ * otherwise self-contained, and any number of them may be used       *
+ * concurrently, as long as each is used by only one thread at a time. */
 typedef struct heap {
   heap_node_t *min;
   uint32_t size;
-  int32_t (*compare)(const void *key, const void *with);
+  int32_t (*compare)(const void *key, const void *with, void *context);
   void (*datum_delete)(void *);
+  void *context;
 } heap_t;
 
 void heap_init(heap_t *h,
-               int32_t (*compare)(const void *key, const void *with),
-               void (*datum_delete)(void *));
+               int32_t (*compare)(const void *key, const void *with,
+                                  void *context),
+               void (*datum_delete)(void *),
+               void *context);
 void heap_delete(heap_t *h);
 heap_node_t *heap_insert(heap_t *h, void *v);
 void *heap_peek_min(heap_t *h);
@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+
+#include "intern.h"
+#include "journal.h"
+
+#define ARENA_BLOCK      (64 * 1024)
+#define ARENA_MIN_TABLE  256
+
+/* Each string is its length, then its bytes and a NUL. */
+#define ARENA_OVERHEAD   (sizeof (uint32_t) + 1)
+
+static inline uint32_t arena_length(const char *s)
+{
+  uint32_t length;
+
+  memcpy(&length, s - sizeof (length), sizeof (length));
+
+  return length;
+}
+
+void string_arena::reserve(size_t n, uint32_t num_strings)
+{
+  n += num_strings * ARENA_OVERHEAD;
+  if (n > (size_t) (end - next)) {
+    block_size = n;
+    next = end = NULL;
+  }
+  while ((count + num_strings) * 2 > table.size()) {
+    grow_table();
+  }
+}
+
+void string_arena::grow_table()
+{
+  std::vector<slot> old;
+  uint32_t i, j, mask;
+
+  old.swap(table);
+  table.assign(old.size() ? old.size() * 2 : ARENA_MIN_TABLE, slot());
+  mask = table.size() - 1;
+
+  for (i = 0; i < old.size(); i++) {
+    if (old[i].s) {
+      for (j = old[i].hash; table[j & mask].s; j++)
+        ;
+      table[j & mask] = old[i];
+    }
+  }
+}
+
+uint32_t string_arena::hash(std::string_view s)
+{
+  return journal_hash((const uint8_t *) s.data(), s.length());
+}
+
+std::string_view string_arena::intern(std::string_view s, uint32_t hash)
+{
+  uint32_t i, mask, length;
+  size_t need;
+  char *p;
+
+  if ((count + 1) * 2 > table.size()) {
+    grow_table();
+  }
+
+  mask = table.size() - 1;
+  for (i = hash; table[i & mask].s; i++) {
+    if (table[i & mask].hash == hash &&
+        arena_length(table[i & mask].s) == s.length() &&
+        !memcmp(table[i & mask].s, s.data(), s.length())) {
+      return std::string_view(table[i & mask].s, s.length());
+    }
+  }
+
+  need = s.length() + ARENA_OVERHEAD;
+  if (need > (size_t) (end - next)) {
+    if (block_size < need) {
+      block_size = need > ARENA_BLOCK ? need : ARENA_BLOCK;
+    }
+    blocks.push_back((char *) malloc(block_size));
+    next = blocks.back();
+    end = next + block_size;
+    block_size = 0;
+  }
+
+  length = s.length();
+  memcpy(next, &length, sizeof (length));
+  p = next + sizeof (length);
+  memcpy(p, s.data(), length);
+  p[length] = '\0';
+  next += need;
+
+  table[i & mask].hash = hash;
+  table[i & mask].s = p;
+  count++;
+  bytes += length;
+
+  return std::string_view(p, length);
+}
+
+void string_arena::clear()
+{
+  uint32_t i;
+
+  for (i = 0; i < blocks.size(); i++) {
+    free(blocks[i]);
+  }
+  blocks.clear();
+  table.clear();
+  next = end = NULL;
+  block_size = 0;
+  count = 0;
+  bytes = 0;
+}
+
+/* Blocks never move, so views into either arena stay good. */
+void string_arena::swap(string_arena &other)
+{
+  std::swap(blocks, other.blocks);
+  std::swap(next, other.next);
+  std::swap(end, other.end);
+  std::swap(block_size, other.block_size);
+  std::swap(table, other.table);
+  std::swap(count, other.count);
+  std::swap(bytes, other.bytes);
+}
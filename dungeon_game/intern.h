@@ -0,0 +1,57 @@
+#ifndef INTERN_H
+# define INTERN_H
+
+# include <stdint.h>
+# include <stddef.h>
+# include <string_view>
+# include <vector>
+
+/* All of the description text, each distinct string stored once.      *
+ * Strings are appended to large blocks and never move, so the views    *
+ * intern() hands out stay good for the life of the arena, however the  *
+ * description vectors that hold them are copied or grown, and NPCs and *
+ * objects can keep them as plain pointers.  Sized with reserve() from  *
+ * what's about to be loaded, the whole lot lands in one block, laid    *
+ * out in load order.  Every string is NUL terminated, so a view's      *
+ * data() is also a C string.                                           *
+ *                                                                      *
+ * Nothing is ever removed; clear() throws the whole arena away.  An    *
+ * all-zero arena is a valid empty one, since dungeon_t gets memset().  */
+
+class string_arena {
+ private:
+  std::vector<char *> blocks;
+  char *next, *end;
+  size_t block_size;         /* Of the next block, if set by reserve() */
+  /* Open addressing.  Slots keep the hash, so that probing and growing *
+   * don't have to go out to the strings themselves.                    */
+  struct slot {
+    uint32_t hash;
+    const char *s;
+    slot() : hash(0), s(0) {}
+  };
+  std::vector<slot> table;
+  uint32_t count;
+  size_t bytes;
+  void grow_table();
+ public:
+  string_arena() : blocks(), next(0), end(0), block_size(0),
+                   table(), count(0), bytes(0)
+  {
+  }
+  ~string_arena() { clear(); }
+  string_arena(const string_arena &) = delete;
+  string_arena &operator=(const string_arena &) = delete;
+  /* Room for num_strings more strings totalling n bytes, in one block */
+  void reserve(size_t n, uint32_t num_strings);
+  std::string_view intern(std::string_view s) { return intern(s, hash(s)); }
+  /* For text whose hash was kept from an earlier intern() */
+  std::string_view intern(std::string_view s, uint32_t hash);
+  static uint32_t hash(std::string_view s);
+  void clear();
+  void swap(string_arena &other);
+  inline uint32_t strings() const { return count; }
+  inline size_t size() const { return bytes; }
+};
+
+#endif
@@ -5,16 +5,22 @@
 #include <sys/time.h>
 #include <signal.h>
 #include <stdio.h>
+#include <algorithm>
 
 #include "io.h"
 #include "move.h"
+#include "npc.h"
 #include "path.h"
 #include "pc.h"
 #include "utils.h"
 #include "dungeon.h"
+#include "journal.h"
+#include "checkpoint.h"
 
 using namespace std;
-/* Same ugly hack we did in path.c */
+/* The dungeon on the terminal, for the display timer.  There is only *
+ * one terminal and SIGALRM is process-wide, so this is the one piece *
+ * of display state that cannot be per-dungeon.                       */
 static dungeon_t *dungeon;
 
 typedef struct io_message {
@@ -24,7 +30,25 @@ typedef struct io_message {
   struct io_message *next;
 } io_message_t;
 
-static io_message_t *io_head, *io_tail;
+/* Input comes from here while a journal is being replayed.  Nothing *
+ * is drawn until it runs out, or until the turn to stop on, when the *
+ * terminal takes over.  Turns are the PC's, counted by input.       */
+static journal_t *io_replay_journal;
+static uint32_t io_replay_stop;
+static uint32_t io_turns;
+/* Every key read, as it's read */
+static journal_t *io_journal;
+
+/* Drawing rolls dice too: monsters flicker between their colors and *
+ * the status line shows a roll of the PC's damage.  The timer redraws *
+ * at arbitrary points, so those rolls come from a stream of their    *
+ * own; on the game's, every game would depend on when the timer      *
+ * fired, and no journal would replay.                                 */
+static rng_t io_rng;
+
+/* Messages are queued by game logic, so the queue is per-thread; a *
+ * simulation running on another thread never touches this one.     */
+static __thread io_message_t *io_head, *io_tail;
 
 static void sigalrm_handler(int unused)
 {
@@ -38,7 +62,7 @@ static void mask_alarm(void)
 
   sigemptyset(&s);
   sigaddset(&s, SIGALRM);
-  sigprocmask(SIG_BLOCK, &s, NULL);
+  pthread_sigmask(SIG_BLOCK, &s, NULL);
 }
 
 static void unmask_alarm(void)
@@ -47,13 +71,23 @@ static void unmask_alarm(void)
 
   sigemptyset(&s);
   sigaddset(&s, SIGALRM);
-  sigprocmask(SIG_UNBLOCK, &s, NULL);
+  pthread_sigmask(SIG_UNBLOCK, &s, NULL);
 }
 
-void io_init_terminal(dungeon_t *d)
+/* Redraws every usec microseconds; 0 stops. */
+static void io_set_timer(uint32_t usec)
 {
   struct itimerval itv;
 
+  itv.it_interval.tv_sec = 0;
+  itv.it_interval.tv_usec = usec;
+  itv.it_value.tv_sec = 0;
+  itv.it_value.tv_usec = usec;
+  setitimer(ITIMER_REAL, &itv, NULL);
+}
+
+void io_init_terminal(dungeon_t *d)
+{
   initscr();
   raw();
   noecho();
@@ -69,19 +103,126 @@ void io_init_terminal(dungeon_t *d)
   init_pair(COLOR_CYAN, COLOR_CYAN, COLOR_BLACK);
   init_pair(COLOR_WHITE, COLOR_WHITE, COLOR_BLACK);
   
-  itv.it_interval.tv_sec = 0;
-  itv.it_interval.tv_usec = 200000; /* 1/5 seconds */
-  itv.it_value.tv_sec = 0;
-  itv.it_value.tv_usec = 200000;
-  setitimer(ITIMER_REAL, &itv, NULL);
+  io_set_timer(200000); /* 1/5 seconds */
   dungeon = d;
   signal(SIGALRM, sigalrm_handler);
 }
 
 void io_reset_terminal(void)
 {
-  endwin();
+  if (!io_replay_journal) {
+    endwin();
+  }
+
+  io_clear_messages();
+}
+
+void io_record(journal_t *j)
+{
+  io_journal = j;
+}
+
+void io_replay(dungeon_t *d, journal_t *j, uint32_t stop_turn)
+{
+  dungeon = d;
+  io_replay_journal = j;
+  io_replay_stop = stop_turn;
+}
+
+int io_is_headless(void)
+{
+  return io_replay_journal != NULL;
+}
+
+uint32_t io_turn(void)
+{
+  return io_turns;
+}
+
+/* Hands the game over to the terminal, part way through a replay. */
+static void io_end_replay(void)
+{
+  io_replay_journal = NULL;
+  io_init_terminal(dungeon);
+  io_display_all(dungeon);
+}
+
+/* All input goes through here, so that it can be recorded and replayed. */
+int io_getch(void)
+{
+  int key;
+
+  if (io_replay_journal && !journal_next(io_replay_journal, &key)) {
+    if (!io_replay_stop) {
+      fprintf(stderr, "Journal ends in the middle of a command "
+              "on turn %u.\n", io_turns + 1);
+      exit(1);
+    }
+    io_end_replay();
+  }
+  if (!io_replay_journal) {
+    key = getch();
+  }
+
+  if (io_journal) {
+    journal_record(io_journal, key);
+  }
+
+  return key;
+}
+
+/* Takes a checkpoint.  Returns as checkpoint_take() does, so this    *
+ * returns 1 in the checkpoint if the game is later rewound to it.     *
+ * Then the screen has to be won back: a process made by fork() has no *
+ * timer, and curses has no idea what the game it replaced left on     *
+ * screen.                                                             */
+int io_checkpoint(dungeon_t *d)
+{
+  int retval;
+
+  switch (retval = checkpoint_take(d, io_turns)) {
+  case 0:
+    break;
+  case 1:
+    io_set_timer(200000);
+    clearok(curscr, TRUE);
+    io_queue_message("Rewound to turn %u.", io_turns);
+    io_display_all(d);
+    break;
+  default:
+    io_queue_message("Couldn't take a checkpoint.");
+    break;
+  }
+
+  return retval;
+}
+
+static void io_rewind(dungeon_t *d)
+{
+  if (!checkpoint_count()) {
+    mvprintw(0, 0, "No checkpoints to rewind to. ");
+    return;
+  }
+
+  /* This game's timer would draw over the checkpoint's. */
+  io_set_timer(0);
+  checkpoint_rewind(checkpoint_count() - 1);
+  io_set_timer(200000);
+  mvprintw(0, 0, "That checkpoint is gone. ");
+}
 
+/* The rules are typed out a letter at a time; a replay doesn't wait. */
+static void io_pause(useconds_t usec)
+{
+  if (!io_replay_journal) {
+    usleep(usec);
+  }
+}
+
+/* Drops any queued messages.  Headless games have nowhere to show *
+ * them, so they call this after every turn.                       */
+void io_clear_messages(void)
+{
   while (io_head) {
     io_tail = io_head;
     io_head = io_head->next;
@@ -121,6 +262,20 @@ static void io_print_message_queue(uint32_t y, uint32_t x, dungeon_t *d)
   uint32_t damage, i;
   int COLOR_HIGHLIGHT = 11;
   char input;
+
+  if (io_replay_journal) {
+    /* Nothing to show, but the keys that dismissed them were recorded */
+    while (io_head) {
+      while (io_getch() != '\n')
+        ;
+      io_tail = io_head;
+      io_head = io_head->next;
+      free(io_tail);
+    }
+    io_tail = NULL;
+    return;
+  }
+
   init_pair(COLOR_HIGHLIGHT, COLOR_BLACK, COLOR_WHITE);
   
   mask_alarm();
@@ -137,22 +292,22 @@ static void io_print_message_queue(uint32_t y, uint32_t x, dungeon_t *d)
     attroff(COLOR_PAIR(COLOR_HIGHLIGHT));
 
     string highest_score="";
-    if(d->nummon_beaten>get_highest_score()){
+    if(d->nummon_beaten>get_highest_score(d)){
       highest_score += " HIGHEST SCORE!!!";
     }
     for (i = damage = 0; i < num_eq_slots; i++) {
       if (i == eq_slot_weapon && !d->the_pc->eq[i]) {
-	damage += d->the_pc->damage->roll();
+	damage += character_get_attack(d, PC_ID);
       } else if (d->the_pc->eq[i]) {
 	damage += d->the_pc->eq[i]->roll_dice();
       }
     }
     
     
-    mvprintw(23,0,"PC: HP = %d, SPEED = %d, POWER = %d, SCORE = %d %s",d->the_pc->hp,d->the_pc->speed, damage, d->nummon_beaten, highest_score.c_str());
+    mvprintw(23,0,"PC: HP = %d, SPEED = %d, POWER = %d, SCORE = %d %s",d->characters.hp[PC_ID],d->characters.speed[PC_ID], damage, d->nummon_beaten, highest_score.c_str());
     refresh();
     do{
-    }while(input=getch()!='\n');
+    }while(input=io_getch()!='\n');
     free(io_tail);
   }
   io_tail = NULL;
@@ -228,11 +383,11 @@ static char distance_to_char[] = {
 void io_display_ch(dungeon_t *d)
 {
   mask_alarm();
-  mvprintw(11, 33, " HP:    %5d ", d->the_pc->hp);
-  mvprintw(12, 33, " Speed: %5d ", d->the_pc->speed);
+  mvprintw(11, 33, " HP:    %5d ", d->characters.hp[PC_ID]);
+  mvprintw(12, 33, " Speed: %5d ", d->characters.speed[PC_ID]);
   mvprintw(14, 27, " Hit any key to continue. ");
   refresh();
-  getch();
+  io_getch();
   unmask_alarm();
 }
 
@@ -249,7 +404,7 @@ void io_display_tunnel(dungeon_t *d)
     }
   }
   refresh();
-  while (getch() != 27 /* ESC */)
+  while (io_getch() != 27 /* ESC */)
     ;
   unmask_alarm();
 }
@@ -267,7 +422,7 @@ void io_display_distance(dungeon_t *d)
     }
   }
   refresh();
-  while (getch() != 27 /* ESC */)
+  while (io_getch() != 27 /* ESC */)
     ;
   unmask_alarm();
 }
@@ -291,7 +446,7 @@ void io_display_hardness(dungeon_t *d)
     }
   }
   refresh();
-  while (getch() != 27 /* ESC */)
+  while (io_getch() != 27 /* ESC */)
     ;
   unmask_alarm();
 }
@@ -301,7 +456,7 @@ void io_menu_display(dungeon_t *d)
   int input;
   string dungeon;
   int COLOR_HIGHLIGHT = 11;
-  int read_already;
+  int read_already = 0;
   init_pair(COLOR_HIGHLIGHT, COLOR_BLACK, COLOR_WHITE);
     /*  
    ___   _   _ _   _  ____ _____ ___  _   _
@@ -371,7 +526,7 @@ void io_menu_display(dungeon_t *d)
   if(highlight==2){
       attroff(COLOR_PAIR(COLOR_HIGHLIGHT));
   }
-  input = getch();
+  input = io_getch();
   switch(input){
   case KEY_UP: highlight = (highlight+2)%3; break;
   case KEY_DOWN: highlight = (highlight+1)%3; break;
@@ -429,30 +584,30 @@ void io_read_rule(dungeon_t *d){
   clear();
   
   for(i=0; i<intro1.length(); i++){
-    usleep(125000);
+    io_pause(125000);
     mvaddch(0,i,intro1[i]);
     refresh();
   }
 
   for(i=0; i<intro2.length(); i++){
-    usleep(125000);
+    io_pause(125000);
     mvaddch(1,i,intro2[i]);
     refresh();
   }
 
   for(i=0; i<intro3.length(); i++){
-    usleep(125000);
+    io_pause(125000);
     mvaddch(2,i,intro3[i]);
     refresh();
   }
 
   for(i=0; i<intro4.length(); i++){
-    usleep(125000);
+    io_pause(125000);
     mvaddch(3,i,intro4[i]);
     refresh();
   }
   
-  sleep(2);
+  io_pause(2000000);
 
   io_display_all(d);
   
@@ -503,20 +658,20 @@ void io_rule_display(string rule1, string rule2){
   mvprintw(22,1,"%78s","");
 
   for(i=0; i<rule1.length(); i++){
-    usleep(125000);
+    io_pause(125000);
     mvaddch(20,i+1,rule1[i]);
     refresh();
   }
 
   for(i=0; i<rule2.length(); i++){
-    usleep(125000);
+    io_pause(125000);
     mvaddch(21,i+1,rule2[i]);
     refresh();
   }
   attron(COLOR_PAIR(COLOR_HIGHLIGHT));
   mvprintw(22,73," NEXT ");
   attroff(COLOR_PAIR(COLOR_HIGHLIGHT));
-  input = getch();
+  input = io_getch();
 
 }
 void io_initial_display(dungeon_t *d)
@@ -533,7 +688,7 @@ void io_initial_display(dungeon_t *d)
   int count=0;  
 
   do{
-    input = getch();
+    input = io_getch();
 
     if(count == 0 && (input == 'r' || input=='p')){
       read_ranking(d,input);
@@ -551,15 +706,22 @@ void io_display_all(dungeon_t *d)
 {
   uint32_t y, x;
   uint32_t damage, i;
-    
+  rng_t *old;
+
+  if (io_replay_journal) {
+    io_print_message_queue(0, 0, d);
+    return;
+  }
+
   mask_alarm();
+  old = rng_bind(&io_rng);
   clear();
   for (y = 0; y < DUNGEON_Y; y++) {
     for (x = 0; x < DUNGEON_X; x++) {
       if (d->charmap[y][x]) {
-        attron(COLOR_PAIR(d->charmap[y][x]->get_color()));
-        mvaddch(y + 1, x, d->charmap[y][x]->get_symbol());
-        attroff(COLOR_PAIR(d->charmap[y][x]->get_color()));
+        attron(COLOR_PAIR(character_get_color(d, d->charmap[y][x])));
+        mvaddch(y + 1, x, character_get_symbol(d, d->charmap[y][x]));
+        attroff(COLOR_PAIR(character_get_color(d, d->charmap[y][x])));
       } else if (d->objmap[y][x] /*&& d->objmap[y][x]->have_seen()*/) {
         attron(COLOR_PAIR(d->objmap[y][x]->get_color()));
         mvaddch(y + 1, x, d->objmap[y][x]->get_symbol());
@@ -600,13 +762,13 @@ void io_display_all(dungeon_t *d)
   
   io_print_message_queue(0, 0,d);
   string highest_score="";
-  if(d->nummon_beaten>get_highest_score()){
+  if(d->nummon_beaten>get_highest_score(d)){
     highest_score += " HIGHEST SCORE!!!";
   }
 
   for (i = damage = 0; i < num_eq_slots; i++) {
     if (i == eq_slot_weapon && !d->the_pc->eq[i]) {
-      damage += d->the_pc->damage->roll();
+      damage += character_get_attack(d, PC_ID);
     } else if (d->the_pc->eq[i]) {
       damage += d->the_pc->eq[i]->roll_dice();
     }
@@ -615,9 +777,10 @@ void io_display_all(dungeon_t *d)
   attron(COLOR_PAIR(COLOR_CYAN));
   mvprintw(0,0,"%80s","--Hit 'h' for HELP--");
   attroff(COLOR_PAIR(COLOR_CYAN));
-  mvprintw(23,0,"PC: HP = %d, SPEED = %d, POWER = %d, SCORE = %d %s",d->the_pc->hp,d->the_pc->speed, damage, d->nummon_beaten,highest_score.c_str());
+  mvprintw(23,0,"PC: HP = %d, SPEED = %d, POWER = %d, SCORE = %d %s",d->characters.hp[PC_ID],d->characters.speed[PC_ID], damage, d->nummon_beaten,highest_score.c_str());
 
   refresh();
+  rng_bind(old);
   unmask_alarm();
 }
 
@@ -625,8 +788,10 @@ void io_display(dungeon_t *d)
 {
   uint32_t y, x;
   uint32_t illuminated;
+  rng_t *old;
 
   mask_alarm();
+  old = rng_bind(&io_rng);
   clear();
   for (y = 0; y < DUNGEON_Y; y++) {
     for (x = 0; x < DUNGEON_X; x++) {
@@ -635,12 +800,12 @@ void io_display(dungeon_t *d)
       }
       if (d->charmap[y][x] &&
           can_see(d,
-                  character_get_pos(d->the_pc),
-                  character_get_pos(d->charmap[y][x]),
+                  character_get_pos(d, PC_ID),
+                  character_get_pos(d, d->charmap[y][x]),
                   1)) {
-        attron(COLOR_PAIR(d->charmap[y][x]->get_color()));
-        mvaddch(y + 1, x, d->charmap[y][x]->get_symbol());
-        attroff(COLOR_PAIR(d->charmap[y][x]->get_color()));
+        attron(COLOR_PAIR(character_get_color(d, d->charmap[y][x])));
+        mvaddch(y + 1, x, character_get_symbol(d, d->charmap[y][x]));
+        attroff(COLOR_PAIR(character_get_color(d, d->charmap[y][x])));
       } else if (d->objmap[y][x] && d->objmap[y][x]->have_seen()) {
         attron(COLOR_PAIR(d->objmap[y][x]->get_color()));
         mvaddch(y + 1, x, d->objmap[y][x]->get_symbol());
@@ -685,11 +850,12 @@ void io_display(dungeon_t *d)
 
   io_print_message_queue(0, 0,d);
   string highest_score="";
-  if(d->nummon_beaten>get_highest_score()){
+  if(d->nummon_beaten>get_highest_score(d)){
     highest_score += " HIGHEST SCORE!!!";
   }
-  mvprintw(23,0,"PC: HP = %d, SPEED = %d, SCORE = %d %s",d->the_pc->hp, d->the_pc->speed, d->nummon_beaten,highest_score.c_str());
+  mvprintw(23,0,"PC: HP = %d, SPEED = %d, SCORE = %d %s",d->characters.hp[PC_ID], d->characters.speed[PC_ID], d->nummon_beaten,highest_score.c_str());
   refresh();
+  rng_bind(old);
   unmask_alarm();
 }
 
@@ -699,7 +865,7 @@ void io_display_monster_list(dungeon_t *d)
   mvprintw(12, 33, " Speed: XXXXX ");
   mvprintw(14, 27, " Hit any key to continue. ");
   refresh();
-  getch();
+  io_getch();
 }
 
 uint32_t io_teleport_pc(dungeon_t *d)
@@ -713,11 +879,11 @@ uint32_t io_teleport_pc(dungeon_t *d)
 
   }while(charpair(dest) || (mappair(dest)<ter_floor));
       //} while (charpair(dest) && mappair(dest)!=ter_floor);
-  d->charmap[character_get_y(d->the_pc)][character_get_x(d->the_pc)] = NULL;
-  d->charmap[dest[dim_y]][dest[dim_x]] = d->the_pc;
+  charpair(character_get_pos(d, PC_ID)) = NO_CHARACTER;
+  charpair(dest) = PC_ID;
 
-  character_set_y(d->the_pc, dest[dim_y]);
-  character_set_x(d->the_pc, dest[dim_x]);
+  character_set_y(d, PC_ID, dest[dim_y]);
+  character_set_x(d, PC_ID, dest[dim_x]);
 
   if (mappair(dest) < ter_floor) {
     mappair(dest) = ter_floor;
@@ -727,10 +893,10 @@ uint32_t io_teleport_pc(dungeon_t *d)
 
   dijkstra(d);
   dijkstra_tunnel(d);
-  d->the_pc->hp -= 100;
-  if(d->the_pc->hp<=0){
-    d->the_pc->hp=0;
-    d->the_pc->alive=0;
+  d->characters.hp[PC_ID] -= 100;
+  if(d->characters.hp[PC_ID]<=0){
+    d->characters.hp[PC_ID]=0;
+    d->characters.alive[PC_ID]=0;
   }
   return 0;
 }
@@ -780,7 +946,7 @@ static void io_scroll_monster_list(char (*s)[50], uint32_t count)
     for (i = 0; i < 13; i++) {
       mvprintw(i + 6, 19, " %-50s ", s[i + offset]);
     }
-    switch (getch()) {
+    switch (io_getch()) {
     case KEY_UP:
       if (offset) {
         offset--;
@@ -805,7 +971,7 @@ static bool is_vowel(const char c)
 }
 
 static void io_list_monsters_display(dungeon_t *d,
-                                     character **c,
+                                     character_id_t *c,
                                      uint32_t count)
 {
   uint32_t i;
@@ -836,9 +1002,9 @@ static void io_list_monsters_display(dungeon_t *d,
   
   for (i = 0; i < count; i++) {
     snprintf(s[i], 50, "%3s%s (%c): HP = %d, POWER = %d ",
-             (is_vowel(character_get_name(c[i])[0]) ? "An " : "A "),
-             character_get_name(c[i]),
-             character_get_symbol(c[i]),character_get_hp(c[i]),character_get_attack(c[i]));
+             (is_vowel(character_get_name(d, c[i])[0]) ? "An " : "A "),
+             character_get_name(d, c[i]),
+             character_get_symbol(d, c[i]),character_get_hp(d, c[i]),character_get_attack(d, c[i]));
 
 	     /*
              abs(character_get_y(c[i]) - character_get_y(d->the_pc)),
@@ -858,12 +1024,12 @@ static void io_list_monsters_display(dungeon_t *d,
 
   mvprintw(16,14," |_________________________________________________| ");
   mvprintw(17,14," %-49s "," Hit any key to continue.");
-  input = getch();
+  input = io_getch();
   /*
   if (count <= 13) {
     mvprintw(count + 6, 14, " %-50s ", "");
     mvprintw(count + 7, 14, " %-50s ", "Hit escape to continue.");
-    while (getch() != 27)
+    while (io_getch() != 27)
       ;
   } else {
     mvprintw(14, 14, " %-50s ", "");
@@ -875,37 +1041,29 @@ static void io_list_monsters_display(dungeon_t *d,
   free(s);
 }
 
-static int compare_monster_distance(const void *v1, const void *v2)
-{
-  const character *const *c1 = (const character * const *) v1;
-  const character *const *c2 = (const character * const *) v2;
-
-  return (dungeon->pc_distance[character_get_y(*c1)][character_get_x(*c1)] -
-          dungeon->pc_distance[character_get_y(*c2)][character_get_x(*c2)]);
-}
-
 static void io_list_monsters(dungeon_t *d)
 {
-  character **c;
+  character_id_t *c;
   uint32_t x, y, count;
 
   mask_alarm();
-  c = (character **) malloc(d->num_monsters * sizeof (*c));
+  c = (character_id_t *) malloc(d->num_monsters * sizeof (*c));
 
   /* Get a linear list of monsters */
   for (count = 0, y = 1; y < DUNGEON_Y - 1; y++) {
     for (x = 1; x < DUNGEON_X - 1; x++) {
       if (d->charmap[y][x] &&
-          d->charmap[y][x] != d->the_pc &&
-          can_see(d, d->the_pc->position, character_get_pos(d->charmap[y][x]), 1)) {
+          d->charmap[y][x] != PC_ID &&
+          can_see(d, character_get_pos(d, PC_ID), character_get_pos(d, d->charmap[y][x]), 1)) {
         c[count++] = d->charmap[y][x];
       }
     }
   }
 
   /* Sort it by distance from PC */
-  dungeon = d;
-  qsort(c, count, sizeof (*c), compare_monster_distance);
+  std::sort(c, c + count, [d](character_id_t a, character_id_t b) {
+    return npc_distance(d, a) < npc_distance(d, b);
+  });
 
   /* Display it */
   io_list_monsters_display(d, c, count);
@@ -978,7 +1136,7 @@ uint32_t io_wear_eq(dungeon_t *d)
   mvprintw(18, 11, "  %-58s ", "Wear which item (ESC to cancel)?");
   refresh();
 
-  input = getch();  
+  input = io_getch();  
   switch(input){
   case KEY_UP: highlight = (highlight+count-1)%count; break;
   case KEY_DOWN: highlight = (highlight+1)%count; break;
@@ -994,7 +1152,7 @@ uint32_t io_wear_eq(dungeon_t *d)
 
   /*
   while (1) {
-    if ((key = getch()) == 27) {
+    if ((key = io_getch()) == 27) {
       //io_display(d);
       io_display_all(d);
       unmask_alarm();
@@ -1066,7 +1224,7 @@ void io_display_in(dungeon_t *d)
 
   refresh();
 
-  getch();
+  io_getch();
   unmask_alarm();
 
   //io_display(d);
@@ -1089,7 +1247,7 @@ uint32_t io_remove_eq(dungeon_t *d)
   refresh();
 
   while (1) {
-    if ((key = getch()) == 27 /* ESC */) {
+    if ((key = io_getch()) == 27 /* ESC */) {
       //io_display(d);
      io_display_all(d);
       return 1;
@@ -1227,7 +1385,7 @@ void io_display_help(dungeon_t *d)
   mvprintw(++i,19," %-49s "," Hit any key to continue.");
   ++i;
   mvprintw(++i,0,"%80s","");
-  input = getch();
+  input = io_getch();
   unmask_alarm();
 }
 
@@ -1265,7 +1423,7 @@ void io_display_eq(dungeon_t *d)
 
   refresh();
 
-  getch();
+  io_getch();
 
   //io_display(d);
   io_display_all(d);
@@ -1291,7 +1449,7 @@ uint32_t io_drop_in(dungeon_t *d)
   refresh();
 
   while (1) {
-    if ((key = getch()) == 27 /* ESC */) {
+    if ((key = io_getch()) == 27 /* ESC */) {
       //io_display(d);
       io_display_all(d);
       unmask_alarm();
@@ -1350,7 +1508,7 @@ uint32_t io_expunge_in(dungeon_t *d)
   refresh();
 
   while (1) {
-    if ((key = getch()) == 27 /* ESC */) {
+    if ((key = io_getch()) == 27 /* ESC */) {
       //io_display(d);
       io_display_all(d);
       unmask_alarm();
@@ -1398,8 +1556,18 @@ void io_handle_input(dungeon_t *d)
   uint32_t fail_code;
   int key;
 
+  if (io_replay_journal && (journal_done(io_replay_journal) ||
+                            (io_replay_stop && io_turns == io_replay_stop))) {
+    if (!io_replay_stop) {
+      /* Played out; leave the game as the recording left it. */
+      d->save_and_exit = d->quit_no_save = 1;
+      return;
+    }
+    io_end_replay();
+  }
+
   do {
-    switch (key = getch()) {
+    switch (key = io_getch()) {
       //case '7':
       //case 'y':
     case KEY_HOME:
@@ -1456,7 +1624,7 @@ void io_handle_input(dungeon_t *d)
       break;
     case 'S':
       d->save_and_exit = 1;
-      character_reset_turn(d->the_pc);
+      character_reset_turn(d, PC_ID);
       fail_code = 0;
       break;
       /*case 'Q':
@@ -1486,6 +1654,23 @@ void io_handle_input(dungeon_t *d)
       io_display_all(d);
       fail_code = 1;
       break;*/
+    case 'C':
+      /* Checkpoint.  Free, and only with --checkpoints.                */
+      if (d->checkpoints) {
+        if (!io_checkpoint(d)) {
+          mvprintw(0, 0, "Checkpoint %u taken on turn %u. ",
+                   checkpoint_count(), io_turns);
+        }
+      } else {
+        mvprintw(0, 0, "Checkpoints are off. ");
+      }
+      fail_code = 1;
+      break;
+    case 'R':
+      /* Rewind to the newest checkpoint.                               */
+      io_rewind(d);
+      fail_code = 1;
+      break;
     case 'g':
       /* Teleport the PC to a random place in the dungeon.              */
       io_teleport_pc(d);
@@ -1563,4 +1748,6 @@ void io_handle_input(dungeon_t *d)
       fail_code = 1;
     }
   } while (fail_code);
+
+  io_turns++;
 }
@@ -2,9 +2,11 @@
 # define IO_H
 
 typedef struct dungeon dungeon_t;
+typedef struct journal journal_t;
 using namespace std;
 
 #include <string>
+#include <stdint.h>
 
 void io_init_terminal(dungeon_t *d);
 void io_reset_terminal(void);
@@ -16,5 +18,17 @@ void io_read_rule(dungeon_t *d);
 void io_rule_display(string rule1, string rule2);
 void io_handle_input(dungeon_t *d);
 void io_queue_message(const char *format, ...);
+void io_clear_messages(void);
+int io_getch(void);
+int io_checkpoint(dungeon_t *d);
+/* Records every key read to j; NULL stops. */
+void io_record(journal_t *j);
+/* Takes input from j, without a terminal, until it runs out.  With a *
+ * stop_turn, the terminal takes over at that turn, or when the keys  *
+ * run out if that's sooner; without, the game ends there.            */
+void io_replay(dungeon_t *d, journal_t *j, uint32_t stop_turn);
+int io_is_headless(void);
+/* PC turns taken so far */
+uint32_t io_turn(void);
 
 #endif
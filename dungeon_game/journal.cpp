@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "journal.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+/* The fixed part of the header, up to the player's name */
+#define JOURNAL_FIXED_SIZE 40
+
+/* What ERR is recorded as, which is also the largest key that fits */
+#define JOURNAL_ERR 0x7fff
+
+static uint64_t fnv1a(uint64_t hash, const uint8_t *data, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * FNV_PRIME;
+  }
+
+  return hash;
+}
+
+uint64_t journal_hash(const uint8_t *data, size_t size)
+{
+  return fnv1a(FNV_OFFSET, data, size);
+}
+
+uint64_t journal_hash_file(const char *path)
+{
+  uint8_t buf[4096];
+  uint64_t hash;
+  ssize_t n;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) < 0) {
+    return 0;
+  }
+
+  hash = FNV_OFFSET;
+  while ((n = read(fd, buf, sizeof (buf))) > 0) {
+    hash = fnv1a(hash, buf, n);
+  }
+  close(fd);
+
+  return n ? 0 : hash;
+}
+
+static uint8_t *put_be16(uint8_t *p, uint16_t v)
+{
+  v = htobe16(v);
+  memcpy(p, &v, sizeof (v));
+
+  return p + sizeof (v);
+}
+
+static uint8_t *put_be32(uint8_t *p, uint32_t v)
+{
+  v = htobe32(v);
+  memcpy(p, &v, sizeof (v));
+
+  return p + sizeof (v);
+}
+
+static uint8_t *put_be64(uint8_t *p, uint64_t v)
+{
+  v = htobe64(v);
+  memcpy(p, &v, sizeof (v));
+
+  return p + sizeof (v);
+}
+
+static uint16_t get_be16(const uint8_t *p)
+{
+  uint16_t v;
+
+  memcpy(&v, p, sizeof (v));
+
+  return be16toh(v);
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+  uint32_t v;
+
+  memcpy(&v, p, sizeof (v));
+
+  return be32toh(v);
+}
+
+static uint64_t get_be64(const uint8_t *p)
+{
+  uint64_t v;
+
+  memcpy(&v, p, sizeof (v));
+
+  return be64toh(v);
+}
+
+int journal_create(journal_t *j, const char *path)
+{
+  uint8_t header[JOURNAL_FIXED_SIZE + 4], *p;
+  uint16_t name_length;
+
+  if (!(j->out = fopen(path, "w"))) {
+    perror(path);
+    return 1;
+  }
+
+  name_length = j->player_name ? strlen(j->player_name) : 0;
+
+  p = header;
+  memcpy(p, JOURNAL_SEMANTIC, strlen(JOURNAL_SEMANTIC));
+  p += strlen(JOURNAL_SEMANTIC);
+  p = put_be32(p, JOURNAL_VERSION);
+  p = put_be64(p, j->seed);
+  p = put_be64(p, j->monster_hash);
+  p = put_be64(p, j->object_hash);
+  p = put_be16(p, j->max_monsters);
+  p = put_be16(p, j->max_objects);
+  p = put_be16(p, name_length);
+  fwrite(header, 1, p - header, j->out);
+  fwrite(j->player_name, 1, name_length, j->out);
+
+  put_be32(header, j->start ? j->start_size : 0);
+  fwrite(header, 1, 4, j->out);
+  if (j->start) {
+    fwrite(j->start, 1, j->start_size, j->out);
+  }
+
+  if (fflush(j->out)) {
+    perror(path);
+    fclose(j->out);
+    j->out = NULL;
+    return 1;
+  }
+
+  return 0;
+}
+
+void journal_record(journal_t *j, int key)
+{
+  uint8_t buf[2];
+
+  if (key < 0 || key >= JOURNAL_ERR) {
+    key = JOURNAL_ERR;
+  }
+
+  if (key < 0x80) {
+    buf[0] = key;
+    fwrite(buf, 1, 1, j->out);
+  } else {
+    buf[0] = 0x80 | (key >> 8);
+    buf[1] = key & 0xff;
+    fwrite(buf, 1, 2, j->out);
+  }
+
+  /* A key at a time into the kernel, so that it outlives a crash. */
+  fflush(j->out);
+}
+
+int journal_open(journal_t *j, const char *path)
+{
+  struct stat buf;
+  uint32_t name_length, p;
+  FILE *f;
+
+  memset(j, 0, sizeof (*j));
+
+  if (!(f = fopen(path, "r")) || fstat(fileno(f), &buf)) {
+    perror(path);
+    if (f) {
+      fclose(f);
+    }
+    return 1;
+  }
+
+  j->size = buf.st_size;
+  j->image = (uint8_t *) malloc(j->size + 1);
+  if (fread(j->image, 1, j->size, f) != j->size) {
+    perror(path);
+    fclose(f);
+    journal_close(j);
+    return 1;
+  }
+  fclose(f);
+
+  if (j->size < JOURNAL_FIXED_SIZE ||
+      strncmp((const char *) j->image, JOURNAL_SEMANTIC, 6)) {
+    fprintf(stderr, "%s: Not an RLG327 journal.\n", path);
+    journal_close(j);
+    return 1;
+  }
+  if (get_be32(j->image + 6) != JOURNAL_VERSION) {
+    fprintf(stderr, "%s: Journal version mismatch.\n", path);
+    journal_close(j);
+    return 1;
+  }
+
+  j->seed = get_be64(j->image + 10);
+  j->monster_hash = get_be64(j->image + 18);
+  j->object_hash = get_be64(j->image + 26);
+  j->max_monsters = get_be16(j->image + 34);
+  j->max_objects = get_be16(j->image + 36);
+  name_length = get_be16(j->image + 38);
+
+  p = JOURNAL_FIXED_SIZE;
+  if (j->size - p < name_length + 4) {
+    fprintf(stderr, "%s: Truncated journal.\n", path);
+    journal_close(j);
+    return 1;
+  }
+  j->player_name = (char *) malloc(name_length + 1);
+  memcpy(j->player_name, j->image + p, name_length);
+  j->player_name[name_length] = '\0';
+  p += name_length;
+
+  j->start_size = get_be32(j->image + p);
+  p += 4;
+  if (j->size - p < j->start_size) {
+    fprintf(stderr, "%s: Truncated journal.\n", path);
+    journal_close(j);
+    return 1;
+  }
+  if (j->start_size) {
+    j->start = j->image + p;
+    p += j->start_size;
+  }
+
+  j->next = p;
+
+  return 0;
+}
+
+int journal_next(journal_t *j, int *key)
+{
+  if (j->next >= j->size) {
+    return 0;
+  }
+
+  if (j->image[j->next] < 0x80) {
+    *key = j->image[j->next++];
+  } else if (j->next + 1 < j->size) {
+    *key = ((j->image[j->next] & 0x7f) << 8) | j->image[j->next + 1];
+    if (*key == JOURNAL_ERR) {
+      *key = -1;
+    }
+    j->next += 2;
+  } else {
+    /* Cut off halfway through a key by the crash being chased */
+    j->next = j->size;
+    return 0;
+  }
+  j->keys_read++;
+
+  return 1;
+}
+
+void journal_close(journal_t *j)
+{
+  if (j->out) {
+    fclose(j->out);
+    j->out = NULL;
+  }
+  if (j->image) {
+    /* Only a journal being replayed owns its name and start snapshot */
+    free(j->player_name);
+    free(j->image);
+    j->image = NULL;
+    j->start = NULL;
+    j->player_name = NULL;
+  }
+}
@@ -0,0 +1,67 @@
+#ifndef JOURNAL_H
+# define JOURNAL_H
+
+# include <stdint.h>
+# include <stdio.h>
+# include <stddef.h>
+
+/* A record of one game: everything needed to start it again, then    *
+ * every key the game read, in order.  Replaying the keys against the *
+ * same start plays the game out exactly as before, since the only     *
+ * other inputs are the random stream, which the seed fixes, and the  *
+ * description files, whose hashes are kept to catch a changed one.    *
+ * Big-endian, like the save files:                                    *
+ *                                                                     *
+ *   0   "RLJ327"                                                      *
+ *   6   version, 4 bytes                                              *
+ *   10  seed, 8 bytes                                                 *
+ *   18  hash of the monster descriptions, 8 bytes                     *
+ *   26  hash of the object descriptions, 8 bytes                     *
+ *   34  max monsters, 2 bytes                                         *
+ *   36  max objects, 2 bytes                                          *
+ *   38  length of the player's name, 2 bytes, then the name           *
+ *   ... length of the starting snapshot, 4 bytes, then the snapshot.  *
+ *       Zero for a dungeon generated from the seed; games started    *
+ *       from a save file or an image carry their own start, so the    *
+ *       journal doesn't depend on files that play may overwrite.      *
+ *   ... the keys to the end of the file.  One byte for keys below     *
+ *       0x80; anything else is two bytes, the first with its high     *
+ *       bit set.  ERR is 0xffff.                                      *
+ *                                                                     *
+ * Keys are flushed as they're recorded, so a journal survives the     *
+ * crash it was meant to capture.                                      */
+
+# define JOURNAL_SEMANTIC "RLJ327"
+# define JOURNAL_VERSION  0U
+
+typedef struct journal {
+  uint64_t seed;
+  uint64_t monster_hash;
+  uint64_t object_hash;
+  uint16_t max_monsters;
+  uint16_t max_objects;
+  char *player_name;
+  uint8_t *start;        /* Snapshot to start from, or NULL */
+  uint32_t start_size;
+  FILE *out;             /* Recording */
+  uint8_t *image;        /* Replaying: the whole file, and where the */
+  uint32_t size, next;   /* keys start and the next one is           */
+  uint32_t keys_read;
+} journal_t;
+
+/* FNV-1a, over memory or over a file's contents; the file's hash is 0 *
+ * if it can't be read.                                                */
+uint64_t journal_hash(const uint8_t *data, size_t size);
+uint64_t journal_hash_file(const char *path);
+
+/* Writes the header from the fields above; keys follow. */
+int journal_create(journal_t *j, const char *path);
+void journal_record(journal_t *j, int key);
+/* Reads a journal and fills in the fields above. */
+int journal_open(journal_t *j, const char *path);
+/* The next key recorded; returns 0 once they've run out. */
+int journal_next(journal_t *j, int *key);
+# define journal_done(j) ((j)->next >= (j)->size)
+void journal_close(journal_t *j);
+
+#endif
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <iostream>
+
+#include "dungeon.h"
+#include "descriptions.h"
+#include "builtin.h"
+#include "journal.h"
+
+/* Writes builtin_tables.h (see builtin.h) to stdout from the two     *
+ * description files named on the command line.  It's linked with the *
+ * rest of the game, so the tables come out of the same parser that   *
+ * reads the files at run time, and can't drift from it.              */
+
+/* This is what makes the tables, so it has none to fall back on. */
+void builtin_monster_descriptions(dungeon_t *d)
+{
+}
+
+void builtin_object_descriptions(dungeon_t *d)
+{
+}
+
+/* c as it goes between quote marks q */
+static void put_char(char c, char q)
+{
+  switch (c) {
+  case '\n':
+    fputs("\\n", stdout);
+    break;
+  case '\\':
+  case '"':
+  case '\'':
+    printf(c == '\\' || c == q ? "\\%c" : "%c", c);
+    break;
+  default:
+    if (c >= ' ' && c <= '~') {
+      putchar(c);
+    } else {
+      /* Always three digits, so a digit after it can't join in */
+      printf("\\%03o", (uint8_t) c);
+    }
+  }
+}
+
+/* A string literal, broken after each newline to keep the lines short */
+static void put_string(std::string_view s, const char *indent)
+{
+  uint32_t i;
+
+  putchar('"');
+  for (i = 0; i < s.length(); i++) {
+    put_char(s[i], '"');
+    if (s[i] == '\n' && i + 1 < s.length()) {
+      printf("\"\n%s\"", indent);
+    }
+  }
+  putchar('"');
+}
+
+static void put_dice(const dice &d)
+{
+  printf("{ %d, %u, %u }", d.get_base(), d.get_number(), d.get_sides());
+}
+
+static void put_spawn(uint32_t rarity, uint32_t min_depth, uint32_t max_depth)
+{
+  printf("    %u, %u, ", rarity, min_depth);
+  if (max_depth == MAX_DEPTH) {
+    printf("MAX_DEPTH }");
+  } else {
+    printf("%u }", max_depth);
+  }
+}
+
+static void put_monsters(std::vector<monster_description> &m)
+{
+  uint32_t i, j, num_colors;
+
+  printf("static constexpr uint32_t builtin_monster_colors[] = {\n");
+  for (i = 0; i < m.size(); i++) {
+    printf("  ");
+    for (j = 0; j < m[i].get_color().size(); j++) {
+      printf("%u,%s", m[i].get_color()[j],
+             j + 1 < m[i].get_color().size() ? " " : "\n");
+    }
+  }
+  printf("};\n\n");
+
+  printf("static constexpr builtin_monster_t builtin_monsters[] = {\n");
+  for (num_colors = i = 0; i < m.size(); i++) {
+    printf("  { ");
+    put_string(m[i].get_name(), "    ");
+    printf(",\n    ");
+    put_string(m[i].get_description(), "    ");
+    printf(",\n    '");
+    put_char(m[i].get_symbol(), '\'');
+    printf("', %u, %lu, 0x%08x,\n    ", num_colors, m[i].get_color().size(),
+           m[i].get_abilities());
+    num_colors += m[i].get_color().size();
+    put_dice(m[i].get_speed());
+    printf(", ");
+    put_dice(m[i].get_hitpoints());
+    printf(", ");
+    put_dice(m[i].get_damage());
+    printf(",\n");
+    put_spawn(m[i].get_rarity(), m[i].get_min_depth(),
+              m[i].get_max_depth());
+    printf("%s\n", i + 1 < m.size() ? "," : "");
+  }
+  printf("};\n\n");
+}
+
+static void put_objects(std::vector<object_description> &o)
+{
+  uint32_t i;
+
+  printf("static constexpr builtin_object_t builtin_objects[] = {\n");
+  for (i = 0; i < o.size(); i++) {
+    printf("  { ");
+    put_string(o[i].get_name(), "    ");
+    printf(",\n    ");
+    put_string(o[i].get_description(), "    ");
+    printf(",\n    %u, %u,\n    ", o[i].get_type(), o[i].get_color());
+    put_dice(o[i].get_hit());
+    printf(", ");
+    put_dice(o[i].get_damage());
+    printf(", ");
+    put_dice(o[i].get_dodge());
+    printf(", ");
+    put_dice(o[i].get_defence());
+    printf(",\n    ");
+    put_dice(o[i].get_weight());
+    printf(", ");
+    put_dice(o[i].get_speed());
+    printf(", ");
+    put_dice(o[i].get_attribute());
+    printf(", ");
+    put_dice(o[i].get_value());
+    printf(",\n");
+    put_spawn(o[i].get_rarity(), o[i].get_min_depth(),
+              o[i].get_max_depth());
+    printf("%s\n", i + 1 < o.size() ? "," : "");
+  }
+  printf("};\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+  static dungeon_t d;
+
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <monster file> <object file>\n", argv[0]);
+    return 1;
+  }
+
+  /* The build fails rather than ship a game with nothing to spawn */
+  if (parse_description_files(&d, argv[1], argv[2], std::cerr, NULL) ||
+      d.monster_descriptions.empty() || d.object_descriptions.empty()) {
+    fprintf(stderr, "%s: No descriptions from %s and %s.\n",
+            argv[0], argv[1], argv[2]);
+    return 1;
+  }
+
+  printf("/* Generated by mkbuiltin; edit %s and %s, not this. */\n\n",
+         argv[1], argv[2]);
+  printf("#ifndef BUILTIN_TABLES_H\n# define BUILTIN_TABLES_H\n\n");
+  printf("# include \"builtin.h\"\n# include \"descriptions.h\"\n\n");
+  printf("# define BUILTIN_MONSTER_HASH 0x%016" PRIx64 "ULL\n",
+         journal_hash_file(argv[1]));
+  printf("# define BUILTIN_OBJECT_HASH  0x%016" PRIx64 "ULL\n\n",
+         journal_hash_file(argv[2]));
+  put_monsters(d.monster_descriptions);
+  put_objects(d.object_descriptions);
+  printf("#endif\n");
+
+  destroy_descriptions(&d);
+
+  return 0;
+}
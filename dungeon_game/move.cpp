@@ -13,46 +13,52 @@
 #include "utils.h"
 #include "path.h"
 #include "io.h"
+#include "decide.h"
 
-void do_combat(dungeon_t *d, character *atk, character *def)
+void do_combat(dungeon_t *d, character_id_t atk, character_id_t def)
 {
+  character_table &t = d->characters;
   uint32_t damage, i;
   
-  if (atk != d->the_pc) {
-    damage = atk->damage->roll();
-    io_queue_message("The %s hits you for %d.", atk->name, damage);
+  if (atk != PC_ID) {
+    damage = character_get_attack(d, atk);
+    io_queue_message("The %s hits you for %d.",
+                     character_get_name(d, atk), damage);
   } else {
     for (i = damage = 0; i < num_eq_slots; i++) {
       if (i == eq_slot_weapon && !d->the_pc->eq[i]) {
-        damage += atk->damage->roll();
+        damage += character_get_attack(d, atk);
       } else if (d->the_pc->eq[i]) {
         damage += d->the_pc->eq[i]->roll_dice();
       }
     }
-    io_queue_message("You hit the %s for %d.", def->name, damage);
+    io_queue_message("You hit the %s for %d.",
+                     character_get_name(d, def), damage);
   }
 
-  if (damage >= def->hp) {
-    if (atk != d->the_pc) {
+  if (damage >= t.hp[def]) {
+    if (atk != PC_ID) {
+      d->pc_killed_by = character_get_name(d, atk);
       io_queue_message("You die.");
       io_queue_message(""); /* Extra message to force pause on "more" prompt */
     } else {
-      io_queue_message("The %s dies.", def->name);
+      io_queue_message("The %s dies.", character_get_name(d, def));
     }
-    def->hp = 0;
-    def->alive = 0;
-    if (def != d->the_pc) {
+    t.hp[def] = 0;
+    t.alive[def] = 0;
+    if (def != PC_ID) {
       d->num_monsters--;
       d->nummon_beaten++;
     }
-    charpair(def->position) = NULL;
+    charpair(t.position[def]) = NO_CHARACTER;
   } else {
-    def->hp -= damage;
+    t.hp[def] -= damage;
   }
 }
 
-void move_character(dungeon_t *d, character *c, pair_t next)
+void move_character(dungeon_t *d, character_id_t c, pair_t next)
 {
+  int8_t *position = d->characters.position[c];
   pair_t displacement;
   uint32_t found_cell;
   pair_t order[9] = {
@@ -69,10 +75,10 @@ void move_character(dungeon_t *d, character *c, pair_t next)
   uint32_t s, i;
 
   if (charpair(next) &&
-      ((next[dim_y] != c->position[dim_y]) ||
-       (next[dim_x] != c->position[dim_x]))) {
-    if ((charpair(next) == d->the_pc) ||
-        c == d->the_pc) {
+      ((next[dim_y] != position[dim_y]) ||
+       (next[dim_x] != position[dim_x]))) {
+    if ((charpair(next) == PC_ID) ||
+        c == PC_ID) {
       do_combat(d, c, charpair(next));
     } else {
       /* Easiest way for a monster to displace another monster is *
@@ -86,12 +92,14 @@ void move_character(dungeon_t *d, character *c, pair_t next)
        * instead select a random square from the 8 surrounding    *
        * the target cell.  Keep doing it until either we swap or  *
        * find an empty one for the displacement.                  */
-      for (s = rand() % 9, found_cell = i = 0;
+      for (s = rng_rand() % 9, found_cell = i = 0;
            i < 9 && !found_cell; i++) {
         displacement[dim_y] = next[dim_y] + order[s % 9][dim_y];
         displacement[dim_x] = next[dim_x] + order[s % 9][dim_x];
-        if (((npc *) charpair(next))->characteristics & NPC_PASS_WALL) {
-          if (!charpair(displacement) ||
+        if (d->characters.characteristics[charpair(next)] & NPC_PASS_WALL) {
+          /* Anywhere a wall passer could have walked to itself */
+          if ((!charpair(displacement) &&
+               (mappair(displacement) != ter_wall_immutable)) ||
               (charpair(displacement) == c)) {
             found_cell = 1;
           }
@@ -110,97 +118,171 @@ void move_character(dungeon_t *d, character *c, pair_t next)
 
       assert(charpair(next));
 
-      charpair(c->position) = NULL;
+      charpair(position) = NO_CHARACTER;
       charpair(displacement) = charpair(next);
       charpair(next) = c;
-      charpair(displacement)->position[dim_y] = displacement[dim_y];
-      charpair(displacement)->position[dim_x] = displacement[dim_x];
-      c->position[dim_y] = next[dim_y];
-      c->position[dim_x] = next[dim_x];
+      character_set_y(d, charpair(displacement), displacement[dim_y]);
+      character_set_x(d, charpair(displacement), displacement[dim_x]);
+      position[dim_y] = next[dim_y];
+      position[dim_x] = next[dim_x];
     }
   } else {
     /* No character in new position. */
 
-    d->charmap[c->position[dim_y]][c->position[dim_x]] = NULL;
-    c->position[dim_y] = next[dim_y];
-    c->position[dim_x] = next[dim_x];
-    d->charmap[c->position[dim_y]][c->position[dim_x]] = c;
+    d->charmap[position[dim_y]][position[dim_x]] = NO_CHARACTER;
+    position[dim_y] = next[dim_y];
+    position[dim_x] = next[dim_x];
+    d->charmap[position[dim_y]][position[dim_x]] = c;
   }
 
-  if (c == d->the_pc) {
-    pc_reset_visibility(c);
-    pc_observe_terrain(c, d);
+  if (c == PC_ID) {
+    pc_reset_visibility(d->the_pc);
+    pc_observe_terrain(d->the_pc, d);
   }
 }
 
-void do_moves(dungeon_t *d)
+/* A dead NPC, off the heap: nothing refers to it, so the ID is free */
+static void npc_retire(dungeon_t *d, character_id_t c)
+{
+  character_table &t = d->characters;
+
+  if (charpair(t.position[c]) == c) {
+    charpair(t.position[c]) = NO_CHARACTER;
+  }
+  t.remove(c);
+}
+
+/* do_npc_moves() in two phases; see decide.h.  Everyone due at the      *
+ * time at the head of the queue is popped, and decides; then they move  *
+ * in the order the serial loop would have popped them.  None of them    *
+ * comes back before the rest have gone, because 1000 / speed is at      *
+ * least one, and the PC, sequence number zero, can't be in the middle.  */
+static void do_npc_moves_decided(dungeon_t *d)
+{
+  std::vector<npc_decision_t> &batch = d->decisions;
+  character_table &t = d->characters;
+  pair_t next;
+  character_id_t c;
+  uint32_t i, tick;
+
+  while (pc_is_alive(d) &&
+         ((c = d->next_turn.remove_min()) != PC_ID)) {
+    batch.resize(1);
+    batch[0].c = c;
+    tick = t.next_turn[c];
+    while ((c = d->next_turn.peek()) && c != PC_ID &&
+           t.next_turn[c] == tick) {
+      batch.emplace_back();
+      batch.back().c = d->next_turn.remove_min();
+    }
+
+    decide_npcs(d, batch.data(), batch.size());
+
+    for (i = 0; i < batch.size(); i++) {
+      c = batch[i].c;
+      if (!pc_is_alive(d)) {
+        /* The rest never got their turns */
+        for (; i < batch.size(); i++) {
+          decide_drop(d, &batch[i]);
+          d->next_turn.insert(t, batch[i].c);
+        }
+        break;
+      }
+
+      if (!t.alive[c]) {
+        npc_retire(d, c);
+        continue;
+      }
+
+      t.next_turn[c] += 1000 / t.speed[c];
+
+      if (!decide_take(d, &batch[i], next)) {
+        npc_next_pos(d, c, next);
+      }
+      move_character(d, c, next);
+
+      d->next_turn.insert(t, c);
+    }
+  }
+}
+
+/* Runs NPC turns until it is the PC's turn again, or the PC is dead.  *
+ * On return with the PC alive, the PC has been taken off the heap and *
+ * it is up to the caller to move it.                                  */
+void do_npc_moves(dungeon_t *d)
 {
+  character_table &t = d->characters;
   pair_t next;
-  character *c;
+  character_id_t c;
 
   /* Remove the PC when it is PC turn.  Replace on next call.  This allows *
    * use to completely uninit the heap when generating a new level without *
-   * worrying about deleting the PC.                                       */
+   * worrying about the PC.                                                */
 
   if (pc_is_alive(d)) {
-    heap_insert(&d->next_turn, d->the_pc);
+    d->next_turn.insert(t, PC_ID);
   }
 
-  while (pc_is_alive(d) && ((c = ((character *)
-                                  heap_remove_min(&d->next_turn))) != d->the_pc)) {
-    if (!character_is_alive(c)) {
-      if (d->charmap[character_get_y(c)][character_get_x(c)] == c) {
-        d->charmap[character_get_y(c)][character_get_x(c)] = NULL;
-      }
-      if (c != d->the_pc) {
-        character_delete(c);
-      }
+  if (decide_running()) {
+    do_npc_moves_decided(d);
+    return;
+  }
+
+  while (pc_is_alive(d) &&
+         ((c = d->next_turn.remove_min()) != PC_ID)) {
+    if (!t.alive[c]) {
+      npc_retire(d, c);
       continue;
     }
 
-    character_next_turn(c);
+    t.next_turn[c] += 1000 / t.speed[c];
 
     npc_next_pos(d, c, next);
     move_character(d, c, next);
 
-    heap_insert(&d->next_turn, c);
+    d->next_turn.insert(t, c);
   }
+}
+
+void do_moves(dungeon_t *d)
+{
+  do_npc_moves(d);
 
   //io_display(d);
   io_display_all(d);
   
-  if (pc_is_alive(d) && c == d->the_pc) {
-    character_next_turn(c);
+  if (pc_is_alive(d)) {
+    character_next_turn(d, PC_ID);
     io_handle_input(d);
   }
 }
 
-void dir_nearest_wall(dungeon_t *d, character *c, pair_t dir)
+void dir_nearest_wall(dungeon_t *d, character_id_t c, pair_t dir)
 {
   dir[dim_x] = dir[dim_y] = 0;
 
-  if (character_get_x(c) != 1 && character_get_x(c) != DUNGEON_X - 2) {
-    dir[dim_x] = (character_get_x(c) > DUNGEON_X - character_get_x(c) ? 1 : -1);
+  if (character_get_x(d, c) != 1 && character_get_x(d, c) != DUNGEON_X - 2) {
+    dir[dim_x] = (character_get_x(d, c) > DUNGEON_X - character_get_x(d, c) ? 1 : -1);
   }
-  if (character_get_y(c) != 1 && character_get_y(c) != DUNGEON_Y - 2) {
-    dir[dim_y] = (character_get_y(c) > DUNGEON_Y - character_get_y(c) ? 1 : -1);
+  if (character_get_y(d, c) != 1 && character_get_y(d, c) != DUNGEON_Y - 2) {
+    dir[dim_y] = (character_get_y(d, c) > DUNGEON_Y - character_get_y(d, c) ? 1 : -1);
   }
 }
 
-uint32_t in_corner(dungeon_t *d, character *c)
+uint32_t in_corner(dungeon_t *d, character_id_t c)
 {
   uint32_t num_immutable;
 
   num_immutable = 0;
 
-  num_immutable += (mapxy(character_get_x(c) - 1,
-                          character_get_y(c)    ) == ter_wall_immutable);
-  num_immutable += (mapxy(character_get_x(c) + 1,
-                          character_get_y(c)    ) == ter_wall_immutable);
-  num_immutable += (mapxy(character_get_x(c)    ,
-                          character_get_y(c) - 1) == ter_wall_immutable);
-  num_immutable += (mapxy(character_get_x(c)    ,
-                          character_get_y(c) + 1) == ter_wall_immutable);
+  num_immutable += (mapxy(character_get_x(d, c) - 1,
+                          character_get_y(d, c)    ) == ter_wall_immutable);
+  num_immutable += (mapxy(character_get_x(d, c) + 1,
+                          character_get_y(d, c)    ) == ter_wall_immutable);
+  num_immutable += (mapxy(character_get_x(d, c)    ,
+                          character_get_y(d, c) - 1) == ter_wall_immutable);
+  num_immutable += (mapxy(character_get_x(d, c)    ,
+                          character_get_y(d, c) + 1) == ter_wall_immutable);
 
   return num_immutable > 1;
 }
@@ -212,12 +294,23 @@ static void new_dungeon_level(dungeon_t *d, uint32_t dir)
 
   switch (dir) {
   case '<':
+    if (d->depth) {
+      d->depth--;
+    }
+    new_dungeon(d);
+    break;
   case '>':
+    d->depth++;
     new_dungeon(d);
     break;
   default:
     break;
   }
+
+  if (d->checkpoints) {
+    /* Somewhere to come back to if the level goes badly */
+    io_checkpoint(d);
+  }
 }
 
 uint32_t move_pc(dungeon_t *d, uint32_t dir)
@@ -226,8 +319,8 @@ uint32_t move_pc(dungeon_t *d, uint32_t dir)
   uint32_t was_stairs = 0;
   uint32_t was_hospital = 0;
   
-  next[dim_y] = character_get_y(d->the_pc);
-  next[dim_x] = character_get_x(d->the_pc);
+  next[dim_y] = character_get_y(d, PC_ID);
+  next[dim_x] = character_get_x(d, PC_ID);
 
   switch (dir) {
   case 1:
@@ -261,23 +354,23 @@ uint32_t move_pc(dungeon_t *d, uint32_t dir)
     next[dim_x]++;
     break;
   case '<':
-    if (mappair(character_get_pos(d->the_pc)) == ter_stairs_up) {
+    if (mappair(character_get_pos(d, PC_ID)) == ter_stairs_up) {
       was_stairs = 1;
       new_dungeon_level(d, '<');
     }
     break;
   case '>':
-    if (mappair(character_get_pos(d->the_pc)) == ter_stairs_down) {
+    if (mappair(character_get_pos(d, PC_ID)) == ter_stairs_down) {
       was_stairs = 1;
       new_dungeon_level(d, '>');
     }
     break;
   case '+':
-    if (mappair(character_get_pos(d->the_pc)) == ter_hospital){
+    if (mappair(character_get_pos(d, PC_ID)) == ter_hospital){
       was_hospital = 1;
-      d->the_pc->hp +=50;
-      if(d->the_pc->hp>1000){
-	d->the_pc->hp =1000;
+      d->characters.hp[PC_ID] +=50;
+      if(d->characters.hp[PC_ID]>1000){
+	d->characters.hp[PC_ID] =1000;
       }
     }
   }
@@ -291,7 +384,7 @@ uint32_t move_pc(dungeon_t *d, uint32_t dir)
   }
 
   if ((dir != '>') && (dir != '<') && (mappair(next) >= ter_floor)) {
-    move_character(d, d->the_pc, next);
+    move_character(d, PC_ID, next);
     dijkstra(d);
     dijkstra_tunnel(d);
     d->the_pc->pick_up(d);
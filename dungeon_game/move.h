@@ -9,13 +9,14 @@
 typedef struct dungeon dungeon_t;
 
 void next_move(dungeon_t *d,
-               character *c,
+               character_id_t c,
                pair_t goal_pos,
                pair_t next_pos);
+void do_npc_moves(dungeon_t *d);
 void do_moves(dungeon_t *d);
-void dir_nearest_wall(dungeon_t *d, character *c, pair_t dir);
-uint32_t in_corner(dungeon_t *d, character *c);
+void dir_nearest_wall(dungeon_t *d, character_id_t c, pair_t dir);
+uint32_t in_corner(dungeon_t *d, character_id_t c);
 uint32_t move_pc(dungeon_t *d, uint32_t dir);
-void move_character(dungeon_t *d, character *c, pair_t next);
+void move_character(dungeon_t *d, character_id_t c, pair_t next);
 
 #endif
@@ -1,4 +1,7 @@
 #include <stdlib.h>
+#include <array>
+#include <type_traits>
+#include <utility>
 
 #include "utils.h"
 #include "npc.h"
@@ -13,58 +16,151 @@ void gen_monsters(dungeon_t *d, uint32_t nummon, uint32_t game_turn)
 {
   uint32_t i;
 
-  d->num_monsters = nummon;
-  for (i = 0; i < nummon; i++) {
-    monster_description::generate_monster(d);
+  /* However many fit */
+  for (d->num_monsters = i = 0; i < nummon; i++, d->num_monsters++) {
+    if (monster_description::generate_monster(d) == NO_CHARACTER) {
+      break;
+    }
   }
 }
 
-void npc_next_pos_rand_tunnel(dungeon_t *d, character *c, pair_t next)
-{
-  pair_t n;
-  union {
-    uint32_t i;
-    uint8_t a[4];
-  } r;
-
-  do {
-    n[dim_y] = next[dim_y];
-    n[dim_x] = next[dim_x];
-    r.i = rand();
-    if (r.a[0] > 85 /* 255 / 3 */) {
-      if (r.a[0] & 1) {
-        n[dim_y]--;
-      } else {
-        n[dim_y]++;
-      }
-    }
-    if (r.a[1] > 85 /* 255 / 3 */) {
-      if (r.a[1] & 1) {
-        n[dim_x]--;
-      } else {
-        n[dim_x]++;
-      }
+/* NPC movement is composed from policies, and a mover is instantiated *
+ * for each combination of the ability bits, so every one of them is   *
+ * straight-line code with nothing left to test at run time.  The      *
+ * policy members are forced inline so that even the unoptimized build *
+ * makes one function of each mover, as the hand-written ones were.    */
+#define npc_inline inline __attribute__ ((always_inline))
+
+/* Terrain policies: how a mover gets through the dungeon.  reachable() *
+ * is where it may try to go, and enter() is what trying does.  Walkers *
+ * keep to the floor.  Tunnelers bore through rock, a bit at a time.    *
+ * Wall passers go through rock as though it weren't there.             */
+struct npc_walk {
+  static npc_inline bool reachable(dungeon_t *d, pair_t n)
+  {
+    return mappair(n) >= ter_floor;
+  }
+  static npc_inline void enter(dungeon_t *d, pair_t n, pair_t next)
+  {
+    next[dim_x] = n[dim_x];
+    next[dim_y] = n[dim_y];
+  }
+  /* Straight for the PC; failing that, along one axis or the other */
+  static npc_inline void toward(dungeon_t *d, pair_t dir, pair_t next)
+  {
+    if (mapxy(next[dim_x] + dir[dim_x],
+              next[dim_y] + dir[dim_y]) >= ter_floor) {
+      next[dim_x] += dir[dim_x];
+      next[dim_y] += dir[dim_y];
+    } else if (mapxy(next[dim_x] + dir[dim_x], next[dim_y]) >= ter_floor) {
+      next[dim_x] += dir[dim_x];
+    } else if (mapxy(next[dim_x], next[dim_y] + dir[dim_y]) >= ter_floor) {
+      next[dim_y] += dir[dim_y];
     }
-  } while (mappair(n) == ter_wall_immutable);
+  }
+  static npc_inline void follow(dungeon_t *d, pair_t next)
+  {
+    const int8_t *step = downhill_step[d->pc_downhill[next[dim_y]]
+                                                     [next[dim_x]]];
 
-  if (hardnesspair(n) <= 60) {
-    if (hardnesspair(n)) {
-      hardnesspair(n) = 0;
-      mappair(n) = ter_floor_hall;
+    next[dim_y] += step[dim_y];
+    next[dim_x] += step[dim_x];
+  }
+  /* The way to a PC in plain view */
+  typedef npc_walk sighted;
+};
+
+struct npc_tunnel {
+  static npc_inline bool reachable(dungeon_t *d, pair_t n)
+  {
+    return mappair(n) != ter_wall_immutable;
+  }
+  static npc_inline void enter(dungeon_t *d, pair_t n, pair_t next)
+  {
+    if (hardnesspair(n) <= 60) {
+      if (hardnesspair(n)) {
+        hardnesspair(n) = 0;
+        mappair(n) = ter_floor_hall;
+        d->digs++;
 
-      /* Update distance maps because map has changed. */
-      dijkstra(d);
-      dijkstra_tunnel(d);
+        /* Update distance maps because map has changed. */
+        dijkstra(d);
+        dijkstra_tunnel(d);
+      }
+
+      next[dim_x] = n[dim_x];
+      next[dim_y] = n[dim_y];
+    } else {
+      hardnesspair(n) -= 60;
+      downhill_tunnel_around(d->pc_tunnel, d->hardness,
+                             d->pc_tunnel_downhill, n[dim_x], n[dim_y]);
     }
+  }
+  static npc_inline void toward(dungeon_t *d, pair_t dir, pair_t next)
+  {
+    pair_t n;
+
+    n[dim_x] = next[dim_x] + dir[dim_x];
+    n[dim_y] = next[dim_y] + dir[dim_y];
+    /* Always true: the PC is inside the immutable border */
+    if (reachable(d, n)) {
+      enter(d, n, next);
+    }
+  }
+  static npc_inline void follow(dungeon_t *d, pair_t next)
+  {
+    const int8_t *step = downhill_step[d->pc_tunnel_downhill[next[dim_y]]
+                                                            [next[dim_x]]];
+    pair_t min_next;
+
+    min_next[dim_y] = next[dim_y] + step[dim_y];
+    min_next[dim_x] = next[dim_x] + step[dim_x];
+    enter(d, min_next, next);
+  }
+  /* A PC in view is usually across open floor */
+  typedef npc_walk sighted;
+};
 
+struct npc_pass {
+  static npc_inline bool reachable(dungeon_t *d, pair_t n)
+  {
+    return mappair(n) != ter_wall_immutable;
+  }
+  static npc_inline void enter(dungeon_t *d, pair_t n, pair_t next)
+  {
     next[dim_x] = n[dim_x];
     next[dim_y] = n[dim_y];
-  } else {
-    hardnesspair(n) -= 60;
   }
-}
+  static npc_inline void toward(dungeon_t *d, pair_t dir, pair_t next)
+  {
+    pair_t n;
+
+    n[dim_x] = next[dim_x] + dir[dim_x];
+    n[dim_y] = next[dim_y] + dir[dim_y];
+    if (reachable(d, n)) {
+      enter(d, n, next);
+    }
+  }
+  /* Nothing stands in the way, so the straight line is the shortest */
+  static npc_inline void follow(dungeon_t *d, pair_t next)
+  {
+    pass_step(d->characters.position[PC_ID], next);
+  }
+  typedef npc_pass sighted;
+};
 
-void npc_next_pos_rand(dungeon_t *d, character *c, pair_t next)
+/* Passing walls makes tunneling pointless, so it wins */
+template <npc_characteristics_t abilities>
+struct npc_terrain {
+  typedef typename std::conditional<
+    abilities & NPC_PASS_WALL, npc_pass,
+    typename std::conditional<abilities & NPC_TUNNEL,
+                              npc_tunnel, npc_walk>::type>::type type;
+};
+
+/* A random step, to anywhere the terrain allows */
+template <class terrain>
+static npc_inline void npc_wander(dungeon_t *d, pair_t next)
 {
   pair_t n;
   union {
@@ -75,7 +171,7 @@ void npc_next_pos_rand(dungeon_t *d, character *c, pair_t next)
   do {
     n[dim_y] = next[dim_y];
     n[dim_x] = next[dim_x];
-    r.i = rand();
+    r.i = rng_rand();
     if (r.a[0] > 85 /* 255 / 3 */) {
       if (r.a[0] & 1) {
         n[dim_y]--;
@@ -90,23 +186,21 @@ void npc_next_pos_rand(dungeon_t *d, character *c, pair_t next)
         n[dim_x]++;
       }
     }
-  } while (mappair(n) < ter_floor);
+  } while (!terrain::reachable(d, n));
 
-  next[dim_y] = n[dim_y];
-  next[dim_x] = n[dim_x];
+  terrain::enter(d, n, next);
 }
 
-void npc_next_pos_line_of_sight(dungeon_t *d, character *c, pair_t next)
+/* A step in the PC's direction, wherever it is now */
+template <class terrain>
+static npc_inline void npc_toward_pc(dungeon_t *d, character_id_t c,
+                                     pair_t next)
 {
+  character_table &t = d->characters;
   pair_t dir;
-  pc *the_pc;
-  npc *the_npc;
-
-  the_pc = (pc *) d->the_pc;
-  the_npc = (npc *) c;
 
-  dir[dim_y] = the_pc->position[dim_y] - the_npc->position[dim_y];
-  dir[dim_x] = the_pc->position[dim_x] - the_npc->position[dim_x];
+  dir[dim_y] = t.position[PC_ID][dim_y] - t.position[c][dim_y];
+  dir[dim_x] = t.position[PC_ID][dim_x] - t.position[c][dim_x];
   if (dir[dim_y]) {
     dir[dim_y] /= abs(dir[dim_y]);
   }
@@ -114,455 +208,236 @@ void npc_next_pos_line_of_sight(dungeon_t *d, character *c, pair_t next)
     dir[dim_x] /= abs(dir[dim_x]);
   }
 
-  if (mapxy(next[dim_x] + dir[dim_x],
-            next[dim_y] + dir[dim_y]) >= ter_floor) {
-    next[dim_x] += dir[dim_x];
-    next[dim_y] += dir[dim_y];
-  } else if (mapxy(next[dim_x] + dir[dim_x], next[dim_y]) >= ter_floor) {
-    next[dim_x] += dir[dim_x];
-  } else if (mapxy(next[dim_x], next[dim_y] + dir[dim_y]) >= ter_floor) {
-    next[dim_y] += dir[dim_y];
-  }
+  terrain::toward(d, dir, next);
 }
 
-void npc_next_pos_line_of_sight_tunnel(dungeon_t *d,
-                                       character *c,
-                                       pair_t next)
+static npc_inline void npc_remember_pc(dungeon_t *d, character_id_t c)
 {
-  pair_t dir;
-  pc *the_pc;
-  npc *the_npc;
+  character_table &t = d->characters;
 
-  the_pc = (pc *) d->the_pc;
-  the_npc = (npc *) c;
+  t.pc_last_known_position[c][dim_y] = t.position[PC_ID][dim_y];
+  t.pc_last_known_position[c][dim_x] = t.position[PC_ID][dim_x];
+}
 
-  dir[dim_y] = the_pc->position[dim_y] - the_npc->position[dim_y];
-  dir[dim_x] = the_pc->position[dim_x] - the_npc->position[dim_x];
-  if (dir[dim_y]) {
-    dir[dim_y] /= abs(dir[dim_y]);
-  }
-  if (dir[dim_x]) {
-    dir[dim_x] /= abs(dir[dim_x]);
-  }
+/* Knowledge policies.  Smart, telepathic NPCs always know where the PC *
+ * is and follow the distance maps to it.  Telepaths alone head         *
+ * straight for it.  Smart NPCs go after a PC they've seen until they   *
+ * reach where they saw it.  The rest chase what they can see, and      *
+ * wander otherwise.  Erratic NPCs do something random half the time.   *
+ *                                                                      *
+ * A mover that is only planning (see npc_plan_pos()) gives up, before  *
+ * it has changed anything, wherever it would draw from the RNG or dig. */
+template <npc_characteristics_t abilities, bool planning>
+static uint32_t npc_mover(dungeon_t *d, character_id_t c, pair_t next)
+{
+  typedef typename npc_terrain<abilities>::type terrain;
+  character_table &t = d->characters;
 
-  dir[dim_x] += next[dim_x];
-  dir[dim_y] += next[dim_y];
+  if (planning && ((abilities & NPC_ERRATIC) ||
+                   std::is_same<terrain, npc_tunnel>::value)) {
+    return 0;
+  }
 
-  if (hardnesspair(dir) <= 60) {
-    if (hardnesspair(dir)) {
-      hardnesspair(dir) = 0;
-      mappair(dir) = ter_floor_hall;
+  if ((abilities & NPC_ERRATIC) && (rng_rand() & 1)) {
+    npc_wander<terrain>(d, next);
+    return 1;
+  }
 
-      /* Update distance maps because map has changed. */
-      dijkstra(d);
-      dijkstra_tunnel(d);
-    }
+  if ((abilities & NPC_SMART) && (abilities & NPC_TELEPATH)) {
+    terrain::follow(d, next);
+    return 1;
+  }
 
-    next[dim_x] = dir[dim_x];
-    next[dim_y] = dir[dim_y];
-  } else {
-    hardnesspair(dir) -= 60;
+  if (abilities & NPC_TELEPATH) {
+    npc_remember_pc(d, c);
+    npc_toward_pc<terrain>(d, c, next);
+    return 1;
   }
-}
 
-void npc_next_pos_gradient(dungeon_t *d, character *c, pair_t next)
-{
-  npc *the_npc;
-
-  the_npc = (npc *) c;
-
-  /* Handles both tunneling and non-tunneling versions */
-  pair_t min_next;
-  uint16_t min_cost;
-  if (the_npc->characteristics & NPC_TUNNEL) {
-    min_cost = (d->pc_tunnel[next[dim_y] - 1][next[dim_x]] +
-                (d->hardness[next[dim_y] - 1][next[dim_x]] / 60));
-    min_next[dim_x] = next[dim_x];
-    min_next[dim_y] = next[dim_y] - 1;
-    if ((d->pc_tunnel[next[dim_y] + 1][next[dim_x]    ] +
-         (d->hardness[next[dim_y] + 1][next[dim_x]] / 60)) < min_cost) {
-      min_cost = (d->pc_tunnel[next[dim_y] + 1][next[dim_x]] +
-                  (d->hardness[next[dim_y] + 1][next[dim_x]] / 60));
-      min_next[dim_x] = next[dim_x];
-      min_next[dim_y] = next[dim_y] + 1;
-    }
-    if ((d->pc_tunnel[next[dim_y]    ][next[dim_x] + 1] +
-         (d->hardness[next[dim_y]    ][next[dim_x] + 1] / 60)) < min_cost) {
-      min_cost = (d->pc_tunnel[next[dim_y]][next[dim_x] + 1] +
-                  (d->hardness[next[dim_y]][next[dim_x] + 1] / 60));
-      min_next[dim_x] = next[dim_x] + 1;
-      min_next[dim_y] = next[dim_y];
-    }
-    if ((d->pc_tunnel[next[dim_y]    ][next[dim_x] - 1] +
-         (d->hardness[next[dim_y]    ][next[dim_x] - 1] / 60)) < min_cost) {
-      min_cost = (d->pc_tunnel[next[dim_y]][next[dim_x] - 1] +
-                  (d->hardness[next[dim_y]][next[dim_x] - 1] / 60));
-      min_next[dim_x] = next[dim_x] - 1;
-      min_next[dim_y] = next[dim_y];
-    }
-    if ((d->pc_tunnel[next[dim_y] - 1][next[dim_x] + 1] +
-         (d->hardness[next[dim_y] - 1][next[dim_x] + 1] / 60)) < min_cost) {
-      min_cost = (d->pc_tunnel[next[dim_y] - 1][next[dim_x] + 1] +
-                  (d->hardness[next[dim_y] - 1][next[dim_x] + 1] / 60));
-      min_next[dim_x] = next[dim_x] + 1;
-      min_next[dim_y] = next[dim_y] - 1;
+  if (can_see(d, t.position[c], t.position[PC_ID], 0)) {
+    npc_remember_pc(d, c);
+    if (abilities & NPC_SMART) {
+      t.have_seen_pc[c] = 1;
     }
-    if ((d->pc_tunnel[next[dim_y] + 1][next[dim_x] + 1] +
-         (d->hardness[next[dim_y] + 1][next[dim_x] + 1] / 60)) < min_cost) {
-      min_cost = (d->pc_tunnel[next[dim_y] + 1][next[dim_x] + 1] +
-                  (d->hardness[next[dim_y] + 1][next[dim_x] + 1] / 60));
-      min_next[dim_x] = next[dim_x] + 1;
-      min_next[dim_y] = next[dim_y] + 1;
-    }
-    if ((d->pc_tunnel[next[dim_y] - 1][next[dim_x] - 1] +
-         (d->hardness[next[dim_y] - 1][next[dim_x] - 1] / 60)) < min_cost) {
-      min_cost = (d->pc_tunnel[next[dim_y] - 1][next[dim_x] - 1] +
-                  (d->hardness[next[dim_y] - 1][next[dim_x] - 1] / 60));
-      min_next[dim_x] = next[dim_x] - 1;
-      min_next[dim_y] = next[dim_y] - 1;
-    }
-    if ((d->pc_tunnel[next[dim_y] + 1][next[dim_x] - 1] +
-         (d->hardness[next[dim_y] + 1][next[dim_x] - 1] / 60)) < min_cost) {
-      min_cost = (d->pc_tunnel[next[dim_y] + 1][next[dim_x] - 1] +
-                  (d->hardness[next[dim_y] + 1][next[dim_x] - 1] / 60));
-      min_next[dim_x] = next[dim_x] - 1;
-      min_next[dim_y] = next[dim_y] + 1;
-    }
-    if (hardnesspair(min_next) <= 60) {
-      if (hardnesspair(min_next)) {
-        hardnesspair(min_next) = 0;
-        mappair(min_next) = ter_floor_hall;
-
-        /* Update distance maps because map has changed. */
-        dijkstra(d);
-        dijkstra_tunnel(d);
-      }
-
-      next[dim_x] = min_next[dim_x];
-      next[dim_y] = min_next[dim_y];
-    } else {
-      hardnesspair(min_next) -= 60;
+    npc_toward_pc<typename terrain::sighted>(d, c, next);
+  } else if (abilities & NPC_SMART) {
+    if (t.have_seen_pc[c]) {
+      npc_toward_pc<terrain>(d, c, next);
     }
   } else {
-    /* Make monsters prefer cardinal directions */
-    if (d->pc_distance[next[dim_y] - 1][next[dim_x]    ] <
-        d->pc_distance[next[dim_y]][next[dim_x]]) {
-      next[dim_y]--;
-      return;
-    }
-    if (d->pc_distance[next[dim_y] + 1][next[dim_x]    ] <
-        d->pc_distance[next[dim_y]][next[dim_x]]) {
-      next[dim_y]++;
-      return;
-    }
-    if (d->pc_distance[next[dim_y]    ][next[dim_x] + 1] <
-        d->pc_distance[next[dim_y]][next[dim_x]]) {
-      next[dim_x]++;
-      return;
-    }
-    if (d->pc_distance[next[dim_y]    ][next[dim_x] - 1] <
-        d->pc_distance[next[dim_y]][next[dim_x]]) {
-      next[dim_x]--;
-      return;
-    }
-    if (d->pc_distance[next[dim_y] - 1][next[dim_x] + 1] <
-        d->pc_distance[next[dim_y]][next[dim_x]]) {
-      next[dim_y]--;
-      next[dim_x]++;
-      return;
-    }
-    if (d->pc_distance[next[dim_y] + 1][next[dim_x] + 1] <
-        d->pc_distance[next[dim_y]][next[dim_x]]) {
-      next[dim_y]++;
-      next[dim_x]++;
-      return;
-    }
-    if (d->pc_distance[next[dim_y] - 1][next[dim_x] - 1] <
-        d->pc_distance[next[dim_y]][next[dim_x]]) {
-      next[dim_y]--;
-      next[dim_x]--;
-      return;
-    }
-    if (d->pc_distance[next[dim_y] + 1][next[dim_x] - 1] <
-        d->pc_distance[next[dim_y]][next[dim_x]]) {
-      next[dim_y]++;
-      next[dim_x]--;
-      return;
+    if (planning) {
+      return 0;
     }
+    npc_wander<terrain>(d, next);
   }
-}
-
-static void npc_next_pos_00(dungeon_t *d, character *c, pair_t next)
-{
-  pc *the_pc;
-  npc *the_npc;
-
-  the_pc = (pc *) d->the_pc;
-  the_npc = (npc *) c;
 
-  /* not smart; not telepathic; not tunneling; not erratic */
-  if (can_see(d, character_get_pos(c), character_get_pos(d->the_pc), 0)) {
-    the_npc->pc_last_known_position[dim_y] = the_pc->position[dim_y];
-    the_npc->pc_last_known_position[dim_x] = the_pc->position[dim_x];
-    npc_next_pos_line_of_sight(d, c, next);
-  } else {
-    npc_next_pos_rand(d, c, next);
+  if ((abilities & NPC_SMART) &&
+      (next[dim_x] == t.pc_last_known_position[c][dim_x]) &&
+      (next[dim_y] == t.pc_last_known_position[c][dim_y])) {
+    t.have_seen_pc[c] = 0;
   }
-}
 
-static void npc_next_pos_01(dungeon_t *d, character *c, pair_t next)
-{
-  pc *the_pc;
-  npc *the_npc;
-
-  the_pc = (pc *) d->the_pc;
-  the_npc = (npc *) c;
-
-  /*     smart; not telepathic; not tunneling; not erratic */
-  if (can_see(d, character_get_pos(c), character_get_pos(d->the_pc), 0)) {
-    the_npc->pc_last_known_position[dim_y] = the_pc->position[dim_y];
-    the_npc->pc_last_known_position[dim_x] = the_pc->position[dim_x];
-    the_npc->have_seen_pc = 1;
-    npc_next_pos_line_of_sight(d, c, next);
-  } else if (the_npc->have_seen_pc) {
-    npc_next_pos_line_of_sight(d, c, next);
-  }
-
-  if ((next[dim_x] == the_npc->pc_last_known_position[dim_x]) &&
-      (next[dim_y] == the_npc->pc_last_known_position[dim_y])) {
-    the_npc->have_seen_pc = 0;
-  }
+  return 1;
 }
 
-static void npc_next_pos_02(dungeon_t *d, character *c, pair_t next)
-{
-  pc *the_pc;
-  npc *the_npc;
-
-  the_pc = (pc *) d->the_pc;
-  the_npc = (npc *) c;
+typedef uint32_t (*npc_move_t)(dungeon_t *d, character_id_t c, pair_t next);
 
-  /* not smart;     telepathic; not tunneling; not erratic */
-  the_npc->pc_last_known_position[dim_y] = the_pc->position[dim_y];
-  the_npc->pc_last_known_position[dim_x] = the_pc->position[dim_x];
-  npc_next_pos_line_of_sight(d, c, next);
-}
+/* Every combination of the bits that affect movement */
+#define NPC_MOVERS (NPC_PASS_WALL << 1)
 
-static void npc_next_pos_03(dungeon_t *d, character *c, pair_t next)
+template <bool planning, npc_characteristics_t... abilities>
+static constexpr std::array<npc_move_t, sizeof... (abilities)>
+npc_movers(std::integer_sequence<npc_characteristics_t, abilities...>)
 {
-  /*     smart;     telepathic; not tunneling; not erratic */
-  npc_next_pos_gradient(d, c, next);
+  return { { npc_mover<abilities, planning>... } };
 }
 
-static void npc_next_pos_04(dungeon_t *d, character *c, pair_t next)
+/* Indexed by the low bits of the characteristics, as the hand-written *
+ * table was, but generated, so it can't be put in the wrong order.    */
+static constexpr std::array<npc_move_t, NPC_MOVERS> npc_move_func =
+  npc_movers<false>(std::make_integer_sequence<npc_characteristics_t,
+                                               NPC_MOVERS>());
+static constexpr std::array<npc_move_t, NPC_MOVERS> npc_plan_func =
+  npc_movers<true>(std::make_integer_sequence<npc_characteristics_t,
+                                              NPC_MOVERS>());
+
+void npc_next_pos(dungeon_t *d, character_id_t c, pair_t next)
 {
-  pc *the_pc;
-  npc *the_npc;
+  character_table &t = d->characters;
 
-  the_pc = (pc *) d->the_pc;
-  the_npc = (npc *) c;
+  next[dim_y] = t.position[c][dim_y];
+  next[dim_x] = t.position[c][dim_x];
 
-  /* not smart; not telepathic;     tunneling; not erratic */
-  if (can_see(d, character_get_pos(c), character_get_pos(d->the_pc), 0)) {
-    the_npc->pc_last_known_position[dim_y] = the_pc->position[dim_y];
-    the_npc->pc_last_known_position[dim_x] = the_pc->position[dim_x];
-    npc_next_pos_line_of_sight(d, c, next);
-  } else {
-    npc_next_pos_rand_tunnel(d, c, next);
-  }
+  npc_move_func[t.characteristics[c] & (NPC_MOVERS - 1)](d, c, next);
 }
 
-static void npc_next_pos_05(dungeon_t *d, character *c, pair_t next)
+uint32_t npc_plan_pos(dungeon_t *d, character_id_t c, pair_t next)
 {
-  pc *the_pc;
-  npc *the_npc;
-
-  the_pc = (pc *) d->the_pc;
-  the_npc = (npc *) c;
-
-  /*     smart; not telepathic;     tunneling; not erratic */
-  if (can_see(d, character_get_pos(c), character_get_pos(d->the_pc), 0)) {
-    the_npc->pc_last_known_position[dim_y] = the_pc->position[dim_y];
-    the_npc->pc_last_known_position[dim_x] = the_pc->position[dim_x];
-    the_npc->have_seen_pc = 1;
-    npc_next_pos_line_of_sight(d, c, next);
-  } else if (the_npc->have_seen_pc) {
-    npc_next_pos_line_of_sight_tunnel(d, c, next);
-  }
+  character_table &t = d->characters;
 
-  if ((next[dim_x] == the_npc->pc_last_known_position[dim_x]) &&
-      (next[dim_y] == the_npc->pc_last_known_position[dim_y])) {
-    the_npc->have_seen_pc = 0;
-  }
+  next[dim_y] = t.position[c][dim_y];
+  next[dim_x] = t.position[c][dim_x];
+
+  return npc_plan_func[t.characteristics[c] & (NPC_MOVERS - 1)](d, c, next);
 }
 
-static void npc_next_pos_06(dungeon_t *d, character *c, pair_t next)
+uint8_t npc_distance(dungeon_t *d, character_id_t c)
 {
-  pc *the_pc;
-  npc *the_npc;
+  character_table &t = d->characters;
 
-  the_pc = (pc *) d->the_pc;
-  the_npc = (npc *) c;
+  if (t.characteristics[c] & NPC_PASS_WALL) {
+    return pass_distance(t.position[c], t.position[PC_ID]);
+  }
 
-  /* not smart;     telepathic;     tunneling; not erratic */
-  the_npc->pc_last_known_position[dim_y] = the_pc->position[dim_y];
-  the_npc->pc_last_known_position[dim_x] = the_pc->position[dim_x];
-  npc_next_pos_line_of_sight_tunnel(d, c, next);
+  return d->pc_distance[t.position[c][dim_y]][t.position[c][dim_x]];
 }
 
-static void npc_next_pos_07(dungeon_t *d, character *c, pair_t next)
+uint32_t dungeon_has_npcs(dungeon_t *d)
 {
-  /*     smart;     telepathic;     tunneling; not erratic */
-  npc_next_pos_gradient(d, c, next);
+  return d->num_monsters;
 }
 
-static void npc_next_pos_08(dungeon_t *d, character *c, pair_t next)
+character_id_t new_npc(dungeon_t *d, const monster_description &m)
 {
-  /* not smart; not telepathic; not tunneling;     erratic */
-  if (rand() & 1) {
-    npc_next_pos_rand(d, c, next);
-  } else {
-    npc_next_pos_00(d, c, next);
-  }
-}
+  character_table &t = d->characters;
+  character_id_t c;
 
-static void npc_next_pos_09(dungeon_t *d, character *c, pair_t next)
-{
-  /*     smart; not telepathic; not tunneling;     erratic */
-  if (rand() & 1) {
-    npc_next_pos_rand(d, c, next);
-  } else {
-    npc_next_pos_01(d, c, next);
+  if ((c = t.add()) != NO_CHARACTER) {
+    t.archetype[c] = &m;
+    t.characteristics[c] = m.get_abilities();
   }
-}
 
-static void npc_next_pos_0a(dungeon_t *d, character *c, pair_t next)
-{
-  /* not smart;     telepathic; not tunneling;     erratic */
-  if (rand() & 1) {
-    npc_next_pos_rand(d, c, next);
-  } else {
-        npc_next_pos_02(d, c, next);
-  }
+  return c;
 }
 
-static void npc_next_pos_0b(dungeon_t *d, character *c, pair_t next)
+static uint32_t room_is_full(dungeon_t *d, uint32_t room)
 {
-  /*     smart;     telepathic; not tunneling;     erratic */
-  if (rand() & 1) {
-    npc_next_pos_rand(d, c, next);
-  } else {
-    npc_next_pos_03(d, c, next);
+  uint32_t x, y;
+
+  for (y = d->rooms[room].position[dim_y];
+       y < d->rooms[room].position[dim_y] + d->rooms[room].size[dim_y];
+       y++) {
+    for (x = d->rooms[room].position[dim_x];
+         x < d->rooms[room].position[dim_x] + d->rooms[room].size[dim_x];
+         x++) {
+      if (!charxy(x, y)) {
+        return 0;
+      }
+    }
   }
-}
 
-static void npc_next_pos_0c(dungeon_t *d, character *c, pair_t next)
-{
-  /* not smart; not telepathic;     tunneling;     erratic */
-  if (rand() & 1) {
-    npc_next_pos_rand_tunnel(d, c, next);
-  } else {
-    npc_next_pos_04(d, c, next);
-  }
+  return 1;
 }
 
-static void npc_next_pos_0d(dungeon_t *d, character *c, pair_t next)
+/* A random empty cell in a random room other than the PC's.  A full   *
+ * room passes on to the next, the PC's is the last of them, and only  *
+ * once every room is full do NPCs go into the corridors.  Returns     *
+ * non-zero if there's nowhere left at all.                            */
+static uint32_t npc_find_cell(dungeon_t *d, pair_t p)
 {
-  /*     smart; not telepathic;     tunneling;     erratic */
-  if (rand() & 1) {
-    npc_next_pos_rand_tunnel(d, c, next);
-  } else {
-    npc_next_pos_05(d, c, next);
+  uint32_t i, first, room, free_cells, x, y;
+
+  first = rand_range(1, d->num_rooms - 1);
+  for (i = 0; i < d->num_rooms; i++) {
+    room = ((i == d->num_rooms - 1) ? 0 :
+            (first - 1 + i) % (d->num_rooms - 1) + 1);
+    if (!room_is_full(d, room)) {
+      do {
+        p[dim_y] = rand_range(d->rooms[room].position[dim_y],
+                              (d->rooms[room].position[dim_y] +
+                               d->rooms[room].size[dim_y] - 1));
+        p[dim_x] = rand_range(d->rooms[room].position[dim_x],
+                              (d->rooms[room].position[dim_x] +
+                               d->rooms[room].size[dim_x] - 1));
+      } while (charpair(p));
+
+      return 0;
+    }
   }
-}
 
-static void npc_next_pos_0e(dungeon_t *d, character *c, pair_t next)
-{
-  /* not smart;     telepathic;     tunneling;     erratic */
-  if (rand() & 1) {
-    npc_next_pos_rand_tunnel(d, c, next);
-  } else {
-    npc_next_pos_06(d, c, next);
+  for (free_cells = 0, y = 1; y < DUNGEON_Y - 1; y++) {
+    for (x = 1; x < DUNGEON_X - 1; x++) {
+      free_cells += mapxy(x, y) >= ter_floor && !charxy(x, y);
+    }
   }
-}
-
-static void npc_next_pos_0f(dungeon_t *d, character *c, pair_t next)
-{
-  /*     smart;     telepathic;     tunneling;     erratic */
-  if (rand() & 1) {
-    npc_next_pos_rand_tunnel(d, c, next);
-  } else {
-    npc_next_pos_07(d, c, next);
+  if (!free_cells) {
+    return 1;
+  }
+  free_cells = rand_range(1, free_cells);
+  for (y = 1; y < DUNGEON_Y - 1; y++) {
+    for (x = 1; x < DUNGEON_X - 1; x++) {
+      if (mapxy(x, y) >= ter_floor && !charxy(x, y) && !--free_cells) {
+        p[dim_y] = y;
+        p[dim_x] = x;
+        return 0;
+      }
+    }
   }
-}
-
-void (*npc_move_func[])(dungeon_t *d, character *c, pair_t next) = {
-  /* We'll have one function for each combination of bits, so the *
-   * order is based on binary counting through the NPC_* bits.    *
-   * It could be very easy to mess this up, so be careful.  We'll *
-   * name them according to their hex value.                      */
-  npc_next_pos_00,
-  npc_next_pos_01,
-  npc_next_pos_02,
-  npc_next_pos_03,
-  npc_next_pos_04,
-  npc_next_pos_05,
-  npc_next_pos_06,
-  npc_next_pos_07,
-  npc_next_pos_08,
-  npc_next_pos_09,
-  npc_next_pos_0a,
-  npc_next_pos_0b,
-  npc_next_pos_0c,
-  npc_next_pos_0d,
-  npc_next_pos_0e,
-  npc_next_pos_0f,
-};
-
-void npc_next_pos(dungeon_t *d, character *c, pair_t next)
-{
-  npc *the_npc = (npc *) c;
-
-  next[dim_y] = the_npc->position[dim_y];
-  next[dim_x] = the_npc->position[dim_x];
-
-  npc_move_func[the_npc->characteristics & 0x0000000f](d, c, next);
-}
 
-uint32_t dungeon_has_npcs(dungeon_t *d)
-{
-  return d->num_monsters;
+  return 1;
 }
 
-npc::npc(dungeon_t *d, const monster_description &m)
+character_id_t place_npc(dungeon_t *d, const monster_description &m)
 {
+  character_table &t = d->characters;
+  character_id_t c;
   pair_t p;
-  uint32_t room;
 
-  symbol = m.symbol;
-  color = m.color;
-  room = rand_range(1, d->num_rooms - 1);
-  do {
-    p[dim_y] = rand_range(d->rooms[room].position[dim_y],
-                          (d->rooms[room].position[dim_y] +
-                           d->rooms[room].size[dim_y] - 1));
-    p[dim_x] = rand_range(d->rooms[room].position[dim_x],
-                          (d->rooms[room].position[dim_x] +
-                           d->rooms[room].size[dim_x] - 1));
-  } while (d->charmap[p[dim_y]][p[dim_x]]);
-  pc_last_known_position[dim_y] = p[dim_y];
-  pc_last_known_position[dim_x] = p[dim_x];
-  position[dim_y] = p[dim_y];
-  position[dim_x] = p[dim_x];
-  d->charmap[p[dim_y]][p[dim_x]] = this;
-  speed = m.speed.roll();
-  hp = m.hitpoints.roll();
-  damage = &m.damage;
-  next_turn = d->the_pc->next_turn;
-  alive = 1;
-  sequence_number = ++d->character_sequence_number;
-  characteristics = m.abilities;
-  have_seen_pc = 0;
-  name = m.name.c_str();
-  description = (const char *) m.description.c_str();
+  if (npc_find_cell(d, p) || (c = new_npc(d, m)) == NO_CHARACTER) {
+    return NO_CHARACTER;
+  }
+
+  t.pc_last_known_position[c][dim_y] = p[dim_y];
+  t.pc_last_known_position[c][dim_x] = p[dim_x];
+  t.position[c][dim_y] = p[dim_y];
+  t.position[c][dim_x] = p[dim_x];
+  charpair(p) = c;
+  t.speed[c] = m.get_speed().roll();
+  t.hp[c] = m.get_hitpoints().roll();
+  t.next_turn[c] = t.next_turn[PC_ID];
+  t.alive[c] = 1;
+  t.sequence_number[c] = ++d->character_sequence_number;
+  t.have_seen_pc[c] = 0;
+
+  return c;
 }
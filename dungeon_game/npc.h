@@ -39,25 +39,39 @@
 # define NPC_BIT30         0x40000000
 # define NPC_BIT31         0x80000000
 
-# define has_characteristic(character, bit)              \
-  ((character)->npc->characteristics & NPC_##bit)
+# define has_characteristic(d, c, bit)                   \
+  ((d)->characters.characteristics[c] & NPC_##bit)
 
 typedef struct dungeon dungeon_t;
 typedef uint32_t npc_characteristics_t;
 
 void gen_monsters(dungeon_t *d, uint32_t nummon, uint32_t game_turn);
-void npc_next_pos(dungeon_t *d, character *c, pair_t next);
+void npc_next_pos(dungeon_t *d, character_id_t c, pair_t next);
+/* npc_next_pos() ahead of time, for an NPC whose move follows from its   *
+ * position and memory, the map, the distance maps and where the PC is,   *
+ * and nothing else.  It writes only c's memory of the PC, so NPCs can be *
+ * planned on any number of threads while nothing else moves.  Gives 0,   *
+ * having changed nothing, for an NPC that would draw from the RNG or     *
+ * dig; that one has to move in its turn.                                 */
+uint32_t npc_plan_pos(dungeon_t *d, character_id_t c, pair_t next);
+/* Telepathic wall passers never look at the map, so no dig can change *
+ * a plan of theirs.                                                   */
+# define npc_plan_ignores_digs(d, c)                                    \
+  (((d)->characters.characteristics[c] &                                \
+    (NPC_PASS_WALL | NPC_TELEPATH)) == (NPC_PASS_WALL | NPC_TELEPATH))
+/* How far c is from the PC, going its own way: the walking distance, *
+ * or for a wall passer, the straight line, with no map needed.       */
+uint8_t npc_distance(dungeon_t *d, character_id_t c);
 uint32_t dungeon_has_npcs(dungeon_t *d);
 
 class monster_description;
 
-class npc : public character {
- public:
-  npc(dungeon_t *d, const monster_description &m);
-  npc_characteristics_t characteristics;
-  uint32_t have_seen_pc;
-  pair_t pc_last_known_position;
-  const char *description;
-};
+/* NPCs are kept in the dungeon's character_table (see character.h).    *
+ * new_npc() makes one with only the parts that come from its           *
+ * description, for a saved game to fill in the rest; place_npc() puts  *
+ * one in a room, to move after the PC.  Either gives NO_CHARACTER if   *
+ * the table is full, and place_npc() does too if the dungeon is.       */
+character_id_t new_npc(dungeon_t *d, const monster_description &m);
+character_id_t place_npc(dungeon_t *d, const monster_description &m);
 
 #endif
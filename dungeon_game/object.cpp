@@ -6,11 +6,11 @@
 #include "utils.h"
 
 object::object(const object_description &o, pair_t p, object *next) :
-  name(o.get_name()),
-  description(o.get_description()),
+  archetype(&o),
+  name(o.get_name().data()),
+  description(o.get_description().data()),
   type(o.get_type()),
   color(o.get_color()),
-  damage(o.get_damage()),
   hit(o.get_hit().roll()),
   dodge(o.get_dodge().roll()),
   defence(o.get_defence().roll()),
@@ -25,6 +25,39 @@ object::object(const object_description &o, pair_t p, object *next) :
   position[dim_y] = p[dim_y];
 }
 
+/* Rebuilds a saved object; nothing is rolled. */
+object::object(const object_description &o, pair_t p, object *next,
+               const object_stats_t &s, bool seen) :
+  archetype(&o),
+  name(o.get_name().data()),
+  description(o.get_description().data()),
+  type(o.get_type()),
+  color(o.get_color()),
+  hit(s.hit),
+  dodge(s.dodge),
+  defence(s.defence),
+  weight(s.weight),
+  speed(s.speed),
+  attribute(s.attribute),
+  value(s.value),
+  seen(seen),
+  next(next)
+{
+  position[dim_x] = p[dim_x];
+  position[dim_y] = p[dim_y];
+}
+
+void object::get_stats(object_stats_t *s) const
+{
+  s->hit = hit;
+  s->dodge = dodge;
+  s->defence = defence;
+  s->weight = weight;
+  s->speed = speed;
+  s->attribute = attribute;
+  s->value = value;
+}
+
 object::~object()
 {
   if (next) {
@@ -37,8 +70,7 @@ void gen_object(dungeon_t *d)
   object *o;
   uint32_t room;
   pair_t p;
-  const std::vector<object_description> &v = d->object_descriptions;
-  const object_description &od = v[rand_range(0, v.size() - 1)];
+  const object_description &od = d->object_descriptions[spawn_object(d)];
 
   room = rand_range(0, d->num_rooms - 1);
   p[dim_y] = rand_range(d->rooms[room].position[dim_y],
@@ -57,7 +89,7 @@ void gen_objects(dungeon_t *d, uint32_t numobj)
 {
   uint32_t i;
 
-  memset(d->objmap, 0, sizeof (d->objmap));
+  d->objmap.clear(NULL);
 
   d->num_objects = numobj;
   for (i = 0; i < numobj; i++) {
@@ -77,7 +109,7 @@ uint32_t object::get_color()
 
 const char *object::get_name()
 {
-  return name.c_str();
+  return name;
 }
 
 int32_t object::get_speed()
@@ -87,7 +119,7 @@ int32_t object::get_speed()
 
 int32_t object::roll_dice()
 {
-  return damage.roll();
+  return get_damage().roll();
 }
 
 void destroy_objects(dungeon_t *d)
@@ -6,23 +6,46 @@
 # include "descriptions.h"
 # include "dims.h"
 
+/* The rolled, per-instance part of an object.  Everything else comes *
+ * from its description.                                              */
+typedef struct object_stats {
+  int32_t hit, dodge, defence, weight, speed, attribute, value;
+} object_stats_t;
+
 class object {
  private:
-  const std::string &name;
-  const std::string &description;
+  const object_description *archetype;  /* What it was made from */
+  const char *name;          /* Interned; see intern.h */
+  const char *description;
   object_type_t type;
   uint32_t color;
   pair_t position;
-  const dice &damage;
   int32_t hit, dodge, defence, weight, speed, attribute, value;
   bool seen;
   object *next;
  public:
   object(const object_description &o, pair_t p, object *next);
+  object(const object_description &o, pair_t p, object *next,
+         const object_stats_t &s, bool seen);
   ~object();
-  inline int32_t get_damage_base() const { return damage.get_base(); }
-  inline int32_t get_damage_number() const { return damage.get_number(); }
-  inline int32_t get_damage_sides() const { return damage.get_sides(); }
+  void get_stats(object_stats_t *s) const;
+  inline const object_description *get_archetype() const
+  {
+    return archetype;
+  }
+  inline const dice &get_damage() const { return archetype->get_damage(); }
+  inline int32_t get_damage_base() const
+  {
+    return get_damage().get_base();
+  }
+  inline int32_t get_damage_number() const
+  {
+    return get_damage().get_number();
+  }
+  inline int32_t get_damage_sides() const
+  {
+    return get_damage().get_sides();
+  }
   char get_symbol();
   uint32_t get_color();
   const char *get_name();
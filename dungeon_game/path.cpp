@@ -1,69 +1,71 @@
 #include "path.h"
 #include "dungeon.h"
 
-/* Ugly hack: There is no way to pass a pointer to the dungeon into the *
- * heap's comparitor funtion without modifying the heap.  Copying the   *
- * pc_distance array is a possible solution, but that doubles the       *
- * bandwidth requirements for dijkstra, which would also be bad.        *
- * Instead, make a global pointer to the dungeon in this file,          *
- * initialize it in dijkstra, and use it in the comparitor to get to    *
- * pc_distance.  Otherwise, pretend it doesn't exist, because it really *
- * is ugly.                                                             */
-static dungeon_t *dungeon;
-
+/* Each node carries its own cost, so the comparitor never has to reach *
+ * into the distance map.  That used to require a global pointer to the *
+ * dungeon; now the same code works for any kind of grid the distances  *
+ * are being written to.  Costs are kept as bytes, exactly like the     *
+ * distance maps themselves.                                            */
 typedef struct path {
   heap_node_t *hn;
-  uint8_t pos[2];
+  uint16_t pos[2];
+  uint8_t cost;
 } path_t;
 
-static int32_t dist_cmp(const void *key, const void *with) {
-  return ((int32_t) dungeon->pc_distance[((path_t *) key)->pos[dim_y]]
-                                        [((path_t *) key)->pos[dim_x]] -
-          (int32_t) dungeon->pc_distance[((path_t *) with)->pos[dim_y]]
-                                        [((path_t *) with)->pos[dim_x]]);
+static int32_t path_cmp(const void *key, const void *with, void *unused) {
+  return ((int32_t) ((path_t *) key)->cost) - ((path_t *) with)->cost;
 }
 
-static int32_t tunnel_cmp(const void *key, const void *with) {
-  return ((int32_t) dungeon->pc_tunnel[((path_t *) key)->pos[dim_y]]
-                                      [((path_t *) key)->pos[dim_x]] -
-          (int32_t) dungeon->pc_tunnel[((path_t *) with)->pos[dim_y]]
-                                      [((path_t *) with)->pos[dim_x]]);
-}
+#define relax_walk(dy, dx) ({                                          \
+  path_t *_n = &p[c->pos[dim_y] + (dy)][c->pos[dim_x] + (dx)];         \
+  if (_n->hn && (_n->cost > c->cost + 1)) {                            \
+    _n->cost = c->cost + 1;                                            \
+    dist[_n->pos[dim_y]][_n->pos[dim_x]] = _n->cost;                   \
+    heap_decrease_key_no_replace(&h, _n->hn);                          \
+  }                                                                    \
+})
 
-void dijkstra(dungeon_t *d)
+#define relax_tunnel(dy, dx) ({                                        \
+  path_t *_n = &p[c->pos[dim_y] + (dy)][c->pos[dim_x] + (dx)];         \
+  if (_n->hn && (_n->cost > c->cost + 1 + step)) {                     \
+    _n->cost = c->cost + 1 + step;                                     \
+    dist[_n->pos[dim_y]][_n->pos[dim_x]] = _n->cost;                   \
+    heap_decrease_key_no_replace(&h, _n->hn);                          \
+  }                                                                    \
+})
+
+template <class map_grid, class dist_grid>
+void dijkstra_walk(map_grid &map, dist_grid &dist,
+                   uint32_t pc_x, uint32_t pc_y)
 {
   /* Currently assumes that monsters only move on floors.  Will *
    * need to be modified for tunneling and pass-wall monsters.  */
 
   heap_t h;
-  uint32_t x, y;
-  static path_t p[DUNGEON_Y][DUNGEON_X], *c;
-  static uint32_t initialized = 0;
-
-  if (!initialized) {
-    initialized = 1;
-    dungeon = d;
-    for (y = 0; y < DUNGEON_Y; y++) {
-      for (x = 0; x < DUNGEON_X; x++) {
-        p[y][x].pos[dim_y] = y;
-        p[y][x].pos[dim_x] = x;
-      }
-    }
-  }
+  uint32_t x, y, w, hgt;
+  typename map_grid::template rebind<path_t>::other p;
+  path_t *c;
+
+  w = map.get_width();
+  hgt = map.get_height();
+  p.init(w, hgt, path_t());
 
-  for (y = 0; y < DUNGEON_Y; y++) {
-    for (x = 0; x < DUNGEON_X; x++) {
-      d->pc_distance[y][x] = 255;
+  for (y = 0; y < hgt; y++) {
+    for (x = 0; x < w; x++) {
+      p[y][x].pos[dim_y] = y;
+      p[y][x].pos[dim_x] = x;
+      p[y][x].cost = 255;
+      p[y][x].hn = NULL;
+      dist[y][x] = 255;
     }
   }
-  d->pc_distance[character_get_y((const character *) d->the_pc)]
-                [character_get_x((const character *) d->the_pc)] = 0;
+  p[pc_y][pc_x].cost = dist[pc_y][pc_x] = 0;
 
-  heap_init(&h, dist_cmp, NULL);
+  heap_init(&h, path_cmp, NULL, NULL);
 
-  for (y = 0; y < DUNGEON_Y; y++) {
-    for (x = 0; x < DUNGEON_X; x++) {
-      if (mapxy(x, y) >= ter_floor) {
+  for (y = 0; y < hgt; y++) {
+    for (x = 0; x < w; x++) {
+      if (map[y][x] >= ter_floor) {
         p[y][x].hn = heap_insert(&h, &p[y][x]);
       }
     }
@@ -71,108 +73,48 @@ void dijkstra(dungeon_t *d)
 
   while ((c = (path_t *) heap_remove_min(&h))) {
     c->hn = NULL;
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn) &&
-        (d->pc_distance[c->pos[dim_y] - 1][c->pos[dim_x] - 1] >
-         d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1)) {
-      d->pc_distance[c->pos[dim_y] - 1][c->pos[dim_x] - 1] =
-        d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1;
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn) &&
-        (d->pc_distance[c->pos[dim_y] - 1][c->pos[dim_x]    ] >
-         d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1)) {
-      d->pc_distance[c->pos[dim_y] - 1][c->pos[dim_x]    ] =
-        d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1;
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn) &&
-        (d->pc_distance[c->pos[dim_y] - 1][c->pos[dim_x] + 1] >
-         d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1)) {
-      d->pc_distance[c->pos[dim_y] - 1][c->pos[dim_x] + 1] =
-        d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1;
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn) &&
-        (d->pc_distance[c->pos[dim_y]    ][c->pos[dim_x] - 1] >
-         d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1)) {
-      d->pc_distance[c->pos[dim_y]    ][c->pos[dim_x] - 1] =
-        d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1;
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn) &&
-        (d->pc_distance[c->pos[dim_y]    ][c->pos[dim_x] + 1] >
-         d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1)) {
-      d->pc_distance[c->pos[dim_y]    ][c->pos[dim_x] + 1] =
-        d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1;
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn) &&
-        (d->pc_distance[c->pos[dim_y] + 1][c->pos[dim_x] - 1] >
-         d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1)) {
-      d->pc_distance[c->pos[dim_y] + 1][c->pos[dim_x] - 1] =
-        d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1;
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn) &&
-        (d->pc_distance[c->pos[dim_y] + 1][c->pos[dim_x]    ] >
-         d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1)) {
-      d->pc_distance[c->pos[dim_y] + 1][c->pos[dim_x]    ] =
-        d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1;
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn) &&
-        (d->pc_distance[c->pos[dim_y] + 1][c->pos[dim_x] + 1] >
-         d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1)) {
-      d->pc_distance[c->pos[dim_y] + 1][c->pos[dim_x] + 1] =
-        d->pc_distance[c->pos[dim_y]][c->pos[dim_x]] + 1;
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn);
-    }
+    relax_walk(-1, -1);
+    relax_walk(-1,  0);
+    relax_walk(-1,  1);
+    relax_walk( 0, -1);
+    relax_walk( 0,  1);
+    relax_walk( 1, -1);
+    relax_walk( 1,  0);
+    relax_walk( 1,  1);
   }
   heap_delete(&h);
 }
 
-void dijkstra_tunnel(dungeon_t *d)
+template <class map_grid, class hardness_grid, class dist_grid>
+void dijkstra_tunnel_walk(map_grid &map, hardness_grid &hardness,
+                          dist_grid &dist, uint32_t pc_x, uint32_t pc_y)
 {
-  /* Currently assumes that monsters only move on floors.  Will *
-   * need to be modified for tunneling and pass-wall monsters.  */
-
   heap_t h;
-  uint32_t x, y;
-  static path_t p[DUNGEON_Y][DUNGEON_X], *c;
-  static uint32_t initialized = 0;
-
-  if (!initialized) {
-    initialized = 1;
-    dungeon = d;
-    for (y = 0; y < DUNGEON_Y; y++) {
-      for (x = 0; x < DUNGEON_X; x++) {
-        p[y][x].pos[dim_y] = y;
-        p[y][x].pos[dim_x] = x;
-      }
-    }
-  }
+  uint32_t x, y, w, hgt;
+  typename map_grid::template rebind<path_t>::other p;
+  path_t *c;
+  int32_t step;
+
+  w = map.get_width();
+  hgt = map.get_height();
+  p.init(w, hgt, path_t());
 
-  for (y = 0; y < DUNGEON_Y; y++) {
-    for (x = 0; x < DUNGEON_X; x++) {
-      d->pc_tunnel[y][x] = 255;
+  for (y = 0; y < hgt; y++) {
+    for (x = 0; x < w; x++) {
+      p[y][x].pos[dim_y] = y;
+      p[y][x].pos[dim_x] = x;
+      p[y][x].cost = 255;
+      p[y][x].hn = NULL;
+      dist[y][x] = 255;
     }
   }
-  d->pc_tunnel[character_get_y((const character *) d->the_pc)]
-              [character_get_x((const character *) d->the_pc)] = 0;
+  p[pc_y][pc_x].cost = dist[pc_y][pc_x] = 0;
 
-  heap_init(&h, tunnel_cmp, NULL);
+  heap_init(&h, path_cmp, NULL, NULL);
 
-  for (y = 0; y < DUNGEON_Y; y++) {
-    for (x = 0; x < DUNGEON_X; x++) {
-      if (mapxy(x, y) != ter_wall_immutable) {
+  for (y = 0; y < hgt; y++) {
+    for (x = 0; x < w; x++) {
+      if (map[y][x] != ter_wall_immutable) {
         p[y][x].hn = heap_insert(&h, &p[y][x]);
       }
     }
@@ -180,86 +122,220 @@ void dijkstra_tunnel(dungeon_t *d)
 
   while ((c = (path_t *) heap_remove_min(&h))) {
     c->hn = NULL;
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn) &&
-        (d->pc_tunnel[c->pos[dim_y] - 1][c->pos[dim_x] - 1] >
-         d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60))) {
-      d->pc_tunnel[c->pos[dim_y] - 1][c->pos[dim_x] - 1] =
-        (d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60));
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn) &&
-        (d->pc_tunnel[c->pos[dim_y] - 1][c->pos[dim_x]    ] >
-         d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60))) {
-      d->pc_tunnel[c->pos[dim_y] - 1][c->pos[dim_x]    ] =
-        (d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60));
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn) &&
-        (d->pc_tunnel[c->pos[dim_y] - 1][c->pos[dim_x] + 1] >
-         d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60))) {
-      d->pc_tunnel[c->pos[dim_y] - 1][c->pos[dim_x] + 1] =
-        (d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60));
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn) &&
-        (d->pc_tunnel[c->pos[dim_y]    ][c->pos[dim_x] - 1] >
-         d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60))) {
-      d->pc_tunnel[c->pos[dim_y]    ][c->pos[dim_x] - 1] =
-        (d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60));
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn) &&
-        (d->pc_tunnel[c->pos[dim_y]    ][c->pos[dim_x] + 1] >
-         d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60))) {
-      d->pc_tunnel[c->pos[dim_y]    ][c->pos[dim_x] + 1] =
-        (d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60));
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn) &&
-        (d->pc_tunnel[c->pos[dim_y] + 1][c->pos[dim_x] - 1] >
-         d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60))) {
-      d->pc_tunnel[c->pos[dim_y] + 1][c->pos[dim_x] - 1] =
-        (d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60));
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn);
+    step = hardness[c->pos[dim_y]][c->pos[dim_x]] / 60;
+    relax_tunnel(-1, -1);
+    relax_tunnel(-1,  0);
+    relax_tunnel(-1,  1);
+    relax_tunnel( 0, -1);
+    relax_tunnel( 0,  1);
+    relax_tunnel( 1, -1);
+    relax_tunnel( 1,  0);
+    relax_tunnel( 1,  1);
+  }
+  heap_delete(&h);
+}
+
+/* The classic fixed-size level and the dynamic, chunked grids. */
+#define instantiate_dijkstra(w, h)                                       \
+  template void dijkstra_walk(grid<w, h, terrain_type_t> &,              \
+                              grid<w, h, uint8_t> &, uint32_t, uint32_t); \
+  template void dijkstra_tunnel_walk(grid<w, h, terrain_type_t> &,       \
+                                     grid<w, h, uint8_t> &,              \
+                                     grid<w, h, uint8_t> &,              \
+                                     uint32_t, uint32_t)
+
+instantiate_dijkstra(DUNGEON_X, DUNGEON_Y);
+instantiate_dijkstra(GRID_DYNAMIC, GRID_DYNAMIC);
+
+/* Smart, non-tunneling movers step to the first neighbour that is *
+ * downhill on the distance map.  Monsters prefer cardinal          *
+ * directions, so those are tried first.                            */
+template <class dist_grid>
+void gradient_walk_step(dist_grid &dist, pair_t next)
+{
+  uint8_t here;
+
+  here = dist[next[dim_y]][next[dim_x]];
+
+  if (dist[next[dim_y] - 1][next[dim_x]    ] < here) {
+    next[dim_y]--;
+    return;
+  }
+  if (dist[next[dim_y] + 1][next[dim_x]    ] < here) {
+    next[dim_y]++;
+    return;
+  }
+  if (dist[next[dim_y]    ][next[dim_x] + 1] < here) {
+    next[dim_x]++;
+    return;
+  }
+  if (dist[next[dim_y]    ][next[dim_x] - 1] < here) {
+    next[dim_x]--;
+    return;
+  }
+  if (dist[next[dim_y] - 1][next[dim_x] + 1] < here) {
+    next[dim_y]--;
+    next[dim_x]++;
+    return;
+  }
+  if (dist[next[dim_y] + 1][next[dim_x] + 1] < here) {
+    next[dim_y]++;
+    next[dim_x]++;
+    return;
+  }
+  if (dist[next[dim_y] - 1][next[dim_x] - 1] < here) {
+    next[dim_y]--;
+    next[dim_x]--;
+    return;
+  }
+  if (dist[next[dim_y] + 1][next[dim_x] - 1] < here) {
+    next[dim_y]++;
+    next[dim_x]--;
+    return;
+  }
+}
+
+/* Tunnelers take the cheapest neighbour, counting the cost of boring *
+ * through it.  Ties go to the first one found, cardinals first.      */
+#define tunnel_cost(dy, dx)                                  \
+  (dist[next[dim_y] + (dy)][next[dim_x] + (dx)] +            \
+   (hardness[next[dim_y] + (dy)][next[dim_x] + (dx)] / 60))
+
+#define tunnel_try(dy, dx) ({                                \
+  if (tunnel_cost(dy, dx) < min_cost) {                      \
+    min_cost = tunnel_cost(dy, dx);                          \
+    min_next[dim_x] = next[dim_x] + (dx);                    \
+    min_next[dim_y] = next[dim_y] + (dy);                    \
+  }                                                          \
+})
+
+template <class dist_grid, class hardness_grid>
+void gradient_tunnel_step(dist_grid &dist, hardness_grid &hardness,
+                          pair_t next, pair_t min_next)
+{
+  uint16_t min_cost;
+
+  min_cost = tunnel_cost(-1, 0);
+  min_next[dim_x] = next[dim_x];
+  min_next[dim_y] = next[dim_y] - 1;
+  tunnel_try( 1,  0);
+  tunnel_try( 0,  1);
+  tunnel_try( 0, -1);
+  tunnel_try(-1,  1);
+  tunnel_try( 1,  1);
+  tunnel_try(-1, -1);
+  tunnel_try( 1, -1);
+}
+
+#define instantiate_gradient(w, h)                                        \
+  template void gradient_walk_step(grid<w, h, uint8_t> &, pair_t);        \
+  template void gradient_tunnel_step(grid<w, h, uint8_t> &,               \
+                                     grid<w, h, uint8_t> &, pair_t, pair_t)
+
+instantiate_gradient(DUNGEON_X, DUNGEON_Y);
+instantiate_gradient(GRID_DYNAMIC, GRID_DYNAMIC);
+
+/* Indexed by dim_x and dim_y; cardinals first, in the order the *
+ * gradient steps try them.                                       */
+const int8_t downhill_step[DOWNHILL_STAY + 1][num_dims] = {
+  {  0, -1 }, {  0,  1 }, {  1,  0 }, { -1,  0 },
+  {  1, -1 }, {  1,  1 }, { -1, -1 }, { -1,  1 },
+  {  0,  0 }
+};
+
+/* The index into downhill_step of a step of [dy + 1][dx + 1] */
+static const uint8_t downhill_code[3][3] = {
+  { 6, 0, 4 },
+  { 3, 8, 2 },
+  { 7, 1, 5 }
+};
+
+/* The border is never anyone's to leave, and stays DOWNHILL_STAY */
+template <class dist_grid>
+void downhill_walk(dist_grid &dist, dist_grid &downhill)
+{
+  uint32_t x, y;
+  pair_t next;
+
+  for (y = 1; y < dist.get_height() - 1; y++) {
+    for (x = 1; x < dist.get_width() - 1; x++) {
+      next[dim_y] = y;
+      next[dim_x] = x;
+      gradient_walk_step(dist, next);
+      downhill[y][x] = downhill_code[next[dim_y] - y + 1][next[dim_x] - x + 1];
     }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn) &&
-        (d->pc_tunnel[c->pos[dim_y] + 1][c->pos[dim_x]    ] >
-         d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60))) {
-      d->pc_tunnel[c->pos[dim_y] + 1][c->pos[dim_x]    ] =
-        (d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60));
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn);
+  }
+}
+
+template <class dist_grid, class hardness_grid>
+static inline void downhill_tunnel_cell(dist_grid &dist,
+                                        hardness_grid &hardness,
+                                        dist_grid &downhill,
+                                        uint32_t x, uint32_t y)
+{
+  pair_t here, next;
+
+  here[dim_y] = y;
+  here[dim_x] = x;
+  gradient_tunnel_step(dist, hardness, here, next);
+  downhill[y][x] = downhill_code[next[dim_y] - y + 1][next[dim_x] - x + 1];
+}
+
+template <class dist_grid, class hardness_grid>
+void downhill_tunnel(dist_grid &dist, hardness_grid &hardness,
+                     dist_grid &downhill)
+{
+  uint32_t x, y;
+
+  for (y = 1; y < dist.get_height() - 1; y++) {
+    for (x = 1; x < dist.get_width() - 1; x++) {
+      downhill_tunnel_cell(dist, hardness, downhill, x, y);
     }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn) &&
-        (d->pc_tunnel[c->pos[dim_y] + 1][c->pos[dim_x] + 1] >
-         d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60))) {
-      d->pc_tunnel[c->pos[dim_y] + 1][c->pos[dim_x] + 1] =
-        (d->pc_tunnel[c->pos[dim_y]][c->pos[dim_x]] + 1 +
-         (d->hardness[c->pos[dim_y]][c->pos[dim_x]] / 60));
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn);
+  }
+}
+
+/* Only the cells that might step into (x, y) weigh its hardness */
+template <class dist_grid, class hardness_grid>
+void downhill_tunnel_around(dist_grid &dist, hardness_grid &hardness,
+                            dist_grid &downhill, uint32_t x, uint32_t y)
+{
+  uint32_t i, j;
+
+  for (j = y - 1; j <= y + 1; j++) {
+    for (i = x - 1; i <= x + 1; i++) {
+      if (j && i && j < dist.get_height() - 1 && i < dist.get_width() - 1) {
+        downhill_tunnel_cell(dist, hardness, downhill, i, j);
+      }
     }
   }
-  heap_delete(&h);
+}
+
+#define instantiate_downhill(w, h)                                        \
+  template void downhill_walk(grid<w, h, uint8_t> &,                      \
+                              grid<w, h, uint8_t> &);                     \
+  template void downhill_tunnel(grid<w, h, uint8_t> &,                    \
+                                grid<w, h, uint8_t> &,                    \
+                                grid<w, h, uint8_t> &);                   \
+  template void downhill_tunnel_around(grid<w, h, uint8_t> &,             \
+                                       grid<w, h, uint8_t> &,             \
+                                       grid<w, h, uint8_t> &,             \
+                                       uint32_t, uint32_t)
+
+instantiate_downhill(DUNGEON_X, DUNGEON_Y);
+instantiate_downhill(GRID_DYNAMIC, GRID_DYNAMIC);
+
+void dijkstra(dungeon_t *d)
+{
+  dijkstra_walk(d->map, d->pc_distance,
+                character_get_x(d, PC_ID),
+                character_get_y(d, PC_ID));
+  downhill_walk(d->pc_distance, d->pc_downhill);
+}
+
+void dijkstra_tunnel(dungeon_t *d)
+{
+  dijkstra_tunnel_walk(d->map, d->hardness, d->pc_tunnel,
+                       character_get_x(d, PC_ID),
+                       character_get_y(d, PC_ID));
+  downhill_tunnel(d->pc_tunnel, d->hardness, d->pc_tunnel_downhill);
 }
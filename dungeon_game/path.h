@@ -1,9 +1,72 @@
 #ifndef PATH_H
 # define PATH_H
 
+# include <stdint.h>
+# include <stdlib.h>
+
+# include "dims.h"
+
 typedef struct dungeon dungeon_t;
 
+/* Each also fills in its downhill map (see below) */
 void dijkstra(dungeon_t *d);
 void dijkstra_tunnel(dungeon_t *d);
 
+/* The engines behind the two above, generic over the grid type.  They *
+ * are instantiated for the fixed DUNGEON_X x DUNGEON_Y grids and for   *
+ * GRID_DYNAMIC grids (see grid.h).                                     */
+template <class map_grid, class dist_grid>
+void dijkstra_walk(map_grid &map, dist_grid &dist,
+                   uint32_t pc_x, uint32_t pc_y);
+template <class map_grid, class hardness_grid, class dist_grid>
+void dijkstra_tunnel_walk(map_grid &map, hardness_grid &hardness,
+                          dist_grid &dist, uint32_t pc_x, uint32_t pc_y);
+
+/* Gradient-following steps for smart movers, generic over the grid type *
+ * (instantiated for the fixed and the GRID_DYNAMIC grids, see grid.h).  */
+template <class dist_grid>
+void gradient_walk_step(dist_grid &dist, pair_t next);
+template <class dist_grid, class hardness_grid>
+void gradient_tunnel_step(dist_grid &dist, hardness_grid &hardness,
+                          pair_t next, pair_t min_next);
+
+/* The gradient steps, taken ahead of time from every cell of a distance *
+ * map, whenever the map is made, so that a smart NPC's move is a single *
+ * byte.  Each cell of a downhill map is an index into downhill_step.    *
+ * Tunneling costs count the hardness of the rock as well, so a dig that *
+ * leaves the rock standing has to put right the cells around it with   *
+ * downhill_tunnel_around(); one that breaks through remakes the maps.   */
+# define DOWNHILL_STAY 8    /* No step downhill from here */
+
+extern const int8_t downhill_step[DOWNHILL_STAY + 1][num_dims];
+
+template <class dist_grid>
+void downhill_walk(dist_grid &dist, dist_grid &downhill);
+template <class dist_grid, class hardness_grid>
+void downhill_tunnel(dist_grid &dist, hardness_grid &hardness,
+                     dist_grid &downhill);
+template <class dist_grid, class hardness_grid>
+void downhill_tunnel_around(dist_grid &dist, hardness_grid &hardness,
+                            dist_grid &downhill, uint32_t x, uint32_t y);
+
+/* Wall passers need no map at all.  Nothing but the immutable border    *
+ * stands in their way, and both ends are inside it, so the straight     *
+ * line between them is too.  The distance is the larger of the two      *
+ * axis distances, and a step moves one toward the target on each axis.  */
+static inline uint8_t pass_distance(const pair_t from, const pair_t to)
+{
+  uint8_t dx, dy;
+
+  dx = abs(to[dim_x] - from[dim_x]);
+  dy = abs(to[dim_y] - from[dim_y]);
+
+  return dx > dy ? dx : dy;
+}
+
+static inline void pass_step(const pair_t to, pair_t next)
+{
+  next[dim_x] += (to[dim_x] > next[dim_x]) - (to[dim_x] < next[dim_x]);
+  next[dim_y] += (to[dim_y] > next[dim_y]) - (to[dim_y] < next[dim_y]);
+}
+
 #endif
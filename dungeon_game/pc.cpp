@@ -25,7 +25,7 @@ const char *eq_slot_name[num_eq_slots] = {
   "rh ring"
 };
 
-pc::pc()
+pc::pc(character_table *characters) : characters(characters)
 {
   uint32_t i;
 
@@ -36,8 +36,6 @@ pc::pc()
   for (i = 0; i < MAX_INVENTORY; i++) {
     in[i] = 0;
   }
-
-  hp = 1000;
 }
 
 pc::~pc()
@@ -59,51 +57,73 @@ pc::~pc()
   }
 }
 
-void delete_pc(character *the_pc)
+void delete_pc(pc *the_pc)
 {
-  delete static_cast<pc *>(the_pc);
+  delete the_pc;
 }
 uint32_t pc_is_alive(dungeon_t *d)
 {
-  return ((pc *) d->the_pc)->alive;
+  return d->characters.alive[PC_ID];
 }
 
 void place_pc(dungeon_t *d)
 {
-  ((pc *) d->the_pc)->position[dim_y] = rand_range(d->rooms->position[dim_y],
-                                               (d->rooms->position[dim_y] +
-                                                d->rooms->size[dim_y] - 1));
-  ((pc *) d->the_pc)->position[dim_x] = rand_range(d->rooms->position[dim_x],
-                                               (d->rooms->position[dim_x] +
-                                                d->rooms->size[dim_x] - 1));
+  character_set_y(d, PC_ID, rand_range(d->rooms->position[dim_y],
+                                       (d->rooms->position[dim_y] +
+                                        d->rooms->size[dim_y] - 1)));
+  character_set_x(d, PC_ID, rand_range(d->rooms->position[dim_x],
+                                       (d->rooms->position[dim_x] +
+                                        d->rooms->size[dim_x] - 1)));
 
   pc_init_known_terrain(d->the_pc);
   pc_observe_terrain(d->the_pc, d);
 }
 
-void config_pc(dungeon_t *d)
+/* Shared by every game's PC, simulated ones on other threads included, *
+ * so it's made once, under the guard C++ gives a local static, and     *
+ * never changed after.                                                 */
+static const monster_description *pc_archetype(void)
 {
-  /* This should be in the PC constructor, now. */
-  pc *the_pc;
-  static dice pc_dice(0, 1, 4);
+  static const monster_description archetype = [] {
+    monster_description m;
 
-  the_pc = new pc;
-  d->the_pc = the_pc;
+    m.set("Isabella Garcia-Shapiro", "", '@',
+          std::vector<uint32_t>(1, COLOR_WHITE),
+          dice(PC_SPEED, 0, 1), 0, dice(1000, 0, 1), dice(0, 1, 4));
 
-  the_pc->symbol = '@';
+    return m;
+  }();
 
-  place_pc(d);
+  return &archetype;
+}
+
+pc *new_pc(dungeon_t *d)
+{
+  character_table &t = d->characters;
+
+  if (t.size() < PC_ID + 1) {
+    t.clear_npcs();
+  }
+
+  t.position[PC_ID] = character_pair();
+  t.archetype[PC_ID] = pc_archetype();
+  t.speed[PC_ID] = PC_SPEED;
+  t.next_turn[PC_ID] = 0;
+  t.alive[PC_ID] = 1;
+  t.sequence_number[PC_ID] = 0;
+  t.hp[PC_ID] = 1000;
+  t.characteristics[PC_ID] = 0;
 
-  the_pc->speed = PC_SPEED;
-  the_pc->next_turn = 0;
-  the_pc->alive = 1;
-  the_pc->sequence_number = 0;
-  the_pc->color.push_back(COLOR_WHITE);
-  the_pc->damage = &pc_dice;
-  the_pc->name = "Isabella Garcia-Shapiro";
+  return new pc(&t);
+}
 
-  d->charmap[the_pc->position[dim_y]]
-            [the_pc->position[dim_x]] = (character *) d->the_pc;
+void config_pc(dungeon_t *d)
+{
+  d->the_pc = new_pc(d);
+
+  place_pc(d);
+
+  charpair(character_get_pos(d, PC_ID)) = PC_ID;
 
   dijkstra(d);
   dijkstra_tunnel(d);
@@ -116,110 +136,181 @@ uint32_t pc_next_pos(dungeon_t *d, pair_t dir)
   /* Tunnel to the nearest dungeon corner, then move around in hopes *
    * of killing a couple of monsters before we die ourself.          */
 
-  if (in_corner(d, d->the_pc)) {
+  if (in_corner(d, PC_ID)) {
     /*
     dir[dim_x] = (mapxy(d->the_pc.position[dim_x] - 1,
                         d->the_pc.position[dim_y]) ==
                   ter_wall_immutable) ? 1 : -1;
     */
-    dir[dim_y] = (mapxy(((pc *) d->the_pc)->position[dim_x],
-                        ((pc *) d->the_pc)->position[dim_y] - 1) ==
+    dir[dim_y] = (mapxy(character_get_x(d, PC_ID),
+                        character_get_y(d, PC_ID) - 1) ==
                   ter_wall_immutable) ? 1 : -1;
   } else {
-    dir_nearest_wall(d, d->the_pc, dir);
+    dir_nearest_wall(d, PC_ID, dir);
   }
 
   return 0;
 }
 
-void pc_learn_terrain(character *the_pc, pair_t pos, terrain_type_t ter)
+/* Converts a step to the keypad numbering move_pc() expects. */
+#define keypad_dir(dy, dx) (5 + (dx) - 3 * (dy))
+
+/* Autopilot for headless games.  Wears anything it carries that fits *
+ * an empty slot, then attacks an adjacent monster if there is one;   *
+ * otherwise it heads for the nearest reachable monster by walking    *
+ * the PC distance map back from the monster to the PC, and if there  *
+ * is none, it wanders.  Returns a direction for move_pc().           */
+uint32_t pc_auto_move(dungeon_t *d)
+{
+  pc *p = d->the_pc;
+  int8_t *pos = character_get_pos(d, PC_ID);
+  pair_t cur, target;
+  uint32_t i, x, y, best;
+  int32_t dx, dy, found;
+
+  for (i = 0; i < MAX_INVENTORY; i++) {
+    if (p->in[i] && p->in[i]->is_equipable() &&
+        !p->eq[p->in[i]->get_eq_slot_index()]) {
+      p->wear_in(i);
+    }
+  }
+
+  for (dy = -1; dy <= 1; dy++) {
+    for (dx = -1; dx <= 1; dx++) {
+      if ((dy || dx) &&
+          charxy(pos[dim_x] + dx, pos[dim_y] + dy) &&
+          mapxy(pos[dim_x] + dx, pos[dim_y] + dy) >= ter_floor) {
+        return keypad_dir(dy, dx);
+      }
+    }
+  }
+
+  for (best = 255, y = 1; y < DUNGEON_Y - 1; y++) {
+    for (x = 1; x < DUNGEON_X - 1; x++) {
+      if (charxy(x, y) && charxy(x, y) != PC_ID &&
+          d->pc_distance[y][x] < best) {
+        best = d->pc_distance[y][x];
+        target[dim_x] = x;
+        target[dim_y] = y;
+      }
+    }
+  }
+
+  if (best == 255) {
+    return rand_range(1, 9);
+  }
+
+  cur[dim_x] = target[dim_x];
+  cur[dim_y] = target[dim_y];
+  while (d->pc_distance[cur[dim_y]][cur[dim_x]] > 1) {
+    for (found = 0, dy = -1; dy <= 1 && !found; dy++) {
+      for (dx = -1; dx <= 1 && !found; dx++) {
+        if (d->pc_distance[cur[dim_y] + dy][cur[dim_x] + dx] ==
+            d->pc_distance[cur[dim_y]][cur[dim_x]] - 1) {
+          cur[dim_y] += dy;
+          cur[dim_x] += dx;
+          found = 1;
+        }
+      }
+    }
+    if (!found) {
+      /* Stale distance map; it will be refreshed by our next move. */
+      return rand_range(1, 9);
+    }
+  }
+
+  return keypad_dir(cur[dim_y] - pos[dim_y], cur[dim_x] - pos[dim_x]);
+}
+
+void pc_learn_terrain(pc *the_pc, pair_t pos, terrain_type_t ter)
 {
-  ((pc *) the_pc)->known_terrain[pos[dim_y]][pos[dim_x]] = ter;
-  ((pc *) the_pc)->visible[pos[dim_y]][pos[dim_x]] = 1;
+  the_pc->known_terrain[pos[dim_y]][pos[dim_x]] = ter;
+  the_pc->visible[pos[dim_y]][pos[dim_x]] = 1;
 }
 
-void pc_see_object(character *the_pc, object *o)
+void pc_see_object(pc *the_pc, object *o)
 {
   if (o) {
     o->has_been_seen();
   }
 }
 
-void pc_reset_visibility(character *the_pc)
+void pc_reset_visibility(pc *the_pc)
 {
   uint32_t y, x;
 
   for (y = 0; y < DUNGEON_Y; y++) {
     for (x = 0; x < DUNGEON_X; x++) {
-      ((pc *) the_pc)->visible[y][x] = 0;
+      the_pc->visible[y][x] = 0;
     }
   }
 }
 
-terrain_type_t pc_learned_terrain(character *the_pc, int8_t y, int8_t x)
+terrain_type_t pc_learned_terrain(pc *the_pc, int8_t y, int8_t x)
 {
-  return ((pc *) the_pc)->known_terrain[y][x];
+  return the_pc->known_terrain[y][x];
 }
 
-void pc_init_known_terrain(character *the_pc)
+void pc_init_known_terrain(pc *the_pc)
 {
   uint32_t y, x;
 
   for (y = 0; y < DUNGEON_Y; y++) {
     for (x = 0; x < DUNGEON_X; x++) {
-      ((pc *) the_pc)->known_terrain[y][x] = ter_unknown;
-      ((pc *) the_pc)->visible[y][x] = 0;
+      the_pc->known_terrain[y][x] = ter_unknown;
+      the_pc->visible[y][x] = 0;
     }
   }
 }
 
-void pc_observe_terrain(character *the_pc, dungeon_t *d)
+void pc_observe_terrain(pc *the_pc, dungeon_t *d)
 {
   pair_t where;
-  pc *p;
+  int8_t *p;
   int8_t y_min, y_max, x_min, x_max;
 
-  p = (pc *) the_pc;
+  p = character_get_pos(d, PC_ID);
 
-  y_min = p->position[dim_y] - PC_VISUAL_RANGE;
+  y_min = p[dim_y] - PC_VISUAL_RANGE;
   if (y_min < 0) {
     y_min = 0;
   }
-  y_max = p->position[dim_y] + PC_VISUAL_RANGE;
+  y_max = p[dim_y] + PC_VISUAL_RANGE;
   if (y_max > DUNGEON_Y - 1) {
     y_max = DUNGEON_Y - 1;
   }
-  x_min = p->position[dim_x] - PC_VISUAL_RANGE;
+  x_min = p[dim_x] - PC_VISUAL_RANGE;
   if (x_min < 0) {
     x_min = 0;
   }
-  x_max = p->position[dim_x] + PC_VISUAL_RANGE;
+  x_max = p[dim_x] + PC_VISUAL_RANGE;
   if (x_max > DUNGEON_X - 1) {
     x_max = DUNGEON_X - 1;
   }
 
   for (where[dim_y] = y_min; where[dim_y] <= y_max; where[dim_y]++) {
     where[dim_x] = x_min;
-    can_see(d, p->position, where, 1);
+    can_see(d, p, where, 1);
     where[dim_x] = x_max;
-    can_see(d, p->position, where, 1);
+    can_see(d, p, where, 1);
   }
   /* Take one off the x range because we alreay hit the corners above. */
   for (where[dim_x] = x_min - 1; where[dim_x] <= x_max - 1; where[dim_x]++) {
     where[dim_y] = y_min;
-    can_see(d, p->position, where, 1);
+    can_see(d, p, where, 1);
     where[dim_y] = y_max;
-    can_see(d, p->position, where, 1);
+    can_see(d, p, where, 1);
   }       
 }
 
-int32_t is_illuminated(character *the_pc, int8_t y, int8_t x)
+int32_t is_illuminated(pc *the_pc, int8_t y, int8_t x)
 {
-  return ((pc *) the_pc)->visible[y][x];
+  return the_pc->visible[y][x];
 }
 
 void pc::recalculate_speed()
 {
+  int32_t &speed = characters->speed[PC_ID];
   int i;
 
   speed = 20;
@@ -328,7 +419,7 @@ uint32_t pc::drop_in(dungeon_t *d, uint32_t slot)
 
   io_queue_message("You drop %s.", in[slot]->get_name());
 
-  in[slot]->to_pile(d, position);
+  in[slot]->to_pile(d, character_get_pos(d, PC_ID));
   in[slot] = NULL;
 
   return 0;
@@ -350,6 +441,7 @@ uint32_t pc::destroy_in(uint32_t slot)
 
 uint32_t pc::pick_up(dungeon_t *d)
 {
+  int8_t *position = character_get_pos(d, PC_ID);
   object *o;
 
   while (has_open_inventory_slot() &&
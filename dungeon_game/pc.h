@@ -13,15 +13,16 @@ typedef struct dungeon dungeon_t;
 uint32_t pc_is_alive(dungeon_t *d);
 void config_pc(dungeon_t *d);
 uint32_t pc_next_pos(dungeon_t *d, pair_t dir);
+uint32_t pc_auto_move(dungeon_t *d);
 void place_pc(dungeon_t *d);
-void delete_pc(character *the_pc);
-void pc_learn_terrain(character *the_pc, pair_t pos, terrain_type_t ter);
-terrain_type_t pc_learned_terrain(character *the_pc, int8_t y, int8_t x);
-void pc_init_known_terrain(character *the_pc);
-void pc_observe_terrain(character *the_pc, dungeon_t *d);
-int32_t is_illuminated(character *the_pc, int8_t y, int8_t x);
-void pc_reset_visibility(character *the_pc);
-void pc_see_object(character *the_pc, object *o);
+void delete_pc(pc *the_pc);
+void pc_learn_terrain(pc *the_pc, pair_t pos, terrain_type_t ter);
+terrain_type_t pc_learned_terrain(pc *the_pc, int8_t y, int8_t x);
+void pc_init_known_terrain(pc *the_pc);
+void pc_observe_terrain(pc *the_pc, dungeon_t *d);
+int32_t is_illuminated(pc *the_pc, int8_t y, int8_t x);
+void pc_reset_visibility(pc *the_pc);
+void pc_see_object(pc *the_pc, object *o);
 
 typedef enum eq_slot {
   eq_slot_weapon,
@@ -43,8 +44,12 @@ extern const char *eq_slot_name[num_eq_slots];
 
 # include "character.h"
 
-class pc : public character {
+/* Only what no NPC has; the PC's position, speed, hit points and the *
+ * rest are in the dungeon's character_table, at PC_ID.               */
+class pc {
  private:
+  character_table *characters;
+
   void recalculate_speed();
   uint32_t has_open_inventory_slot();
   int32_t get_first_open_inventory_slot();
@@ -62,8 +67,11 @@ class pc : public character {
   uint32_t drop_in(dungeon_t *d, uint32_t slot);
   uint32_t destroy_in(uint32_t slot);
   uint32_t pick_up(dungeon_t *d);
-  pc();
+  pc(character_table *characters);
   ~pc();
 };
 
+/* A fresh PC, in d's PC_ID slot, not yet placed in any dungeon. */
+pc *new_pc(dungeon_t *d);
+
 #endif
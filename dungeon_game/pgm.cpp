@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dungeon.h"
+
+/* Dungeons from gray maps.  Any binary (P5) or plain (P2) PGM will do, *
+ * at any size and with any maxval up to 65535; black is room floor,    *
+ * white (maxval) is corridor, and anything in between is rock, as hard *
+ * as it is bright.  Images that aren't the size of the dungeon's       *
+ * interior are resampled to fit, a row at a time, so that only one    *
+ * row of the image is ever in memory: each target cell takes the most  *
+ * common kind of pixel among those that land on it (floor wins ties),  *
+ * and rock the mean of their hardness.                                 *
+ *                                                                      *
+ * Rooms are the connected regions of room floor.  The rest of the game *
+ * treats a room as a rectangle and places things anywhere inside it,   *
+ * so each region's room is the largest rectangle of floor within it.   */
+
+#define PGM_X (DUNGEON_X - 2)
+#define PGM_Y (DUNGEON_Y - 2)
+
+#define PGM_BUFFER (1 << 16)
+
+typedef enum pgm_class {
+  pgm_room,
+  pgm_hall,
+  pgm_rock
+} pgm_class_t;
+
+typedef struct pgm_cell {
+  uint32_t count[3];       /* Pixels of each class */
+  uint64_t hardness;       /* Sum over the rock    */
+} pgm_cell_t;
+
+static void pgm_fail(const char *pgm, const char *why)
+{
+  fprintf(stderr, "%s: %s\n", pgm, why);
+  exit(-1);
+}
+
+/* Skips whitespace and comments, which the header may have anywhere. */
+static int pgm_skip(FILE *f)
+{
+  int c;
+
+  while ((c = getc_unlocked(f)) != EOF) {
+    if (c == '#') {
+      while ((c = getc_unlocked(f)) != EOF && c != '\n')
+        ;
+    } else if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+      break;
+    }
+  }
+
+  return c;
+}
+
+static int pgm_number(FILE *f, uint32_t *v)
+{
+  int c;
+
+  if ((c = pgm_skip(f)) < '0' || c > '9') {
+    return 1;
+  }
+  for (*v = 0; c >= '0' && c <= '9'; c = getc_unlocked(f)) {
+    if (*v > 0xffffff) {
+      return 1;
+    }
+    *v = *v * 10 + c - '0';
+  }
+  /* The single whitespace character that ends the header matters in P5 */
+  if (c != EOF && c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+    ungetc(c, f);
+  }
+
+  return 0;
+}
+
+/* Reads one row into row[], as samples in [0, maxval]. */
+static int pgm_row(FILE *f, int binary, uint32_t maxval,
+                   uint32_t width, uint8_t *raw, uint16_t *row)
+{
+  uint32_t x, v;
+
+  if (!binary) {
+    for (x = 0; x < width; x++) {
+      if (pgm_number(f, &v)) {
+        return 1;
+      }
+      row[x] = v > maxval ? maxval : v;
+    }
+  } else if (maxval < 256) {
+    if (fread(raw, 1, width, f) != width) {
+      return 1;
+    }
+    for (x = 0; x < width; x++) {
+      row[x] = raw[x] > maxval ? maxval : raw[x];
+    }
+  } else {
+    if (fread(raw, 2, width, f) != width) {
+      return 1;
+    }
+    for (x = 0; x < width; x++) {
+      v = (raw[2 * x] << 8) | raw[2 * x + 1];
+      row[x] = v > maxval ? maxval : v;
+    }
+  }
+
+  return 0;
+}
+
+/* Source pixel i of n covers target cells [*lo, *hi) of m.  Shrinking, *
+ * that's exactly one cell; stretching, the cells between its edges.    */
+static void pgm_span(uint32_t i, uint32_t n, uint32_t m,
+                     uint32_t *lo, uint32_t *hi)
+{
+  *lo = (uint64_t) i * m / n;
+  *hi = (uint64_t) (i + 1) * m / n;
+  if (*hi == *lo) {
+    *hi = *lo + 1;
+  }
+}
+
+/* Label the connected regions of room floor, returning how many */
+static uint32_t pgm_label(uint8_t cls[PGM_Y][PGM_X],
+                          uint16_t label[PGM_Y][PGM_X])
+{
+  static uint16_t stack[PGM_Y * PGM_X];
+  static const int32_t step[4][2] = {
+    { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 }
+  };
+  uint32_t x, y, sp, n, i, c;
+  int32_t nx, ny;
+
+  memset(label, 0, sizeof (label[0]) * PGM_Y);
+
+  for (n = 0, y = 0; y < PGM_Y; y++) {
+    for (x = 0; x < PGM_X; x++) {
+      if (cls[y][x] != pgm_room || label[y][x]) {
+        continue;
+      }
+      label[y][x] = ++n;
+      stack[0] = y * PGM_X + x;
+      for (sp = 1; sp; ) {
+        c = stack[--sp];
+        for (i = 0; i < 4; i++) {
+          nx = c % PGM_X + step[i][0];
+          ny = c / PGM_X + step[i][1];
+          if (nx >= 0 && nx < PGM_X && ny >= 0 && ny < PGM_Y &&
+              cls[ny][nx] == pgm_room && !label[ny][nx]) {
+            label[ny][nx] = n;
+            stack[sp++] = ny * PGM_X + nx;
+          }
+        }
+      }
+    }
+  }
+
+  return n;
+}
+
+/* The largest rectangle of cells labelled l, by the usual histogram *
+ * sweep: heights of floor above each cell in the row, then for each *
+ * cell the widest span it's no taller than.                         */
+static void pgm_rectangle(uint16_t label[PGM_Y][PGM_X], uint16_t l,
+                          room_t *r)
+{
+  uint32_t height[PGM_X], left[PGM_X], right[PGM_X];
+  uint32_t x, y, area, best;
+
+  memset(height, 0, sizeof (height));
+  best = 0;
+  for (y = 0; y < PGM_Y; y++) {
+    for (x = 0; x < PGM_X; x++) {
+      height[x] = label[y][x] == l ? height[x] + 1 : 0;
+    }
+    for (x = 0; x < PGM_X; x++) {
+      for (left[x] = x; left[x] && height[left[x] - 1] >= height[x]; ) {
+        left[x] = left[left[x] - 1];
+      }
+    }
+    for (x = PGM_X; x--; ) {
+      for (right[x] = x + 1;
+           right[x] < PGM_X && height[right[x]] >= height[x]; ) {
+        right[x] = right[right[x]];
+      }
+    }
+    for (x = 0; x < PGM_X; x++) {
+      if ((area = height[x] * (right[x] - left[x])) > best) {
+        best = area;
+        r->position[dim_x] = left[x] + 1;
+        r->position[dim_y] = y - height[x] + 2;
+        r->size[dim_x] = right[x] - left[x];
+        r->size[dim_y] = height[x];
+      }
+    }
+  }
+}
+
+int read_pgm(dungeon_t *d, char *pgm)
+{
+  static pgm_cell_t cell[PGM_Y][PGM_X];
+  static uint8_t cls[PGM_Y][PGM_X], hardness[PGM_Y][PGM_X];
+  static uint16_t label[PGM_Y][PGM_X];
+  uint32_t width, height, maxval, x, y, tx, ty, y0, y1, i, c, v;
+  uint32_t *x0, *x1;
+  uint16_t *row;
+  uint8_t *raw;
+  char magic[2];
+  int binary;
+  FILE *f;
+
+  if (!(f = fopen(pgm, "r"))) {
+    perror(pgm);
+    exit(-1);
+  }
+  setvbuf(f, NULL, _IOFBF, PGM_BUFFER);
+
+  if (fread(magic, 1, 2, f) != 2 || magic[0] != 'P' ||
+      (magic[1] != '2' && magic[1] != '5')) {
+    pgm_fail(pgm, "Not a PGM (P2 or P5) image.");
+  }
+  binary = magic[1] == '5';
+  if (pgm_number(f, &width) || pgm_number(f, &height) ||
+      pgm_number(f, &maxval)) {
+    pgm_fail(pgm, "Corrupt PGM header.");
+  }
+  if (!width || !height || !maxval || maxval > 65535) {
+    pgm_fail(pgm, "Unsupported PGM dimensions or maxval.");
+  }
+
+  row = (uint16_t *) malloc(width * sizeof (*row));
+  raw = (uint8_t *) malloc(width * 2);
+  x0 = (uint32_t *) malloc(width * sizeof (*x0) * 2);
+  x1 = x0 + width;
+  for (x = 0; x < width; x++) {
+    pgm_span(x, width, PGM_X, x0 + x, x1 + x);
+  }
+  memset(cell, 0, sizeof (cell));
+
+  for (y = 0; y < height; y++) {
+    if (pgm_row(f, binary, maxval, width, raw, row)) {
+      pgm_fail(pgm, "Premature end of PGM data.");
+    }
+    pgm_span(y, height, PGM_Y, &y0, &y1);
+    for (ty = y0; ty < y1; ty++) {
+      for (x = 0; x < width; x++) {
+        c = !row[x] ? pgm_room : row[x] == maxval ? pgm_hall : pgm_rock;
+        for (tx = x0[x]; tx < x1[x]; tx++) {
+          cell[ty][tx].count[c]++;
+          if (c == pgm_rock) {
+            cell[ty][tx].hardness += row[x];
+          }
+        }
+      }
+    }
+  }
+
+  fclose(f);
+  free(row);
+  free(raw);
+  free(x0);
+
+  for (y = 0; y < PGM_Y; y++) {
+    for (x = 0; x < PGM_X; x++) {
+      pgm_cell_t *p = &cell[y][x];
+
+      if (p->count[pgm_room] >= p->count[pgm_hall] &&
+          p->count[pgm_room] >= p->count[pgm_rock]) {
+        cls[y][x] = pgm_room;
+      } else if (p->count[pgm_hall] >= p->count[pgm_rock]) {
+        cls[y][x] = pgm_hall;
+      } else {
+        cls[y][x] = pgm_rock;
+        /* Rescaled to 0-255, and kept off both ends, which are open */
+        v = (p->hardness * 255 + p->count[pgm_rock] * maxval / 2) /
+            ((uint64_t) p->count[pgm_rock] * maxval);
+        hardness[y][x] = v < 1 ? 1 : v > 254 ? 254 : v;
+      }
+    }
+  }
+
+  d->num_rooms = pgm_label(cls, label);
+  if (!d->num_rooms) {
+    pgm_fail(pgm, "No room floor (black) in image.");
+  }
+  /* Monsters are placed outside the PC's room, so there must be two. */
+  d->rooms = (room_t *) malloc(sizeof (*d->rooms) *
+                               (d->num_rooms < 2 ? 2 : d->num_rooms));
+  for (i = 0; i < d->num_rooms; i++) {
+    pgm_rectangle(label, i + 1, d->rooms + i);
+    d->rooms[i].connected = 0;
+  }
+  if (d->num_rooms == 1) {
+    d->rooms[1] = d->rooms[0];
+    if (d->rooms[0].size[dim_x] >= d->rooms[0].size[dim_y]) {
+      d->rooms[0].size[dim_x] /= 2;
+      d->rooms[1].position[dim_x] += d->rooms[0].size[dim_x];
+      d->rooms[1].size[dim_x] -= d->rooms[0].size[dim_x];
+    } else {
+      d->rooms[0].size[dim_y] /= 2;
+      d->rooms[1].position[dim_y] += d->rooms[0].size[dim_y];
+      d->rooms[1].size[dim_y] -= d->rooms[0].size[dim_y];
+    }
+    if (!d->rooms[0].size[dim_x] || !d->rooms[0].size[dim_y]) {
+      pgm_fail(pgm, "Need at least two cells of room floor.");
+    }
+    d->num_rooms = 2;
+  }
+
+  for (y = 0; y < PGM_Y; y++) {
+    for (x = 0; x < PGM_X; x++) {
+      switch (cls[y][x]) {
+      case pgm_room:
+        d->map[y + 1][x + 1] = ter_floor_room;
+        d->hardness[y + 1][x + 1] = 0;
+        break;
+      case pgm_hall:
+        d->map[y + 1][x + 1] = ter_floor_hall;
+        d->hardness[y + 1][x + 1] = 0;
+        break;
+      default:
+        d->map[y + 1][x + 1] = ter_wall;
+        d->hardness[y + 1][x + 1] = hardness[y][x];
+        break;
+      }
+    }
+  }
+
+  for (x = 0; x < DUNGEON_X; x++) {
+    d->map[0][x] = ter_wall_immutable;
+    d->hardness[0][x] = 255;
+    d->map[DUNGEON_Y - 1][x] = ter_wall_immutable;
+    d->hardness[DUNGEON_Y - 1][x] = 255;
+  }
+  for (y = 1; y < DUNGEON_Y - 1; y++) {
+    d->map[y][0] = ter_wall_immutable;
+    d->hardness[y][0] = 255;
+    d->map[y][DUNGEON_X - 1] = ter_wall_immutable;
+    d->hardness[y][DUNGEON_X - 1] = 255;
+  }
+
+  return 0;
+}
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include <iostream>
+#include <sstream>
+
+#include "reload.h"
+#include "builtin.h"
+#include "dungeon.h"
+#include "io.h"
+#include "pc.h"
+#include "npc.h"
+#include "utils.h"
+
+static struct {
+  pthread_t thread;
+  uint32_t running;
+  uint32_t restart;          /* Forked while running; start on next poll */
+  int watch;                 /* inotify */
+  int stop[2];               /* Written to, to stop the watcher */
+  description_set *pending;  /* Parsed and waiting; swapped atomically */
+} reload;
+
+static int reload_relevant(const char *buf, ssize_t n)
+{
+  const struct inotify_event *e;
+  ssize_t i;
+
+  for (i = 0; i < n; i += sizeof (*e) + e->len) {
+    e = (const struct inotify_event *) (buf + i);
+    if (e->len && (!strcmp(e->name, MONSTER_DESC_FILE) ||
+                   !strcmp(e->name, OBJECT_DESC_FILE))) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Parses into a scratch dungeon, since that's what the parser fills in, *
+ * and moves the results into a set of their own.  The parser's          *
+ * complaints would land on top of the game's screen, so they go to a    *
+ * stream of the watcher's own, and only their number is kept.  A file   *
+ * that's gone is stood in for by its built-in table, as at start up.    */
+static description_set *reload_parse(void)
+{
+  std::ostringstream complaints;
+  description_set *s;
+  dungeon_t *scratch;
+  uint32_t failed, discarded;
+
+  scratch = new dungeon_t();
+  failed = parse_description_files(scratch,
+                                   description_file(MONSTER_DESC_FILE),
+                                   description_file(OBJECT_DESC_FILE),
+                                   complaints, &discarded);
+  if (scratch->monster_descriptions.empty()) {
+    builtin_monster_descriptions(scratch);
+  }
+  if (scratch->object_descriptions.empty()) {
+    builtin_object_descriptions(scratch);
+  }
+
+  /* A game can't go on without something to spawn */
+  s = NULL;
+  if (!failed && scratch->monster_descriptions.size() &&
+      scratch->object_descriptions.size()) {
+    s = new description_set();
+    s->monster_descriptions.swap(scratch->monster_descriptions);
+    s->object_descriptions.swap(scratch->object_descriptions);
+    s->description_text.swap(scratch->description_text);
+    s->discarded = discarded;
+  }
+  destroy_descriptions(scratch);
+  delete scratch;
+
+  return s;
+}
+
+static void *reload_main(void *unused)
+{
+  char buf[4096]
+    __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  struct pollfd p[2];
+  description_set *s;
+  uint32_t changed;
+  ssize_t n;
+
+  p[0].fd = reload.watch;
+  p[0].events = POLLIN;
+  p[1].fd = reload.stop[0];
+  p[1].events = POLLIN;
+
+  for (changed = 0;;) {
+    /* Once something has changed, wait for a quiet spell before parsing */
+    if (poll(p, 2, changed ? RELOAD_SETTLE_MS : -1) < 0) {
+      continue;
+    }
+    if (p[1].revents) {
+      break;
+    }
+    if (p[0].revents & POLLIN) {
+      if ((n = read(reload.watch, buf, sizeof (buf))) > 0) {
+        changed |= reload_relevant(buf, n);
+      }
+      continue;
+    }
+    if (!changed) {
+      continue;
+    }
+
+    changed = 0;
+    if ((s = reload_parse())) {
+      /* One the game never picked up has nothing pointing into it */
+      delete __atomic_exchange_n(&reload.pending, s, __ATOMIC_ACQ_REL);
+    }
+  }
+
+  return NULL;
+}
+
+static void reload_child(void)
+{
+  reload.restart = reload.running;
+  reload.running = 0;
+  if (reload.restart) {
+    close(reload.watch);
+    close(reload.stop[0]);
+    close(reload.stop[1]);
+  }
+}
+
+static void reload_register_fork(void)
+{
+  pthread_atfork(NULL, NULL, reload_child);
+}
+
+int reload_start(void)
+{
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+  if (reload.running) {
+    return 0;
+  }
+
+  pthread_once(&once, reload_register_fork);
+
+  if ((reload.watch = inotify_init1(IN_CLOEXEC)) < 0) {
+    return 1;
+  }
+  if (inotify_add_watch(reload.watch, description_file("").c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+      pipe(reload.stop)) {
+    close(reload.watch);
+    return 1;
+  }
+  if (create_thread(&reload.thread, reload_main, NULL)) {
+    close(reload.watch);
+    close(reload.stop[0]);
+    close(reload.stop[1]);
+    return 1;
+  }
+  reload.running = 1;
+
+  return 0;
+}
+
+void reload_stop(void)
+{
+  if (!reload.running) {
+    return;
+  }
+
+  write(reload.stop[1], "", 1);
+  pthread_join(reload.thread, NULL);
+  close(reload.watch);
+  close(reload.stop[0]);
+  close(reload.stop[1]);
+  reload.running = 0;
+
+  delete reload.pending;
+  reload.pending = NULL;
+}
+
+static bool in_set(const description_set *s, const monster_description *m)
+{
+  const std::vector<monster_description> &v = s->monster_descriptions;
+
+  return v.size() && m >= &v.front() && m <= &v.back();
+}
+
+static bool in_set(const description_set *s, const object_description *o)
+{
+  const std::vector<object_description> &v = s->object_descriptions;
+
+  return v.size() && o >= &v.front() && o <= &v.back();
+}
+
+/* The references to retired set s: a few thousand pointer comparisons */
+static uint32_t count_references(dungeon_t *d, const description_set *s)
+{
+  pc *the_pc = d->the_pc;
+  uint32_t x, y, i, refs;
+  object *o;
+
+  for (refs = 0, i = PC_ID + 1; i < d->characters.size(); i++) {
+    refs += d->characters.alive[i] && in_set(s, d->characters.archetype[i]);
+  }
+  for (y = 0; y < DUNGEON_Y; y++) {
+    for (x = 0; x < DUNGEON_X; x++) {
+      for (o = d->objmap[y][x]; o; o = o->get_next()) {
+        refs += in_set(s, o->get_archetype());
+      }
+    }
+  }
+  for (i = 0; i < num_eq_slots; i++) {
+    refs += the_pc->eq[i] && in_set(s, the_pc->eq[i]->get_archetype());
+  }
+  for (i = 0; i < MAX_INVENTORY; i++) {
+    refs += the_pc->in[i] && in_set(s, the_pc->in[i]->get_archetype());
+  }
+
+  return refs;
+}
+
+void reload_poll(dungeon_t *d)
+{
+  description_set *s;
+  uint32_t i;
+
+  if (!reload.running && reload.restart) {
+    reload.restart = 0;
+    reload_start();
+  }
+
+  if ((s = __atomic_exchange_n(&reload.pending, NULL, __ATOMIC_ACQ_REL))) {
+    /* s takes the old descriptions into retirement */
+    d->monster_descriptions.swap(s->monster_descriptions);
+    d->object_descriptions.swap(s->object_descriptions);
+    d->description_text.swap(s->description_text);
+    d->monster_spawn.clear();
+    d->object_spawn.clear();
+    d->retired_descriptions.push_back(s);
+    if (s->discarded) {
+      io_queue_message("Reloaded %lu monsters and %lu objects; "
+                       "%u discarded.",
+                       d->monster_descriptions.size(),
+                       d->object_descriptions.size(), s->discarded);
+    } else {
+      io_queue_message("Reloaded %lu monsters and %lu objects.",
+                       d->monster_descriptions.size(),
+                       d->object_descriptions.size());
+    }
+  }
+
+  for (i = 0; i < d->retired_descriptions.size(); ) {
+    if (count_references(d, d->retired_descriptions[i])) {
+      i++;
+    } else {
+      delete d->retired_descriptions[i];
+      d->retired_descriptions.erase(d->retired_descriptions.begin() + i);
+    }
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef RELOAD_H
+# define RELOAD_H
+
+# include <stdint.h>
+# include <vector>
+
+# include "descriptions.h"
+# include "intern.h"
+
+typedef struct dungeon dungeon_t;
+
+/* Live reloading of the description files.  A watcher thread waits on  *
+ * inotify for either file to be rewritten or renamed into place, lets   *
+ * the editor finish, and parses both into a description_set of its own. *
+ * The game only ever sees a finished set: between turns, reload_poll()  *
+ * takes it and swaps it with the dungeon's descriptions, which is a few *
+ * pointer swaps, so the parse never holds up the game.                  *
+ *                                                                       *
+ * NPCs and objects point into the descriptions they were made from, so  *
+ * the set that was swapped out is retired rather than freed.  Retired   *
+ * sets are counted against the live NPCs and objects as the game goes   *
+ * on, and each is freed once nothing refers to it.  New spawns come     *
+ * from the new set.                                                     *
+ *                                                                       *
+ * A reload can't be journaled, so reloading is off for recorded and     *
+ * replayed games.  fork() copies only the calling thread; a checkpoint  *
+ * starts a watcher of its own if it's ever resumed.                     */
+
+# define RELOAD_SETTLE_MS 100 /* Quiet needed after a change before a parse */
+
+class description_set {
+ public:
+  std::vector<monster_description> monster_descriptions;
+  std::vector<object_description> object_descriptions;
+  string_arena description_text;
+  uint32_t discarded;        /* Entries the parse threw out */
+  description_set() : discarded(0) {}
+};
+
+int reload_start(void);
+/* Between turns: swaps in a newly parsed set, if there is one, and frees *
+ * the retired sets that nothing refers to any more.                      */
+void reload_poll(dungeon_t *d);
+void reload_stop(void);
+
+#endif
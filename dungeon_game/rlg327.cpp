@@ -12,6 +12,16 @@
 #include "move.h"
 #include "io.h"
 #include "object.h"
+#include "utils.h"
+#include "corpus.h"
+#include "sim.h"
+#include "save.h"
+#include "archive.h"
+#include "journal.h"
+#include "checkpoint.h"
+#include "reload.h"
+#include "decide.h"
+#include "builtin.h"
 
 const char *victory =
   "\n                                       o\n"
@@ -70,10 +80,24 @@ const char *tombstone =
 void usage(char *name)
 {
   fprintf(stderr,
-          "Usage: %s [-r|--rand <seed>] [-l|--load [<file>]]\n"
-          "       [-i|--image <pgm>] [-s|--save] "
-          "[-n|--nummon <num monsters>]\n",
-          name);
+          "Usage: %s [-r|--rand <seed>] "
+          "[-l|--load [<file>|<archive.rla>#<seed>]]\n"
+          "       [-i|--image <pgm>] [-s|--save] [-z|--compress] "
+          "[-n|--nummon <num monsters>]\n"
+          "       [--journal <file>] [--checkpoints] [-t|--threads <n>]\n"
+          "       %s -g|--generate <count> --out <dir> [-t|--threads <n>]\n"
+          "       [-r|--rand <seed>] [-z|--compress]\n"
+          "       %s --repack <file>... [-z|--compress]\n"
+          "       %s --append <archive.rla> <file or dir>... | "
+          "--list <archive.rla> |\n"
+          "       --extract <archive.rla> <seed> [<file>]\n"
+          "       %s --replay <journal> [--stop <turn>] [--journal <file>]\n"
+          "       [-t|--threads <n>]\n"
+          "       %s --simulate <games> [--turns <max turns>] "
+          "[-t|--threads <n>]\n"
+          "       [--out <csv>] [-r|--rand <seed>] [-n|--nummon <num>] "
+          "[-o|--objcount <num>]\n",
+          name, name, name, name, name, name);
 
   exit(-1);
 }
@@ -86,8 +110,22 @@ int main(int argc, char *argv[])
   uint32_t i;
   uint32_t do_load, do_save, do_seed, do_image;
   uint32_t long_arg;
+  uint32_t generate_count, threads, simulate_count, max_turns;
+  uint32_t turns;
+  char **repack_files;
+  uint32_t repack_count, failed;
+  char *archive_file, **archive_args;
+  uint32_t archive_count, archive_seed;
+  char archive_op;
+  char *journal_file, *replay_file;
+  uint32_t stop_turn;
+  journal_t journal, replay;
+  uint8_t *image;
+  uint32_t size;
+  double elapsed;
   char *save_file;
   char *pgm_file;
+  char *out_dir;
   string player_name;
   
   memset(&d, 0, sizeof (d));
@@ -97,6 +135,18 @@ int main(int argc, char *argv[])
   do_load = do_save = do_image = 0;
   do_seed = 1;
   save_file = NULL;
+  generate_count = simulate_count = repack_count = 0;
+  repack_files = NULL;
+  archive_op = 0;
+  archive_file = NULL;
+  archive_args = NULL;
+  archive_count = archive_seed = 0;
+  journal_file = replay_file = NULL;
+  stop_turn = 0;
+  memset(&journal, 0, sizeof (journal));
+  max_turns = 10000;
+  threads = sysconf(_SC_NPROCESSORS_ONLN);
+  out_dir = NULL;
   d.max_monsters = 10;
   d.max_objects = 10;
 
@@ -123,6 +173,24 @@ int main(int argc, char *argv[])
         }
         switch (argv[i][1]) {
         case 'r':
+          if (long_arg && !strcmp(argv[i], "-replay")) {
+            if (argc < ++i + 1 /* No more arguments */) {
+              usage(argv[0]);
+            }
+            replay_file = argv[i];
+            break;
+          }
+          if (long_arg && !strcmp(argv[i], "-repack")) {
+            /* Every argument up to the next switch is a save file */
+            for (repack_files = argv + i + 1;
+                 i + 1 < argc && argv[i + 1][0] != '-';
+                 i++, repack_count++)
+              ;
+            if (!repack_count) {
+              usage(argv[0]);
+            }
+            break;
+          }
           if ((!long_arg && argv[i][2]) ||
               (long_arg && strcmp(argv[i], "-rand")) ||
               argc < ++i + 1 /* No more arguments */ ||
@@ -131,7 +199,42 @@ int main(int argc, char *argv[])
           }
           do_seed = 0;
           break;
+        case 'a':
+          if (!long_arg || strcmp(argv[i], "-append") ||
+              argc < ++i + 1 /* No more arguments */) {
+            usage(argv[0]);
+          }
+          archive_op = 'a';
+          archive_file = argv[i];
+          for (archive_args = argv + i + 1;
+               i + 1 < argc && argv[i + 1][0] != '-';
+               i++, archive_count++)
+            ;
+          if (!archive_count) {
+            usage(argv[0]);
+          }
+          break;
+        case 'e':
+          if (!long_arg || strcmp(argv[i], "-extract") ||
+              argc < ++i + 2 /* An archive and a seed */ ||
+              !sscanf(argv[i + 1], "%u", &archive_seed)) {
+            usage(argv[0]);
+          }
+          archive_op = 'e';
+          archive_file = argv[i++];
+          if ((argc > i + 1) && argv[i + 1][0] != '-') {
+            archive_args = argv + ++i;
+          }
+          break;
         case 'l':
+          if (long_arg && !strcmp(argv[i], "-list")) {
+            if (argc < ++i + 1 /* No more arguments */) {
+              usage(argv[0]);
+            }
+            archive_op = 'l';
+            archive_file = argv[i];
+            break;
+          }
           if ((!long_arg && argv[i][2]) ||
               (long_arg && strcmp(argv[i], "-load"))) {
             usage(argv[0]);
@@ -143,13 +246,47 @@ int main(int argc, char *argv[])
             save_file = argv[++i];
           }
           break;
+        case 'c':
+          if (!long_arg || strcmp(argv[i], "-checkpoints")) {
+            usage(argv[0]);
+          }
+          d.checkpoints = 1;
+          break;
+        case 'j':
+          if (!long_arg || strcmp(argv[i], "-journal") ||
+              argc < ++i + 1 /* No more arguments */) {
+            usage(argv[0]);
+          }
+          journal_file = argv[i];
+          break;
         case 's':
+          if (long_arg && !strcmp(argv[i], "-stop")) {
+            if (argc < ++i + 1 /* No more arguments */ ||
+                !sscanf(argv[i], "%u", &stop_turn)) {
+              usage(argv[0]);
+            }
+            break;
+          }
+          if (long_arg && !strcmp(argv[i], "-simulate")) {
+            if (argc < ++i + 1 /* No more arguments */ ||
+                !sscanf(argv[i], "%u", &simulate_count)) {
+              usage(argv[0]);
+            }
+            break;
+          }
           if ((!long_arg && argv[i][2]) ||
               (long_arg && strcmp(argv[i], "-save"))) {
             usage(argv[0]);
           }
           do_save = 1;
           break;
+        case 'z':
+          if ((!long_arg && argv[i][2]) ||
+              (long_arg && strcmp(argv[i], "-compress"))) {
+            usage(argv[0]);
+          }
+          d.compress_saves = 1;
+          break;
         case 'i':
           if ((!long_arg && argv[i][2]) ||
               (long_arg && strcmp(argv[i], "-image"))) {
@@ -170,7 +307,38 @@ int main(int argc, char *argv[])
             usage(argv[0]);
           }
           break;
+        case 'g':
+          if ((!long_arg && argv[i][2]) ||
+              (long_arg && strcmp(argv[i], "-generate")) ||
+              argc < ++i + 1 /* No more arguments */ ||
+              !sscanf(argv[i], "%u", &generate_count)) {
+            usage(argv[0]);
+          }
+          break;
+        case 't':
+          if (long_arg && !strcmp(argv[i], "-turns")) {
+            if (argc < ++i + 1 /* No more arguments */ ||
+                !sscanf(argv[i], "%u", &max_turns)) {
+              usage(argv[0]);
+            }
+            break;
+          }
+          if ((!long_arg && argv[i][2]) ||
+              (long_arg && strcmp(argv[i], "-threads")) ||
+              argc < ++i + 1 /* No more arguments */ ||
+              !sscanf(argv[i], "%u", &threads)) {
+            usage(argv[0]);
+          }
+          break;
         case 'o':
+          /* '-o' was already taken by '--objcount', so '--out' is long only */
+          if (long_arg && !strcmp(argv[i], "-out")) {
+            if (argc < ++i + 1 /* No more arguments */) {
+              usage(argv[0]);
+            }
+            out_dir = argv[i];
+            break;
+          }
           if ((!long_arg && argv[i][2]) ||
               (long_arg && strcmp(argv[i], "-objcount")) ||
               argc < ++i + 1 /* No more arguments */ ||
@@ -187,6 +355,23 @@ int main(int argc, char *argv[])
     }
   }
 
+  if (d.checkpoints && (journal_file || replay_file)) {
+    /* A rewind would leave keys in the journal that never happened */
+    fprintf(stderr, "Checkpoints can't be used with a journal.\n");
+    return 1;
+  }
+
+  if (replay_file) {
+    /* The journal says how the game started; nothing is written back. */
+    if (journal_open(&replay, replay_file)) {
+      return 1;
+    }
+    seed = replay.seed;
+    d.max_monsters = replay.max_monsters;
+    d.max_objects = replay.max_objects;
+    do_seed = do_load = do_image = do_save = 0;
+  }
+
   if (do_seed) {
     /* Allows me to generate more than one dungeon *
      * per second, as opposed to time().           */
@@ -194,16 +379,69 @@ int main(int argc, char *argv[])
     seed = (tv.tv_usec ^ (tv.tv_sec << 20)) & 0xffffffff;
   }
 
-  cout << "Type your name: ";
-  cin >> player_name;
+  if (generate_count) {
+    if (!out_dir) {
+      usage(argv[0]);
+    }
+
+    return generate_corpus(generate_count, out_dir, threads, seed,
+                           d.compress_saves);
+  }
+
+  switch (archive_op) {
+  case 'a':
+    return archive_append(archive_file, archive_args, archive_count);
+  case 'l':
+    return archive_list(archive_file);
+  case 'e':
+    return archive_extract(archive_file, archive_seed,
+                           archive_args ? archive_args[0] : NULL);
+  }
+
+  if (repack_count) {
+    for (i = failed = 0; i < repack_count; i++) {
+      failed += save_file_repack(repack_files[i], d.compress_saves);
+    }
+
+    return !!failed;
+  }
+
+  if (simulate_count) {
+    parse_descriptions(&d);
+    i = run_simulations(&d, simulate_count, threads, seed, max_turns, out_dir);
+    destroy_descriptions(&d);
+
+    return i;
+  }
+
+  if (replay_file) {
+    player_name = replay.player_name;
+  } else {
+    cout << "Type your name: ";
+    cin >> player_name;
+  }
   
   printf("Seed is %ld.\n", seed);
-  srand(seed);
+  rng_seed(seed);
 
   parse_descriptions(&d);
   init_dungeon(&d);
 
-  if (do_load) {
+  if (replay_file) {
+    if (replay.monster_hash != description_hash(MONSTER_DESC_FILE) ||
+        replay.object_hash != description_hash(OBJECT_DESC_FILE)) {
+      fprintf(stderr, "Warning: The descriptions have changed since %s "
+              "was recorded; the replay may not match.\n", replay_file);
+    }
+    if (replay.start && snapshot_load(&d, replay.start, replay.start_size)) {
+      fprintf(stderr, "%s: Corrupt starting snapshot.\n", replay_file);
+      return 1;
+    }
+  }
+
+  if (replay_file && replay.start) {
+    /* Loaded above */
+  } else if (do_load) {
     read_dungeon(&d, save_file);
   } else if (do_image) {
     read_pgm(&d, pgm_file);
@@ -211,45 +449,113 @@ int main(int argc, char *argv[])
     gen_dungeon(&d);
   }
 
-  config_pc(&d);
-  gen_monsters(&d, d.max_monsters, 0);
-  gen_objects(&d, d.max_objects);
+  /* A saved game brings its own PC, monsters and objects. */
+  if (!d.the_pc) {
+    config_pc(&d);
+    gen_monsters(&d, d.max_monsters, 0);
+    gen_objects(&d, d.max_objects);
+  }
 
-  io_init_terminal(&d);
+  if (journal_file) {
+    journal.seed = seed;
+    journal.monster_hash = description_hash(MONSTER_DESC_FILE);
+    journal.object_hash = description_hash(OBJECT_DESC_FILE);
+    journal.max_monsters = d.max_monsters;
+    journal.max_objects = d.max_objects;
+    journal.player_name = (char *) player_name.c_str();
+    /* Only a dungeon generated from the seed can be generated again */
+    if (do_load || do_image || (replay_file && replay.start)) {
+      journal.start = snapshot_save(&d, &journal.start_size);
+    }
+    if (journal_create(&journal, journal_file)) {
+      return 1;
+    }
+    free(journal.start);
+    io_record(&journal);
+  }
+
+  gettimeofday(&tv, NULL);
+  elapsed = tv.tv_sec + tv.tv_usec / 1000000.0;
+  if (replay_file) {
+    io_replay(&d, &replay, stop_turn);
+  } else {
+    io_init_terminal(&d);
+  }
   pc_observe_terrain(d.the_pc, &d);
   io_menu_display(&d);
   //io_display(&d);
   io_display_all(&d);
   //io_initial_display(&d);
+  if (do_save) {
+    autosave_start();
+  }
+  if (!journal_file && !replay_file) {
+    reload_start();
+  }
+  /* NPCs decide on the pool; see decide.h */
+  if (threads > 1) {
+    decide_start(threads);
+  }
+  turns = 0;
   while (pc_is_alive(&d) && dungeon_has_npcs(&d) && !d.save_and_exit) {
+    reload_poll(&d);
     do_moves(&d);
     if (!pc_is_alive(&d)) {
        break;
     }
+    if (do_save && !(++turns % AUTOSAVE_TURNS)) {
+      /* A forked copy does the serialising, off to one side */
+      if (!d.checkpoints || checkpoint_autosave(&d, NULL)) {
+        autosave_dungeon(&d, NULL);
+      }
+    }
   }
-  //io_display(&d);
-  io_display_all(&d);
-  if (!d.save_and_exit) {
-    sleep(2);
+  gettimeofday(&tv, NULL);
+  elapsed = tv.tv_sec + tv.tv_usec / 1000000.0 - elapsed;
+  if (!io_is_headless()) {
+    //io_display(&d);
+    io_display_all(&d);
+    if (!d.save_and_exit) {
+      sleep(2);
+    }
   }
 
   io_reset_terminal();
+  reload_stop();
+  decide_stop();
+  journal_close(&journal);
+  checkpoint_discard_all();
 
   if (do_save) {
-    //write_dungeon(&d);
+    /* Drain the autosaves first, so the final save can't be overwritten. */
+    autosave_stop();
+    if (pc_is_alive(&d)) {
+      write_dungeon(&d, NULL);
+    }
   }
 
-  write_ranking(&d,player_name); 
-  printf(pc_is_alive(&d) ? victory : tombstone);
+  if (replay_file) {
+    printf("Replayed %u keys, %u turns in %.3fs: %.0f turns/s.\n",
+           replay.keys_read, io_turn(), elapsed, io_turn() / elapsed);
+    if (pc_is_alive(&d)) {
+      image = snapshot_save(&d, &size);
+      printf("PC alive with %d HP, %u monsters beaten, state %016llx.\n",
+             d.characters.hp[PC_ID], d.nummon_beaten,
+             (unsigned long long) journal_hash(image, size));
+      free(image);
+    } else {
+      printf("PC killed by %s, %u monsters beaten.\n",
+             d.pc_killed_by ? d.pc_killed_by : "something", d.nummon_beaten);
+    }
+    journal_close(&replay);
+  } else {
+    write_ranking(&d,player_name); 
+    printf(pc_is_alive(&d) ? victory : tombstone);
+  }
 
   /* PC can't be deleted with the dungeon, else *
    * it disappears when we use the stairs.      */
-  if (pc_is_alive(&d)) {
-    /* If the PC is dead, it's in the move heap and will get automatically *
-     * deleted when the heap destructs.  In that case, we can't call       *
-     * delete_pc(), because it will lead to a double delete.               */
-    delete_pc(d.the_pc);
-  }
+  delete_pc(d.the_pc);
   delete_dungeon(&d);
   destroy_descriptions(&d);
 
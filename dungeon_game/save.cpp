@@ -0,0 +1,846 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "save.h"
+#include "codec.h"
+#include "dungeon.h"
+#include "heap.h"
+#include "npc.h"
+#include "pc.h"
+#include "path.h"
+#include "utils.h"
+
+#define align(n) (((n) + SNAPSHOT_ALIGN - 1) & ~(SNAPSHOT_ALIGN - 1))
+
+#define section_of(image, hdr, id, type)                                \
+  ((type *) ((image) + (hdr)->section[id].offset))
+
+/* NPCs and objects point at their descriptions.  Something made      *
+ * before a reload (see reload.h) points into a retired set, and goes  *
+ * by its name instead; one whose description has gone altogether     *
+ * becomes the first.                                                  */
+template <class description>
+static uint32_t description_index(const std::vector<description> &v,
+                                  const description *p)
+{
+  uint32_t i;
+
+  if (v.size() && p >= &v.front() && p <= &v.back()) {
+    return p - &v.front();
+  }
+  for (i = 0; i < v.size(); i++) {
+    if (v[i].get_name() == p->get_name()) {
+      return i;
+    }
+  }
+
+  return 0;
+}
+
+static uint32_t monster_index(dungeon_t *d, character_id_t c)
+{
+  return description_index(d->monster_descriptions,
+                           d->characters.archetype[c]);
+}
+
+static uint32_t object_index(dungeon_t *d, object *o)
+{
+  return description_index(d->object_descriptions, o->get_archetype());
+}
+
+static void save_object(dungeon_t *d, snapshot_object_t *r, object *o,
+                        snapshot_location_t location, uint32_t slot,
+                        uint32_t x, uint32_t y)
+{
+  r->description = object_index(d, o);
+  r->location = location;
+  r->slot = slot;
+  r->position[dim_x] = x;
+  r->position[dim_y] = y;
+  o->get_stats(&r->stats);
+  r->seen = o->have_seen();
+}
+
+uint8_t *snapshot_save(dungeon_t *d, uint32_t *size)
+{
+  pc *the_pc = d->the_pc;
+  character_table &t = d->characters;
+  snapshot_header_t *hdr;
+  snapshot_game_t *g;
+  snapshot_npc_t *n;
+  snapshot_object_t *o;
+  uint8_t *image;
+  object *obj;
+  character_id_t c;
+  uint32_t i, x, y, offset, num_npcs, num_objects;
+  uint32_t be32;
+
+  for (num_npcs = num_objects = 0, y = 0; y < DUNGEON_Y; y++) {
+    for (x = 0; x < DUNGEON_X; x++) {
+      num_npcs += d->charmap[y][x] && d->charmap[y][x] != PC_ID;
+      for (obj = d->objmap[y][x]; obj; obj = obj->get_next()) {
+        num_objects++;
+      }
+    }
+  }
+  for (i = 0; i < num_eq_slots; i++) {
+    num_objects += !!the_pc->eq[i];
+  }
+  for (i = 0; i < MAX_INVENTORY; i++) {
+    num_objects += !!the_pc->in[i];
+  }
+
+  /* Lay out the sections */
+  hdr = (snapshot_header_t *) calloc(1, sizeof (*hdr));
+  hdr->byte_order = SNAPSHOT_BYTE_ORDER;
+  hdr->num_sections = num_snapshot_sections;
+  hdr->section[snap_game].size = sizeof (snapshot_game_t);
+  hdr->section[snap_game].count = 1;
+  hdr->section[snap_rooms].size = d->num_rooms * sizeof (room_t);
+  hdr->section[snap_rooms].count = d->num_rooms;
+  hdr->section[snap_map].size = DUNGEON_Y * DUNGEON_X;
+  hdr->section[snap_map].count = DUNGEON_Y;
+  hdr->section[snap_hardness].size = DUNGEON_Y * DUNGEON_X;
+  hdr->section[snap_hardness].count = DUNGEON_Y;
+  hdr->section[snap_known].size = sizeof (the_pc->known_terrain);
+  hdr->section[snap_known].count = DUNGEON_Y;
+  hdr->section[snap_npcs].size = num_npcs * sizeof (snapshot_npc_t);
+  hdr->section[snap_npcs].count = num_npcs;
+  hdr->section[snap_objects].size = num_objects * sizeof (snapshot_object_t);
+  hdr->section[snap_objects].count = num_objects;
+  hdr->section[snap_level].size = sizeof (snapshot_level_t);
+  hdr->section[snap_level].count = 1;
+
+  offset = align(SNAPSHOT_HEADER_OFFSET + sizeof (*hdr));
+  for (i = 0; i < num_snapshot_sections; i++) {
+    hdr->section[i].offset = offset;
+    offset = align(offset + hdr->section[i].size);
+  }
+  *size = offset;
+
+  image = (uint8_t *) calloc(1, *size);
+  memcpy(image + SNAPSHOT_HEADER_OFFSET, hdr, sizeof (*hdr));
+  free(hdr);
+  hdr = (snapshot_header_t *) (image + SNAPSHOT_HEADER_OFFSET);
+
+  /* The same 14 bytes that start a version 0 file */
+  memcpy(image, DUNGEON_SAVE_SEMANTIC, strlen(DUNGEON_SAVE_SEMANTIC));
+  be32 = htobe32(DUNGEON_SAVE_VERSION);
+  memcpy(image + 6, &be32, sizeof (be32));
+  be32 = htobe32(*size);
+  memcpy(image + 10, &be32, sizeof (be32));
+
+  g = section_of(image, hdr, snap_game, snapshot_game_t);
+  g->character_sequence_number = d->character_sequence_number;
+  g->num_monsters = d->num_monsters;
+  g->nummon_beaten = d->nummon_beaten;
+  g->max_monsters = d->max_monsters;
+  g->num_objects = d->num_objects;
+  g->max_objects = d->max_objects;
+  g->pc_position[dim_x] = t.position[PC_ID][dim_x];
+  g->pc_position[dim_y] = t.position[PC_ID][dim_y];
+  g->pc_speed = t.speed[PC_ID];
+  g->pc_next_turn = t.next_turn[PC_ID];
+  g->pc_hp = t.hp[PC_ID];
+  g->rng = *rng_current();
+  section_of(image, hdr, snap_level, snapshot_level_t)->depth = d->depth;
+
+  memcpy(section_of(image, hdr, snap_rooms, room_t), d->rooms,
+         hdr->section[snap_rooms].size);
+  for (y = 0; y < DUNGEON_Y; y++) {
+    d->map.get_row(y, (section_of(image, hdr, snap_map, terrain_type_t) +
+                       y * DUNGEON_X));
+    d->hardness.get_row(y, (section_of(image, hdr, snap_hardness, uint8_t) +
+                            y * DUNGEON_X));
+  }
+  memcpy(section_of(image, hdr, snap_known, uint8_t), the_pc->known_terrain,
+         sizeof (the_pc->known_terrain));
+
+  n = section_of(image, hdr, snap_npcs, snapshot_npc_t);
+  o = section_of(image, hdr, snap_objects, snapshot_object_t);
+  for (y = 0; y < DUNGEON_Y; y++) {
+    for (x = 0; x < DUNGEON_X; x++) {
+      if (d->charmap[y][x] && d->charmap[y][x] != PC_ID) {
+        c = d->charmap[y][x];
+        n->description = monster_index(d, c);
+        n->position[dim_x] = t.position[c][dim_x];
+        n->position[dim_y] = t.position[c][dim_y];
+        n->pc_last_known_position[dim_x] = t.pc_last_known_position[c][dim_x];
+        n->pc_last_known_position[dim_y] = t.pc_last_known_position[c][dim_y];
+        n->speed = t.speed[c];
+        n->next_turn = t.next_turn[c];
+        n->hp = t.hp[c];
+        n->sequence_number = t.sequence_number[c];
+        n->characteristics = t.characteristics[c];
+        n->have_seen_pc = t.have_seen_pc[c];
+        n++;
+      }
+      for (obj = d->objmap[y][x]; obj; obj = obj->get_next()) {
+        save_object(d, o++, obj, snap_floor, 0, x, y);
+      }
+    }
+  }
+  for (i = 0; i < num_eq_slots; i++) {
+    if (the_pc->eq[i]) {
+      save_object(d, o++, the_pc->eq[i], snap_equipment, i, 0, 0);
+    }
+  }
+  for (i = 0; i < MAX_INVENTORY; i++) {
+    if (the_pc->in[i]) {
+      save_object(d, o++, the_pc->in[i], snap_inventory, i, 0, 0);
+    }
+  }
+
+  return image;
+}
+
+static int check_section(const snapshot_header_t *hdr, uint32_t size,
+                         uint32_t id, uint32_t record_size)
+{
+  const snapshot_section_t *s = hdr->section + id;
+
+  if (s->encoding || (s->offset % SNAPSHOT_ALIGN) || s->offset > size ||
+      s->size > size - s->offset || s->size != s->count * record_size) {
+    fprintf(stderr, "Corrupt save file section %u.\n", id);
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Inside the immutable border, where anything on the level can be */
+static int snapshot_position_ok(const int8_t position[2])
+{
+  return (position[dim_x] >= 1 && position[dim_x] <= DUNGEON_X - 2 &&
+          position[dim_y] >= 1 && position[dim_y] <= DUNGEON_Y - 2);
+}
+
+/* Everything that goes on to index a grid, or into 1000 / speed */
+static int snapshot_characters_ok(const uint8_t *image,
+                                  const snapshot_header_t *hdr)
+{
+  const snapshot_game_t *g;
+  const snapshot_npc_t *n;
+  const snapshot_object_t *o;
+  uint32_t i;
+
+  g = section_of(image, hdr, snap_game, const snapshot_game_t);
+  if (!snapshot_position_ok(g->pc_position) || g->pc_speed <= 0) {
+    return 0;
+  }
+  n = section_of(image, hdr, snap_npcs, const snapshot_npc_t);
+  for (i = 0; i < hdr->section[snap_npcs].count; i++) {
+    if (!snapshot_position_ok(n[i].position) || n[i].speed <= 0) {
+      return 0;
+    }
+  }
+  o = section_of(image, hdr, snap_objects, const snapshot_object_t);
+  for (i = 0; i < hdr->section[snap_objects].count; i++) {
+    if (o[i].location == snap_floor && !snapshot_position_ok(o[i].position)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int snapshot_load(dungeon_t *d, const uint8_t *image, uint32_t size)
+{
+  const snapshot_header_t *hdr;
+  const snapshot_game_t *g;
+  const snapshot_npc_t *n;
+  const snapshot_object_t *o;
+  character_table &t = d->characters;
+  pc *the_pc;
+  character_id_t c;
+  object *obj;
+  pair_t p;
+  uint32_t i, y;
+
+  hdr = (const snapshot_header_t *) (image + SNAPSHOT_HEADER_OFFSET);
+  if (size < SNAPSHOT_HEADER_OFFSET + sizeof (*hdr)) {
+    fprintf(stderr, "Save file truncated.\n");
+    return 1;
+  }
+  if (hdr->byte_order != SNAPSHOT_BYTE_ORDER) {
+    fprintf(stderr, "Save file is from a machine of different byte order.\n");
+    return 1;
+  }
+  if (hdr->num_sections < num_snapshot_sections ||
+      check_section(hdr, size, snap_game, sizeof (snapshot_game_t)) ||
+      check_section(hdr, size, snap_rooms, sizeof (room_t)) ||
+      check_section(hdr, size, snap_map, DUNGEON_X) ||
+      check_section(hdr, size, snap_hardness, DUNGEON_X) ||
+      check_section(hdr, size, snap_known, DUNGEON_X) ||
+      check_section(hdr, size, snap_npcs, sizeof (snapshot_npc_t)) ||
+      check_section(hdr, size, snap_objects, sizeof (snapshot_object_t)) ||
+      check_section(hdr, size, snap_level, sizeof (snapshot_level_t)) ||
+      hdr->section[snap_game].count != 1 ||
+      hdr->section[snap_rooms].count < 1 ||
+      hdr->section[snap_map].count != DUNGEON_Y ||
+      hdr->section[snap_hardness].count != DUNGEON_Y ||
+      hdr->section[snap_known].count != DUNGEON_Y ||
+      hdr->section[snap_level].count != 1 ||
+      !snapshot_characters_ok(image, hdr)) {
+    fprintf(stderr, "Corrupt save file.\n");
+    return 1;
+  }
+
+  g = section_of(image, hdr, snap_game, const snapshot_game_t);
+  d->character_sequence_number = g->character_sequence_number;
+  d->num_monsters = g->num_monsters;
+  d->nummon_beaten = g->nummon_beaten;
+  d->max_monsters = g->max_monsters;
+  d->num_objects = g->num_objects;
+  d->max_objects = g->max_objects;
+  d->depth = section_of(image, hdr, snap_level,
+                        const snapshot_level_t)->depth;
+
+  d->num_rooms = hdr->section[snap_rooms].count;
+  d->rooms = (room_t *) malloc(hdr->section[snap_rooms].size);
+  memcpy(d->rooms, section_of(image, hdr, snap_rooms, const room_t),
+         hdr->section[snap_rooms].size);
+  for (y = 0; y < DUNGEON_Y; y++) {
+    d->map.set_row(y, (section_of(image, hdr, snap_map,
+                                  const terrain_type_t) + y * DUNGEON_X));
+    d->hardness.set_row(y, (section_of(image, hdr, snap_hardness,
+                                       const uint8_t) + y * DUNGEON_X));
+  }
+
+  d->the_pc = the_pc = new_pc(d);
+  t.position[PC_ID][dim_x] = g->pc_position[dim_x];
+  t.position[PC_ID][dim_y] = g->pc_position[dim_y];
+  t.speed[PC_ID] = g->pc_speed;
+  t.next_turn[PC_ID] = g->pc_next_turn;
+  t.hp[PC_ID] = g->pc_hp;
+  memcpy(the_pc->known_terrain, section_of(image, hdr, snap_known,
+                                           const uint8_t),
+         sizeof (the_pc->known_terrain));
+  charpair(t.position[PC_ID]) = PC_ID;
+
+  n = section_of(image, hdr, snap_npcs, const snapshot_npc_t);
+  for (i = 0; i < hdr->section[snap_npcs].count; i++, n++) {
+    if (n->description >= d->monster_descriptions.size()) {
+      fprintf(stderr, "Save file refers to monster description %u, "
+              "but only %lu are loaded.\n", n->description,
+              (unsigned long) d->monster_descriptions.size());
+      return 1;
+    }
+    if ((c = new_npc(d, d->monster_descriptions[n->description])) ==
+        NO_CHARACTER) {
+      fprintf(stderr, "Save file has more than %u monsters.\n", i);
+      return 1;
+    }
+    t.position[c][dim_x] = n->position[dim_x];
+    t.position[c][dim_y] = n->position[dim_y];
+    t.pc_last_known_position[c][dim_x] = n->pc_last_known_position[dim_x];
+    t.pc_last_known_position[c][dim_y] = n->pc_last_known_position[dim_y];
+    t.speed[c] = n->speed;
+    t.next_turn[c] = n->next_turn;
+    t.hp[c] = n->hp;
+    t.alive[c] = 1;
+    t.sequence_number[c] = n->sequence_number;
+    t.characteristics[c] = n->characteristics;
+    t.have_seen_pc[c] = n->have_seen_pc;
+    charpair(t.position[c]) = c;
+    d->next_turn.insert(t, c);
+  }
+
+  /* Backwards, so that pushing onto the piles restores their order. */
+  o = section_of(image, hdr, snap_objects, const snapshot_object_t);
+  for (i = hdr->section[snap_objects].count; i--; ) {
+    if (o[i].description >= d->object_descriptions.size()) {
+      fprintf(stderr, "Save file refers to object description %u, "
+              "but only %lu are loaded.\n", o[i].description,
+              (unsigned long) d->object_descriptions.size());
+      return 1;
+    }
+    p[dim_x] = o[i].position[dim_x];
+    p[dim_y] = o[i].position[dim_y];
+    switch (o[i].location) {
+    case snap_floor:
+      obj = new object(d->object_descriptions[o[i].description], p,
+                       d->objmap[p[dim_y]][p[dim_x]], o[i].stats,
+                       o[i].seen);
+      d->objmap[p[dim_y]][p[dim_x]] = obj;
+      break;
+    case snap_equipment:
+      if (o[i].slot >= num_eq_slots) {
+        fprintf(stderr, "Corrupt save file object %u.\n", i);
+        return 1;
+      }
+      the_pc->eq[o[i].slot] =
+        new object(d->object_descriptions[o[i].description], p, NULL,
+                   o[i].stats, o[i].seen);
+      break;
+    case snap_inventory:
+      if (o[i].slot >= MAX_INVENTORY) {
+        fprintf(stderr, "Corrupt save file object %u.\n", i);
+        return 1;
+      }
+      the_pc->in[o[i].slot] =
+        new object(d->object_descriptions[o[i].description], p, NULL,
+                   o[i].stats, o[i].seen);
+      break;
+    default:
+      fprintf(stderr, "Corrupt save file object %u.\n", i);
+      return 1;
+    }
+  }
+
+  pc_reset_visibility(the_pc);
+  pc_observe_terrain(the_pc, d);
+  dijkstra(d);
+  dijkstra_tunnel(d);
+
+  /* Last, so nothing above can disturb the restored stream. */
+  *rng_current() = g->rng;
+
+  return 0;
+}
+
+/* Offsets into version 0 level files */
+#define LEVEL_HEADER   14
+#define LEVEL_HARDNESS ((DUNGEON_X - 2) * (DUNGEON_Y - 2))
+
+static uint32_t image_version(const uint8_t *image)
+{
+  uint32_t be32;
+
+  memcpy(&be32, image + 6, sizeof (be32));
+
+  return be32toh(be32);
+}
+
+static void set_image_header(uint8_t *image, uint32_t version, uint32_t size)
+{
+  uint32_t be32;
+
+  memcpy(image, DUNGEON_SAVE_SEMANTIC, strlen(DUNGEON_SAVE_SEMANTIC));
+  be32 = htobe32(version);
+  memcpy(image + 6, &be32, sizeof (be32));
+  be32 = htobe32(size);
+  memcpy(image + 10, &be32, sizeof (be32));
+}
+
+/* The section table, read generically so that sections this build *
+ * doesn't know about are carried through too.                      */
+static snapshot_section_t *section_table(const uint8_t *image, uint32_t size,
+                                         uint32_t *num)
+{
+  const snapshot_header_t *hdr;
+
+  hdr = (const snapshot_header_t *) (image + SNAPSHOT_HEADER_OFFSET);
+  if (size < SNAPSHOT_HEADER_OFFSET + 2 * sizeof (uint32_t) ||
+      hdr->byte_order != SNAPSHOT_BYTE_ORDER ||
+      hdr->num_sections > (size - SNAPSHOT_HEADER_OFFSET - 2 *
+                           sizeof (uint32_t)) / sizeof (snapshot_section_t)) {
+    return NULL;
+  }
+  *num = hdr->num_sections;
+
+  return (snapshot_section_t *) hdr->section;
+}
+
+uint8_t *save_image_pack(const uint8_t *image, uint32_t size,
+                         uint32_t *packed_size)
+{
+  snapshot_section_t *in, *out;
+  uint8_t *packed;
+  uint32_t version, i, num, table, offset, stride;
+
+  version = image_version(image);
+  if (version & DUNGEON_SAVE_COMPRESSED) {
+    packed = (uint8_t *) malloc(size);
+    memcpy(packed, image, size);
+    *packed_size = size;
+
+    return packed;
+  }
+
+  if (version == DUNGEON_LEVEL_VERSION) {
+    packed = (uint8_t *) malloc(LEVEL_HEADER + pack_bound(LEVEL_HARDNESS) +
+                                pack_bound(size - LEVEL_HEADER -
+                                           LEVEL_HARDNESS));
+    offset = LEVEL_HEADER;
+    offset += pack_bytes(image + LEVEL_HEADER, LEVEL_HARDNESS,
+                         DUNGEON_X - 2, packed + offset);
+    offset += pack_bytes(image + LEVEL_HEADER + LEVEL_HARDNESS,
+                         size - LEVEL_HEADER - LEVEL_HARDNESS,
+                         4 /* Bytes per room */, packed + offset);
+  } else {
+    if (!(in = section_table(image, size, &num))) {
+      return NULL;
+    }
+    table = SNAPSHOT_HEADER_OFFSET + 2 * sizeof (uint32_t) + num * sizeof (*in);
+    for (offset = table, i = 0; i < num; i++) {
+      offset += pack_bound(in[i].size);
+    }
+    packed = (uint8_t *) malloc(offset);
+    memcpy(packed, image, table);
+    out = (snapshot_section_t *) (packed + (((uint8_t *) in) - image));
+
+    /* Rows of the grids delta against the row above, records against *
+     * the record before.                                               */
+    for (offset = table, i = 0; i < num; i++) {
+      if (in[i].offset > size || in[i].size > size - in[i].offset) {
+        free(packed);
+        return NULL;
+      }
+      stride = in[i].count ? in[i].size / in[i].count : 0;
+      out[i].offset = offset;
+      out[i].size = pack_bytes(image + in[i].offset, in[i].size, stride,
+                               packed + offset);
+      out[i].encoding = SNAPSHOT_PACKED;
+      offset += out[i].size;
+    }
+  }
+
+  set_image_header(packed, version | DUNGEON_SAVE_COMPRESSED, offset);
+  *packed_size = offset;
+
+  return packed;
+}
+
+uint8_t *save_image_unpack(const uint8_t *image, uint32_t size,
+                           uint32_t *unpacked_size)
+{
+  const snapshot_section_t *in;
+  snapshot_section_t *out;
+  uint8_t *unpacked;
+  uint32_t version, i, num, table, offset, n, used, block, rooms;
+
+  version = image_version(image);
+  if (!(version & DUNGEON_SAVE_COMPRESSED)) {
+    return NULL;
+  }
+  version &= ~DUNGEON_SAVE_COMPRESSED;
+
+  if (version == DUNGEON_LEVEL_VERSION) {
+    if (packed_info(image + LEVEL_HEADER, size - LEVEL_HEADER, &n, &used) ||
+        n != LEVEL_HARDNESS ||
+        packed_info(image + LEVEL_HEADER + used, size - LEVEL_HEADER - used,
+                    &rooms, &block) ||
+        LEVEL_HEADER + used + block != size || rooms % 4) {
+      return NULL;
+    }
+    offset = LEVEL_HEADER + LEVEL_HARDNESS + rooms;
+    unpacked = (uint8_t *) malloc(offset);
+    if (!unpack_bytes(image + LEVEL_HEADER, used,
+                      unpacked + LEVEL_HEADER, LEVEL_HARDNESS) ||
+        !unpack_bytes(image + LEVEL_HEADER + used, block,
+                      unpacked + LEVEL_HEADER + LEVEL_HARDNESS, rooms)) {
+      free(unpacked);
+      return NULL;
+    }
+  } else if (version == DUNGEON_SAVE_VERSION) {
+    if (!(in = section_table(image, size, &num))) {
+      return NULL;
+    }
+    table = SNAPSHOT_HEADER_OFFSET + 2 * sizeof (uint32_t) + num * sizeof (*in);
+    for (offset = align(table), i = 0; i < num; i++) {
+      if (in[i].encoding != SNAPSHOT_PACKED || in[i].offset > size ||
+          in[i].size > size - in[i].offset ||
+          packed_info(image + in[i].offset, in[i].size, &n, &block) ||
+          block != in[i].size) {
+        return NULL;
+      }
+      offset = align(offset + n);
+    }
+    unpacked = (uint8_t *) calloc(1, offset);
+    memcpy(unpacked, image, table);
+    out = (snapshot_section_t *) (unpacked + (((uint8_t *) in) - image));
+    for (offset = align(table), i = 0; i < num; i++) {
+      packed_info(image + in[i].offset, in[i].size, &n, &block);
+      if (!unpack_bytes(image + in[i].offset, in[i].size,
+                        unpacked + offset, n)) {
+        free(unpacked);
+        return NULL;
+      }
+      out[i].offset = offset;
+      out[i].size = n;
+      out[i].encoding = 0;
+      offset = align(offset + n);
+    }
+  } else {
+    return NULL;
+  }
+
+  set_image_header(unpacked, version, offset);
+  *unpacked_size = offset;
+
+  return unpacked;
+}
+
+/* Doesn't print anything, since it runs on the writer thread while *
+ * curses owns the terminal; on failure, errno says why.             */
+int save_file_write(const char *path, const uint8_t *image, uint32_t size)
+{
+  char *tmp, *dir, *slash;
+  ssize_t written;
+  uint32_t done;
+  int fd, err = 0;
+
+  tmp = (char *) malloc(strlen(path) + sizeof (".tmp"));
+  sprintf(tmp, "%s.tmp", path);
+
+  if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    free(tmp);
+
+    return 1;
+  }
+  for (done = 0; done < size; done += written) {
+    if ((written = write(fd, image + done, size - done)) < 0) {
+      if (errno == EINTR) {
+        written = 0;
+        continue;
+      }
+      break;
+    }
+  }
+  if (done < size || fsync(fd)) {
+    err = errno;
+    close(fd);
+    fd = -1;
+  }
+  if (fd < 0 || close(fd) || rename(tmp, path)) {
+    err = fd < 0 ? err : errno;
+    unlink(tmp);
+    free(tmp);
+    errno = err;
+
+    return 1;
+  }
+  free(tmp);
+
+  /* And the directory, so that the rename itself is durable. */
+  dir = strdup(path);
+  if ((slash = strrchr(dir, '/'))) {
+    *(slash == dir ? slash + 1 : slash) = '\0';
+  } else {
+    strcpy(dir, ".");
+  }
+  if ((fd = open(dir, O_RDONLY | O_DIRECTORY)) >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+  free(dir);
+
+  return 0;
+}
+
+int save_file_repack(const char *path, int compress)
+{
+  struct stat buf;
+  const uint8_t *image;
+  uint8_t *converted;
+  uint32_t size, version;
+  int fd, retval;
+
+  if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &buf)) {
+    perror(path);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return 1;
+  }
+  if (buf.st_size < 14 /* The semantic, version, and size */ ||
+      (image = (const uint8_t *) mmap(NULL, buf.st_size, PROT_READ,
+                                      MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+    fprintf(stderr, "%s: Not an RLG327 save file.\n", path);
+    close(fd);
+    return 1;
+  }
+  close(fd);
+
+  if (strncmp((const char *) image, DUNGEON_SAVE_SEMANTIC, 6)) {
+    fprintf(stderr, "%s: Not an RLG327 save file.\n", path);
+    munmap((void *) image, buf.st_size);
+    return 1;
+  }
+
+  version = image_version(image);
+  if (!(version & DUNGEON_SAVE_COMPRESSED) == !compress) {
+    /* Already in the format asked for */
+    munmap((void *) image, buf.st_size);
+    return 0;
+  }
+
+  converted = (compress                                          ?
+               save_image_pack(image, buf.st_size, &size)        :
+               save_image_unpack(image, buf.st_size, &size));
+  munmap((void *) image, buf.st_size);
+  if (!converted) {
+    fprintf(stderr, "%s: Corrupt save file.\n", path);
+    return 1;
+  }
+
+  if ((retval = save_file_write(path, converted, size))) {
+    perror(path);
+  }
+  free(converted);
+
+  return retval;
+}
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_t thread;
+  uint32_t running;
+  uint32_t restart; /* Forked while running; start a writer on demand */
+  uint32_t stopping;
+  uint32_t failures;
+  int error;       /* errno of the last failure */
+  char *path;      /* The pending save, if any */
+  uint8_t *image;
+  uint32_t size;
+} autosave = {
+  PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_COND_INITIALIZER
+};
+
+static void *autosave_main(void *unused)
+{
+  char *path;
+  uint8_t *image;
+  uint32_t size;
+  int i;
+
+  pthread_mutex_lock(&autosave.lock);
+  for (;;) {
+    while (!autosave.image && !autosave.stopping) {
+      pthread_cond_wait(&autosave.wake, &autosave.lock);
+    }
+    if (!autosave.image) {
+      break;
+    }
+    path = autosave.path;
+    image = autosave.image;
+    size = autosave.size;
+    autosave.path = NULL;
+    autosave.image = NULL;
+    pthread_mutex_unlock(&autosave.lock);
+
+    i = save_file_write(path, image, size);
+    free(path);
+    free(image);
+
+    pthread_mutex_lock(&autosave.lock);
+    if (i) {
+      autosave.failures++;
+      autosave.error = errno;
+    }
+  }
+  pthread_mutex_unlock(&autosave.lock);
+
+  return NULL;
+}
+
+/* fork() copies only the calling thread, so a child gets the writer's *
+ * state without the writer.  Holding the lock across the fork means   *
+ * the child's copy of it is consistent; the child then starts again   *
+ * with no thread, and makes a new one if it ever saves.               */
+static void autosave_prepare(void)
+{
+  pthread_mutex_lock(&autosave.lock);
+}
+
+static void autosave_parent(void)
+{
+  pthread_mutex_unlock(&autosave.lock);
+}
+
+static void autosave_child(void)
+{
+  pthread_mutex_init(&autosave.lock, NULL);
+  pthread_cond_init(&autosave.wake, NULL);
+  autosave.restart = autosave.running;
+  autosave.running = 0;
+  free(autosave.path);
+  free(autosave.image);
+  autosave.path = NULL;
+  autosave.image = NULL;
+}
+
+static void autosave_register_fork(void)
+{
+  pthread_atfork(autosave_prepare, autosave_parent, autosave_child);
+}
+
+int autosave_start(void)
+{
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+  if (autosave.running) {
+    return 0;
+  }
+
+  pthread_once(&once, autosave_register_fork);
+
+  autosave.stopping = 0;
+  autosave.failures = 0;
+  if (create_thread(&autosave.thread, autosave_main, NULL)) {
+    fprintf(stderr, "Couldn't start the autosave thread.\n");
+    return 1;
+  }
+  autosave.running = 1;
+
+  return 0;
+}
+
+int autosave_submit(char *path, uint8_t *image, uint32_t size)
+{
+  if (!autosave.running && autosave.restart) {
+    autosave.restart = 0;
+    autosave_start();
+  }
+  if (!autosave.running) {
+    free(path);
+    free(image);
+
+    return 1;
+  }
+
+  pthread_mutex_lock(&autosave.lock);
+  free(autosave.path);
+  free(autosave.image);
+  autosave.path = path;
+  autosave.image = image;
+  autosave.size = size;
+  pthread_cond_signal(&autosave.wake);
+  pthread_mutex_unlock(&autosave.lock);
+
+  return 0;
+}
+
+int autosave_stop(void)
+{
+  if (!autosave.running) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&autosave.lock);
+  autosave.stopping = 1;
+  pthread_cond_signal(&autosave.wake);
+  pthread_mutex_unlock(&autosave.lock);
+
+  pthread_join(autosave.thread, NULL);
+  autosave.running = 0;
+
+  if (autosave.failures) {
+    fprintf(stderr, "%u autosave%s failed: %s\n", autosave.failures,
+            autosave.failures == 1 ? "" : "s", strerror(autosave.error));
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,134 @@
+#ifndef SAVE_H
+# define SAVE_H
+
+# include <stdint.h>
+
+# include "dims.h"
+# include "utils.h"
+# include "object.h"
+
+typedef struct dungeon dungeon_t;
+
+/* Version 1 save files are full snapshots of a game in progress.  After *
+ * the usual big-endian "RLG327", version and size comes a section       *
+ * table at SNAPSHOT_HEADER_OFFSET, then the sections themselves, each   *
+ * aligned to SNAPSHOT_ALIGN.  Every section is an array of fixed-size   *
+ * records in native byte order, with a marker to catch a foreign one,  *
+ * so the loader reads the whole file at once and works in place: grids *
+ * go in a row at a time, and records only need their description       *
+ * indices turned back into pointers before being linked into the       *
+ * charmap, the object piles, the PC's equipment and the turn heap.      */
+
+# define SNAPSHOT_BYTE_ORDER    0x01020304
+# define SNAPSHOT_HEADER_OFFSET 16
+# define SNAPSHOT_ALIGN         8
+
+typedef enum snapshot_section_id {
+  snap_game,
+  snap_rooms,
+  snap_map,
+  snap_hardness,
+  snap_known,
+  snap_npcs,
+  snap_objects,
+  snap_level,
+  num_snapshot_sections
+} snapshot_section_id_t;
+
+# define SNAPSHOT_PACKED        1 /* Section is a codec.h block */
+
+typedef struct snapshot_section {
+  uint32_t offset;   /* From the start of the file          */
+  uint32_t size;     /* In bytes, as stored                 */
+  uint32_t count;    /* Records                             */
+  uint32_t encoding; /* 0 for plain records, or SNAPSHOT_PACKED */
+} snapshot_section_t;
+
+/* Readers ignore sections beyond the ones they know about. */
+typedef struct snapshot_header {
+  uint32_t byte_order;
+  uint32_t num_sections;
+  snapshot_section_t section[num_snapshot_sections];
+} snapshot_header_t;
+
+typedef struct snapshot_game {
+  uint32_t character_sequence_number;
+  uint16_t num_monsters;
+  uint16_t nummon_beaten;
+  uint16_t max_monsters;
+  uint16_t num_objects;
+  uint16_t max_objects;
+  int8_t pc_position[2];
+  int32_t pc_speed;
+  uint32_t pc_next_turn;
+  int32_t pc_hp;
+  rng_t rng;
+} snapshot_game_t;
+
+/* NPCs in the turn heap.  The heap orders by next_turn, then by     *
+ * sequence_number, which is unique, so reinserting them gives back *
+ * exactly the same turn order.                                     */
+typedef struct snapshot_npc {
+  uint32_t description;  /* Index into monster_descriptions */
+  int8_t position[2];
+  int8_t pc_last_known_position[2];
+  int32_t speed;
+  uint32_t next_turn;
+  int32_t hp;
+  uint32_t sequence_number;
+  uint32_t characteristics;
+  uint32_t have_seen_pc;
+} snapshot_npc_t;
+
+typedef enum snapshot_location {
+  snap_floor,
+  snap_equipment,
+  snap_inventory
+} snapshot_location_t;
+
+/* Floor piles are stored top to bottom. */
+typedef struct snapshot_object {
+  uint32_t description;  /* Index into object_descriptions */
+  uint8_t location;
+  uint8_t slot;          /* eq or in slot, when not on the floor */
+  int8_t position[2];
+  object_stats_t stats;
+  uint32_t seen;
+} snapshot_object_t;
+
+typedef struct snapshot_level {
+  uint32_t depth;
+} snapshot_level_t;
+
+uint8_t *snapshot_save(dungeon_t *d, uint32_t *size);
+int snapshot_load(dungeon_t *d, const uint8_t *image, uint32_t size);
+
+/* Compressed save files set DUNGEON_SAVE_COMPRESSED in the version  *
+ * word.  A compressed level packs its hardness and its rooms as two   *
+ * codec.h blocks after the usual 14 bytes; a compressed snapshot      *
+ * keeps its section table and packs each section, unaligned.  These  *
+ * convert whole file images either way; a plain image is returned as *
+ * a copy from save_image_pack(), and NULL from save_image_unpack().   */
+uint8_t *save_image_pack(const uint8_t *image, uint32_t size,
+                         uint32_t *packed_size);
+uint8_t *save_image_unpack(const uint8_t *image, uint32_t size,
+                           uint32_t *unpacked_size);
+
+/* Replaces path with image all at once: the bytes go to a temporary *
+ * file in the same directory, which is synced and renamed over it.  *
+ * A crash leaves either the old file or the new one, never a mix.   */
+int save_file_write(const char *path, const uint8_t *image, uint32_t size);
+
+/* Rewrites a save file in place, compressed or not. */
+int save_file_repack(const char *path, int compress);
+
+/* The autosave writer thread.  autosave_submit() takes ownership of  *
+ * path and image and returns at once; if the writer is still busy    *
+ * with an earlier save, a pending one that hasn't started is simply  *
+ * replaced, since only the newest matters.  autosave_stop() writes   *
+ * out whatever is pending, joins the thread, and reports any failure. */
+int autosave_start(void);
+int autosave_submit(char *path, uint8_t *image, uint32_t size);
+int autosave_stop(void);
+
+#endif
@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "sim.h"
+#include "dungeon.h"
+#include "corpus.h"
+#include "move.h"
+#include "npc.h"
+#include "pc.h"
+#include "io.h"
+
+/* A host for many headless games at once.  Each worker thread owns a *
+ * deque of games; it runs the game at the bottom for a quantum, then *
+ * pushes it back.  A worker whose deque runs dry steals from the top *
+ * of someone else's.  Games never share mutable state: each has its  *
+ * own dungeon, PC, turn heap, descriptions and random stream, so the *
+ * results for a seed do not depend on the thread count or on which   *
+ * thread ran what.                                                    */
+
+typedef struct sim_deque {
+  pthread_mutex_t lock;
+  uint32_t *slot;
+  uint32_t head, count, capacity;
+} sim_deque_t;
+
+typedef struct sim_host {
+  dungeon_t *config;
+  sim_game_t *games;
+  sim_deque_t *deques;
+  uint32_t num_games;
+  uint32_t num_deques;
+  uint32_t max_turns;
+  uint32_t done;
+} sim_host_t;
+
+typedef struct sim_worker {
+  sim_host_t *host;
+  uint32_t id;
+  uint32_t steals;
+} sim_worker_t;
+
+static const char *outcome_name[] = {
+  "running",
+  "killed",
+  "cleared",
+  "timed out"
+};
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void sim_deque_init(sim_deque_t *q, uint32_t capacity)
+{
+  pthread_mutex_init(&q->lock, NULL);
+  q->slot = (uint32_t *) malloc(capacity * sizeof (*q->slot));
+  q->head = q->count = 0;
+  q->capacity = capacity;
+}
+
+static void sim_deque_delete(sim_deque_t *q)
+{
+  pthread_mutex_destroy(&q->lock);
+  free(q->slot);
+}
+
+static void sim_push_bottom(sim_deque_t *q, uint32_t game)
+{
+  pthread_mutex_lock(&q->lock);
+  q->slot[(q->head + q->count++) % q->capacity] = game;
+  pthread_mutex_unlock(&q->lock);
+}
+
+static int sim_pop_bottom(sim_deque_t *q, uint32_t *game)
+{
+  int found;
+
+  pthread_mutex_lock(&q->lock);
+  if ((found = !!q->count)) {
+    *game = q->slot[(q->head + --q->count) % q->capacity];
+  }
+  pthread_mutex_unlock(&q->lock);
+
+  return found;
+}
+
+static int sim_steal_top(sim_deque_t *q, uint32_t *game)
+{
+  int found;
+
+  pthread_mutex_lock(&q->lock);
+  if ((found = !!q->count)) {
+    *game = q->slot[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+  }
+  pthread_mutex_unlock(&q->lock);
+
+  return found;
+}
+
+/* The same start as an interactive game run with --rand <seed>. */
+static void sim_start_game(sim_game_t *g, dungeon_t *config)
+{
+  dungeon_t *d;
+
+  g->d = d = new dungeon_t();
+  d->max_monsters = config->max_monsters;
+  d->max_objects = config->max_objects;
+  /* The text stays in config's arena, which outlives the games and *
+   * is never written once they start.                               */
+  d->monster_descriptions = config->monster_descriptions;
+  d->object_descriptions = config->object_descriptions;
+
+  rng_seed(g->seed);
+  init_dungeon(d);
+  gen_dungeon(d);
+  config_pc(d);
+  gen_monsters(d, d->max_monsters, 0);
+  gen_objects(d, d->max_objects);
+}
+
+static void sim_end_game(sim_game_t *g, sim_outcome_t outcome)
+{
+  dungeon_t *d = g->d;
+
+  g->outcome = outcome;
+  g->nummon_beaten = d->nummon_beaten;
+  if (outcome == sim_killed) {
+    snprintf(g->cause_of_death, sizeof (g->cause_of_death), "%s",
+             d->pc_killed_by ? d->pc_killed_by : "unknown");
+  }
+
+  delete_pc(d->the_pc);
+  delete_dungeon(d);
+  destroy_descriptions(d);
+  delete d;
+  g->d = NULL;
+}
+
+/* Runs up to SIM_QUANTUM PC turns.  Returns non-zero once the game *
+ * is over.                                                         */
+static int sim_run_game(sim_game_t *g, sim_host_t *host)
+{
+  dungeon_t *d;
+  rng_t *old;
+  uint32_t i;
+
+  old = rng_bind(&g->rng);
+
+  if (!g->d) {
+    sim_start_game(g, host->config);
+  }
+  d = g->d;
+
+  for (i = 0; i < SIM_QUANTUM && g->outcome == sim_running; i++) {
+    if (!dungeon_has_npcs(d)) {
+      sim_end_game(g, sim_cleared);
+    } else if (g->turns >= host->max_turns) {
+      sim_end_game(g, sim_timed_out);
+    } else {
+      do_npc_moves(d);
+      if (!pc_is_alive(d)) {
+        sim_end_game(g, sim_killed);
+      } else {
+        character_next_turn(d, PC_ID);
+        move_pc(d, pc_auto_move(d));
+        g->turns++;
+      }
+    }
+  }
+
+  io_clear_messages();
+  rng_bind(old);
+
+  return g->outcome != sim_running;
+}
+
+static void *sim_worker_main(void *v)
+{
+  sim_worker_t *w = (sim_worker_t *) v;
+  sim_host_t *host = w->host;
+  uint32_t game, i;
+  int found;
+
+  while (__atomic_load_n(&host->done, __ATOMIC_ACQUIRE) < host->num_games) {
+    found = sim_pop_bottom(host->deques + w->id, &game);
+    for (i = 1; !found && i < host->num_deques; i++) {
+      if ((found = sim_steal_top(host->deques + ((w->id + i) %
+                                                 host->num_deques),
+                                 &game))) {
+        w->steals++;
+      }
+    }
+    if (!found) {
+      /* Everything left is being run by someone else right now. */
+      sched_yield();
+      continue;
+    }
+
+    if (sim_run_game(host->games + game, host)) {
+      __atomic_fetch_add(&host->done, 1, __ATOMIC_RELEASE);
+    } else {
+      sim_push_bottom(host->deques + w->id, game);
+    }
+  }
+
+  return NULL;
+}
+
+static int compare_causes(const void *v1, const void *v2)
+{
+  return strcmp(*(const char * const *) v1, *(const char * const *) v2);
+}
+
+static void sim_report(sim_host_t *host, double seconds, uint32_t threads,
+                       uint32_t steals)
+{
+  uint32_t i, j, n, outcomes[4];
+  uint64_t turns, beaten;
+  uint32_t max_turns, max_beaten;
+  const char **causes;
+
+  memset(outcomes, 0, sizeof (outcomes));
+  turns = beaten = max_turns = max_beaten = 0;
+  causes = (const char **) malloc(host->num_games * sizeof (*causes));
+
+  for (n = i = 0; i < host->num_games; i++) {
+    outcomes[host->games[i].outcome]++;
+    turns += host->games[i].turns;
+    beaten += host->games[i].nummon_beaten;
+    if (host->games[i].turns > max_turns) {
+      max_turns = host->games[i].turns;
+    }
+    if (host->games[i].nummon_beaten > max_beaten) {
+      max_beaten = host->games[i].nummon_beaten;
+    }
+    if (host->games[i].outcome == sim_killed) {
+      causes[n++] = host->games[i].cause_of_death;
+    }
+  }
+
+  printf("%u games on %u threads in %.2fs: %.1f games/s, "
+         "%.0f PC turns/s, %u steals\n",
+         host->num_games, threads, seconds, host->num_games / seconds,
+         turns / seconds, steals);
+  printf("  killed %u, cleared %u, timed out %u\n",
+         outcomes[sim_killed], outcomes[sim_cleared], outcomes[sim_timed_out]);
+  printf("  turns survived:  mean %.1f, max %u\n",
+         (double) turns / host->num_games, max_turns);
+  printf("  monsters beaten: mean %.2f, max %u\n",
+         (double) beaten / host->num_games, max_beaten);
+
+  if (n) {
+    printf("  causes of death:\n");
+    qsort(causes, n, sizeof (*causes), compare_causes);
+    for (i = 0; i < n; i = j) {
+      for (j = i + 1; j < n && !strcmp(causes[i], causes[j]); j++)
+        ;
+      printf("    %5u  %s\n", j - i, causes[i]);
+    }
+  }
+
+  free(causes);
+}
+
+static int sim_write_csv(sim_host_t *host, const char *file)
+{
+  FILE *f;
+  uint32_t i;
+
+  if (!(f = fopen(file, "w"))) {
+    perror(file);
+    return 1;
+  }
+
+  fprintf(f, "game,seed,outcome,turns,nummon_beaten,cause_of_death\n");
+  for (i = 0; i < host->num_games; i++) {
+    fprintf(f, "%u,%u,%s,%u,%u,\"%s\"\n", i, host->games[i].seed,
+            outcome_name[host->games[i].outcome], host->games[i].turns,
+            host->games[i].nummon_beaten, host->games[i].cause_of_death);
+  }
+
+  fclose(f);
+
+  return 0;
+}
+
+int run_simulations(dungeon_t *config, uint32_t count, uint32_t threads,
+                    uint32_t base_seed, uint32_t max_turns,
+                    const char *csv_file)
+{
+  sim_host_t host;
+  sim_worker_t *workers;
+  pthread_t *pool;
+  uint32_t i, started, steals;
+  double t;
+  int retval;
+
+  if (!threads) {
+    threads = 1;
+  }
+
+  host.config = config;
+  host.num_games = count;
+  host.num_deques = threads;
+  host.max_turns = max_turns;
+  host.done = 0;
+  host.games = (sim_game_t *) calloc(count, sizeof (*host.games));
+  host.deques = (sim_deque_t *) malloc(threads * sizeof (*host.deques));
+
+  /* Level i is the same level --generate writes as <seed>.rlg327 */
+  for (i = 0; i < count; i++) {
+    host.games[i].seed = corpus_level_seed(base_seed, i);
+  }
+  for (i = 0; i < threads; i++) {
+    sim_deque_init(host.deques + i, count);
+  }
+  for (i = 0; i < count; i++) {
+    sim_push_bottom(host.deques + (i % threads), i);
+  }
+
+  workers = (sim_worker_t *) calloc(threads, sizeof (*workers));
+  pool = (pthread_t *) malloc(threads * sizeof (*pool));
+
+  for (i = 0; i < threads; i++) {
+    workers[i].host = &host;
+    workers[i].id = i;
+  }
+
+  t = now();
+  for (started = 0; started < threads; started++) {
+    if (pthread_create(pool + started, NULL, sim_worker_main,
+                       workers + started)) {
+      perror("pthread_create");
+      break;
+    }
+  }
+  if (!started) {
+    sim_worker_main(workers);
+  }
+  for (i = 0; i < started; i++) {
+    pthread_join(pool[i], NULL);
+  }
+  t = now() - t;
+
+  for (steals = i = 0; i < threads; i++) {
+    steals += workers[i].steals;
+    sim_deque_delete(host.deques + i);
+  }
+
+  sim_report(&host, t, started ? started : 1, steals);
+  retval = csv_file ? sim_write_csv(&host, csv_file) : 0;
+
+  free(pool);
+  free(workers);
+  free(host.deques);
+  free(host.games);
+
+  return retval;
+}
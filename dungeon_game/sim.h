@@ -0,0 +1,39 @@
+#ifndef SIM_H
+# define SIM_H
+
+# include <stdint.h>
+
+# include "utils.h"
+
+typedef struct dungeon dungeon_t;
+
+/* PC turns a game runs before going back on its worker's deque.  Small *
+ * enough that long games are split up for stealing, large enough that *
+ * the deque locks are noise.                                           */
+# define SIM_QUANTUM 64
+
+typedef enum sim_outcome {
+  sim_running,
+  sim_killed,    /* PC died                   */
+  sim_cleared,   /* Every monster was beaten  */
+  sim_timed_out  /* Hit the turn limit        */
+} sim_outcome_t;
+
+/* One headless game.  Everything it touches is reachable from here,     *
+ * including its random stream, so it can be stepped by whichever       *
+ * thread gets to it next and still play out exactly the same way.       */
+typedef struct sim_game {
+  dungeon_t *d;
+  rng_t rng;
+  uint32_t seed;
+  uint32_t turns;
+  uint32_t nummon_beaten;
+  sim_outcome_t outcome;
+  char cause_of_death[80];
+} sim_game_t;
+
+int run_simulations(dungeon_t *config, uint32_t count, uint32_t threads,
+                    uint32_t base_seed, uint32_t max_turns,
+                    const char *csv_file);
+
+#endif
@@ -0,0 +1,108 @@
+#include "spawn.h"
+#include "dungeon.h"
+#include "descriptions.h"
+#include "utils.h"
+
+void alias_table::build(const std::vector<uint32_t> &weight)
+{
+  std::vector<uint64_t> scaled;
+  std::vector<uint32_t> small, large;
+  uint64_t total;
+  uint32_t i, n, s, l;
+
+  n = weight.size();
+  threshold.assign(n, ALIAS_ONE);
+  alias.resize(n);
+  for (total = i = 0; i < n; i++) {
+    alias[i] = i;
+    total += weight[i];
+  }
+  if (!total) {
+    return;
+  }
+
+  /* Scaled by n, a weight of exactly total fills one column. */
+  scaled.resize(n);
+  for (i = 0; i < n; i++) {
+    scaled[i] = (uint64_t) weight[i] * n;
+    if (scaled[i] < total) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+
+  /* Each short column is topped up from a tall one, which may then be *
+   * short itself.  Whatever is left over is full, up to rounding.     */
+  while (!small.empty() && !large.empty()) {
+    s = small.back();
+    small.pop_back();
+    l = large.back();
+    threshold[s] = (scaled[s] << 31) / total;
+    alias[s] = l;
+    scaled[l] -= total - scaled[s];
+    if (scaled[l] < total) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+}
+
+uint32_t alias_table::sample() const
+{
+  uint32_t i;
+
+  i = rng_rand() % threshold.size();
+
+  return (uint32_t) rng_rand() < threshold[i] ? i : alias[i];
+}
+
+/* Its rarity within its depths, and nothing outside them */
+template <class description>
+static void spawn_build(alias_table *t, const std::vector<description> &v,
+                        uint32_t depth)
+{
+  std::vector<uint32_t> weight(v.size());
+  uint32_t i, total;
+
+  for (total = i = 0; i < v.size(); i++) {
+    if (depth >= v[i].get_min_depth() && depth <= v[i].get_max_depth()) {
+      weight[i] = v[i].get_rarity();
+      total += weight[i];
+    }
+  }
+
+  /* Nothing belongs this deep; better anything than nothing. */
+  if (!total) {
+    for (i = 0; i < v.size(); i++) {
+      weight[i] = v[i].get_rarity();
+    }
+  }
+
+  t->build(weight);
+}
+
+void spawn_prepare(dungeon_t *d)
+{
+  if (d->monster_spawn.size() != d->monster_descriptions.size() ||
+      d->object_spawn.size() != d->object_descriptions.size() ||
+      d->spawn_depth != d->depth) {
+    spawn_build(&d->monster_spawn, d->monster_descriptions, d->depth);
+    spawn_build(&d->object_spawn, d->object_descriptions, d->depth);
+    d->spawn_depth = d->depth;
+  }
+}
+
+uint32_t spawn_monster(dungeon_t *d)
+{
+  spawn_prepare(d);
+
+  return d->monster_spawn.sample();
+}
+
+uint32_t spawn_object(dungeon_t *d)
+{
+  spawn_prepare(d);
+
+  return d->object_spawn.sample();
+}
@@ -0,0 +1,42 @@
+#ifndef SPAWN_H
+# define SPAWN_H
+
+# include <stdint.h>
+# include <vector>
+
+typedef struct dungeon dungeon_t;
+
+/* Walker's alias method: after an O(n) build, drawing from any discrete *
+ * distribution takes one column pick and one biased coin flip, however  *
+ * many outcomes there are.  Each column holds its own outcome with      *
+ * probability threshold / 2^31 and its alias otherwise; the build fills *
+ * the columns so that every outcome's share, summed over the columns    *
+ * it appears in, is its weight over the total.                          *
+ *                                                                       *
+ * Weights are integers and so is the build, so a table, and every draw *
+ * from it, is the same on any machine.  The weights' total must fit in  *
+ * 32 bits; all zeros gives a uniform table.  An all-zero table is a    *
+ * valid empty one, since dungeon_t gets memset().                       */
+
+# define ALIAS_ONE 0x80000000U /* Threshold of a column that never aliases */
+
+class alias_table {
+ private:
+  std::vector<uint32_t> threshold;
+  std::vector<uint32_t> alias;
+ public:
+  void build(const std::vector<uint32_t> &weight);
+  uint32_t sample() const;
+  inline uint32_t size() const { return threshold.size(); }
+  inline void clear() { threshold.clear(); alias.clear(); }
+};
+
+/* The spawn tables are built from the descriptions' rarities, for the  *
+ * current depth (see descriptions.h), the first time they're needed    *
+ * and again whenever the depth changes.  destroy_descriptions() clears *
+ * them, so that new descriptions get new tables.                       */
+void spawn_prepare(dungeon_t *d);
+uint32_t spawn_monster(dungeon_t *d);
+uint32_t spawn_object(dungeon_t *d);
+
+#endif
@@ -3,6 +3,7 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <stdio.h>
+#include <signal.h>
 
 #include "utils.h"
 
@@ -40,3 +41,97 @@ int makedirectory(char *dir)
 
   return 0;
 }
+
+static __thread rng_t rng_thread;
+static __thread rng_t *rng_bound;
+
+void rng_seed_r(rng_t *r, uint32_t seed)
+{
+  int32_t word, hi, lo;
+  uint32_t i;
+
+  /* Park and Miller's minimal standard generator fills the state, *
+   * without overflowing 32 bits, exactly as srandom() does.        */
+  r->state[0] = word = seed ? seed : 1;
+  for (i = 1; i < RNG_DEG; i++) {
+    hi = word / 127773;
+    lo = word % 127773;
+    word = 16807 * lo - 2836 * hi;
+    if (word < 0) {
+      word += 2147483647;
+    }
+    r->state[i] = word;
+  }
+  r->front = RNG_SEP;
+  r->rear = 0;
+  r->seeded = 1;
+
+  for (i = 0; i < 10 * RNG_DEG; i++) {
+    rng_rand_r(r);
+  }
+}
+
+int32_t rng_rand_r(rng_t *r)
+{
+  uint32_t result;
+
+  r->state[r->front] += r->state[r->rear];
+  result = r->state[r->front] >> 1;
+  if (++r->front == RNG_DEG) {
+    r->front = 0;
+  }
+  if (++r->rear == RNG_DEG) {
+    r->rear = 0;
+  }
+
+  return result;
+}
+
+rng_t *rng_bind(rng_t *r)
+{
+  rng_t *old;
+
+  old = rng_bound;
+  rng_bound = r;
+
+  return old;
+}
+
+/* The generator rng_rand() would use right now. */
+rng_t *rng_current(void)
+{
+  return rng_bound ? rng_bound : &rng_thread;
+}
+
+void rng_seed(uint32_t seed)
+{
+  rng_seed_r(rng_bound ? rng_bound : &rng_thread, seed);
+}
+
+/* Like rand(), an unseeded generator behaves as if seeded with 1. */
+int32_t rng_rand(void)
+{
+  rng_t *r;
+
+  r = rng_bound ? rng_bound : &rng_thread;
+  if (__builtin_expect(!r->seeded, 0)) {
+    rng_seed_r(r, 1);
+  }
+
+  return rng_rand_r(r);
+}
+
+int create_thread(pthread_t *thread, void *(*start)(void *), void *arg)
+{
+  sigset_t s, old;
+  int err;
+
+  /* The new thread inherits the mask it's created with */
+  sigemptyset(&s);
+  sigaddset(&s, SIGALRM);
+  pthread_sigmask(SIG_BLOCK, &s, &old);
+  err = pthread_create(thread, NULL, start, arg);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  return err;
+}
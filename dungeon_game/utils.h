@@ -2,15 +2,47 @@
 # define UTILS_H
 
 # include <cstdlib>
+# include <stdint.h>
+# include <pthread.h>
+
+/* A reentrant stand-in for rand() and srand().  It is the same additive *
+ * feedback generator that glibc uses behind rand(), so a given seed     *
+ * still produces the same dungeon, but the state lives in an rng_t      *
+ * instead of in libc.  rng_rand() and rng_seed() use a per-thread       *
+ * generator; concurrent simulations on different threads get their own *
+ * streams and never perturb one another.  rng_bind() points the        *
+ * calling thread at some other generator (NULL restores its own), so a *
+ * game can carry its stream with it from thread to thread.             */
+# define RNG_MAX 0x7fffffff
+# define RNG_DEG 31
+# define RNG_SEP 3
+
+typedef struct rng {
+  uint32_t state[RNG_DEG];
+  uint32_t front, rear;
+  uint32_t seeded;
+} rng_t;
+
+void rng_seed_r(rng_t *r, uint32_t seed);
+int32_t rng_rand_r(rng_t *r);
+void rng_seed(uint32_t seed);
+int32_t rng_rand(void);
+rng_t *rng_bind(rng_t *r);
+rng_t *rng_current(void);
 
 /* Returns true if random float in [0,1] is less than *
  * numerator/denominator.  Uses only integer math.    */
 # define rand_under(numerator, denominator) \
-  (rand() < ((RAND_MAX / denominator) * numerator))
+  (rng_rand() < ((RNG_MAX / denominator) * numerator))
 
 /* Returns random integer in [min, max]. */
-# define rand_range(min, max) ((rand() % (((max) + 1) - (min))) + (min))
+# define rand_range(min, max) ((rng_rand() % (((max) + 1) - (min))) + (min))
 
 int makedirectory(char *dir);
 
+/* pthread_create() with SIGALRM blocked in the new thread.  The redraw *
+ * timer (see io.cpp) goes to the whole process, and its handler draws  *
+ * the dungeon, so it has to land on the thread that plays the game.    */
+int create_thread(pthread_t *thread, void *(*start)(void *), void *arg);
+
 #endif